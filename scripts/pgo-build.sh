@@ -0,0 +1,172 @@
+#!/bin/sh
+### pgo-build.sh
+### Builds a profile-guided and link-time optimized gUki.
+###
+### An instrumented build is trained on a scratch copy of a workspace, padded
+### with synthetic pages, and then rebuilt in the same folder with the profile
+### it recorded. (GCC matches the profiles to the object files by their path)
+### Finally both the optimized build and a plain Release build are benchmarked.
+###
+### Usage: scripts/pgo-build.sh WORKSPACE [GTK_VERSION]
+###
+### Environment:
+###   BUILD_DIR     Folder of the optimized build. (build-pgo)
+###   BASELINE_DIR  Release build it's compared to. (build-release)
+###   SOAK_CYCLES   Page switches done by the soak part of the training. (300)
+###   LLVM_PROFDATA Tool used to merge the profiles of Clang. (llvm-profdata)
+###
+### Author: Nathan Campos <hi@nathancampos.me>
+
+set -e
+
+if [ -z "$1" ] || [ ! -d "$1" ]; then
+	echo "Usage: $0 WORKSPACE [GTK_VERSION]" >&2
+	exit 1
+fi
+
+root="$(cd "$(dirname "$0")/.." && pwd)"
+workspace="$(cd "$1" && pwd)"
+gtk_version="${2:-3}"
+build_dir="${BUILD_DIR:-$root/build-pgo}"
+baseline_dir="${BASELINE_DIR:-$root/build-release}"
+profile_dir="$build_dir/pgo-profile"
+soak_cycles="${SOAK_CYCLES:-300}"
+llvm_profdata="${LLVM_PROFDATA:-llvm-profdata}"
+
+# Keep the training away from the session and caches of the user.
+scratch="$(mktemp -d)"
+trap 'rm -rf "$scratch"' EXIT
+export XDG_CACHE_HOME="$scratch/cache"
+export XDG_CONFIG_HOME="$scratch/config"
+wiki="$scratch/wiki"
+cp -R "$workspace" "$wiki"
+
+# Puts the workspace back the way it was before anything was saved to it.
+reset_workspace() {
+	rm -rf "$wiki"
+	cp -R "$scratch/pristine" "$wiki"
+}
+
+# Runs the graphical interface, on a virtual display if there isn't one.
+gui() {
+	if [ -n "$DISPLAY" ] || [ -n "$WAYLAND_DISPLAY" ]; then
+		"$@"
+	elif command -v xvfb-run >/dev/null 2>&1; then
+		xvfb-run -a "$@"
+	else
+		echo "No display available, skipping: $*" >&2
+		return 0
+	fi
+}
+
+# Pads the workspace with pages that exercise the slow paths.
+add_synthetic_pages() {
+	pages="$wiki/articles/pgo-training"
+	[ -d "$wiki/articles" ] || return 0
+	mkdir -p "$pages"
+
+	i=0
+	while [ $i -lt 50 ]; do
+		{
+			echo "<h1>Training page $i</h1>"
+			j=0
+			while [ $j -lt 200 ]; do
+				echo "<p>Paragraph $j of page $i links to" \
+					"<a href=\"page-$(( (i + j) % 50 )).html\">another" \
+					"page</a> and has some <b>bold</b> text.</p>"
+				j=$((j + 1))
+			done
+		} > "$pages/page-$i.html"
+		i=$((i + 1))
+	done
+
+	# A page with a very long line and a legacy encoded one.
+	awk 'BEGIN { for (i = 0; i < 5000; i++) printf "<span>%d</span>", i;
+		print "" }' > "$pages/long-lines.html"
+	printf '<p>Caf\351 cr\350me br\373l\351e</p>\n' > "$pages/latin1.html"
+}
+
+# Writes an action log that visits, edits, searches, and saves some pages.
+write_action_log() {
+	"$1" --workspace "$wiki" --list | awk -F '\t' '
+		BEGIN { print "# gUki action log v1"; t = 0 }
+		$1 == "article" && n < 20 {
+			t += 200000; print t "\tselect_page\t0\t0\t" $2
+			t += 100000; print t "\tswitch_tab\t1\t0\t"
+			t += 100000; print t "\tinsert_text\t0\t6\ttrain "
+			t += 100000; print t "\tfind_next\t0\t1\t<p>"
+			t += 100000; print t "\tsave_page\t0\t0\t"
+			t += 100000; print t "\tswitch_tab\t0\t0\t"
+			n++
+		}' > "$2"
+}
+
+# Runs the training workload.
+train() {
+	bin="$1"
+	first="$("$bin" --workspace "$wiki" --list | awk -F '\t' \
+		'$1 == "article" { print $2 }' | head -n 10)"
+
+	# Headless operations. (Finding nothing or finding problems isn't a
+	# failure of the training)
+	"$bin" --workspace "$wiki" --list > /dev/null
+	"$bin" --workspace "$wiki" --search "the" > /dev/null || true
+	"$bin" --workspace "$wiki" --search "LINK" --ignore-case > /dev/null || true
+	"$bin" --workspace "$wiki" --orphans --broken-links > /dev/null || true
+	"$bin" --workspace "$wiki" --export "$scratch/export" > /dev/null
+	"$bin" --workspace "$wiki" --export "$scratch/export" > /dev/null
+	echo "$first" | while read -r page; do
+		[ -n "$page" ] || continue
+		"$bin" --workspace "$wiki" --backlinks "$page" > /dev/null
+		"$bin" --workspace "$wiki" --bench-render "$page" \
+			--iterations 20 > /dev/null
+	done
+
+	# Navigating, rendering, searching, editing, and saving in the interface.
+	write_action_log "$bin" "$scratch/actions.log"
+	gui "$bin" --new-instance --workspace "$wiki" \
+		--replay "$scratch/actions.log" > /dev/null || true
+	gui "$bin" --new-instance --workspace "$wiki" \
+		--soak "$soak_cycles" > /dev/null || true
+}
+
+# Benchmarks a build on the same workspace every time. (The replay saves)
+bench() {
+	bin="$1"
+	reset_workspace
+	page="$("$bin" --workspace "$wiki" --list | awk -F '\t' \
+		'$1 == "article" { print $2; exit }')"
+
+	echo "== $bin"
+	"$bin" --workspace "$wiki" --bench-render "$page" --iterations 200
+	gui "$bin" --new-instance --workspace "$wiki" \
+		--replay "$scratch/actions.log" || true
+}
+
+add_synthetic_pages
+cp -R "$wiki" "$scratch/pristine"
+
+# Instrumented build and its training.
+rm -rf "$profile_dir"
+cmake -S "$root" -B "$build_dir" -DGTK_VERSION="$gtk_version" \
+	-DCMAKE_BUILD_TYPE=Release -DGUKI_PGO=GENERATE \
+	-DGUKI_PGO_DIR="$profile_dir"
+cmake --build "$build_dir" --clean-first
+train "$build_dir/gUki"
+
+# Clang writes raw profiles that have to be merged first.
+if ls "$profile_dir"/*.profraw >/dev/null 2>&1; then
+	"$llvm_profdata" merge -output="$profile_dir/guki.profdata" \
+		"$profile_dir"/*.profraw
+fi
+
+# Optimized build.
+cmake -S "$root" -B "$build_dir" -DGUKI_PGO=USE
+cmake --build "$build_dir" --clean-first
+
+# Compare it to a plain Release build.
+cmake -S "$root" -B "$baseline_dir" -DGTK_VERSION="$gtk_version" \
+	-DCMAKE_BUILD_TYPE=Release -DGUKI_PGO=OFF
+cmake --build "$baseline_dir"
+bench "$baseline_dir/gUki"
+bench "$build_dir/gUki"
@@ -9,6 +9,7 @@
 #define _APPPROPERTIES_H_
 
 #define APP_NAME      "gUki"
+#define APP_ID        "me.nathancampos.gUki"
 #define APP_ICON      "text-editor"
 #define APP_VERSION   "1.0a"
 #define APP_COPYRIGHT "(c) Innove Workshop"
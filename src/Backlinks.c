@@ -0,0 +1,128 @@
+/**
+ * Backlinks.c
+ * Panel that lists the articles that link to the current page.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include "Backlinks.h"
+#include "LinkGraph.h"
+#include "Workspace.h"
+
+// Backlinks list columns.
+enum {
+	BACKLINKS_COL_NAME = 0,
+	BACKLINKS_COL_INDEX,
+	BACKLINKS_NUM_COLS
+};
+
+// Private variables.
+GtkWidget *backlinks_view;
+GtkListStore *backlinks_store;
+
+// Private methods.
+void on_backlinks_row_activated(GtkTreeView *tview, GtkTreePath *path,
+								GtkTreeViewColumn *column, gpointer data);
+
+/**
+ * Initializes the backlinks panel.
+ *
+ * @return Scrolled window that contains the panel.
+ */
+GtkWidget* initialize_backlinks() {
+	GtkWidget *scrolled;
+	GtkTreeViewColumn *column;
+	GtkCellRenderer *renderer;
+
+	// Create the list and its view.
+	backlinks_store = gtk_list_store_new(BACKLINKS_NUM_COLS, G_TYPE_STRING,
+										 G_TYPE_INT);
+	backlinks_view = gtk_tree_view_new_with_model(
+		GTK_TREE_MODEL(backlinks_store));
+	g_signal_connect(backlinks_view, "row-activated",
+					 G_CALLBACK(on_backlinks_row_activated), NULL);
+
+	// Create the column.
+	renderer = gtk_cell_renderer_text_new();
+	column = gtk_tree_view_column_new_with_attributes("Backlinks", renderer,
+			"text", BACKLINKS_COL_NAME, NULL);
+	gtk_tree_view_append_column(GTK_TREE_VIEW(backlinks_view), column);
+
+	// Put it inside a scrolled window.
+	scrolled = gtk_scrolled_window_new(NULL, NULL);
+	gtk_container_add(GTK_CONTAINER(scrolled), backlinks_view);
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled),
+								   GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+	gtk_scrolled_window_set_shadow_type(GTK_SCROLLED_WINDOW(scrolled),
+										GTK_SHADOW_ETCHED_IN);
+
+	return scrolled;
+}
+
+/**
+ * Lists the articles that link to a page.
+ *
+ * @param page Page to have its backlinks listed.
+ */
+void update_backlinks(page_t page) {
+	GArray *backlinks;
+
+	clear_backlinks();
+
+	// Let the user know that they are still being found.
+	if (link_graph_is_pending() && (page.type == PAGE_TYPE_ARTICLE)) {
+		GtkTreeIter iter;
+
+		gtk_list_store_append(backlinks_store, &iter);
+		gtk_list_store_set(backlinks_store, &iter, BACKLINKS_COL_NAME,
+						   BACKLINKS_PENDING, BACKLINKS_COL_INDEX, -1, -1);
+		return;
+	}
+
+	if ((backlinks = link_graph_backlinks(page)) == NULL)
+		return;
+
+	for (guint i = 0; i < backlinks->len; i++) {
+		size_t index = g_array_index(backlinks, size_t, i);
+		GtkTreeIter iter;
+		char *name;
+
+		name = page_display_name(page_article(index));
+		gtk_list_store_append(backlinks_store, &iter);
+		gtk_list_store_set(backlinks_store, &iter, BACKLINKS_COL_NAME, name,
+						   BACKLINKS_COL_INDEX, (gint)index, -1);
+		g_free(name);
+	}
+}
+
+/**
+ * Clears the backlinks panel.
+ */
+void clear_backlinks() {
+	gtk_list_store_clear(backlinks_store);
+}
+
+/**
+ * Callback for the backlinks list row activated signal.
+ *
+ * @param tview  Tree view that received the signal.
+ * @param path   Path to the activated row.
+ * @param column Column that was activated.
+ * @param data   Data passed by the signal connector.
+ */
+void on_backlinks_row_activated(GtkTreeView *tview, GtkTreePath *path,
+								GtkTreeViewColumn *column, gpointer data) {
+	GtkTreeIter iter;
+	gint index;
+
+	// Get the article that was activated.
+	if (!gtk_tree_model_get_iter(GTK_TREE_MODEL(backlinks_store), &iter, path))
+		return;
+	gtk_tree_model_get(GTK_TREE_MODEL(backlinks_store), &iter,
+					   BACKLINKS_COL_INDEX, &index, -1);
+	if (index < 0)
+		return;
+
+	// Open it through the workspace so everything stays in sync.
+	select_workspace_page(page_article((size_t)index));
+}
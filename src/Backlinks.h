@@ -0,0 +1,24 @@
+/**
+ * Backlinks.h
+ * Panel that lists the articles that link to the current page.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _BACKLINKS_H_
+#define _BACKLINKS_H_
+
+#include <gtk/gtk.h>
+#include "Page.h"
+
+// Shown while the link graph is still being built.
+#define BACKLINKS_PENDING "Finding backlinks..."
+
+// Initialization.
+GtkWidget* initialize_backlinks();
+
+// Population.
+void update_backlinks(page_t page);
+void clear_backlinks();
+
+#endif /* _BACKLINKS_H_ */
@@ -0,0 +1,589 @@
+/**
+ * CommandLine.c
+ * Command-line front-end that works without initializing GTK or WebKit.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <glib.h>
+#include "CommandLine.h"
+#include "AppProperties.h"
+#include "Export.h"
+#include "LinkGraph.h"
+#include "Page.h"
+#include "Search.h"
+#include "Stats.h"
+#include "Wiki.h"
+
+// Private variables.
+char *opt_workspace = NULL;
+char *opt_render = NULL;
+char *opt_search = NULL;
+char *opt_export = NULL;
+char *opt_backlinks = NULL;
+char *opt_trace = NULL;
+char *opt_stats = NULL;
+char *opt_bench_render = NULL;
+char *opt_record = NULL;
+char *opt_replay = NULL;
+char *opt_page = NULL;
+char **opt_files = NULL;
+gint opt_iterations = 100;
+gint opt_soak = 0;
+gint opt_soak_limit = 64;
+gboolean opt_list = false;
+gboolean opt_ignore_case = false;
+gboolean opt_full = false;
+gboolean opt_orphans = false;
+gboolean opt_broken_links = false;
+gboolean opt_new_instance = false;
+gboolean opt_realtime = false;
+
+// Command-line options.
+GOptionEntry cli_entries[] = {
+	{ "workspace", 'w', 0, G_OPTION_ARG_FILENAME, &opt_workspace,
+	  "Root of the Uki workspace (defaults to the current directory)", "DIR" },
+	{ "render", 'r', 0, G_OPTION_ARG_STRING, &opt_render,
+	  "Render a page to the standard output", "PAGE" },
+	{ "list", 'l', 0, G_OPTION_ARG_NONE, &opt_list,
+	  "List every page in the workspace", NULL },
+	{ "search", 's', 0, G_OPTION_ARG_STRING, &opt_search,
+	  "Search every page in the workspace", "QUERY" },
+	{ "ignore-case", 'i', 0, G_OPTION_ARG_NONE, &opt_ignore_case,
+	  "Make searches case insensitive", NULL },
+	{ "export", 'e', 0, G_OPTION_ARG_FILENAME, &opt_export,
+	  "Export the workspace as a static website", "DIR" },
+	{ "full", 0, 0, G_OPTION_ARG_NONE, &opt_full,
+	  "Render every page when exporting, even unchanged ones", NULL },
+	{ "backlinks", 'b', 0, G_OPTION_ARG_STRING, &opt_backlinks,
+	  "List the articles that link to a page", "PAGE" },
+	{ "orphans", 'o', 0, G_OPTION_ARG_NONE, &opt_orphans,
+	  "List the articles that no other article links to", NULL },
+	{ "broken-links", 'B', 0, G_OPTION_ARG_NONE, &opt_broken_links,
+	  "List every link that points to a missing file", NULL },
+	{ "trace", 0, 0, G_OPTION_ARG_FILENAME, &opt_trace,
+	  "Write a Chrome/Perfetto trace of this run (also $GUKI_TRACE)",
+	  "FILE" },
+	{ "bench-render", 0, 0, G_OPTION_ARG_STRING, &opt_bench_render,
+	  "Benchmark rendering a page", "PAGE" },
+	{ "iterations", 0, 0, G_OPTION_ARG_INT, &opt_iterations,
+	  "Number of iterations of a benchmark (defaults to 100)", "N" },
+	{ "stats", 0, 0, G_OPTION_ARG_FILENAME, &opt_stats,
+	  "Write the runtime statistics as JSON when done (- for stdout)",
+	  "FILE" },
+	{ "record", 0, 0, G_OPTION_ARG_FILENAME, &opt_record,
+	  "Record the actions taken in the interface to a file", "FILE" },
+	{ "replay", 0, 0, G_OPTION_ARG_FILENAME, &opt_replay,
+	  "Replay recorded actions and report their latencies", "FILE" },
+	{ "realtime", 0, 0, G_OPTION_ARG_NONE, &opt_realtime,
+	  "Replay the actions with the timing they were recorded with", NULL },
+	{ "soak", 0, 0, G_OPTION_ARG_INT, &opt_soak,
+	  "Cycle through the pages N times and fail if memory keeps growing",
+	  "N" },
+	{ "soak-limit", 0, 0, G_OPTION_ARG_INT, &opt_soak_limit,
+	  "Memory growth allowed by --soak (defaults to 64)", "MB" },
+	{ "new-instance", 0, 0, G_OPTION_ARG_NONE, &opt_new_instance,
+	  "Don't hand the request over to a gUki that's already running", NULL },
+	{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &opt_files,
+	  NULL, "[WORKSPACE|PAGE...]" },
+	{ NULL, 0, 0, 0, NULL, NULL, NULL }
+};
+
+// Private methods.
+bool cli_open_workspace();
+int cli_render();
+int cli_list();
+int cli_search();
+int cli_export();
+int cli_links();
+int cli_bench_render();
+void cli_search_hit(page_t page, size_t line, const char *text, size_t length,
+					gpointer data);
+void cli_print_page(page_t page, gpointer data);
+void cli_print_link(page_t source, const link_t *link, gpointer data);
+
+/**
+ * Parses the command-line arguments that are meant for us.
+ *
+ * @param  argc Pointer to the number of command-line arguments.
+ * @param  argv Pointer to the array of command-line arguments.
+ * @return      TRUE if a headless operation was requested.
+ */
+bool cli_parse(int *argc, char ***argv) {
+	GOptionContext *context;
+	GError *error = NULL;
+
+	// Setup the option context, leaving the unknown options for GTK.
+	context = g_option_context_new("- " APP_COMMENTS);
+	g_option_context_add_main_entries(context, cli_entries, NULL);
+	g_option_context_set_ignore_unknown_options(context, true);
+
+	// Parse the arguments.
+	if (!g_option_context_parse(context, argc, argv, &error)) {
+		fprintf(stderr, "%s: %s\n", APP_NAME, error->message);
+		g_error_free(error);
+		g_option_context_free(context);
+
+		exit(EXIT_FAILURE);
+	}
+
+	g_option_context_free(context);
+
+	// Folders are workspaces and anything else is a page to be opened.
+	for (size_t i = 0; (opt_files != NULL) && (opt_files[i] != NULL); i++) {
+		if (g_file_test(opt_files[i], G_FILE_TEST_IS_DIR)) {
+			if (opt_workspace == NULL)
+				opt_workspace = opt_files[i];
+		} else if (opt_page == NULL) {
+			opt_page = opt_files[i];
+		}
+	}
+
+	return (opt_render != NULL) || (opt_search != NULL) ||
+		(opt_export != NULL) || (opt_backlinks != NULL) ||
+		(opt_bench_render != NULL) || opt_list ||
+		opt_orphans || opt_broken_links;
+}
+
+/**
+ * Gets the workspace passed in the command-line.
+ *
+ * @return Workspace root path or NULL if none was given.
+ */
+const char* cli_workspace() {
+	return opt_workspace;
+}
+
+/**
+ * Gets the page that should be opened in the graphical interface.
+ *
+ * @return Page name or path or NULL if none was given.
+ */
+const char* cli_page() {
+	return opt_page;
+}
+
+/**
+ * Should we run on our own even if there's another instance running?
+ *
+ * @return TRUE if a new instance was requested.
+ */
+bool cli_new_instance() {
+	return opt_new_instance;
+}
+
+/**
+ * Gets the trace file passed in the command-line.
+ *
+ * @return Trace file path or NULL if none was given.
+ */
+const char* cli_trace() {
+	return opt_trace;
+}
+
+/**
+ * Gets the statistics file passed in the command-line.
+ *
+ * @return Statistics file path or NULL if none was given.
+ */
+const char* cli_stats() {
+	return opt_stats;
+}
+
+/**
+ * Gets the file the actions should be recorded to.
+ *
+ * @return Action log path or NULL if none was given.
+ */
+const char* cli_record() {
+	return opt_record;
+}
+
+/**
+ * Gets the file with the actions that should be replayed.
+ *
+ * @return Action log path or NULL if none was given.
+ */
+const char* cli_replay() {
+	return opt_replay;
+}
+
+/**
+ * Should the actions be replayed with the timing they were recorded with?
+ *
+ * @return TRUE if a real time replay was requested.
+ */
+bool cli_realtime() {
+	return opt_realtime;
+}
+
+/**
+ * Gets the number of cycles of the soak benchmark.
+ *
+ * @return Number of cycles or 0 if no soak benchmark was requested.
+ */
+guint cli_soak() {
+	return MAX(opt_soak, 0);
+}
+
+/**
+ * Gets the memory growth allowed by the soak benchmark.
+ *
+ * @return Allowed growth in megabytes.
+ */
+guint cli_soak_limit() {
+	return MAX(opt_soak_limit, 0);
+}
+
+/**
+ * Writes the runtime statistics to the file passed in the command-line.
+ *
+ * @return TRUE if the statistics were written or none were requested.
+ */
+bool cli_dump_stats() {
+	GError *error = NULL;
+
+	if (opt_stats == NULL)
+		return true;
+
+	if (!stats_dump(opt_stats, &error)) {
+		fprintf(stderr, "%s: %s\n", APP_NAME, error->message);
+		g_error_free(error);
+
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Runs the requested headless operation.
+ *
+ * @return Process return code.
+ */
+int cli_run() {
+	int ret = EXIT_SUCCESS;
+
+	// Open the workspace.
+	if (!cli_open_workspace())
+		return EXIT_FAILURE;
+
+	// Perform the requested operations.
+	if (opt_list)
+		ret = cli_list();
+	if ((ret == EXIT_SUCCESS) && (opt_render != NULL))
+		ret = cli_render();
+	if ((ret == EXIT_SUCCESS) && (opt_search != NULL))
+		ret = cli_search();
+	if ((ret == EXIT_SUCCESS) && (opt_export != NULL))
+		ret = cli_export();
+	if ((ret == EXIT_SUCCESS) && ((opt_backlinks != NULL) || opt_orphans ||
+								  opt_broken_links)) {
+		ret = cli_links();
+	}
+	if ((ret == EXIT_SUCCESS) && (opt_bench_render != NULL))
+		ret = cli_bench_render();
+
+	// Dump the statistics while the workspace is still around and clean up.
+	cli_dump_stats();
+	wiki_close();
+	return ret;
+}
+
+/**
+ * Opens the workspace requested by the user.
+ *
+ * @return TRUE if the operation was successful.
+ */
+bool cli_open_workspace() {
+	uki_error err;
+	char *root;
+
+	// Default to the current directory.
+	if (opt_workspace != NULL) {
+		root = g_canonicalize_filename(opt_workspace, NULL);
+	} else {
+		root = g_get_current_dir();
+	}
+
+	// Open the workspace.
+	if ((err = wiki_open(root)) != UKI_OK) {
+		fprintf(stderr, "%s: Error while initializing workspace '%s': %s\n",
+				APP_NAME, root, uki_error_msg(err));
+		g_free(root);
+
+		return false;
+	}
+
+	g_free(root);
+	return true;
+}
+
+/**
+ * Renders a page to the standard output.
+ *
+ * @return Process return code.
+ */
+int cli_render() {
+	GError *error = NULL;
+	page_t page;
+	char *contents;
+
+	// Find the requested page.
+	if (!page_find(opt_render, &page)) {
+		fprintf(stderr, "%s: Page '%s' not found.\n", APP_NAME, opt_render);
+		return EXIT_FAILURE;
+	}
+
+	// Read its contents.
+	if (!page_read(page, &contents, NULL, &error)) {
+		fprintf(stderr, "%s: %s\n", APP_NAME, error->message);
+		g_error_free(error);
+
+		return EXIT_FAILURE;
+	}
+
+	// Render it and send it out.
+	page_render(page, &contents);
+	fputs(contents, stdout);
+	g_free(contents);
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Lists every page in the workspace to the standard output.
+ *
+ * @return Process return code.
+ */
+int cli_list() {
+	const page_type_t types[] = { PAGE_TYPE_ARTICLE, PAGE_TYPE_TEMPLATE };
+
+	for (size_t t = 0; t < G_N_ELEMENTS(types); t++) {
+		for (size_t i = 0; i < wiki_pages_available(types[t]); i++) {
+			page_t page;
+			char *name;
+
+			// Build the page reference and its name.
+			page = (types[t] == PAGE_TYPE_ARTICLE) ? page_article(i) :
+				page_template(i);
+			name = page_display_name(page);
+
+			// Print it out.
+			printf("%s\t%s\n", (types[t] == PAGE_TYPE_ARTICLE) ? "article" :
+				   "template", name);
+			g_free(name);
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Searches the workspace and prints the matching lines.
+ *
+ * @return Process return code. (EXIT_FAILURE if nothing was found)
+ */
+int cli_search() {
+	size_t hits;
+
+	hits = search_workspace(opt_search, !opt_ignore_case, cli_search_hit,
+							NULL);
+
+	return (hits > 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * Exports the workspace as a static website.
+ *
+ * @return Process return code.
+ */
+int cli_export() {
+	export_progress_t progress;
+	GError *error = NULL;
+	gint64 start;
+	bool success;
+
+	// Make sure the workspace won't be overwritten.
+	if (!export_check_outdir(opt_export, &error)) {
+		fprintf(stderr, "%s: %s\n", APP_NAME, error->message);
+		g_error_free(error);
+
+		return EXIT_FAILURE;
+	}
+
+	// Export the workspace.
+	export_progress_init(&progress);
+	start = g_get_monotonic_time();
+	success = export_workspace(opt_export, !opt_full, &progress, &error);
+
+	// Report the results.
+	printf("Exported %d pages and %d assets to '%s' in %.2fs. (%d unchanged, "
+		   "%d removed)\n", progress.rendered, progress.assets, opt_export,
+		   (g_get_monotonic_time() - start) / (double)G_USEC_PER_SEC,
+		   progress.skipped, progress.removed);
+	if (!success) {
+		fprintf(stderr, "%s: %s\n", APP_NAME, error->message);
+		g_error_free(error);
+
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Answers the questions about the links between articles.
+ *
+ * @return Process return code. (EXIT_FAILURE if there are broken links)
+ */
+int cli_links() {
+	gint64 start;
+
+	// Index the links of the whole workspace.
+	start = g_get_monotonic_time();
+	link_graph_build();
+
+	// List the backlinks of a page.
+	if (opt_backlinks != NULL) {
+		GArray *backlinks;
+		page_t page;
+
+		if (!page_find(opt_backlinks, &page)) {
+			fprintf(stderr, "%s: Page '%s' not found.\n", APP_NAME,
+					opt_backlinks);
+			return EXIT_FAILURE;
+		}
+
+		if ((backlinks = link_graph_backlinks(page)) != NULL) {
+			for (guint i = 0; i < backlinks->len; i++) {
+				cli_print_page(page_article(g_array_index(backlinks, size_t,
+														  i)), NULL);
+			}
+		}
+	}
+
+	// List the orphans.
+	if (opt_orphans)
+		link_graph_orphans(cli_print_page, NULL);
+
+	// Check for broken links.
+	if (opt_broken_links) {
+		size_t broken = link_graph_broken(cli_print_link, NULL);
+
+		fprintf(stderr, "Found %zu broken links across %zu articles in "
+				"%.2fs.\n", broken, wiki_pages_available(PAGE_TYPE_ARTICLE),
+				(g_get_monotonic_time() - start) / (double)G_USEC_PER_SEC);
+		if (broken > 0)
+			return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Benchmarks rendering a page, reporting how long each render takes and how
+ * much rendering raised the peak memory use of the process. (The viewer isn't
+ * around without GTK, so handing the render over to it isn't measured)
+ *
+ * @return Process return code.
+ */
+int cli_bench_render() {
+	GError *error = NULL;
+	struct rusage usage;
+	glong peak_before;
+	gsize rendered = 0;
+	size_t length;
+	char *source;
+	page_t page;
+
+	// Find the requested page and read it.
+	if (!page_find(opt_bench_render, &page)) {
+		fprintf(stderr, "%s: Page '%s' not found.\n", APP_NAME,
+				opt_bench_render);
+		return EXIT_FAILURE;
+	}
+	if (!page_read(page, &source, &length, &error)) {
+		fprintf(stderr, "%s: %s\n", APP_NAME, error->message);
+		g_error_free(error);
+
+		return EXIT_FAILURE;
+	}
+	if (opt_iterations < 1)
+		opt_iterations = 1;
+
+	// Render it from a copy of the source like the editor does. (Uki renders
+	// in-place)
+	getrusage(RUSAGE_SELF, &usage);
+	peak_before = usage.ru_maxrss;
+	for (gint i = 0; i < opt_iterations; i++) {
+		char *html;
+
+		html = g_strndup(source, length);
+		page_render(page, &html);
+		rendered = strlen(html);
+		g_free(html);
+	}
+	getrusage(RUSAGE_SELF, &usage);
+
+	// Report the results.
+	printf("Rendered '%s' (%zu bytes into %zu bytes) %d times.\n",
+		   opt_bench_render, length, rendered, opt_iterations);
+	printf("render:  p50 %.3fms, p90 %.3fms, p99 %.3fms\n",
+		   stats_percentile(STAT_RENDER_TIME, 0.50) / 1000.0,
+		   stats_percentile(STAT_RENDER_TIME, 0.90) / 1000.0,
+		   stats_percentile(STAT_RENDER_TIME, 0.99) / 1000.0);
+	printf("memory:  peak RSS %.1f MB (%+.1f MB while rendering)\n",
+		   usage.ru_maxrss / 1024.0, (usage.ru_maxrss - peak_before) / 1024.0);
+
+	g_free(source);
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Prints the name of a page.
+ *
+ * @param page Page to be printed.
+ * @param data Data passed by the caller. (Unused)
+ */
+void cli_print_page(page_t page, gpointer data) {
+	char *name = page_display_name(page);
+
+	printf("%s\n", name);
+	g_free(name);
+}
+
+/**
+ * Prints a link in a grep-like format.
+ *
+ * @param source Page that contains the link.
+ * @param link   Link to be printed.
+ * @param data   Data passed by the caller. (Unused)
+ */
+void cli_print_link(page_t source, const link_t *link, gpointer data) {
+	char *name = page_display_name(source);
+
+	printf("%s:%zu:%s\n", name, link->line, link->href);
+	g_free(name);
+}
+
+/**
+ * Prints a search hit in a grep-like format.
+ *
+ * @param page   Page where the needle was found.
+ * @param line   Line number of the match.
+ * @param text   Line that contains the match.
+ * @param length Length of the line.
+ * @param data   Data passed by the caller. (Unused)
+ */
+void cli_search_hit(page_t page, size_t line, const char *text, size_t length,
+					gpointer data) {
+	char *name = page_display_name(page);
+
+	printf("%s:%zu:%.*s\n", name, line, (int)length, text);
+	g_free(name);
+}
@@ -0,0 +1,32 @@
+/**
+ * CommandLine.h
+ * Command-line front-end that works without initializing GTK or WebKit.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _COMMANDLINE_H_
+#define _COMMANDLINE_H_
+
+#include <stdbool.h>
+
+// Parsing.
+bool cli_parse(int *argc, char ***argv);
+const char* cli_workspace();
+const char* cli_page();
+bool cli_new_instance();
+const char* cli_trace();
+const char* cli_stats();
+const char* cli_record();
+const char* cli_replay();
+bool cli_realtime();
+unsigned int cli_soak();
+unsigned int cli_soak_limit();
+
+// Statistics.
+bool cli_dump_stats();
+
+// Headless operation.
+int cli_run();
+
+#endif /* _COMMANDLINE_H_ */
@@ -11,6 +11,7 @@
 
 // Private variables.
 GtkWidget *window;
+bool dialogs_unattended = false;
 
 /**
  * Initializes the dialog helper.
@@ -21,34 +22,66 @@ void initialize_dialogs(GtkWidget *parent_window) {
 	window = parent_window;
 }
 
+/**
+ * Makes every dialog give its default answer without being shown, so that
+ * nothing waits for a user that isn't there.
+ *
+ * @param unattended TRUE if no one is around to answer the dialogs.
+ */
+void set_dialogs_unattended(bool unattended) {
+	dialogs_unattended = unattended;
+}
+
 /**
  * Displays a message dialog.
  *
- * @param type           Dialog type flag.
+ * @param type           Dialog message type.
  * @param title          Dialog title.
  * @param message_format Dialog message format string.
  * @param ...            Message string arguments.
  */
-void message_dialog(GtkDialogFlags type, const gchar *title,
+void message_dialog(GtkMessageType type, const gchar *title,
 					const gchar *message_format, ...) {
-	GtkWidget *dialog;
 	va_list argptr;
 
-	// Create the new dialog.
 	va_start(argptr, message_format);
+	vmessage_dialog(type, title, message_format, argptr);
+	va_end(argptr);
+}
+
+/**
+ * Displays a message dialog with the arguments passed as a va_list.
+ *
+ * @param type           Dialog message type.
+ * @param title          Dialog title.
+ * @param message_format Dialog message format string.
+ * @param argptr         Message string arguments.
+ */
+void vmessage_dialog(GtkMessageType type, const gchar *title,
+					 const gchar *message_format, va_list argptr) {
+	GtkWidget *dialog;
+	gchar *message;
+
+	// Create the new dialog.
+	message = g_strdup_vprintf(message_format, argptr);
+	if (dialogs_unattended) {
+		g_message("%s: %s", title, message);
+		g_free(message);
+
+		return;
+	}
 	dialog = gtk_message_dialog_new(GTK_WINDOW(window),
 									GTK_DIALOG_DESTROY_WITH_PARENT,
-									GTK_MESSAGE_ERROR, GTK_BUTTONS_CLOSE,
-									title);
+									type, GTK_BUTTONS_CLOSE, "%s", title);
 
 	// Add the message text to the dialog.
 	gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog),
-											 message_format, argptr);
+											 "%s", message);
 
 	// Show the dialog and destroy it after closing.
 	gtk_dialog_run(GTK_DIALOG(dialog));
 	gtk_widget_destroy(dialog);
-	va_end(argptr);
+	g_free(message);
 }
 
 /**
@@ -62,7 +95,7 @@ void error_dialog(const gchar *title, const gchar *message_format, ...) {
 	va_list argptr;
 
 	va_start(argptr, message_format);
-	message_dialog(GTK_MESSAGE_ERROR, title, message_format, argptr);
+	vmessage_dialog(GTK_MESSAGE_ERROR, title, message_format, argptr);
 	va_end(argptr);
 }
 
@@ -77,7 +110,7 @@ void warning_dialog(const gchar *title, const gchar *message_format, ...) {
 	va_list argptr;
 
 	va_start(argptr, message_format);
-	message_dialog(GTK_MESSAGE_WARNING, title, message_format, argptr);
+	vmessage_dialog(GTK_MESSAGE_WARNING, title, message_format, argptr);
 	va_end(argptr);
 }
 
@@ -90,6 +123,10 @@ bool unsaved_changes_dialog() {
 	GtkWidget *dialog;
 	gint res;
 
+	// Throw the changes away.
+	if (dialogs_unattended)
+		return false;
+
 	// Create and setup dialog.
 	dialog = gtk_message_dialog_new(GTK_WINDOW(window),
 									GTK_DIALOG_DESTROY_WITH_PARENT,
@@ -122,6 +159,129 @@ bool unsaved_changes_dialog() {
 	return res == GTK_RESPONSE_YES;
 }
 
+/**
+ * Shows a dialog offering to recover the changes that were lost when the
+ * application closed unexpectedly.
+ *
+ * @param  name Name of the page that has changes to recover.
+ * @return      TRUE if the user wants the changes back.
+ */
+bool recover_changes_dialog(const char *name) {
+	GtkWidget *dialog;
+	gint res;
+
+	// Start from what was saved.
+	if (dialogs_unattended)
+		return false;
+
+	// Create and setup dialog.
+	dialog = gtk_message_dialog_new(GTK_WINDOW(window),
+									GTK_DIALOG_DESTROY_WITH_PARENT,
+									GTK_MESSAGE_QUESTION,
+									GTK_BUTTONS_YES_NO,
+									"Recover Unsaved Changes");
+	gtk_window_set_resizable(GTK_WINDOW(dialog), false);
+	gtk_dialog_set_default_response(GTK_DIALOG(dialog), GTK_RESPONSE_YES);
+
+	// Add the message text to the dialog.
+	gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog),
+											 "The page '%s' has changes that "
+											 "weren't saved when %s last "
+											 "closed. Do you want to recover "
+											 "them?", name, APP_NAME);
+
+	// Show the dialog and destroy it after closing.
+	res = gtk_dialog_run(GTK_DIALOG(dialog));
+	gtk_widget_destroy(dialog);
+
+	return res == GTK_RESPONSE_YES;
+}
+
+/**
+ * Shows a dialog offering to merge the changes made to a page outside of the
+ * application with the ones made in the editor.
+ *
+ * @param  name Name of the page that was changed on disk.
+ * @return      TRUE if the user wants both changes merged.
+ */
+bool external_changes_dialog(const char *name) {
+	GtkWidget *dialog;
+	gint res;
+
+	// Keep what's in the editor.
+	if (dialogs_unattended)
+		return false;
+
+	// Create and setup dialog.
+	dialog = gtk_message_dialog_new(GTK_WINDOW(window),
+									GTK_DIALOG_DESTROY_WITH_PARENT,
+									GTK_MESSAGE_QUESTION,
+									GTK_BUTTONS_NONE,
+									"Page Changed on Disk");
+	gtk_window_set_resizable(GTK_WINDOW(dialog), false);
+
+	// Add the buttons.
+	gtk_dialog_add_buttons(GTK_DIALOG(dialog),
+						   "_Keep Mine", GTK_RESPONSE_NO,
+						   "_Merge", GTK_RESPONSE_YES,
+						   NULL);
+	gtk_dialog_set_default_response(GTK_DIALOG(dialog), GTK_RESPONSE_YES);
+
+	// Add the message text to the dialog.
+	gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog),
+											 "The page '%s' was changed by "
+											 "another program while it had "
+											 "unsaved changes. Do you want to "
+											 "merge both changes or keep only "
+											 "yours?", name);
+
+	// Show the dialog and destroy it after closing.
+	res = gtk_dialog_run(GTK_DIALOG(dialog));
+	gtk_widget_destroy(dialog);
+
+	return res == GTK_RESPONSE_YES;
+}
+
+/**
+ * Shows a dialog offering to reformat a page with lines too long to be edited
+ * comfortably.
+ *
+ * @param  name Name of the page with the long lines.
+ * @return      TRUE if the user wants the page reformatted.
+ */
+bool long_lines_dialog(const char *name) {
+	GtkWidget *dialog;
+	gint res;
+
+	// Go with the default.
+	if (dialogs_unattended)
+		return true;
+
+	// Create and setup dialog.
+	dialog = gtk_message_dialog_new(GTK_WINDOW(window),
+									GTK_DIALOG_DESTROY_WITH_PARENT,
+									GTK_MESSAGE_QUESTION,
+									GTK_BUTTONS_YES_NO,
+									"Very Long Lines");
+	gtk_window_set_resizable(GTK_WINDOW(dialog), false);
+	gtk_dialog_set_default_response(GTK_DIALOG(dialog), GTK_RESPONSE_YES);
+
+	// Add the message text to the dialog.
+	gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog),
+											 "The page '%s' has lines that "
+											 "are too long to be edited "
+											 "comfortably. Do you want to "
+											 "edit it reformatted? It will "
+											 "still be saved with its "
+											 "original formatting.", name);
+
+	// Show the dialog and destroy it after closing.
+	res = gtk_dialog_run(GTK_DIALOG(dialog));
+	gtk_widget_destroy(dialog);
+
+	return res == GTK_RESPONSE_YES;
+}
+
 /**
  * Shows an about dialog.
  */
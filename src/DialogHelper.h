@@ -9,19 +9,26 @@
 #define _DIALOGHELPER_H_
 
 #include <gtk/gtk.h>
+#include <stdarg.h>
 #include <stdbool.h>
 
 // Initialization.
 void initialize_dialogs(GtkWidget *parent_window);
+void set_dialogs_unattended(bool unattended);
 
 // Message dialogs.
-void message_dialog(GtkDialogFlags type, const gchar *title,
+void message_dialog(GtkMessageType type, const gchar *title,
 					const gchar *message_format, ...);
+void vmessage_dialog(GtkMessageType type, const gchar *title,
+					 const gchar *message_format, va_list argptr);
 void warning_dialog(const gchar *title, const gchar *message_format, ...);
 void error_dialog(const gchar *title, const gchar *message_format, ...);
 
 // Special dialogs.
 bool unsaved_changes_dialog();
+bool recover_changes_dialog(const char *name);
+bool external_changes_dialog(const char *name);
+bool long_lines_dialog(const char *name);
 void show_about_dialog();
 
 #endif /* _DIALOGHELPER_H_ */
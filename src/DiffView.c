@@ -0,0 +1,380 @@
+/**
+ * DiffView.c
+ * Side-by-side view of the unsaved changes made to a page.
+ *
+ * The comparison runs in a worker thread, and the view is a tree view in fixed
+ * height mode whose rows only hold line numbers. The text of a line is only
+ * fetched from the diff when its row is actually drawn, so a page with 100k
+ * lines costs the same to scroll through as one with a hundred.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include <string.h>
+#include "DiffView.h"
+#include "DialogHelper.h"
+#include "Diff.h"
+#include "PageManager.h"
+#include "Reflow.h"
+
+// Constants.
+#define DIFF_VIEW_MAX_LINE 1024
+#define DIFF_COLOR_REMOVED "#ffd7d5"
+#define DIFF_COLOR_ADDED   "#ccffd8"
+#define DIFF_COLOR_EMPTY   "#eeeeee"
+
+// Diff rows columns.
+enum {
+	DIFF_COL_OLD = 0,
+	DIFF_COL_NEW,
+	DIFF_COL_OP,
+	DIFF_NUM_COLS
+};
+
+// Cells of a diff row.
+enum {
+	DIFF_CELL_OLD_NUMBER = 1,
+	DIFF_CELL_OLD_TEXT,
+	DIFF_CELL_NEW_NUMBER,
+	DIFF_CELL_NEW_TEXT
+};
+
+// Comparison being shown.
+typedef struct {
+	GtkWidget *dialog;
+	GtkWidget *tview;
+	GtkWidget *status;
+	GCancellable *cancellable;
+	diff_t *diff;
+} diff_view_t;
+
+// Private variables.
+GtkWidget *diff_view_parent;
+diff_view_t *diff_view = NULL;
+
+// Private methods.
+void diff_view_free(diff_view_t *view);
+void diff_view_add_column(diff_view_t *view, const char *title, gint cell,
+						  gint width);
+void diff_view_populate(diff_view_t *view);
+void on_diff_computed(GObject *source, GAsyncResult *result, gpointer data);
+void on_diff_cell_data(GtkTreeViewColumn *column, GtkCellRenderer *renderer,
+					   GtkTreeModel *model, GtkTreeIter *iter, gpointer data);
+void on_diff_view_destroy(GtkWidget *widget, gpointer data);
+
+/**
+ * Initializes the diff view module.
+ *
+ * @param main_window Main application window.
+ */
+void initialize_diff_view(GtkWidget *main_window) {
+	diff_view_parent = main_window;
+}
+
+/**
+ * Compares the contents of the editor with what's on disk and shows the
+ * changes side by side.
+ */
+void show_diff_view() {
+	GtkTextBuffer *buffer;
+	GtkTextIter start;
+	GtkTextIter end;
+	GtkWidget *vbox;
+	GtkWidget *scrolled;
+	GError *error = NULL;
+	diff_view_t *view;
+	char *saved;
+	char *contents;
+	size_t length;
+	reflow_t *reflow;
+	page_t page;
+
+	// Get what's on disk and what's in the editor.
+	page = get_current_page();
+	if (!page_is_valid(page))
+		return;
+	if (!page_read(page, &saved, &length, &error)) {
+		error_dialog("Unable to Compare Page", "%s", error->message);
+		g_error_free(error);
+
+		return;
+	}
+	buffer = get_page_editor_buffer();
+
+	// Compare it the way it's being edited.
+	if (is_page_reflowed()) {
+		reflow = reflow_new(saved, length);
+		g_free(saved);
+		saved = g_strndup(reflow->text, reflow->length);
+		length = reflow->length;
+		reflow_free(reflow);
+	}
+	gtk_text_buffer_get_start_iter(buffer, &start);
+	gtk_text_buffer_get_end_iter(buffer, &end);
+	contents = gtk_text_buffer_get_text(buffer, &start, &end, false);
+
+	// Only keep a single comparison around.
+	if (diff_view != NULL)
+		gtk_widget_destroy(diff_view->dialog);
+
+	// Create the window.
+	view = g_new0(diff_view_t, 1);
+	view->dialog = gtk_dialog_new_with_buttons("Changes",
+			GTK_WINDOW(diff_view_parent), GTK_DIALOG_DESTROY_WITH_PARENT,
+#if GTK_MAJOR_VERSION == 2
+			GTK_STOCK_CLOSE,
+#else
+			"Close",
+#endif
+			GTK_RESPONSE_CLOSE, NULL);
+	gtk_window_set_default_size(GTK_WINDOW(view->dialog), 960, 600);
+	g_signal_connect(view->dialog, "response", G_CALLBACK(gtk_widget_destroy),
+					 NULL);
+	g_signal_connect(view->dialog, "destroy",
+					 G_CALLBACK(on_diff_view_destroy), view);
+#if GTK_MAJOR_VERSION == 2
+	vbox = GTK_DIALOG(view->dialog)->vbox;
+#else
+	vbox = gtk_dialog_get_content_area(GTK_DIALOG(view->dialog));
+#endif
+
+	// Create the side-by-side lines.
+	view->tview = gtk_tree_view_new();
+	gtk_tree_view_set_fixed_height_mode(GTK_TREE_VIEW(view->tview), true);
+	diff_view_add_column(view, "", DIFF_CELL_OLD_NUMBER, 60);
+	diff_view_add_column(view, "On Disk", DIFF_CELL_OLD_TEXT, 400);
+	diff_view_add_column(view, "", DIFF_CELL_NEW_NUMBER, 60);
+	diff_view_add_column(view, "Editor", DIFF_CELL_NEW_TEXT, 400);
+	scrolled = gtk_scrolled_window_new(NULL, NULL);
+	gtk_container_add(GTK_CONTAINER(scrolled), view->tview);
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled),
+								   GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+	gtk_scrolled_window_set_shadow_type(GTK_SCROLLED_WINDOW(scrolled),
+										GTK_SHADOW_ETCHED_IN);
+	gtk_box_pack_start(GTK_BOX(vbox), scrolled, true, true, 0);
+	view->status = gtk_label_new("Comparing...");
+	gtk_misc_set_alignment(GTK_MISC(view->status), 0.0, 0.5);
+	gtk_box_pack_start(GTK_BOX(vbox), view->status, false, false, 5);
+	gtk_widget_show_all(view->dialog);
+	diff_view = view;
+
+	// Compare them in the background.
+	view->cancellable = g_cancellable_new();
+	diff_compute_async(diff_new(saved, length, contents, strlen(contents)),
+					   view->cancellable, on_diff_computed, view);
+}
+
+/**
+ * Adds a column to the diff view.
+ *
+ * @param view  Diff view.
+ * @param title Title of the column.
+ * @param cell  Cell of the diff row shown in the column.
+ * @param width Width of the column.
+ */
+void diff_view_add_column(diff_view_t *view, const char *title, gint cell,
+						  gint width) {
+	GtkTreeViewColumn *column;
+	GtkCellRenderer *renderer;
+
+	renderer = gtk_cell_renderer_text_new();
+	g_object_set(renderer, "family", "Monospace", NULL);
+	if ((cell == DIFF_CELL_OLD_TEXT) || (cell == DIFF_CELL_NEW_TEXT))
+		g_object_set(renderer, "ellipsize", PANGO_ELLIPSIZE_END, NULL);
+	else
+		g_object_set(renderer, "xalign", 1.0, NULL);
+	g_object_set_data(G_OBJECT(renderer), "diff-cell", GINT_TO_POINTER(cell));
+
+	column = gtk_tree_view_column_new_with_attributes(title, renderer, NULL);
+	gtk_tree_view_column_set_sizing(column, GTK_TREE_VIEW_COLUMN_FIXED);
+	gtk_tree_view_column_set_fixed_width(column, width);
+	gtk_tree_view_column_set_resizable(column, true);
+	gtk_tree_view_column_set_expand(column, width > 100);
+	gtk_tree_view_column_set_cell_data_func(column, renderer,
+											on_diff_cell_data, view, NULL);
+	gtk_tree_view_append_column(GTK_TREE_VIEW(view->tview), column);
+}
+
+/**
+ * Fills the diff view with the rows of a computed diff and scrolls to the
+ * first change.
+ *
+ * @param view Diff view.
+ */
+void diff_view_populate(diff_view_t *view) {
+	GtkListStore *store;
+	GtkTreePath *path;
+	gint first_change = -1;
+	gint row = 0;
+	char *status;
+	guint i;
+
+	// Align the lines of both versions, padding the shorter side of changes.
+	store = gtk_list_store_new(DIFF_NUM_COLS, G_TYPE_INT, G_TYPE_INT,
+							   G_TYPE_INT);
+	for (i = 0; i < view->diff->hunks->len; i++) {
+		diff_hunk_t *hunk = &g_array_index(view->diff->hunks, diff_hunk_t, i);
+		guint rows = MAX(hunk->old_count, hunk->new_count);
+		guint j;
+
+		if ((hunk->op != DIFF_EQUAL) && (first_change < 0))
+			first_change = row;
+
+		for (j = 0; j < rows; j++) {
+			gtk_list_store_insert_with_values(store, NULL, row++,
+				DIFF_COL_OLD, (j < hunk->old_count) ?
+					(gint)(hunk->old_start + j) : -1,
+				DIFF_COL_NEW, (j < hunk->new_count) ?
+					(gint)(hunk->new_start + j) : -1,
+				DIFF_COL_OP, hunk->op, -1);
+		}
+	}
+
+	// Hand it over to the view.
+	gtk_tree_view_set_model(GTK_TREE_VIEW(view->tview), GTK_TREE_MODEL(store));
+	g_object_unref(store);
+	if (first_change >= 0) {
+		path = gtk_tree_path_new_from_indices(first_change, -1);
+		gtk_tree_view_scroll_to_cell(GTK_TREE_VIEW(view->tview), path, NULL,
+									 true, 0.3, 0.0);
+		gtk_tree_path_free(path);
+	}
+
+	// Summarize it.
+	if ((view->diff->added == 0) && (view->diff->removed == 0)) {
+		status = g_strdup("No changes.");
+	} else {
+		status = g_strdup_printf("%u lines added, %u lines removed.",
+								 view->diff->added, view->diff->removed);
+	}
+	gtk_label_set_text(GTK_LABEL(view->status), status);
+	g_free(status);
+}
+
+/**
+ * Frees a diff view.
+ *
+ * @param view Diff view to be freed.
+ */
+void diff_view_free(diff_view_t *view) {
+	diff_free(view->diff);
+	g_free(view);
+}
+
+/**
+ * Callback for when the comparison is done.
+ *
+ * @param source Unused.
+ * @param result Result of the comparison.
+ * @param data   Diff view.
+ */
+void on_diff_computed(GObject *source, GAsyncResult *result, gpointer data) {
+	diff_view_t *view = (diff_view_t*)data;
+	GError *error = NULL;
+
+	view->diff = diff_compute_finish(result, &error);
+	g_object_unref(view->cancellable);
+	view->cancellable = NULL;
+
+	// The window may have been closed in the meantime.
+	if (view->dialog == NULL) {
+		g_clear_error(&error);
+		diff_view_free(view);
+
+		return;
+	}
+
+	if (view->diff == NULL) {
+		gtk_label_set_text(GTK_LABEL(view->status), error->message);
+		g_error_free(error);
+
+		return;
+	}
+
+	diff_view_populate(view);
+}
+
+/**
+ * Cell data function that fetches the line numbers and text of a row.
+ *
+ * @param column   Column being drawn.
+ * @param renderer Renderer of the cell.
+ * @param model    Diff rows.
+ * @param iter     Row being drawn.
+ * @param data     Diff view.
+ */
+void on_diff_cell_data(GtkTreeViewColumn *column, GtkCellRenderer *renderer,
+					   GtkTreeModel *model, GtkTreeIter *iter, gpointer data) {
+	diff_view_t *view = (diff_view_t*)data;
+	gint cell = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(renderer),
+												  "diff-cell"));
+	bool new_side = cell >= DIFF_CELL_NEW_NUMBER;
+	const char *background = NULL;
+	const char *line;
+	const char *valid;
+	gsize length;
+	char *text;
+	gint number;
+	gint op;
+
+	gtk_tree_model_get(model, iter, (new_side) ? DIFF_COL_NEW : DIFF_COL_OLD,
+					   &number, DIFF_COL_OP, &op, -1);
+
+	// Colour the changed lines.
+	if (number < 0) {
+		background = DIFF_COLOR_EMPTY;
+	} else if (!new_side && ((op == DIFF_DELETE) || (op == DIFF_REPLACE))) {
+		background = DIFF_COLOR_REMOVED;
+	} else if (new_side && ((op == DIFF_INSERT) || (op == DIFF_REPLACE))) {
+		background = DIFF_COLOR_ADDED;
+	}
+	if (background != NULL) {
+		g_object_set(renderer, "cell-background", background, NULL);
+	} else {
+		g_object_set(renderer, "cell-background-set", false, NULL);
+	}
+
+	// Get the line.
+	if (number < 0) {
+		g_object_set(renderer, "text", "", NULL);
+		return;
+	} else if ((cell == DIFF_CELL_OLD_NUMBER) ||
+			   (cell == DIFF_CELL_NEW_NUMBER)) {
+		text = g_strdup_printf("%d", number + 1);
+		g_object_set(renderer, "text", text, NULL);
+		g_free(text);
+
+		return;
+	}
+
+	// Only show as much of it as fits on the screen.
+	line = diff_line(view->diff, new_side, number, &length);
+	if (length > DIFF_VIEW_MAX_LINE)
+		length = DIFF_VIEW_MAX_LINE;
+	g_utf8_validate(line, length, &valid);
+	text = g_strndup(line, valid - line);
+	g_object_set(renderer, "text", text, NULL);
+	g_free(text);
+}
+
+/**
+ * Callback for when the diff view is closed.
+ *
+ * @param widget Diff view window.
+ * @param data   Diff view.
+ */
+void on_diff_view_destroy(GtkWidget *widget, gpointer data) {
+	diff_view_t *view = (diff_view_t*)data;
+
+	if (diff_view == view)
+		diff_view = NULL;
+	view->dialog = NULL;
+
+	// Let the comparison free it if it's still running.
+	if (view->cancellable != NULL) {
+		g_cancellable_cancel(view->cancellable);
+		return;
+	}
+
+	diff_view_free(view);
+}
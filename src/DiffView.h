@@ -0,0 +1,19 @@
+/**
+ * DiffView.h
+ * Side-by-side view of the unsaved changes made to a page.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _DIFFVIEW_H_
+#define _DIFFVIEW_H_
+
+#include <gtk/gtk.h>
+
+// Initialization.
+void initialize_diff_view(GtkWidget *main_window);
+
+// Display.
+void show_diff_view();
+
+#endif /* _DIFFVIEW_H_ */
@@ -0,0 +1,197 @@
+/**
+ * ExportDialog.c
+ * Dialogs to export the workspace as a static website.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include <uki/uki.h>
+#include "ExportDialog.h"
+#include "DialogHelper.h"
+#include "Export.h"
+
+// Constants.
+#define PROGRESS_INTERVAL 100
+
+// Export running in the background.
+typedef struct {
+	GtkWidget *dialog;
+	GtkWidget *progressbar;
+	char *outdir;
+	export_progress_t progress;
+	GError *error;
+	gint finished;
+	bool success;
+} export_run_t;
+
+// Private variables.
+GtkWidget *export_parent;
+
+// Private methods.
+char* export_choose_folder();
+gpointer export_thread(gpointer data);
+gboolean export_update_progress(gpointer data);
+
+/**
+ * Initializes the export dialog module.
+ *
+ * @param main_window Main application window.
+ */
+void initialize_export_dialog(GtkWidget *main_window) {
+	export_parent = main_window;
+}
+
+/**
+ * Asks for an output folder and exports the workspace to it.
+ */
+void show_export_dialog() {
+	export_run_t run;
+	GtkWidget *vbox;
+	GThread *thread;
+	guint timer;
+	gint res;
+
+	// Ask the user where to put the website.
+	if ((run.outdir = export_choose_folder()) == NULL)
+		return;
+
+	// Make sure the workspace won't be overwritten.
+	run.error = NULL;
+	if (!export_check_outdir(run.outdir, &run.error)) {
+		error_dialog("Invalid Export Folder", "%s", run.error->message);
+		g_error_free(run.error);
+		g_free(run.outdir);
+
+		return;
+	}
+
+	// Create the progress dialog.
+	run.dialog = gtk_dialog_new_with_buttons("Exporting Workspace",
+											 GTK_WINDOW(export_parent),
+											 GTK_DIALOG_MODAL |
+											 GTK_DIALOG_DESTROY_WITH_PARENT,
+#if GTK_MAJOR_VERSION == 2
+											 GTK_STOCK_CANCEL,
+#else
+											 "Cancel",
+#endif
+											 GTK_RESPONSE_CANCEL, NULL);
+#if GTK_MAJOR_VERSION == 2
+	vbox = GTK_DIALOG(run.dialog)->vbox;
+#else
+	vbox = gtk_dialog_get_content_area(GTK_DIALOG(run.dialog));
+#endif
+	run.progressbar = gtk_progress_bar_new();
+	gtk_widget_set_size_request(run.progressbar, 300, -1);
+	gtk_box_pack_start(GTK_BOX(vbox), run.progressbar, false, false, 10);
+	gtk_widget_show_all(vbox);
+
+	// Start exporting in the background.
+	export_progress_init(&run.progress);
+	run.finished = false;
+	run.success = false;
+	thread = g_thread_new("export", export_thread, &run);
+	timer = g_timeout_add(PROGRESS_INTERVAL, export_update_progress, &run);
+
+	// Wait for it to finish or for the user to cancel it.
+	res = gtk_dialog_run(GTK_DIALOG(run.dialog));
+	if (res != GTK_RESPONSE_OK)
+		export_cancel(&run.progress);
+	g_thread_join(thread);
+	g_source_remove(timer);
+	gtk_widget_destroy(run.dialog);
+
+	// Report the results.
+	if (run.success) {
+		message_dialog(GTK_MESSAGE_INFO, "Export Finished", "Exported %d pages "
+					   "and %d assets to '%s'. %d pages were unchanged.",
+					   run.progress.rendered, run.progress.assets, run.outdir,
+					   run.progress.skipped);
+	} else {
+		error_dialog("Export Failed", "%s", run.error->message);
+		g_error_free(run.error);
+	}
+
+	g_free(run.outdir);
+}
+
+/**
+ * Shows a dialog for the user to choose the export output folder.
+ *
+ * @return Newly allocated path to the folder or NULL if cancelled.
+ */
+char* export_choose_folder() {
+	GtkWidget *dialog;
+	char *fpath = NULL;
+
+	// Create the folder dialog and set it up.
+	dialog = gtk_file_chooser_dialog_new("Export Workspace To",
+										 GTK_WINDOW(export_parent),
+										 GTK_FILE_CHOOSER_ACTION_SELECT_FOLDER,
+#if GTK_MAJOR_VERSION == 2
+										 GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+										 GTK_STOCK_OK, GTK_RESPONSE_OK, NULL);
+#else
+										 "Cancel", GTK_RESPONSE_CANCEL,
+										 "Export", GTK_RESPONSE_OK, NULL);
+#endif
+	gtk_dialog_set_default_response(GTK_DIALOG(dialog), GTK_RESPONSE_OK);
+	gtk_file_chooser_set_create_folders(GTK_FILE_CHOOSER(dialog), true);
+	gtk_file_chooser_set_local_only(GTK_FILE_CHOOSER(dialog), true);
+
+	// Show the dialog and get the folder.
+	if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_OK)
+		fpath = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
+	gtk_widget_destroy(dialog);
+
+	return fpath;
+}
+
+/**
+ * Background thread that performs the export.
+ *
+ * @param  data Export run structure.
+ * @return      Always NULL.
+ */
+gpointer export_thread(gpointer data) {
+	export_run_t *run = (export_run_t*)data;
+
+	run->success = export_workspace(run->outdir, true, &run->progress,
+									&run->error);
+	g_atomic_int_set(&run->finished, true);
+
+	return NULL;
+}
+
+/**
+ * Timer callback that updates the export progress bar.
+ *
+ * @param  data Export run structure.
+ * @return      TRUE to keep the timer running.
+ */
+gboolean export_update_progress(gpointer data) {
+	export_run_t *run = (export_run_t*)data;
+	gint total;
+	gint done;
+	char text[64];
+
+	// Close the dialog if we are done.
+	if (g_atomic_int_get(&run->finished)) {
+		gtk_dialog_response(GTK_DIALOG(run->dialog), GTK_RESPONSE_OK);
+		return true;
+	}
+
+	// Update the progress bar.
+	total = g_atomic_int_get(&run->progress.total);
+	done = g_atomic_int_get(&run->progress.rendered) +
+		g_atomic_int_get(&run->progress.skipped) +
+		g_atomic_int_get(&run->progress.failed);
+	snprintf(text, sizeof(text), "%d of %d pages", done, total);
+	gtk_progress_bar_set_text(GTK_PROGRESS_BAR(run->progressbar), text);
+	if (total > 0) {
+		gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(run->progressbar),
+									  (gdouble)done / total);
+	}
+
+	return true;
+}
@@ -0,0 +1,19 @@
+/**
+ * ExportDialog.h
+ * Dialogs to export the workspace as a static website.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _EXPORTDIALOG_H_
+#define _EXPORTDIALOG_H_
+
+#include <gtk/gtk.h>
+
+// Initialization.
+void initialize_export_dialog(GtkWidget *main_window);
+
+// Display.
+void show_export_dialog();
+
+#endif /* _EXPORTDIALOG_H_ */
@@ -11,6 +11,9 @@
 #include <ctype.h>
 #include "FindReplace.h"
 #include "DialogHelper.h"
+#include "Arena.h"
+#include "Replay.h"
+#include "Trace.h"
 
 // Constants.
 #define SEARCH_MARK "search_start"
@@ -22,6 +25,7 @@ GtkWidget *entry_find;
 GtkWidget *check_matchcase;
 char *needle;
 bool match_case;
+arena_t *find_arena;
 
 // Private methods.
 void store_find_state();
@@ -43,6 +47,7 @@ void initialize_find_replace(GtkWidget *main_window, GtkWidget *_editor) {
 	// Initialize the state variables.
 	match_case = true;
 	needle = (char*)calloc(1, sizeof(char));
+	find_arena = arena_new(256);
 }
 
 /**
@@ -50,6 +55,7 @@ void initialize_find_replace(GtkWidget *main_window, GtkWidget *_editor) {
  */
 void destroy_find_replace() {
 	free(needle);
+	arena_free(find_arena);
 }
 
 /**
@@ -156,6 +162,18 @@ void restore_find_state() {
 	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(check_matchcase), match_case);
 }
 
+/**
+ * Sets what should be searched for without going through the dialog.
+ *
+ * @param text           String to search for.
+ * @param case_sensitive Should the search match the case of the string?
+ */
+void set_find_needle(const char *text, bool case_sensitive) {
+	needle = (char*)realloc(needle, (strlen(text) + 1) * sizeof(char));
+	strcpy(needle, text);
+	match_case = case_sensitive;
+}
+
 /**
  * Performs a "Find Next" operation in the text view.
  */
@@ -167,6 +185,9 @@ bool find_next() {
 	GtkTextMark *mark;
 	char *search_needle;
 
+	TRACE_BEGIN("find_next");
+	record_action(ACTION_FIND_NEXT, 0, match_case, needle);
+
 	// Handle case-insensitive search.
 	if (match_case) {
 		search_needle = needle;
@@ -174,7 +195,7 @@ bool find_next() {
 		char *tmp;
 
 		// Duplicate the needle string.
-		search_needle = strdup(needle);
+		search_needle = arena_strdup(find_arena, needle);
 		tmp = search_needle;
 
 		// Convert needle to lowercase.
@@ -215,6 +236,8 @@ bool find_next() {
 		// Wrap the search mark around.
 		gtk_text_buffer_get_start_iter(buffer, &iter);
 		gtk_text_buffer_move_mark_by_name(buffer, SEARCH_MARK, &iter);
+		arena_reset(find_arena);
+		TRACE_END("find_next");
 
 		return false;
 	}
@@ -224,8 +247,8 @@ bool find_next() {
 	gtk_text_buffer_move_mark_by_name(buffer, SEARCH_MARK, &match_end);
 
 	// Clean up.
-	if (!match_case)
-		free(search_needle);
+	arena_reset(find_arena);
+	TRACE_END("find_next");
 
 	return true;
 }
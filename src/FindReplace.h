@@ -15,6 +15,7 @@ void initialize_find_replace(GtkWidget *main_window, GtkWidget *_editor);
 void destroy_find_replace();
 
 // Actually Find and/or Replace.
+void set_find_needle(const char *text, bool case_sensitive);
 bool find_next();
 
 // Display.
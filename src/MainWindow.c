@@ -8,11 +8,18 @@
 #include <uki/uki.h>
 #include <glib/gstdio.h>
 #include "MainWindow.h"
-#include "MenuManager.h"
 #include "AppProperties.h"
+#include "Backlinks.h"
 #include "DialogHelper.h"
+#include "DiffView.h"
+#include "ExportDialog.h"
 #include "FindReplace.h"
+#include "MenuManager.h"
 #include "PageManager.h"
+#include "PerformanceWindow.h"
+#include "Replay.h"
+#include "RevisionsDialog.h"
+#include "SessionManager.h"
 #include "Workspace.h"
 
 // Private variables.
@@ -34,7 +41,9 @@ void initialize_mainwindow() {
 	GtkWidget *menubar;
 	GtkWidget *toolbar;
 	GtkWidget *hpaned;
+	GtkWidget *vpaned;
 	GtkWidget *scltree;
+	GtkWidget *backlinks;
 	GtkWidget *scleditor;
 	GtkWidget *pageeditor;
 	GtkWidget *pageviewer;
@@ -54,6 +63,10 @@ void initialize_mainwindow() {
 
 	// Initialize dialogs.
 	initialize_dialogs(window);
+	initialize_diff_view(window);
+	initialize_export_dialog(window);
+	initialize_revisions_dialog(window);
+	initialize_performance_window(window);
 
 	// Add vertical container to place the menu bar.
 #if GTK_MAJOR_VERSION == 2
@@ -92,7 +105,17 @@ void initialize_mainwindow() {
 								   GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
 	gtk_scrolled_window_set_shadow_type(GTK_SCROLLED_WINDOW(scltree),
 										GTK_SHADOW_ETCHED_IN);
-	gtk_paned_add1(GTK_PANED(hpaned), scltree);
+
+	// Stack the tree view on top of the backlinks panel.
+#if GTK_MAJOR_VERSION == 2
+	vpaned = gtk_vpaned_new();
+#else
+	vpaned = gtk_paned_new(GTK_ORIENTATION_VERTICAL);
+#endif
+	backlinks = initialize_backlinks();
+	gtk_paned_pack1(GTK_PANED(vpaned), scltree, true, false);
+	gtk_paned_pack2(GTK_PANED(vpaned), backlinks, false, true);
+	gtk_paned_add1(GTK_PANED(hpaned), vpaned);
 
 	// Initialize the page manager and the find and replace module.
 	initialize_page_manager(&pageeditor, &pageviewer);
@@ -154,7 +177,15 @@ GtkWidget* initialize_treeview() {
 	// Create the cell renderer.
 	renderer = gtk_cell_renderer_text_new();
 	gtk_tree_view_column_pack_start(mcol, renderer, TRUE);
-	gtk_tree_view_column_add_attribute(mcol, renderer, "text", 0);
+	gtk_tree_view_column_set_cell_data_func(mcol, renderer,
+											workspace_name_cell_data, NULL,
+											NULL);
+
+	// Search the names as they are shown. (They aren't stored as strings)
+	gtk_tree_view_set_search_column(GTK_TREE_VIEW(tview), COL_NAME);
+	gtk_tree_view_set_search_equal_func(GTK_TREE_VIEW(tview),
+										workspace_name_search_equal, NULL,
+										NULL);
 
 	// Set the callback for the selection change signal.
 	g_signal_connect(selection, "changed",
@@ -200,6 +231,31 @@ GtkWidget* initialize_notebook(GtkWidget *editor_container,
 	return notebook;
 }
 
+/**
+ * Sets the title of the main window to reflect the selected page.
+ *
+ * @param name Name of the page or NULL if there's none.
+ */
+void set_window_page_title(const char *name) {
+	char *title;
+
+	if (name == NULL) {
+		gtk_window_set_title(GTK_WINDOW(window), APP_NAME);
+		return;
+	}
+
+	title = g_strdup_printf("%s - %s", name, APP_NAME);
+	gtk_window_set_title(GTK_WINDOW(window), title);
+	g_free(title);
+}
+
+/**
+ * Brings the main window to the front.
+ */
+void present_mainwindow() {
+	gtk_window_present(GTK_WINDOW(window));
+}
+
 /**
  * Destroys the main window
  */
@@ -207,7 +263,8 @@ void window_destroy() {
 	// Call the window deletion callback just to be sure.
 	on_window_delete();
 
-	// Clean up.
+	// Remember where we were and clean up.
+	store_session();
 	destroy_find_replace();
 	close_workspace();
 
@@ -231,8 +288,8 @@ void on_window_delete() {
  * @param user_data Data passed by the signal connector.
  */
 void on_editor_buffer_changed(GtkTextBuffer *buffer, gpointer user_data) {
-	// Set the page as having unsaved changes.
-	set_page_unsaved_changes(true);
+	// Check if the page really differs from what's on disk.
+	update_page_unsaved_changes();
 }
 
 /**
@@ -248,6 +305,7 @@ void on_notebook_page_changed(GtkNotebook *notebook, GtkWidget *page,
 							  guint page_num, gpointer user_data) {
 	// Get the viewer page index from the user_data field.
 	guint view_index = (unsigned int)(long)user_data;
+	record_action(ACTION_SWITCH_TAB, page_num, 0, NULL);
 
 	// Only do something if we are changing to the viewer tab.
 	if (page_num == view_index) {
@@ -275,19 +333,27 @@ void on_treeview_selection_changed(GtkWidget *widget, gpointer callback_data) {
 	if (gtk_tree_selection_get_selected(selection, &model, &iter)) {
 		gint index;
 		gchar type;
+		const gchar *name;
 
 		// Get the important values from the selection.
-		gtk_tree_model_get(model, &iter, COL_INDEX, &index, COL_TYPE, &type, -1);
+		gtk_tree_model_get(model, &iter, COL_NAME, &name, COL_INDEX, &index,
+						   COL_TYPE, &type, -1);
 
-		// Check for the type of selection.
+		// Check for the type of selection. (Pages load in the background, so
+		// show their name straight away)
 		switch (type) {
 		case ROW_TYPE_ARTICLE:
+			record_page_selected(page_article(index));
+			set_window_page_title(name);
 			load_article(index);
 			break;
 		case ROW_TYPE_TEMPLATE:
+			record_page_selected(page_template(index));
+			set_window_page_title(name);
 			load_template(index);
 			break;
 		default:
+			set_window_page_title(NULL);
 			clear_page_contents();
 			break;
 		}
@@ -492,6 +558,7 @@ void on_menu_new_page(GtkWidget *widget, gpointer data) {
 										 NULL);
 	gtk_dialog_set_default_response(GTK_DIALOG(dialog), GTK_RESPONSE_OK);
 	gtk_file_chooser_set_current_folder_uri(GTK_FILE_CHOOSER(dialog), uri);
+	free(uri);
 	gtk_file_chooser_set_create_folders(GTK_FILE_CHOOSER(dialog), true);
 	gtk_file_chooser_set_local_only(GTK_FILE_CHOOSER(dialog), true);
     gtk_file_chooser_set_current_name(GTK_FILE_CHOOSER(dialog),
@@ -515,7 +582,6 @@ void on_menu_new_page(GtkWidget *widget, gpointer data) {
 	}
 
 	// Get the file name and destroy the dialog.
-	free(uri);
 	uri = gtk_file_chooser_get_uri(GTK_FILE_CHOOSER(dialog));
 	strcpy(fpath, uri + ub_len - 1);
 	g_free(uri);
@@ -631,6 +697,16 @@ void on_workspace_close(GtkWidget *widget, gpointer data) {
 	update_workspace_state_menu();
 }
 
+/**
+ * Menu item callback for exporting the workspace as a static website.
+ *
+ * @param widget Widget that fired this event.
+ * @param data   Data passed by the signal connector.
+ */
+void on_workspace_export(GtkWidget *widget, gpointer data) {
+	show_export_dialog();
+}
+
 /**
  * Menu item callback for saving the current opened page.
  *
@@ -638,9 +714,31 @@ void on_workspace_close(GtkWidget *widget, gpointer data) {
  * @param data   Data passed by the signal connector.
  */
 void on_page_save(GtkWidget *widget, gpointer data) {
+	record_action(ACTION_SAVE_PAGE, 0, 0, NULL);
 	save_current_page();
 }
 
+/**
+ * Menu item callback for browsing the saved revisions of the current page.
+ *
+ * @param widget Widget that fired this event.
+ * @param data   Data passed by the signal connector.
+ */
+void on_page_history(GtkWidget *widget, gpointer data) {
+	show_revisions_dialog();
+}
+
+/**
+ * Menu item callback for choosing to save a reformatted page as it's shown.
+ *
+ * @param widget Widget that fired this event.
+ * @param data   Data passed by the signal connector.
+ */
+void on_save_reformatted(GtkWidget *widget, gpointer data) {
+	set_page_save_reformatted(gtk_check_menu_item_get_active(
+		GTK_CHECK_MENU_ITEM(widget)));
+}
+
 /**
  * Menu item callback for saving the current opened page as a new page.
  *
@@ -680,6 +778,7 @@ void on_page_save_as(GtkWidget *widget, gpointer data) {
 										 NULL);
 	gtk_dialog_set_default_response(GTK_DIALOG(dialog), GTK_RESPONSE_OK);
 	gtk_file_chooser_set_current_folder_uri(GTK_FILE_CHOOSER(dialog), uri);
+	free(uri);
 	gtk_file_chooser_set_create_folders(GTK_FILE_CHOOSER(dialog), true);
 	gtk_file_chooser_set_local_only(GTK_FILE_CHOOSER(dialog), true);
     gtk_file_chooser_set_current_name(GTK_FILE_CHOOSER(dialog),
@@ -703,7 +802,6 @@ void on_page_save_as(GtkWidget *widget, gpointer data) {
 	}
 
 	// Get the file name and destroy the dialog.
-	free(uri);
 	uri = gtk_file_chooser_get_uri(GTK_FILE_CHOOSER(dialog));
 	strcpy(fpath, uri + ub_len - 1);
 	g_free(uri);
@@ -815,6 +913,62 @@ void on_show_page_editor(GtkWidget *widget, gpointer data) {
 	gtk_notebook_set_current_page(GTK_NOTEBOOK(notebook), 1);
 }
 
+/**
+ * Menu item callback for comparing the editor with the page on disk.
+ *
+ * @param widget Widget that fired this event.
+ * @param data   Data passed by the signal connector.
+ */
+void on_show_changes(GtkWidget *widget, gpointer data) {
+	show_diff_view();
+}
+
+/**
+ * Menu item callback for going back to the previous page.
+ *
+ * @param widget Widget that fired this event.
+ * @param data   Data passed by the signal connector.
+ */
+void on_go_back(GtkWidget *widget, gpointer data) {
+	go_back_page();
+
+	// Set the state of the widgets affected by the changes.
+	update_workspace_state_menu();
+}
+
+/**
+ * Menu item callback for going forward to the next page.
+ *
+ * @param widget Widget that fired this event.
+ * @param data   Data passed by the signal connector.
+ */
+void on_go_forward(GtkWidget *widget, gpointer data) {
+	go_forward_page();
+
+	// Set the state of the widgets affected by the changes.
+	update_workspace_state_menu();
+}
+
+/**
+ * Menu item callback for showing the performance window.
+ *
+ * @param widget Widget that fired this event.
+ * @param data   Data passed by the signal connector.
+ */
+void on_show_performance(GtkWidget *widget, gpointer data) {
+	show_performance_window();
+}
+
+/**
+ * Menu item callback for dumping the statistics to a file.
+ *
+ * @param widget Widget that fired this event.
+ * @param data   Data passed by the signal connector.
+ */
+void on_dump_statistics(GtkWidget *widget, gpointer data) {
+	dump_performance_stats();
+}
+
 /**
  * Menu item callback for showing the find dialog.
  *
@@ -15,19 +15,31 @@
 void initialize_mainwindow();
 void window_destroy();
 
+// State.
+void set_window_page_title(const char *name);
+void present_mainwindow();
+
 // Menu items and callbacks.
 void on_menu_new_page(GtkWidget *widget, gpointer data);
 void on_workspace_open(GtkWidget *widget, gpointer data);
 void on_workspace_refresh(GtkWidget *widget, gpointer data);
 void on_workspace_close(GtkWidget *widget, gpointer data);
+void on_workspace_export(GtkWidget *widget, gpointer data);
 void on_page_save(GtkWidget *widget, gpointer data);
 void on_page_save_as(GtkWidget *widget, gpointer data);
+void on_page_history(GtkWidget *widget, gpointer data);
+void on_save_reformatted(GtkWidget *widget, gpointer data);
 void on_editor_cut(GtkWidget *widget, gpointer data);
 void on_editor_copy(GtkWidget *widget, gpointer data);
 void on_editor_paste(GtkWidget *widget, gpointer data);
 void on_editor_select_all(GtkWidget *widget, gpointer data);
 void on_show_page_viewer(GtkWidget *widget, gpointer data);
 void on_show_page_editor(GtkWidget *widget, gpointer data);
+void on_show_changes(GtkWidget *widget, gpointer data);
+void on_go_back(GtkWidget *widget, gpointer data);
+void on_go_forward(GtkWidget *widget, gpointer data);
+void on_show_performance(GtkWidget *widget, gpointer data);
+void on_dump_statistics(GtkWidget *widget, gpointer data);
 void on_show_dialog_find(GtkWidget *widget, gpointer data);
 void on_editor_find_next(GtkWidget *widget, gpointer data);
 void on_toggle_notebook_page(GtkWidget *widget, gpointer data);
@@ -22,15 +22,23 @@ GtkToolItem *tool_save_page;
 GtkToolItem *tool_jump_to;
 GtkToolItem *tool_workspace_refresh;
 GtkToolItem *tool_workspace_close;
+GtkToolItem *tool_go_back;
+GtkToolItem *tool_go_forward;
 
 // Global menu items.
 GtkWidget *menu_refresh_workspace;
 GtkWidget *menu_close_workspace;
+GtkWidget *menu_export_workspace;
 GtkWidget *menu_new_template;
 GtkWidget *menu_new_article;
 GtkWidget *menu_save_as;
 GtkWidget *menu_save;
+GtkWidget *menu_save_reformatted;
+GtkWidget *menu_page_history;
+GtkWidget *menu_show_changes;
 GtkWidget *menu_jump_page;
+GtkWidget *menu_go_back;
+GtkWidget *menu_go_forward;
 
 /**
  * Initializes te menu manager.
@@ -127,6 +135,19 @@ GtkWidget* initialize_menubar() {
 	g_signal_connect(G_OBJECT(menu_close_workspace), "activate",
 			G_CALLBACK(on_workspace_close), NULL);
 	gtk_menu_shell_append(GTK_MENU_SHELL(menu), menu_close_workspace);
+#if GTK_MAJOR_VERSION == 2
+	menu_export_workspace = gtk_image_menu_item_new_from_stock(
+			GTK_STOCK_CONVERT, accel_group);
+#else
+	menu_export_workspace = gtk_menu_item_new_with_mnemonic("_Export");
+#endif
+	gtk_menu_item_set_label(GTK_MENU_ITEM(menu_export_workspace),
+			"Export Workspace...");
+	gtk_widget_add_accelerator(menu_export_workspace, "activate", accel_group,
+			GDK_KEY_e, GDK_CONTROL_MASK | GDK_SHIFT_MASK, GTK_ACCEL_VISIBLE);
+	g_signal_connect(G_OBJECT(menu_export_workspace), "activate",
+			G_CALLBACK(on_workspace_export), NULL);
+	gtk_menu_shell_append(GTK_MENU_SHELL(menu), menu_export_workspace);
 	separator = gtk_separator_menu_item_new();
 	gtk_menu_shell_append(GTK_MENU_SHELL(menu), separator);
 #if GTK_MAJOR_VERSION == 2
@@ -147,6 +168,17 @@ GtkWidget* initialize_menubar() {
 	g_signal_connect(G_OBJECT(menu_save_as), "activate",
 			G_CALLBACK(on_page_save_as), NULL);
 	gtk_menu_shell_append(GTK_MENU_SHELL(menu), menu_save_as);
+	menu_save_reformatted = gtk_check_menu_item_new_with_mnemonic(
+			"Save _Reformatted");
+	g_signal_connect(G_OBJECT(menu_save_reformatted), "toggled",
+			G_CALLBACK(on_save_reformatted), NULL);
+	gtk_menu_shell_append(GTK_MENU_SHELL(menu), menu_save_reformatted);
+	menu_page_history = gtk_menu_item_new_with_mnemonic("Page _History...");
+	gtk_widget_add_accelerator(menu_page_history, "activate", accel_group,
+			GDK_KEY_h, GDK_CONTROL_MASK | GDK_SHIFT_MASK, GTK_ACCEL_VISIBLE);
+	g_signal_connect(G_OBJECT(menu_page_history), "activate",
+			G_CALLBACK(on_page_history), NULL);
+	gtk_menu_shell_append(GTK_MENU_SHELL(menu), menu_page_history);
 	separator = gtk_separator_menu_item_new();
 	gtk_menu_shell_append(GTK_MENU_SHELL(menu), separator);
 #if GTK_MAJOR_VERSION == 2
@@ -316,6 +348,50 @@ GtkWidget* initialize_menubar() {
 	g_signal_connect(G_OBJECT(item), "activate",
 			G_CALLBACK(on_toggle_notebook_page), NULL);
 	gtk_menu_shell_append(GTK_MENU_SHELL(menu), item);
+	menu_show_changes = gtk_menu_item_new_with_mnemonic("Show _Changes");
+	gtk_widget_add_accelerator(menu_show_changes, "activate", accel_group,
+			GDK_KEY_d, GDK_CONTROL_MASK | GDK_SHIFT_MASK, GTK_ACCEL_VISIBLE);
+	g_signal_connect(G_OBJECT(menu_show_changes), "activate",
+			G_CALLBACK(on_show_changes), NULL);
+	gtk_menu_shell_append(GTK_MENU_SHELL(menu), menu_show_changes);
+	separator = gtk_separator_menu_item_new();
+	gtk_menu_shell_append(GTK_MENU_SHELL(menu), separator);
+#if GTK_MAJOR_VERSION == 2
+	menu_go_back = gtk_image_menu_item_new_from_stock(GTK_STOCK_GO_BACK,
+			accel_group);
+#else
+	menu_go_back = gtk_menu_item_new_with_mnemonic("_Back");
+#endif
+	gtk_widget_add_accelerator(menu_go_back, "activate", accel_group,
+			GDK_KEY_Left, GDK_MOD1_MASK, GTK_ACCEL_VISIBLE);
+	g_signal_connect(G_OBJECT(menu_go_back), "activate",
+			G_CALLBACK(on_go_back), NULL);
+	gtk_menu_shell_append(GTK_MENU_SHELL(menu), menu_go_back);
+#if GTK_MAJOR_VERSION == 2
+	menu_go_forward = gtk_image_menu_item_new_from_stock(GTK_STOCK_GO_FORWARD,
+			accel_group);
+#else
+	menu_go_forward = gtk_menu_item_new_with_mnemonic("_Forward");
+#endif
+	gtk_widget_add_accelerator(menu_go_forward, "activate", accel_group,
+			GDK_KEY_Right, GDK_MOD1_MASK, GTK_ACCEL_VISIBLE);
+	g_signal_connect(G_OBJECT(menu_go_forward), "activate",
+			G_CALLBACK(on_go_forward), NULL);
+	gtk_menu_shell_append(GTK_MENU_SHELL(menu), menu_go_forward);
+	separator = gtk_separator_menu_item_new();
+	gtk_menu_shell_append(GTK_MENU_SHELL(menu), separator);
+	item = gtk_menu_item_new_with_mnemonic("_Performance");
+	gtk_widget_add_accelerator(item, "activate", accel_group,
+			GDK_KEY_p, GDK_CONTROL_MASK | GDK_SHIFT_MASK, GTK_ACCEL_VISIBLE);
+	g_signal_connect(G_OBJECT(item), "activate",
+			G_CALLBACK(on_show_performance), NULL);
+	gtk_menu_shell_append(GTK_MENU_SHELL(menu), item);
+	item = gtk_menu_item_new_with_label("Dump Statistics");
+	gtk_widget_add_accelerator(item, "activate", accel_group,
+			GDK_KEY_p, GDK_CONTROL_MASK | GDK_MOD1_MASK, GTK_ACCEL_VISIBLE);
+	g_signal_connect(G_OBJECT(item), "activate",
+			G_CALLBACK(on_dump_statistics), NULL);
+	gtk_menu_shell_append(GTK_MENU_SHELL(menu), item);
 	gtk_menu_shell_append(GTK_MENU_SHELL(menubar), menu_view);
 
 	// Build the help menu.
@@ -350,6 +426,17 @@ GtkWidget* initialize_toolbar() {
 	toolbar = gtk_toolbar_new();
 	gtk_toolbar_set_style(GTK_TOOLBAR(toolbar), GTK_TOOLBAR_ICONS);
 
+	// Add the navigation items.
+	tool_go_back = gtk_tool_button_new_from_stock(GTK_STOCK_GO_BACK);
+	g_signal_connect(tool_go_back, "clicked", G_CALLBACK(on_go_back), NULL);
+	gtk_toolbar_insert(GTK_TOOLBAR(toolbar), tool_go_back, -1);
+	tool_go_forward = gtk_tool_button_new_from_stock(GTK_STOCK_GO_FORWARD);
+	g_signal_connect(tool_go_forward, "clicked", G_CALLBACK(on_go_forward),
+			NULL);
+	gtk_toolbar_insert(GTK_TOOLBAR(toolbar), tool_go_forward, -1);
+	item = gtk_separator_tool_item_new();
+	gtk_toolbar_insert(GTK_TOOLBAR(toolbar), item, -1);
+
 	// Add the page items.
 	tool_new_page = gtk_tool_button_new_from_stock(GTK_STOCK_NEW);
 	g_signal_connect(tool_new_page, "clicked", G_CALLBACK(on_menu_new_page),
@@ -420,6 +507,7 @@ void update_workspace_state_menu() {
 		// Menu items.
 		gtk_widget_set_sensitive(menu_refresh_workspace, true);
 		gtk_widget_set_sensitive(menu_close_workspace, true);
+		gtk_widget_set_sensitive(menu_export_workspace, true);
 		gtk_widget_set_sensitive(menu_new_article, true);
 		gtk_widget_set_sensitive(menu_new_template, true);
 		gtk_widget_set_sensitive(menu_jump_page, true);
@@ -435,6 +523,7 @@ void update_workspace_state_menu() {
 		// Menu items.
 		gtk_widget_set_sensitive(menu_refresh_workspace, false);
 		gtk_widget_set_sensitive(menu_close_workspace, false);
+		gtk_widget_set_sensitive(menu_export_workspace, false);
 		gtk_widget_set_sensitive(menu_new_article, false);
 		gtk_widget_set_sensitive(menu_new_template, false);
 		gtk_widget_set_sensitive(menu_jump_page, false);
@@ -453,6 +542,9 @@ void update_workspace_state_menu() {
 		// Menu items.
 		gtk_widget_set_sensitive(menu_save, true);
 		gtk_widget_set_sensitive(menu_save_as, true);
+		gtk_widget_set_sensitive(menu_page_history, true);
+		gtk_widget_set_sensitive(menu_show_changes, true);
+		gtk_widget_set_sensitive(menu_save_reformatted, is_page_reflowed());
 
 #if GTK_MAJOR_VERSION == 2
 		// Toolbar items.
@@ -462,11 +554,27 @@ void update_workspace_state_menu() {
 		// Menu items.
 		gtk_widget_set_sensitive(menu_save, false);
 		gtk_widget_set_sensitive(menu_save_as, false);
+		gtk_widget_set_sensitive(menu_page_history, false);
+		gtk_widget_set_sensitive(menu_show_changes, false);
+		gtk_widget_set_sensitive(menu_save_reformatted, false);
 
 #if GTK_MAJOR_VERSION == 2
 		// Toolbar items.
 		gtk_widget_set_sensitive(GTK_WIDGET(tool_save_page), false);
 #endif
 	}
+
+	// Only reformatted pages can be saved reformatted.
+	gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(menu_save_reformatted),
+								   is_page_save_reformatted());
+
+	// Handle history change.
+	gtk_widget_set_sensitive(menu_go_back, can_go_back_page());
+	gtk_widget_set_sensitive(menu_go_forward, can_go_forward_page());
+#if GTK_MAJOR_VERSION == 2
+	gtk_widget_set_sensitive(GTK_WIDGET(tool_go_back), can_go_back_page());
+	gtk_widget_set_sensitive(GTK_WIDGET(tool_go_forward),
+							 can_go_forward_page());
+#endif
 }
 
@@ -5,6 +5,7 @@
  * @author Nathan Campos <hi@nathancampos.me>
  */
 
+#include <string.h>
 #include <uki/uki.h>
 #if GTK_MAJOR_VERSION == 2
 #include <webkit/webkit.h>
@@ -12,332 +13,2007 @@
 #include <webkit2/webkit2.h>
 #endif
 #include "PageManager.h"
+#include "AppProperties.h"
+#include "Backlinks.h"
 #include "DialogHelper.h"
+#include "Encoding.h"
+#include "MenuManager.h"
+#include "History.h"
+#include "Journal.h"
+#include "LinkGraph.h"
+#include "Merge.h"
+#include "Page.h"
+#include "PageIndex.h"
+#include "PageScheduler.h"
+#include "Reflow.h"
+#include "Revisions.h"
+#include "Stats.h"
+#include "Trace.h"
+#include "Workspace.h"
 
 // Constants.
 #define MAX_URI UKI_MAX_PATH + 11
+#define DIRTY_CHECK_DELAY    250
+#define DISK_CHECK_DELAY     500
+
+// Reports the scroll offset of the viewer whenever it changes, at most once
+// per frame, since WebKit2 can't be asked for it synchronously.
+#define SCROLL_HANDLER "scroll"
+#define SCROLL_REPORT_SCRIPT \
+	"(function() { var queued = false;" \
+	" window.addEventListener('scroll', function() {" \
+	"  if (queued) return; queued = true;" \
+	"  window.requestAnimationFrame(function() { queued = false;" \
+	"   window.webkit.messageHandlers." SCROLL_HANDLER \
+	".postMessage(window.scrollY); }); }, { passive: true }); })();"
+
+// Answers to reformatting a page with long lines.
+#define REFLOW_DECLINED 1
+#define REFLOW_ACCEPTED 2
 
 // Private variables.
 GtkWidget *editor;
 GtkWidget *viewer;
-ssize_t current_article_i;
-ssize_t current_template_i;
+GtkWidget *viewer_back;
+GtkWidget *viewer_stack;
+#if GTK_MAJOR_VERSION == 2
+GtkWidget *viewer_scroll;
+#else
+gdouble viewer_scroll_y;
+#endif
+bool viewer_swap_pending;
+bool viewer_back_failed;
+page_t current_page;
 char current_uri[MAX_URI];
+GBytes *current_source;
+GBytes *current_html;
+encoding_t current_encoding;
 bool unsaved_changes;
+guint64 saved_hash;
+gint saved_chars;
+guint64 render_hash;
+guint dirty_check;
+history_entry_t *history_restore;
+gdouble pending_scroll;
+journal_t *journal;
+char *journal_dir;
+guint journal_timer;
+GFileMonitor *disk_monitor;
+gint64 disk_mtime;
+goffset disk_size;
+guint disk_check;
+GCancellable *merge_cancellable;
+reflow_t *reflow;
+bool save_reformatted;
+GHashTable *reflow_choices;
 
 // Private methods.
 GtkWidget* initialize_page_editor();
 GtkWidget* initialize_page_viewer();
+GtkWidget* initialize_web_view();
+void load_viewer_html(GBytes *html);
+void swap_viewer();
+bool load_page(page_t page);
+void on_page_loaded(page_t page, page_load_t *load, GError *error,
+					gpointer data);
+void enter_page(page_t page);
 bool load_file();
+void show_page(GBytes *source, GBytes *html);
+void replace_bytes(GBytes **slot, GBytes *bytes);
+const char* setup_page_reflow(const char *text, gsize length);
+const char* get_editor_base(gsize *length);
+char* get_editor_source(const char *contents, gsize *length);
+history_entry_t* snapshot_page();
+void restore_page(history_entry_t *entry);
+void select_history_entry(history_entry_t *entry);
+bool navigate_history(bool forward);
+gdouble query_viewer_scroll();
+void remember_saved_contents(const char *contents, gsize length);
+void settle_unsaved_changes();
+gboolean on_dirty_check(gpointer data);
+void start_journal();
+void stop_journal(bool discard);
+void offer_journal_recovery();
+void on_editor_insert_text(GtkTextBuffer *buffer, GtkTextIter *location,
+						   gchar *text, gint length, gpointer data);
+void on_editor_delete_range(GtkTextBuffer *buffer, GtkTextIter *start,
+							GtkTextIter *end, gpointer data);
+gboolean on_journal_timer(gpointer data);
+void watch_page_file();
+void unwatch_page_file();
+bool query_disk_state(const char *fpath, gint64 *mtime, goffset *size);
+void remember_disk_state();
+void schedule_disk_check();
+void on_disk_changed(GFileMonitor *monitor, GFile *file, GFile *other,
+					 GFileMonitorEvent event, gpointer data);
+gboolean on_disk_check(gpointer data);
+bool check_external_changes();
+void adopt_disk_contents(GBytes *source);
+void merge_external_changes(GBytes *theirs);
+void on_external_merged(GObject *source, GAsyncResult *result,
+						gpointer data);
+void scroll_viewer_to(gdouble offset);
+bool resolve_viewer_link(const char *uri, page_t *page);
+void follow_viewer_link(page_t page);
+#if GTK_MAJOR_VERSION == 2
+gboolean on_viewer_navigation_requested(WebKitWebView *view,
+										WebKitWebFrame *frame,
+										WebKitNetworkRequest *request,
+										WebKitWebNavigationAction *action,
+										WebKitWebPolicyDecision *decision,
+										gpointer data);
+void on_viewer_load_status(GObject *object, GParamSpec *pspec, gpointer data);
+#else
+gboolean on_viewer_decide_policy(WebKitWebView *view,
+								 WebKitPolicyDecision *decision,
+								 WebKitPolicyDecisionType type, gpointer data);
+void on_viewer_load_changed(WebKitWebView *view, WebKitLoadEvent event,
+							gpointer data);
+gboolean on_viewer_load_failed(WebKitWebView *view, WebKitLoadEvent event,
+							   gchar *uri, GError *error, gpointer data);
+void on_viewer_scroll_captured(GObject *object, GAsyncResult *result,
+							   gpointer data);
+void on_viewer_scroll_reported(WebKitUserContentManager *manager,
+							   WebKitJavascriptResult *js_result,
+							   gpointer data);
+#endif
+gint64 stats_editor_content();
+gint64 stats_viewer_content();
+
+/**
+ * Initializes the page manager.
+ *
+ * @param edit Page editor widget. (Created by this function)
+ * @param view Page viewer widget. (Created by this function)
+ */
+void initialize_page_manager(GtkWidget **edit, GtkWidget **view) {
+	// Create our main widgets and pass them back to our called function.
+	editor = initialize_page_editor();
+	*edit = editor;
+	*view = initialize_page_viewer();
+
+	// Initialize our state variables.
+	current_page = page_none();
+	current_source = NULL;
+	current_html = NULL;
+	current_encoding = ENCODING_UTF8;
+	unsaved_changes = false;
+	saved_hash = 0;
+	saved_chars = -1;
+	render_hash = 0;
+#if GTK_MAJOR_VERSION != 2
+	viewer_scroll_y = 0;
+#endif
+	dirty_check = 0;
+	history_restore = NULL;
+	pending_scroll = -1;
+	journal = NULL;
+	disk_monitor = NULL;
+	disk_mtime = -1;
+	disk_size = -1;
+	disk_check = 0;
+	merge_cancellable = NULL;
+	reflow = NULL;
+	save_reformatted = false;
+	reflow_choices = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+										   NULL);
+	journal_dir = g_build_filename(g_get_user_cache_dir(), APP_NAME, "journal",
+								   NULL);
+	journal_timer = g_timeout_add_seconds(JOURNAL_SYNC_INTERVAL,
+										  on_journal_timer, NULL);
+	page_scheduler_init(on_page_loaded, NULL);
+
+	// Let the statistics know how much content is being shown. (What GTK and
+	// WebKit allocate for it is only part of the process RSS gauges)
+	stats_register_gauge("editor_content_characters", stats_editor_content,
+						 false);
+	stats_register_gauge("viewer_content_bytes", stats_viewer_content, true);
+}
+
+/**
+ * Initializes the page editor (GtkTextView) control.
+ *
+ * @return The GtkTextView control.
+ */
+GtkWidget* initialize_page_editor() {
+	GtkTextBuffer *buffer;
+	GtkWidget *editor;
+
+	// Create and setup editor.
+	editor = gtk_text_view_new();
+	gtk_text_view_set_wrap_mode(GTK_TEXT_VIEW(editor), GTK_WRAP_WORD);
+#if GTK_MAJOR_VERSION == 2
+	gtk_widget_modify_font(editor,
+			pango_font_description_from_string("Monospace 10"));
+#else
+	gtk_text_view_set_monospace(GTK_TEXT_VIEW(editor), true);
+#endif
+
+	// Journal every edit before it's applied.
+	buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(editor));
+	g_signal_connect(buffer, "insert-text",
+					 G_CALLBACK(on_editor_insert_text), NULL);
+	g_signal_connect(buffer, "delete-range",
+					 G_CALLBACK(on_editor_delete_range), NULL);
+
+	return editor;
+}
+
+/**
+ * Initializes the page viewer.
+ *
+ * The viewer is double-buffered: new pages are loaded into a hidden web view
+ * that only gets swapped in once it has finished loading, so the user never
+ * sees a blank or partially laid out page.
+ *
+ * @return Container of the page viewer.
+ */
+GtkWidget* initialize_page_viewer() {
+	// Stack the web views on top of each other, only showing the front one.
+	viewer_stack = gtk_notebook_new();
+	gtk_notebook_set_show_tabs(GTK_NOTEBOOK(viewer_stack), false);
+	gtk_notebook_set_show_border(GTK_NOTEBOOK(viewer_stack), false);
+	viewer = initialize_web_view();
+	viewer_back = initialize_web_view();
+#if GTK_MAJOR_VERSION == 2
+	viewer_scroll = gtk_widget_get_parent(viewer);
+#endif
+
+	viewer_swap_pending = false;
+	viewer_back_failed = false;
+	return viewer_stack;
+}
+
+/**
+ * Initializes a web view (WebKitGTK) of the page viewer.
+ *
+ * @return The WebKitGTK widget already added to the viewer stack.
+ */
+GtkWidget* initialize_web_view() {
+	GtkWidget *webview;
+#if GTK_MAJOR_VERSION == 2
+	GtkWidget *scrolled;
+
+	// Initialize web viewer.
+	webview = webkit_web_view_new();
+#else
+	WebKitUserContentManager *manager;
+	WebKitUserScript *script;
+
+	// Initialize web viewer with a way for it to tell us where it's scrolled.
+	manager = webkit_user_content_manager_new();
+	script = webkit_user_script_new(SCROLL_REPORT_SCRIPT,
+		WEBKIT_USER_CONTENT_INJECT_TOP_FRAME,
+		WEBKIT_USER_SCRIPT_INJECT_AT_DOCUMENT_START, NULL, NULL);
+	webkit_user_content_manager_add_script(manager, script);
+	webkit_user_script_unref(script);
+	webview = webkit_web_view_new_with_user_content_manager(manager);
+	g_signal_connect(manager, "script-message-received::" SCROLL_HANDLER,
+					 G_CALLBACK(on_viewer_scroll_reported), webview);
+	webkit_user_content_manager_register_script_message_handler(manager,
+		SCROLL_HANDLER);
+	g_object_unref(manager);
+#endif
+
+	// Intercept the links to other pages and know when pages are loaded.
+#if GTK_MAJOR_VERSION == 2
+	g_signal_connect(webview, "navigation-policy-decision-requested",
+					 G_CALLBACK(on_viewer_navigation_requested), NULL);
+	g_signal_connect(webview, "notify::load-status",
+					 G_CALLBACK(on_viewer_load_status), NULL);
+
+	// WebKit1 needs a scrolled window for us to know where we are in the page.
+	scrolled = gtk_scrolled_window_new(NULL, NULL);
+	gtk_container_add(GTK_CONTAINER(scrolled), webview);
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled),
+								   GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+	gtk_notebook_append_page(GTK_NOTEBOOK(viewer_stack), scrolled, NULL);
+#else
+	g_signal_connect(webview, "decide-policy",
+					 G_CALLBACK(on_viewer_decide_policy), NULL);
+	g_signal_connect(webview, "load-changed",
+					 G_CALLBACK(on_viewer_load_changed), NULL);
+	g_signal_connect(webview, "load-failed",
+					 G_CALLBACK(on_viewer_load_failed), NULL);
+	gtk_notebook_append_page(GTK_NOTEBOOK(viewer_stack), webview, NULL);
+#endif
+
+	return webview;
+}
+
+/**
+ * Loads a page into the hidden web view, to be swapped in once it's ready.
+ *
+ * @param html Contents of the page. (Must be NUL-terminated for WebKit1)
+ */
+void load_viewer_html(GBytes *html) {
+	// Drop whatever the hidden view was still working on.
+	if (viewer_swap_pending)
+		webkit_web_view_stop_loading(WEBKIT_WEB_VIEW(viewer_back));
+	viewer_swap_pending = true;
+
+	// Hand the render over without making yet another copy of it.
+	TRACE_BEGIN("webkit_web_view_load_bytes");
+#if GTK_MAJOR_VERSION == 2
+	webkit_web_view_load_string(WEBKIT_WEB_VIEW(viewer_back),
+								g_bytes_get_data(html, NULL), NULL, NULL,
+								current_uri);
+#else
+	webkit_web_view_load_bytes(WEBKIT_WEB_VIEW(viewer_back), html,
+							   "text/html", "UTF-8", current_uri);
+#endif
+	TRACE_END("webkit_web_view_load_bytes");
+}
+
+/**
+ * Brings the hidden web view to the front after it has finished loading.
+ */
+void swap_viewer() {
+	GtkWidget *page;
+	GtkWidget *front;
+
+	// Swap the roles of the web views.
+	front = viewer_back;
+	viewer_back = viewer;
+	viewer = front;
+	viewer_swap_pending = false;
+#if GTK_MAJOR_VERSION == 2
+	viewer_scroll = gtk_widget_get_parent(viewer);
+	page = viewer_scroll;
+#else
+	page = viewer;
+	viewer_scroll_y = 0;
+#endif
+
+	// Put the page where it was before showing it.
+	if (pending_scroll > 0) {
+		scroll_viewer_to(pending_scroll);
+		pending_scroll = -1;
+	}
+
+	gtk_notebook_set_current_page(GTK_NOTEBOOK(viewer_stack),
+		gtk_notebook_page_num(GTK_NOTEBOOK(viewer_stack), page));
+}
+
+#if GTK_MAJOR_VERSION == 2
+/**
+ * Callback for the page viewer navigation policy decision signal.
+ *
+ * @param  view     Page viewer.
+ * @param  frame    Frame that is navigating.
+ * @param  request  Request that is about to be made.
+ * @param  action   Action that caused the navigation.
+ * @param  decision Policy decision to be made.
+ * @param  data     Data passed by the signal connector.
+ * @return          TRUE if we handled the navigation.
+ */
+gboolean on_viewer_navigation_requested(WebKitWebView *view,
+										WebKitWebFrame *frame,
+										WebKitNetworkRequest *request,
+										WebKitWebNavigationAction *action,
+										WebKitWebPolicyDecision *decision,
+										gpointer data) {
+	page_t page;
+
+	// Only handle the clicks on links to other pages.
+	if (webkit_web_navigation_action_get_reason(action) !=
+			WEBKIT_WEB_NAVIGATION_REASON_LINK_CLICKED) {
+		return false;
+	}
+	if (!resolve_viewer_link(webkit_network_request_get_uri(request), &page))
+		return false;
+
+	// Load the page ourselves.
+	webkit_web_policy_decision_ignore(decision);
+	follow_viewer_link(page);
+
+	return true;
+}
+#else
+/**
+ * Callback for the page viewer decide policy signal.
+ *
+ * @param  view     Page viewer.
+ * @param  decision Policy decision to be made.
+ * @param  type     Type of the policy decision.
+ * @param  data     Data passed by the signal connector.
+ * @return          TRUE if we handled the navigation.
+ */
+gboolean on_viewer_decide_policy(WebKitWebView *view,
+								 WebKitPolicyDecision *decision,
+								 WebKitPolicyDecisionType type,
+								 gpointer data) {
+	WebKitNavigationAction *action;
+	WebKitURIRequest *request;
+	page_t page;
+
+	// Only handle the clicks on links to other pages.
+	if (type != WEBKIT_POLICY_DECISION_TYPE_NAVIGATION_ACTION)
+		return false;
+	action = webkit_navigation_policy_decision_get_navigation_action(
+		WEBKIT_NAVIGATION_POLICY_DECISION(decision));
+	if (webkit_navigation_action_get_navigation_type(action) !=
+			WEBKIT_NAVIGATION_TYPE_LINK_CLICKED) {
+		return false;
+	}
+	request = webkit_navigation_action_get_request(action);
+	if (!resolve_viewer_link(webkit_uri_request_get_uri(request), &page))
+		return false;
+
+	// Load the page ourselves.
+	webkit_policy_decision_ignore(decision);
+	follow_viewer_link(page);
+
+	return true;
+}
+#endif
+
+/**
+ * Resolves a link clicked in the page viewer to a page in the workspace.
+ *
+ * @param  uri  URI of the link.
+ * @param  page Pointer to store the linked page reference.
+ * @return      TRUE if the link points to another page of the workspace.
+ */
+bool resolve_viewer_link(const char *uri, page_t *page) {
+	char *base;
+	char *fpath;
+	char *canon;
+	bool found;
+
+	// Only local files can be pages.
+	if ((uri == NULL) || !g_str_has_prefix(uri, "file://"))
+		return false;
+
+	// Drop any query or fragment and get the file path.
+	base = g_strndup(uri, strcspn(uri, "?#"));
+	fpath = g_filename_from_uri(base, NULL, NULL);
+	g_free(base);
+	if (fpath == NULL)
+		return false;
+
+	// Look it up.
+	canon = g_canonicalize_filename(fpath, NULL);
+	found = page_index_lookup_path(canon, page);
+	g_free(canon);
+	g_free(fpath);
+
+	// Let WebKit handle the anchors inside the current page.
+	if (found && page_equal(*page, current_page) && (strchr(uri, '#') != NULL))
+		return false;
+
+	return found;
+}
+
+/**
+ * Opens a page that was linked from the page viewer.
+ *
+ * @param page Page to be opened.
+ */
+void follow_viewer_link(page_t page) {
+	// Go through the workspace tree view to keep everything in sync.
+	if (select_workspace_page(page))
+		return;
+
+	// The page isn't in the tree view, so just load it.
+	if (!check_page_unsaved_changes())
+		load_page(page);
+}
+
+/**
+ * Scrolls the page viewer to a vertical offset.
+ *
+ * @param offset Vertical scroll offset in pixels.
+ */
+void scroll_viewer_to(gdouble offset) {
+	char script[64];
+
+	snprintf(script, sizeof(script), "window.scrollTo(0, %d);", (int)offset);
+#if GTK_MAJOR_VERSION == 2
+	webkit_web_view_execute_script(WEBKIT_WEB_VIEW(viewer), script);
+#else
+	webkit_web_view_run_javascript(WEBKIT_WEB_VIEW(viewer), script, NULL, NULL,
+								   NULL);
+#endif
+}
+
+#if GTK_MAJOR_VERSION == 2
+/**
+ * Callback for the page viewer load status change notification.
+ *
+ * @param object Page viewer.
+ * @param pspec  Property that changed.
+ * @param data   Data passed by the signal connector.
+ */
+void on_viewer_load_status(GObject *object, GParamSpec *pspec, gpointer data) {
+	// Show the new page once it's ready.
+	if ((webkit_web_view_get_load_status(WEBKIT_WEB_VIEW(object)) ==
+			WEBKIT_LOAD_FINISHED) && ((GtkWidget*)object == viewer_back) &&
+			viewer_swap_pending) {
+		swap_viewer();
+	}
+}
+#else
+/**
+ * Callback for the page viewer load changed signal.
+ *
+ * @param view  Page viewer.
+ * @param event Load event.
+ * @param data  Data passed by the signal connector.
+ */
+void on_viewer_load_changed(WebKitWebView *view, WebKitLoadEvent event,
+							gpointer data) {
+	// Only the hidden web view gets new pages.
+	if ((event != WEBKIT_LOAD_FINISHED) || ((GtkWidget*)view != viewer_back))
+		return;
+
+	// A load that was superseded also finishes, just ignore it.
+	if (viewer_back_failed) {
+		viewer_back_failed = false;
+		return;
+	}
+
+	// Show the new page now that it's ready.
+	if (viewer_swap_pending)
+		swap_viewer();
+}
+
+/**
+ * Callback for the page viewer load failed signal.
+ *
+ * @param  view  Page viewer.
+ * @param  event Load event where it failed.
+ * @param  uri   URI that failed to load.
+ * @param  error Reason of the failure.
+ * @param  data  Data passed by the signal connector.
+ * @return       FALSE to let WebKit handle the failure.
+ */
+gboolean on_viewer_load_failed(WebKitWebView *view, WebKitLoadEvent event,
+							   gchar *uri, GError *error, gpointer data) {
+	// Remember that the next finished load event belongs to this failure.
+	if ((GtkWidget*)view == viewer_back)
+		viewer_back_failed = true;
+
+	return false;
+}
+
+/**
+ * Callback for when the scroll offset of a page we left is known.
+ *
+ * @param object Page viewer.
+ * @param result Result of the script.
+ * @param data   Identifier of the history entry of the page.
+ */
+void on_viewer_scroll_captured(GObject *object, GAsyncResult *result,
+							   gpointer data) {
+	WebKitJavascriptResult *js_result;
+	history_entry_t *entry;
+	JSCValue *value;
+
+	// Get the result of the script.
+	js_result = webkit_web_view_run_javascript_finish(WEBKIT_WEB_VIEW(object),
+													  result, NULL);
+	if (js_result == NULL)
+		return;
+
+	// Store it if the entry is still around.
+	value = webkit_javascript_result_get_js_value(js_result);
+	entry = history_find(GPOINTER_TO_UINT(data));
+	if ((entry != NULL) && jsc_value_is_number(value))
+		entry->scroll = jsc_value_to_double(value);
+
+	webkit_javascript_result_unref(js_result);
+}
+
+/**
+ * Callback for when the page viewer reports that it has been scrolled.
+ *
+ * @param manager   User content manager of the web view.
+ * @param js_result Scroll offset of the web view.
+ * @param data      Web view that was scrolled.
+ */
+void on_viewer_scroll_reported(WebKitUserContentManager *manager,
+							   WebKitJavascriptResult *js_result,
+							   gpointer data) {
+	JSCValue *value;
+
+	// Only the page being shown matters.
+	if ((GtkWidget*)data != viewer)
+		return;
+
+	value = webkit_javascript_result_get_js_value(js_result);
+	if (jsc_value_is_number(value))
+		viewer_scroll_y = jsc_value_to_double(value);
+}
+#endif
+
+/**
+ * Sets the unsaved changes flag.
+ *
+ * @param state Which state should the unsaved changes flag be in.
+ */
+void set_page_unsaved_changes(bool state) {
+	unsaved_changes = state;
+}
+
+/**
+ * Updates the unsaved changes flag after the page editor contents changed,
+ * only considering the page changed if it actually differs from what's on
+ * disk.
+ *
+ * Different lengths are a sure sign of changes. Otherwise the contents are
+ * hashed once the user stops typing for a moment, so undoing a change by hand
+ * makes the page clean again.
+ */
+void update_page_unsaved_changes() {
+	GtkTextBuffer *buffer;
+
+	// Assume the worst until we know better.
+	unsaved_changes = true;
+	if (dirty_check > 0) {
+		g_source_remove(dirty_check);
+		dirty_check = 0;
+	}
+
+	// Compare the length to the saved contents.
+	buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(editor));
+	if ((saved_chars < 0) ||
+			(gtk_text_buffer_get_char_count(buffer) != saved_chars)) {
+		return;
+	}
+
+	// Only then go through the hassle of hashing them.
+	dirty_check = g_timeout_add(DIRTY_CHECK_DELAY, on_dirty_check, NULL);
+}
+
+/**
+ * Remembers the contents of the page that are on disk.
+ *
+ * @param contents Contents of the page, which must be in the page editor.
+ * @param length   Length of the contents in bytes.
+ */
+void remember_saved_contents(const char *contents, gsize length) {
+	GtkTextBuffer *buffer;
+
+	// Any pending check is about the old contents.
+	if (dirty_check > 0) {
+		g_source_remove(dirty_check);
+		dirty_check = 0;
+	}
+
+	buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(editor));
+	saved_hash = page_content_hash(contents, length);
+	saved_chars = gtk_text_buffer_get_char_count(buffer);
+}
+
+/**
+ * Makes sure the unsaved changes flag is up to date right now.
+ */
+void settle_unsaved_changes() {
+	if (dirty_check > 0) {
+		g_source_remove(dirty_check);
+		on_dirty_check(NULL);
+	}
+}
+
+/**
+ * Runs the checks that are waiting for the page to settle down right away.
+ *
+ * @return TRUE if there was any check waiting.
+ */
+bool settle_page_timers() {
+	bool pending = (dirty_check > 0) || (disk_check > 0);
+
+	settle_unsaved_changes();
+	if (disk_check > 0) {
+		g_source_remove(disk_check);
+		on_disk_check(NULL);
+	}
+
+	return pending;
+}
+
+/**
+ * Pauses or resumes the periodic syncing of the journal to disk. The journal
+ * is synced right away when resumed.
+ *
+ * @param paused Should the journal stop being synced?
+ */
+void set_journal_sync_paused(bool paused) {
+	if (paused) {
+		if (journal_timer > 0)
+			g_source_remove(journal_timer);
+		journal_timer = 0;
+
+		return;
+	}
+
+	on_journal_timer(NULL);
+	if (journal_timer == 0) {
+		journal_timer = g_timeout_add_seconds(JOURNAL_SYNC_INTERVAL,
+											  on_journal_timer, NULL);
+	}
+}
+
+/**
+ * Checks if the page editor contents actually differ from what's on disk.
+ *
+ * @param  data Unused.
+ * @return      FALSE to remove the timeout.
+ */
+gboolean on_dirty_check(gpointer data) {
+	GtkTextBuffer *buffer;
+	GtkTextIter start;
+	GtkTextIter end;
+	char *contents;
+
+	dirty_check = 0;
+
+	// Hash the contents of the editor.
+	buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(editor));
+	gtk_text_buffer_get_start_iter(buffer, &start);
+	gtk_text_buffer_get_end_iter(buffer, &end);
+	contents = gtk_text_buffer_get_text(buffer, &start, &end, false);
+	set_page_unsaved_changes(page_content_hash(contents, strlen(contents)) !=
+							 saved_hash);
+	g_free(contents);
+
+	return false;
+}
+
+/**
+ * Checks if a page has unsaved changes and shows a warning dialog.
+ *
+ * @return TRUE if the current operation should be aborted.
+ */
+bool check_page_unsaved_changes() {
+	// Check if we have unsaved changes and display the dialog if so.
+	settle_unsaved_changes();
+	if (unsaved_changes) {
+		if (unsaved_changes_dialog())
+			return true;
+
+		// The changes are being thrown away, so is their journal.
+		stop_journal(true);
+		return false;
+	}
+
+	set_page_unsaved_changes(false);
+	return false;
+}
+
+/**
+ * Loads an article to the page editor and viewer by its index.
+ *
+ * @param  index Article index.
+ * @return       TRUE if the operation was successful.
+ */
+bool load_article(const gint index) {
+	// Check if the article exists.
+	if (!page_is_valid(page_article((size_t)index))) {
+		error_dialog("Unable to Find Article", "Article with index %d not "
+					 "found.", index);
+		return false;
+	}
+
+	return load_page(page_article((size_t)index));
+}
+
+/**
+ * Loads a template to the page editor and viewer by its index.
+ *
+ * @param  index Article index.
+ * @return       TRUE if the operation was successful.
+ */
+bool load_template(const gint index) {
+	// Check if the template exists.
+	if (!page_is_valid(page_template((size_t)index))) {
+		error_dialog("Unable to Find Template", "Template with index %d not "
+					 "found.", index);
+		return false;
+	}
+
+	return load_page(page_template((size_t)index));
+}
+
+/**
+ * Loads a page to the page editor and viewer.
+ *
+ * Pages are read and rendered in the background, superseding any load that
+ * is still in progress, while pages coming from the history are restored
+ * right away.
+ *
+ * @param  page Page reference.
+ * @return      TRUE if the operation was successful.
+ */
+bool load_page(page_t page) {
+	history_entry_t *entry;
+	gint64 start;
+
+	// Hand it over to the scheduler unless we are going through the history.
+	entry = history_restore;
+	history_restore = NULL;
+	if (entry == NULL) {
+		// The editor still has the old page until the new one arrives.
+		gtk_text_view_set_editable(GTK_TEXT_VIEW(editor), false);
+		page_scheduler_request(page);
+
+		return true;
+	}
+
+	// Restore the page from the history.
+	start = g_get_monotonic_time();
+	page_scheduler_cancel();
+	gtk_text_view_set_editable(GTK_TEXT_VIEW(editor), true);
+	current_page = page;
+	update_backlinks(page);
+	restore_page(entry);
+	history_entry_free(entry);
+
+	// Account for it.
+	stats_count(STAT_PAGE_LOADS);
+	stats_record(STAT_LOAD_TIME, g_get_monotonic_time() - start);
+
+	return true;
+}
+
+/**
+ * Callback for when the page scheduler has read and rendered a page.
+ *
+ * @param page  Page that was requested.
+ * @param load  Contents of the page or NULL if it couldn't be read.
+ * @param error Reason why the page couldn't be read.
+ * @param data  Data passed to the scheduler. (Unused)
+ */
+void on_page_loaded(page_t page, page_load_t *load, GError *error,
+					gpointer data) {
+	gtk_text_view_set_editable(GTK_TEXT_VIEW(editor), true);
+
+	// Check if the page was actually read.
+	if (load == NULL) {
+		error_dialog("Page Reading Error", "Failed to read '%s': %s",
+					 page_name(page), error->message);
+		g_error_free(error);
+
+		return;
+	}
+
+	// Remember where we were and show the new page.
+	enter_page(page);
+	current_encoding = load->encoding;
+	show_page(g_bytes_new_take(load->source, load->length),
+			  g_bytes_new_take(load->html, strlen(load->html)));
+	load->source = NULL;
+	load->html = NULL;
+
+	// Account for it. (From the moment it was requested)
+	stats_count(STAT_PAGE_LOADS);
+	stats_record(STAT_LOAD_TIME, g_get_monotonic_time() - load->requested);
+	page_load_free(load);
+
+	// Set the state of the widgets affected by the changes.
+	update_workspace_state_menu();
+}
+
+/**
+ * Makes a page the current one, recording the one we are leaving in the
+ * history.
+ *
+ * @param page Page that is about to be shown.
+ */
+void enter_page(page_t page) {
+	if (!page_equal(page, current_page))
+		history_visit(snapshot_page());
+
+	current_page = page;
+	update_backlinks(page);
+}
+
+/**
+ * Takes a snapshot of the current page state to be stored in the history.
+ *
+ * @return History entry or NULL if there's no page opened.
+ */
+history_entry_t* snapshot_page() {
+	history_entry_t *entry;
+	GtkTextBuffer *buffer;
+	GtkTextIter cursor;
+	GBytes *source = NULL;
+	GBytes *html = NULL;
+	gdouble scroll = 0;
+
+	// Check if we have anything opened.
+	if (!page_is_valid(current_page))
+		return NULL;
+
+	// Get the editor state, only caching the contents if they are saved.
+	// (They are shared with the history, not copied)
+	buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(editor));
+	gtk_text_buffer_get_iter_at_mark(buffer, &cursor,
+									 gtk_text_buffer_get_insert(buffer));
+	if (!unsaved_changes && (current_source != NULL) &&
+			(current_html != NULL)) {
+		source = g_bytes_ref(current_source);
+		html = g_bytes_ref(current_html);
+	}
+
+	// Get the viewer scroll offset.
+#if GTK_MAJOR_VERSION == 2
+	scroll = gtk_adjustment_get_value(gtk_scrolled_window_get_vadjustment(
+		GTK_SCROLLED_WINDOW(viewer_scroll)));
+#endif
+	entry = history_entry_new(current_page, source, html,
+							  gtk_text_iter_get_offset(&cursor), scroll);
+
+#if GTK_MAJOR_VERSION != 2
+	// WebKit2 can only tell us asynchronously. This is queued before the next
+	// page is loaded, so it still runs against the page we are leaving.
+	webkit_web_view_run_javascript(WEBKIT_WEB_VIEW(viewer), "window.scrollY",
+								   NULL, on_viewer_scroll_captured,
+								   GUINT_TO_POINTER(entry->id));
+#endif
+
+	return entry;
+}
+
+/**
+ * Restores the current page from a history entry.
+ *
+ * @param entry History entry of the current page.
+ */
+void restore_page(history_entry_t *entry) {
+	GtkTextBuffer *buffer;
+	GtkTextIter cursor;
+
+	buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(editor));
+	stats_count((entry->source != NULL) ? STAT_HISTORY_HITS :
+				STAT_HISTORY_MISSES);
+	if (entry->source != NULL) {
+		// Restore the cached contents and render without touching the disk.
+		show_page(entry->source, entry->html);
+		entry->source = NULL;
+		entry->html = NULL;
+
+		// The file may have changed since it was cached.
+		disk_mtime = -1;
+		schedule_disk_check();
+	} else if (!load_file()) {
+		// The contents weren't cached, so we had to go to the disk.
+		return;
+	}
+
+	// Put the cursor and the viewer back where they were.
+	gtk_text_buffer_get_iter_at_offset(buffer, &cursor, entry->cursor);
+	gtk_text_buffer_place_cursor(buffer, &cursor);
+	gtk_text_view_scroll_to_mark(GTK_TEXT_VIEW(editor),
+								 gtk_text_buffer_get_insert(buffer), 0.1,
+								 false, 0, 0);
+	pending_scroll = entry->scroll;
+}
+
+/**
+ * Goes back to the previous page in the history.
+ *
+ * @return TRUE if we went somewhere.
+ */
+bool go_back_page() {
+	return navigate_history(false);
+}
+
+/**
+ * Goes forward to the next page in the history.
+ *
+ * @return TRUE if we went somewhere.
+ */
+bool go_forward_page() {
+	return navigate_history(true);
+}
+
+/**
+ * Checks if there's a page to go back to.
+ *
+ * @return TRUE if we can go back.
+ */
+bool can_go_back_page() {
+	return history_can_go_back();
+}
+
+/**
+ * Checks if there's a page to go forward to.
+ *
+ * @return TRUE if we can go forward.
+ */
+bool can_go_forward_page() {
+	return history_can_go_forward();
+}
+
+/**
+ * Navigates through the history.
+ *
+ * @param  forward Go forward instead of back.
+ * @return         TRUE if we went somewhere.
+ */
+bool navigate_history(bool forward) {
+	history_entry_t *entry;
+
+	// Check if we have unsaved changes.
+	if (check_page_unsaved_changes())
+		return false;
+
+	// Get where we are going.
+	entry = (forward) ? history_forward(snapshot_page()) :
+		history_back(snapshot_page());
+	if (entry == NULL)
+		return false;
+
+	// The user already chose what to do with the changes, don't ask again.
+	set_page_unsaved_changes(false);
+	select_history_entry(entry);
+
+	return true;
+}
+
+/**
+ * Opens a page through the workspace tree view restoring it from a history
+ * entry.
+ *
+ * @param entry History entry of the page. (Ownership is taken)
+ */
+void select_history_entry(history_entry_t *entry) {
+	page_t page = entry->page;
+
+	// Go through the workspace tree view to keep everything in sync.
+	history_restore = entry;
+	select_workspace_page(page);
+
+	// The selection didn't load it for us, so we have to do it ourselves.
+	if (history_restore != NULL)
+		load_page(page);
+}
+
+/**
+ * Saves the current opened page to its file.
+ *
+ * @return TRUE if the operation was successful.
+ */
+bool save_current_page() {
+	GtkTextBuffer *buffer;
+	GtkTextIter start;
+	GtkTextIter end;
+	uki_error uki_err;
+	char *contents;
+	char *source;
+	char *encoded;
+	gsize length;
+	gsize encoded_length;
+	char fpath[UKI_MAX_PATH];
+	GError *g_err = NULL;
+	gint64 start_time;
+	gint offset;
+
+	// Check if we haven't opened anything yet.
+	if (current_page.index < 0) {
+		error_dialog("Page Saving Failed",
+					 "No article or template opened to be saved.");
+		return false;
+	}
+	TRACE_BEGIN("save_current_page");
+	start_time = g_get_monotonic_time();
+
+	// Get page editor buffer and its contents.
+	buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(editor));
+	gtk_text_buffer_get_start_iter(buffer, &start);
+	gtk_text_buffer_get_end_iter(buffer, &end);
+	contents = gtk_text_buffer_get_text(buffer, &start, &end, false);
+
+	// Get the file path of the page.
+	if ((uki_err = page_fpath(fpath, current_page)) != UKI_OK) {
+		error_dialog((current_page.type == PAGE_TYPE_ARTICLE) ?
+					 "Error While Getting Article Path" :
+					 "Error While Getting Template Path",
+					 uki_error_msg(uki_err));
+		g_free(contents);
+		TRACE_END("save_current_page");
+
+		return false;
+	}
+
+	// Don't overwrite changes made by someone else in the meantime.
+	if (check_external_changes()) {
+		g_free(contents);
+		TRACE_END("save_current_page");
+
+		return false;
+	}
+
+	// Don't touch the disk if nothing actually changed.
+	if ((saved_chars >= 0) && !save_reformatted &&
+			(page_content_hash(contents, strlen(contents)) == saved_hash)) {
+		if (journal != NULL)
+			journal_compact(journal, contents, strlen(contents), NULL);
+		g_free(contents);
+		set_page_unsaved_changes(false);
+		stats_count(STAT_SAVES_SKIPPED);
+		TRACE_END("save_current_page");
+
+		return true;
+	}
+
+	// Put the original formatting back unless told otherwise.
+	source = get_editor_source(contents, &length);
+	if (source == NULL) {
+		g_free(contents);
+		TRACE_END("save_current_page");
+
+		return false;
+	}
+
+	// Keep what we had loaded in the history in case it was never recorded.
+	if ((saved_chars >= 0) && (current_source != NULL) &&
+			!revisions_exist(fpath) &&
+			!revisions_record(fpath, g_bytes_get_data(current_source, NULL),
+							  g_bytes_get_size(current_source), &g_err)) {
+		g_warning("%s", g_err->message);
+		g_clear_error(&g_err);
+	}
+
+	// Write it back in the encoding it came in, if it still fits.
+	encoded = encoding_encode(source, length, current_encoding,
+							  &encoded_length, &g_err);
+	if (encoded == NULL) {
+		warning_dialog("Page Encoding Changed", "The page can't be saved as "
+					   "%s anymore, so it will be saved as UTF-8. (%s)",
+					   encoding_name(current_encoding), g_err->message);
+		g_clear_error(&g_err);
+		current_encoding = ENCODING_UTF8;
+		encoded = encoding_encode(source, length, current_encoding,
+								  &encoded_length, NULL);
+	}
+
+	// Set file contents.
+	if (!g_file_set_contents(fpath, encoded, encoded_length, &g_err)) {
+		error_dialog("Page Saving Error", "Failed to save to the file '%s'. "
+					 "(%s)", fpath, g_err->message);
+		if (source != contents)
+			g_free(source);
+		g_free(contents);
+		g_free(encoded);
+		g_error_free(g_err);
+		TRACE_END("save_current_page");
+
+		return false;
+	}
+
+	// Our own write isn't an external change.
+	g_free(encoded);
+	remember_disk_state();
+
+	// Update the links it makes to other articles.
+	link_graph_update(current_page, source);
+
+	// Record the revision in the page's history.
+	if (!revisions_record(fpath, source, length, &g_err)) {
+		g_warning("%s", g_err->message);
+		g_clear_error(&g_err);
+	}
+
+	// Reformat what was saved, which usually is what's already in the editor.
+	if (reflow != NULL) {
+		reflow_free(reflow);
+		reflow = reflow_new(source, length);
+		save_reformatted = false;
+		if (reflow->breaks->len == 0) {
+			// Nothing is too long anymore.
+			reflow_free(reflow);
+			reflow = NULL;
+		} else if (strcmp(reflow->text, contents) != 0) {
+			buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(editor));
+			gtk_text_buffer_get_iter_at_mark(buffer, &start,
+				gtk_text_buffer_get_insert(buffer));
+			offset = gtk_text_iter_get_offset(&start);
+			gtk_text_buffer_set_text(buffer, reflow->text, reflow->length);
+			gtk_text_buffer_get_iter_at_offset(buffer, &start, offset);
+			gtk_text_buffer_place_cursor(buffer, &start);
+
+			if (contents != source)
+				g_free(contents);
+			contents = g_strndup(reflow->text, reflow->length);
+		}
+	}
+
+	// The journal only needs what happens after this.
+	if ((journal != NULL) &&
+			!journal_compact(journal, contents, strlen(contents), &g_err)) {
+		g_warning("%s", g_err->message);
+		g_clear_error(&g_err);
+	}
+
+	// What's on disk is now the source of the page.
+	remember_saved_contents(contents, strlen(contents));
+	if (source != contents)
+		g_free(contents);
+	replace_bytes(&current_source, g_bytes_new_take(source, length));
+	set_page_unsaved_changes(false);
+	update_workspace_state_menu();
+	stats_count(STAT_PAGE_SAVES);
+	stats_record(STAT_SAVE_TIME, g_get_monotonic_time() - start_time);
+	TRACE_END("save_current_page");
+
+	return true;
+}
+
+/**
+ * Reloads the contents of the page viewer based on the contents of the editor.
+ */
+void refresh_page_viewer() {
+	GtkTextBuffer *buffer;
+	GtkTextIter start;
+	GtkTextIter end;
+	char *contents;
+	guint64 hash;
+
+	// Check if we haven't opened anything yet.
+	if (current_page.index < 0)
+		return;
+
+	// Get page editor buffer and its contents.
+	buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(editor));
+	gtk_text_buffer_get_start_iter(buffer, &start);
+	gtk_text_buffer_get_end_iter(buffer, &end);
+	contents = gtk_text_buffer_get_text(buffer, &start, &end, false);
+
+	// The viewer may already be showing these exact contents.
+	hash = page_content_hash(contents, strlen(contents));
+	if ((current_html != NULL) && (hash == render_hash)) {
+		stats_count(STAT_RENDERS_SKIPPED);
+		g_free(contents);
+
+		return;
+	}
+	render_hash = hash;
+
+	// Render what would be saved, since reformatting may add whitespace.
+	if (reflow != NULL) {
+		char *source;
+		gsize length;
+
+		source = get_editor_source(contents, &length);
+		if (source != NULL) {
+			g_free(contents);
+			contents = source;
+		}
+	}
+
+	// Render the page and load it into the web view, keeping the render
+	// around for the history.
+	page_render(current_page, &contents);
+	replace_bytes(&current_html, g_bytes_new_take(contents, strlen(contents)));
+	load_viewer_html(current_html);
+}
+
+/**
+ * Renders the page viewer again even if it's already showing the contents of
+ * the editor.
+ */
+void force_refresh_page_viewer() {
+	render_hash = 0;
+	refresh_page_viewer();
+}
+
+/**
+ * Replaces the contents of the page editor, leaving them as unsaved changes.
+ *
+ * @param contents New contents of the page.
+ */
+void replace_page_contents(const char *contents) {
+	GtkTextBuffer *buffer;
+	reflow_t *reformatted = NULL;
+
+	// Check if we haven't opened anything yet.
+	if (current_page.index < 0)
+		return;
+
+	// Discarded changes may have taken the journal with them.
+	if (journal == NULL)
+		start_journal();
+
+	// Keep the page reformatted if it was.
+	if (reflow != NULL) {
+		reformatted = reflow_new(contents, strlen(contents));
+		contents = reformatted->text;
+	}
+
+	// Replace the text and show the result.
+	buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(editor));
+	gtk_text_buffer_set_text(buffer, contents, -1);
+	reflow_free(reformatted);
+	refresh_page_viewer();
+}
+
+/**
+ * Loads the contents of a file to the page editor and viewer.
+ *
+ * @return TRUE if the operation was successful.
+ */
+bool load_file() {
+	char *contents;
+	char *html;
+	size_t length;
+	char fpath[UKI_MAX_PATH];
+	GError *g_err = NULL;
+
+	// Get the file path.
+	if (page_fpath(fpath, current_page) != UKI_OK) {
+		error_dialog("Path Error", "Unable to find path for %s '%s'.",
+					 (current_page.type == PAGE_TYPE_ARTICLE) ? "article" :
+					 "template", page_name(current_page));
+		return false;
+	}
+	TRACE_BEGIN("load_file");
+
+	// Read contents.
+	if (!page_read_encoded(current_page, &contents, &length,
+						   &current_encoding, &g_err)) {
+		error_dialog("Article Reading Error", "Failed to read the file '%s'.",
+					 fpath);
+		g_error_free(g_err);
+		TRACE_END("load_file");
+
+		return false;
+	}
+
+	// Render it and show it. (Uki renders in-place, so it needs its own copy)
+	html = g_strndup(contents, length);
+	page_render(current_page, &html);
+	show_page(g_bytes_new_take(contents, length),
+			  g_bytes_new_take(html, strlen(html)));
+	TRACE_END("load_file");
+
+	return true;
+}
+
+/**
+ * Shows the contents of the current page in the page editor and viewer.
+ *
+ * @param source Source of the page to be placed in the editor. (The reference
+ *               is taken)
+ * @param html   Rendered page. (The reference is taken)
+ */
+void show_page(GBytes *source, GBytes *html) {
+	GtkTextBuffer *buffer;
+	char fpath[UKI_MAX_PATH];
+	gsize length;
+	const char *text;
+
+	// Get page editor buffer and set its contents.
+	stop_journal(!unsaved_changes);
+	buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(editor));
+	text = g_bytes_get_data(source, &length);
+	text = setup_page_reflow(text, length);
+	if (reflow != NULL)
+		length = reflow->length;
+	TRACE_BEGIN("gtk_text_buffer_set_text");
+	gtk_text_buffer_set_text(buffer, text, length);
+	TRACE_END("gtk_text_buffer_set_text");
+
+	// Load the render into the web view.
+	if (page_fpath(fpath, current_page) == UKI_OK)
+		snprintf(current_uri, MAX_URI, "file://%s", fpath);
+	pending_scroll = -1;
+	load_viewer_html(html);
+
+	// Keep the contents around for the history and set the state.
+	remember_saved_contents(text, length);
+	render_hash = saved_hash;
+	replace_bytes(&current_source, source);
+	replace_bytes(&current_html, html);
+	set_page_unsaved_changes(false);
+
+	// Get back what was lost in a crash and start journaling.
+	offer_journal_recovery();
+
+	// Keep an eye on the file in case someone else changes it.
+	watch_page_file();
+}
+
+/**
+ * Replaces a reference to some contents.
+ *
+ * @param slot  Reference to be replaced. (Its old contents are released)
+ * @param bytes New contents or NULL. (The reference is taken)
+ */
+void replace_bytes(GBytes **slot, GBytes *bytes) {
+	if (*slot != NULL)
+		g_bytes_unref(*slot);
+
+	*slot = bytes;
+}
+
+/**
+ * Reformats the page about to be shown if its lines are too long to be edited,
+ * after asking the user once per page.
+ *
+ * @param  text   Source of the page.
+ * @param  length Length of the source.
+ * @return        What should be placed in the editor.
+ */
+const char* setup_page_reflow(const char *text, gsize length) {
+	GtkWrapMode wrap = GTK_WRAP_WORD;
+	char fpath[UKI_MAX_PATH];
+	gint choice;
+
+	reflow_free(reflow);
+	reflow = NULL;
+	save_reformatted = false;
+
+	// Check if the page is going to bring the editor to a crawl.
+	if ((reflow_longest_line(text, length) > REFLOW_LINE_LIMIT) &&
+			(page_fpath(fpath, current_page) == UKI_OK)) {
+		choice = GPOINTER_TO_INT(g_hash_table_lookup(reflow_choices, fpath));
+		if (choice == 0) {
+			choice = (long_lines_dialog(page_name(current_page))) ?
+				REFLOW_ACCEPTED : REFLOW_DECLINED;
+			g_hash_table_insert(reflow_choices, g_strdup(fpath),
+								GINT_TO_POINTER(choice));
+		}
+
+		// Wrapping a huge line is the slowest part, so at least avoid it.
+		if (choice == REFLOW_ACCEPTED) {
+			reflow = reflow_new(text, length);
+			text = reflow->text;
+		} else {
+			wrap = GTK_WRAP_NONE;
+		}
+	}
+
+	gtk_text_view_set_wrap_mode(GTK_TEXT_VIEW(editor), wrap);
+	return text;
+}
+
+/**
+ * Gets what was placed in the editor when the page was loaded or saved.
+ *
+ * @param  length Pointer to store the length of the contents.
+ * @return        Contents the editor started from.
+ */
+const char* get_editor_base(gsize *length) {
+	if (reflow != NULL) {
+		*length = reflow->length;
+		return reflow->text;
+	}
+
+	return g_bytes_get_data(current_source, length);
+}
+
+/**
+ * Gets the page source to be saved from the contents of the editor, putting
+ * back the original formatting of a reformatted page.
+ *
+ * @param  contents Contents of the editor.
+ * @param  length   Pointer to store the length of the source.
+ * @return          Source of the page, which is the contents themselves if
+ *                  they didn't need restoring, or NULL if an error occurred.
+ */
+char* get_editor_source(const char *contents, gsize *length) {
+	GError *error = NULL;
+	char *source;
+
+	*length = strlen(contents);
+	if ((reflow == NULL) || save_reformatted)
+		return (char*)contents;
+
+	source = reflow_restore(reflow, contents, *length, length, &error);
+	if (source == NULL) {
+		error_dialog("Reformatting Error", "Failed to restore the original "
+					 "formatting of the page: %s", error->message);
+		g_error_free(error);
+	}
+
+	return source;
+}
+
+/**
+ * Starts journaling the edits made to the current page.
+ */
+void start_journal() {
+	GError *error = NULL;
+	char fpath[UKI_MAX_PATH];
+	const char *base;
+	gsize length;
+
+	if (!page_is_valid(current_page) || (current_source == NULL) ||
+			(page_fpath(fpath, current_page) != UKI_OK)) {
+		return;
+	}
+
+	base = get_editor_base(&length);
+	journal = journal_open(journal_dir, fpath, base, length, &error);
+	if (journal == NULL) {
+		g_warning("%s", error->message);
+		g_error_free(error);
+	}
+}
+
+/**
+ * Stops journaling the edits made to the current page.
+ *
+ * @param discard Delete the journal? Otherwise it's kept for recovery.
+ */
+void stop_journal(bool discard) {
+	journal_close(journal, discard);
+	journal = NULL;
+}
+
+/**
+ * Offers to recover the changes left in the journal of the current page and
+ * starts a new journal for it.
+ */
+void offer_journal_recovery() {
+	GtkTextBuffer *buffer;
+	char fpath[UKI_MAX_PATH];
+	char *recovered;
+	const char *base;
+	gsize length;
+	gsize rlength;
+
+	// Check if the page has a journal that applies to what's on disk.
+	if ((current_source == NULL) ||
+			(page_fpath(fpath, current_page) != UKI_OK)) {
+		return;
+	}
+	base = get_editor_base(&length);
+	recovered = journal_recover(journal_dir, fpath, base, length, &rlength);
+
+	// Start from a clean journal. (Recovered changes are journaled again)
+	start_journal();
+	if (recovered == NULL)
+		return;
+
+	// Ask the user what to do with it.
+	if (recover_changes_dialog(page_name(current_page))) {
+		buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(editor));
+		gtk_text_buffer_set_text(buffer, recovered, rlength);
+		set_page_unsaved_changes(true);
+		update_workspace_state_menu();
+	}
+
+	g_free(recovered);
+}
+
+/**
+ * Callback for text about to be inserted in the page editor.
+ *
+ * @param buffer   Page editor text buffer.
+ * @param location Where the text is going to be inserted.
+ * @param text     Text to be inserted.
+ * @param length   Length of the text in bytes.
+ * @param data     Data passed by the signal connector.
+ */
+void on_editor_insert_text(GtkTextBuffer *buffer, GtkTextIter *location,
+						   gchar *text, gint length, gpointer data) {
+	if (journal == NULL)
+		return;
+
+	if (length < 0)
+		length = strlen(text);
+	journal_insert(journal, gtk_text_iter_get_offset(location), text,
+				   (gsize)length);
+}
+
+/**
+ * Callback for text about to be deleted from the page editor.
+ *
+ * @param buffer Page editor text buffer.
+ * @param start  Start of the text to be deleted.
+ * @param end    End of the text to be deleted.
+ * @param data   Data passed by the signal connector.
+ */
+void on_editor_delete_range(GtkTextBuffer *buffer, GtkTextIter *start,
+							GtkTextIter *end, gpointer data) {
+	gint from;
+	gint to;
+
+	if (journal == NULL)
+		return;
+
+	from = gtk_text_iter_get_offset(start);
+	to = gtk_text_iter_get_offset(end);
+	journal_delete(journal, MIN(from, to), ABS(to - from));
+}
 
 /**
- * Initializes the page manager.
+ * Periodically makes sure the journal is on disk.
  *
- * @param edit Page editor widget. (Created by this function)
- * @param view Page viewer widget. (Created by this function)
+ * @param  data Unused.
+ * @return      TRUE to keep the timer going.
  */
-void initialize_page_manager(GtkWidget **edit, GtkWidget **view) {
-	// Create our main widgets.
-	editor = initialize_page_editor();
-	viewer = initialize_page_viewer();
+gboolean on_journal_timer(gpointer data) {
+	GError *error = NULL;
 
-	// Pass them back to our called function.
-	*edit = editor;
-	*view = viewer;
+	if ((journal != NULL) && !journal_sync(journal, &error)) {
+		g_warning("%s", error->message);
+		g_error_free(error);
+	}
 
-	// Initialize our state variables.
-	current_article_i = -1;
-	current_template_i = -1;
-	unsaved_changes = false;
+	return true;
 }
 
 /**
- * Initializes the page editor (GtkTextView) control.
- *
- * @return The GtkTextView control.
+ * Starts watching the file of the current page for changes made by other
+ * programs.
  */
-GtkWidget* initialize_page_editor() {
-	GtkWidget *editor;
+void watch_page_file() {
+	GError *error = NULL;
+	char fpath[UKI_MAX_PATH];
+	GFile *file;
 
-	// Create and setup editor.
-	editor = gtk_text_view_new();
-	gtk_text_view_set_wrap_mode(GTK_TEXT_VIEW(editor), GTK_WRAP_WORD);
-#if GTK_MAJOR_VERSION == 2
-	gtk_widget_modify_font(editor,
-			pango_font_description_from_string("Monospace 10"));
-#else
-	gtk_text_view_set_monospace(GTK_TEXT_VIEW(editor), true);
-#endif
+	// Forget about the previous file.
+	unwatch_page_file();
+	if (page_fpath(fpath, current_page) != UKI_OK)
+		return;
 
-	return editor;
+	// Remember what we've loaded and ask to be told when it changes.
+	remember_disk_state();
+	file = g_file_new_for_path(fpath);
+	disk_monitor = g_file_monitor_file(file, G_FILE_MONITOR_NONE, NULL,
+									   &error);
+	g_object_unref(file);
+	if (disk_monitor == NULL) {
+		g_warning("%s", error->message);
+		g_error_free(error);
+
+		return;
+	}
+
+	g_signal_connect(disk_monitor, "changed", G_CALLBACK(on_disk_changed),
+					 NULL);
 }
 
 /**
- * Initializes the page viewer (WebKitGTK) widget.
- *
- * @return The WebKitGTK widget.
+ * Stops watching the file of the current page and abandons any merge that
+ * was still in progress.
  */
-GtkWidget* initialize_page_viewer() {
-	GtkWidget *webview;
+void unwatch_page_file() {
+	if (disk_monitor != NULL) {
+		g_file_monitor_cancel(disk_monitor);
+		g_object_unref(disk_monitor);
+		disk_monitor = NULL;
+	}
 
-	// Initialize web viewer.
-	webview = webkit_web_view_new();
+	if (disk_check > 0) {
+		g_source_remove(disk_check);
+		disk_check = 0;
+	}
 
-	return webview;
+	if (merge_cancellable != NULL) {
+		g_cancellable_cancel(merge_cancellable);
+		g_clear_object(&merge_cancellable);
+		gtk_text_view_set_editable(GTK_TEXT_VIEW(editor), true);
+	}
+
+	disk_mtime = -1;
+	disk_size = -1;
 }
 
 /**
- * Sets the unsaved changes flag.
+ * Gets the modification time and size of a file.
  *
- * @param state Which state should the unsaved changes flag be in.
+ * @param  fpath Path to the file.
+ * @param  mtime Pointer to store the modification time in microseconds.
+ * @param  size  Pointer to store the size of the file in bytes.
+ * @return       TRUE if the file could be queried.
  */
-void set_page_unsaved_changes(bool state) {
-	unsaved_changes = state;
+bool query_disk_state(const char *fpath, gint64 *mtime, goffset *size) {
+	GFileInfo *info;
+	GFile *file;
+
+	file = g_file_new_for_path(fpath);
+	info = g_file_query_info(file, G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+							 G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC ","
+							 G_FILE_ATTRIBUTE_STANDARD_SIZE,
+							 G_FILE_QUERY_INFO_NONE, NULL, NULL);
+	g_object_unref(file);
+	if (info == NULL)
+		return false;
+
+	*mtime = (gint64)g_file_info_get_attribute_uint64(info,
+		G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+		g_file_info_get_attribute_uint32(info,
+			G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+	*size = g_file_info_get_size(info);
+	g_object_unref(info);
+
+	return true;
 }
 
 /**
- * Checks if a page has unsaved changes and shows a warning dialog.
- *
- * @return TRUE if the current operation should be aborted.
+ * Remembers the modification time and size of the file of the current page as
+ * being the ones of what we have loaded.
  */
-bool check_page_unsaved_changes() {
-	// Check if we have unsaved changes and display the dialog if so.
-	if (unsaved_changes) {
-		return unsaved_changes_dialog();
+void remember_disk_state() {
+	char fpath[UKI_MAX_PATH];
+
+	if ((page_fpath(fpath, current_page) != UKI_OK) ||
+			!query_disk_state(fpath, &disk_mtime, &disk_size)) {
+		disk_mtime = -1;
+		disk_size = -1;
 	}
+}
 
-	set_page_unsaved_changes(false);
-	return false;
+/**
+ * Checks for external changes once the file settles down.
+ */
+void schedule_disk_check() {
+	if (disk_check > 0)
+		g_source_remove(disk_check);
+
+	disk_check = g_timeout_add(DISK_CHECK_DELAY, on_disk_check, NULL);
 }
 
 /**
- * Loads an article to the page editor and viewer by its index.
+ * Callback for when the file of the current page changes on disk.
  *
- * @param  index Article index.
- * @return       TRUE if the operation was successful.
+ * @param monitor File monitor.
+ * @param file    File that changed.
+ * @param other   File it was moved to or from. (Unused)
+ * @param event   What happened to the file.
+ * @param data    Data passed by the signal connector.
  */
-bool load_article(const gint index) {
-	uki_article_t article;
-
-	// Get the article.
-	article = uki_article((size_t)index);
-	if (article.name == NULL) {
-		error_dialog("Unable to Find Article", "Article with index %d not "
-					 "found.", index);
-		return false;
+void on_disk_changed(GFileMonitor *monitor, GFile *file, GFile *other,
+					 GFileMonitorEvent event, gpointer data) {
+	switch (event) {
+		case G_FILE_MONITOR_EVENT_CHANGED:
+		case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+		case G_FILE_MONITOR_EVENT_CREATED:
+			schedule_disk_check();
+			break;
+		default:
+			break;
 	}
+}
 
-	// Set the state.
-	current_article_i = (ssize_t)index;
-	current_template_i = -1;
+/**
+ * Checks if the file of the current page was changed by someone else.
+ *
+ * @param  data Unused.
+ * @return      FALSE to remove the timeout.
+ */
+gboolean on_disk_check(gpointer data) {
+	disk_check = 0;
+	check_external_changes();
 
-	// Load file contents.
-	return load_file();
+	return false;
 }
 
 /**
- * Loads a template to the page editor and viewer by its index.
+ * Checks if the file of the current page was changed by another program and
+ * brings those changes into the editor.
  *
- * @param  index Article index.
- * @return       TRUE if the operation was successful.
+ * The modification time and size are enough to know nothing happened, which is
+ * the usual case. Otherwise the file is read and hashed, since it may have
+ * been touched without actually changing.
+ *
+ * @return TRUE if the editor contents are being replaced, so they shouldn't be
+ *         saved right now.
  */
-bool load_template(const gint index) {
-	uki_template_t template;
+bool check_external_changes() {
+	GtkTextBuffer *buffer;
+	GtkTextIter cursor;
+	GError *error = NULL;
+	char fpath[UKI_MAX_PATH];
+	char *contents;
+	char *html;
+	size_t length;
+	gint64 mtime;
+	goffset size;
+	gint offset;
+
+	// Nothing to check or a merge is still going.
+	if (!page_is_valid(current_page) || (current_source == NULL) ||
+			(page_fpath(fpath, current_page) != UKI_OK)) {
+		return false;
+	} else if (merge_cancellable != NULL) {
+		return true;
+	}
 
-	// Get the template.
-	template = uki_template((size_t)index);
-	if (template.name == NULL) {
-		error_dialog("Unable to Find Template", "Template with index %d not "
-					 "found.", index);
+	// Cheap check first. (A file that's gone will just be saved again)
+	if (!query_disk_state(fpath, &mtime, &size) ||
+			((mtime == disk_mtime) && (size == disk_size))) {
 		return false;
 	}
 
-	// Set the state.
-	current_article_i = -1;
-	current_template_i = (ssize_t)index;
+	// Make sure the contents actually changed. (Whatever it's now encoded in
+	// is what we'll write back)
+	if (!page_read_encoded(current_page, &contents, &length,
+						   &current_encoding, &error)) {
+		g_warning("%s", error->message);
+		g_error_free(error);
+
+		return false;
+	}
+	disk_mtime = mtime;
+	disk_size = size;
+	if (page_content_hash(contents, length) == page_content_hash(
+			g_bytes_get_data(current_source, NULL),
+			g_bytes_get_size(current_source))) {
+		g_free(contents);
+		return false;
+	}
+	stats_count(STAT_EXTERNAL_CHANGES);
+
+	// Nothing to lose, so just reload the page where we were.
+	settle_unsaved_changes();
+	if (!unsaved_changes) {
+		buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(editor));
+		gtk_text_buffer_get_iter_at_mark(buffer, &cursor,
+										 gtk_text_buffer_get_insert(buffer));
+		offset = gtk_text_iter_get_offset(&cursor);
+
+		html = g_strndup(contents, length);
+		page_render(current_page, &html);
+		show_page(g_bytes_new_take(contents, length),
+				  g_bytes_new_take(html, strlen(html)));
+
+		gtk_text_buffer_get_iter_at_offset(buffer, &cursor, offset);
+		gtk_text_buffer_place_cursor(buffer, &cursor);
+		update_workspace_state_menu();
+
+		return true;
+	}
 
-	// Load file contents.
-	return load_file();
+	// Let the user decide what happens to their changes.
+	if (external_changes_dialog(page_name(current_page))) {
+		merge_external_changes(g_bytes_new_take(contents, length));
+		return true;
+	}
+
+	adopt_disk_contents(g_bytes_new_take(contents, length));
+	return false;
 }
 
 /**
- * Saves the current opened page to its file.
+ * Makes the contents on disk the base of the page, leaving whatever is in the
+ * editor as unsaved changes on top of it.
  *
- * @return TRUE if the operation was successful.
+ * @param source Contents of the page on disk. (The reference is taken)
  */
-bool save_current_page() {
+void adopt_disk_contents(GBytes *source) {
 	GtkTextBuffer *buffer;
 	GtkTextIter start;
 	GtkTextIter end;
-	uki_error uki_err;
+	const char *text;
 	char *contents;
-	char fpath[UKI_MAX_PATH];
-	GError *g_err = NULL;
+	gsize length;
 
-	// Check if we haven't opened anything yet.
-	if ((current_article_i < 0) && (current_template_i < 0)) {
-		error_dialog("Page Saving Failed",
-					 "No article or template opened to be saved.");
-		return false;
+	// Any pending check is about the old contents.
+	if (dirty_check > 0) {
+		g_source_remove(dirty_check);
+		dirty_check = 0;
 	}
 
-	// Get page editor buffer and its contents.
-	buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(editor));
-	gtk_text_buffer_get_start_iter(buffer, &start);
-	gtk_text_buffer_get_end_iter(buffer, &end);
-	contents = gtk_text_buffer_get_text(buffer, &start, &end, false);
-
-	// Check if we have an article or tmeplate opened and get the file path.
-	if (is_article_opened()) {
-		// Get the article
-		uki_article_t article = uki_article(current_article_i);
-
-		// Get its path.
-		if ((uki_err = uki_article_fpath(fpath, article)) != UKI_OK) {
-			error_dialog("Error While Getting Article Path",
-						 uki_error_msg(uki_err));
-			return false;
-		}
-	} else {
-		// Get the template.
-		uki_template_t template = uki_template(current_template_i);
-
-		// Get its path.
-		if ((uki_err = uki_template_fpath(fpath, template)) != UKI_OK) {
-			error_dialog("Error While Getting Template Path",
-						 uki_error_msg(uki_err));
-			return false;
-		}
+	// What's on disk is now the source of the page.
+	replace_bytes(&current_source, source);
+	if (reflow != NULL) {
+		text = g_bytes_get_data(source, &length);
+		reflow_free(reflow);
+		reflow = reflow_new(text, length);
 	}
-
-	// Set file contents.
-	if (!g_file_set_contents(fpath, contents, -1, NULL)) {
-		// TODO: Use GError to get an error message.
-		error_dialog("Page Saving Error", "Failed to save to the file '%s'.",
-					 fpath);
-		g_error_free(g_err);
-
-		return false;
+	text = get_editor_base(&length);
+	saved_hash = page_content_hash(text, length);
+	saved_chars = g_utf8_strlen(text, length);
+
+	// The journal has to start over from the new source.
+	stop_journal(true);
+	start_journal();
+	if (journal != NULL) {
+		buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(editor));
+		gtk_text_buffer_get_start_iter(buffer, &start);
+		gtk_text_buffer_get_end_iter(buffer, &end);
+		contents = gtk_text_buffer_get_text(buffer, &start, &end, false);
+		journal_delete(journal, 0, saved_chars);
+		journal_insert(journal, 0, contents, strlen(contents));
+		g_free(contents);
 	}
 
-	// Clean up and set state.
-	g_free(contents);
-	set_page_unsaved_changes(false);
-
-	return true;
+	update_page_unsaved_changes();
 }
 
 /**
- * Reloads the contents of the page viewer based on the contents of the editor.
+ * Merges the changes made in the editor with the ones made on disk in a worker
+ * thread, using what was loaded as their common ancestor.
+ *
+ * @param theirs Contents of the page on disk. (The reference is taken)
  */
-void refresh_page_viewer() {
+void merge_external_changes(GBytes *theirs) {
 	GtkTextBuffer *buffer;
 	GtkTextIter start;
 	GtkTextIter end;
+	GBytes *ours;
 	char *contents;
+	char *source;
+	gsize length;
 
-	// Check if we haven't opened anything yet.
-	if ((current_article_i < 0) && (current_template_i < 0))
-		return;
-
-	// Get page editor buffer and its contents.
+	// Get what's in the editor.
 	buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(editor));
 	gtk_text_buffer_get_start_iter(buffer, &start);
 	gtk_text_buffer_get_end_iter(buffer, &end);
 	contents = gtk_text_buffer_get_text(buffer, &start, &end, false);
+	source = get_editor_source(contents, &length);
+	if (source == NULL) {
+		g_free(contents);
+		g_bytes_unref(theirs);
 
-	// Load the contents into the web view.
-	if (is_article_opened()) {
-		// Get the article
-		uki_article_t article = uki_article(current_article_i);
-
-		// Render the article.
-		uki_render_article_from_text(&contents, article.deepness);
-#if GTK_MAJOR_VERSION == 2
-		webkit_web_view_load_string(WEBKIT_WEB_VIEW(viewer), contents, NULL,
-									NULL, current_uri);
-#else
-		webkit_web_view_load_html(WEBKIT_WEB_VIEW(viewer), contents,
-				current_uri);
-#endif
-	} else {
-		// Get the template.
-		uki_template_t template = uki_template(current_template_i);
-
-		// Render the template.
-		uki_render_template_from_text(&contents, template.deepness);
-#if GTK_MAJOR_VERSION == 2
-		webkit_web_view_load_string(WEBKIT_WEB_VIEW(viewer), contents, NULL,
-									NULL, current_uri);
-#else
-		webkit_web_view_load_html(WEBKIT_WEB_VIEW(viewer), contents,
-				current_uri);
-#endif
+		return;
 	}
-
-	// Free resources.
-	g_free(contents);
+	if (source != contents)
+		g_free(contents);
+	ours = g_bytes_new_take(source, length);
+
+	// Don't let the editor change under the merge.
+	gtk_text_view_set_editable(GTK_TEXT_VIEW(editor), false);
+	merge_cancellable = g_cancellable_new();
+	merge_texts_async(current_source, ours, theirs, merge_cancellable,
+					  on_external_merged, theirs);
+	g_bytes_unref(ours);
 }
 
 /**
- * Loads the contents of a file to the page editor and viewer.
+ * Callback for when the external changes were merged with the editor ones.
  *
- * @return TRUE if the operation was successful.
+ * @param source Unused.
+ * @param result Result of the merge.
+ * @param data   Contents of the page on disk. (The reference is taken)
  */
-bool load_file() {
+void on_external_merged(GObject *source, GAsyncResult *result,
+						gpointer data) {
 	GtkTextBuffer *buffer;
-	char *contents;
-	uki_error uki_err;
-	char fpath[UKI_MAX_PATH];
-	uki_article_t article;
-	uki_template_t template;
-	GError *g_err = NULL;
-
-	if (is_article_opened()) {
-		// Get the article
-		article = uki_article(current_article_i);
+	GtkTextIter cursor;
+	GBytes *theirs = (GBytes*)data;
+	GError *error = NULL;
+	merge_t *merge;
+	gint offset;
+
+	// Check if the page is still around to receive it.
+	merge = merge_texts_finish(result, &error);
+	if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		g_error_free(error);
+		g_bytes_unref(theirs);
 
-		// Get the file path.
-		if ((uki_err = uki_article_fpath(fpath, article)) != UKI_OK) {
-			error_dialog("Path Error", "Unable to find path for article '%s'.",
-						 article.name);
-			return false;
-		}
-	} else {
-		// Get the template.
-		template = uki_template(current_template_i);
-
-		// Get the file path.
-		if ((uki_err = uki_template_fpath(fpath, template)) != UKI_OK) {
-			error_dialog("Path Error", "Unable to find path for template '%s'.",
-						 template.name);
-			return false;
-		}
+		return;
 	}
+	g_clear_object(&merge_cancellable);
+	gtk_text_view_set_editable(GTK_TEXT_VIEW(editor), true);
 
-	// Read contents.
-	if (!g_file_get_contents(fpath, &contents, NULL, &g_err)) {
-		// TODO: Use GError to get an error message.
-		error_dialog("Article Reading Error", "Failed to read the file '%s'.",
-					 fpath);
-		g_error_free(g_err);
+	// Keep the editor contents as they were if we couldn't merge.
+	adopt_disk_contents(theirs);
+	if (merge == NULL) {
+		error_dialog("Merge Error", "Failed to merge the changes: %s",
+					 error->message);
+		g_error_free(error);
 
-		return false;
+		return;
 	}
 
-	// Get page editor buffer and set its contents.
+	// Show the merged contents where we were.
 	buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(editor));
-	gtk_text_buffer_set_text(buffer, contents, -1);
-
-	// Load the file into the web view.
-	snprintf(current_uri, MAX_URI, "file://%s", fpath);
-	refresh_page_viewer();
-
-	// Free resources and set state.
-	g_free(contents);
-	set_page_unsaved_changes(false);
+	gtk_text_buffer_get_iter_at_mark(buffer, &cursor,
+									 gtk_text_buffer_get_insert(buffer));
+	offset = gtk_text_iter_get_offset(&cursor);
+	replace_page_contents(merge->text);
+	gtk_text_buffer_get_iter_at_offset(buffer, &cursor, offset);
+	gtk_text_buffer_place_cursor(buffer, &cursor);
+	update_workspace_state_menu();
+
+	// Point out what couldn't be merged on its own.
+	if (merge->conflicts > 0) {
+		warning_dialog("Merge Conflicts", "%u %s couldn't be merged and %s "
+					   "marked between '" MERGE_MARKER_OURS "' and '"
+					   MERGE_MARKER_THEIRS "'.", merge->conflicts,
+					   (merge->conflicts == 1) ? "change" : "changes",
+					   (merge->conflicts == 1) ? "was" : "were");
+	}
 
-	return true;
+	merge_free(merge);
 }
 
 /**
@@ -345,23 +2021,149 @@ bool load_file() {
  */
 void clear_page_contents() {
 	GtkTextBuffer *buffer;
+	GBytes *blank;
 	char *contents = "\n";
 
-	// Get page editor buffer and set its contents.
+	// Forget about any page that was on its way.
+	page_scheduler_cancel();
+	unwatch_page_file();
+	gtk_text_view_set_editable(GTK_TEXT_VIEW(editor), true);
+
+	// Get page editor buffer and set its contents, keeping the journal of
+	// changes that were never saved nor discarded.
+	stop_journal(!unsaved_changes);
 	buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(editor));
 	gtk_text_buffer_set_text(buffer, contents, -1);
 
 	// Load the blank page..
-#if GTK_MAJOR_VERSION == 2
-		webkit_web_view_load_string(WEBKIT_WEB_VIEW(viewer), contents, NULL,
-									NULL, current_uri);
-#else
-		webkit_web_view_load_html(WEBKIT_WEB_VIEW(viewer), contents,
-				current_uri);
-#endif
+	blank = g_bytes_new_static(contents, 1);
+	load_viewer_html(blank);
+	g_bytes_unref(blank);
 
 	// Set the state.
+	clear_backlinks();
+	reflow_free(reflow);
+	reflow = NULL;
+	save_reformatted = false;
+	current_encoding = ENCODING_UTF8;
+	gtk_text_view_set_wrap_mode(GTK_TEXT_VIEW(editor), GTK_WRAP_WORD);
+	saved_chars = -1;
+	set_page_unsaved_changes(false);
+}
+
+/**
+ * Shows contents that may not belong to the current workspace yet, such as
+ * the page of a previous session, without making them editable.
+ *
+ * @param source Source of the page. (The reference is taken)
+ * @param html   Rendered page. (The reference is taken)
+ * @param scroll Vertical scroll offset of the viewer in pixels.
+ */
+void show_page_preview(GBytes *source, GBytes *html, gdouble scroll) {
+	GtkTextBuffer *buffer;
+	gsize length;
+	const char *text;
+
+	// Place the source in the editor, but don't let anyone touch it.
+	buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(editor));
+	text = g_bytes_get_data(source, &length);
+	gtk_text_buffer_set_text(buffer, text, length);
+	gtk_text_view_set_editable(GTK_TEXT_VIEW(editor), false);
+
+	// Nobody changed anything, it's just what we had on disk.
+	remember_saved_contents(text, length);
 	set_page_unsaved_changes(false);
+
+	// Load the render into the web view.
+	load_viewer_html(html);
+	pending_scroll = scroll;
+
+	g_bytes_unref(source);
+	g_bytes_unref(html);
+}
+
+/**
+ * Opens a page restoring a previously saved state.
+ *
+ * @param page   Page to be opened.
+ * @param source Source of the page or NULL to read it from disk. (The
+ *               reference is taken)
+ * @param html   Rendered page or NULL to render it again. (The reference is
+ *               taken)
+ * @param cursor Offset of the cursor in the editor.
+ * @param scroll Vertical scroll offset of the viewer in pixels.
+ */
+void restore_page_state(page_t page, GBytes *source, GBytes *html,
+						gint cursor, gdouble scroll) {
+	// Both or nothing.
+	if ((source == NULL) || (html == NULL)) {
+		if (source != NULL)
+			g_bytes_unref(source);
+		if (html != NULL)
+			g_bytes_unref(html);
+
+		source = NULL;
+		html = NULL;
+	}
+
+	select_history_entry(history_entry_new(page, source, html, cursor,
+										   scroll));
+}
+
+/**
+ * Gets the state of the current page so that it can be restored later.
+ *
+ * @param  page   Pointer to store the current page.
+ * @param  source Pointer to store a reference to the saved source of the page
+ *                or NULL if it has unsaved changes.
+ * @param  html   Pointer to store a reference to the rendered page or NULL if
+ *                it has unsaved changes.
+ * @param  cursor Pointer to store the offset of the cursor in the editor.
+ * @param  scroll Pointer to store the scroll offset of the viewer.
+ * @return        TRUE if there's a page opened.
+ */
+bool get_page_state(page_t *page, GBytes **source, GBytes **html,
+					gint *cursor, gdouble *scroll) {
+	GtkTextBuffer *buffer;
+	GtkTextIter iter;
+
+	// Check if we have anything opened.
+	*page = current_page;
+	*source = NULL;
+	*html = NULL;
+	if (!page_is_valid(current_page))
+		return false;
+
+	// Get the editor state.
+	buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(editor));
+	gtk_text_buffer_get_iter_at_mark(buffer, &iter,
+									 gtk_text_buffer_get_insert(buffer));
+	*cursor = gtk_text_iter_get_offset(&iter);
+	*scroll = query_viewer_scroll();
+
+	// Only hand out contents that match what's on disk.
+	if (!unsaved_changes && (current_source != NULL) &&
+			(current_html != NULL)) {
+		*source = g_bytes_ref(current_source);
+		*html = g_bytes_ref(current_html);
+	}
+
+	return true;
+}
+
+/**
+ * Gets the vertical scroll offset of the page viewer right away.
+ *
+ * @return Scroll offset in pixels.
+ */
+gdouble query_viewer_scroll() {
+#if GTK_MAJOR_VERSION == 2
+	return gtk_adjustment_get_value(gtk_scrolled_window_get_vadjustment(
+		GTK_SCROLLED_WINDOW(viewer_scroll)));
+#else
+	// Kept up to date by the viewer itself.
+	return viewer_scroll_y;
+#endif
 }
 
 /**
@@ -387,9 +2189,9 @@ size_t new_article(const char *fpath) {
 	article = uki_add_article(fpath);
 	index = uki_articles_available() - 1;
 
-	// Set the state.
-	current_article_i = (ssize_t)index;
-	current_template_i = -1;
+	// Set the state. (Nothing is on disk yet)
+	current_page = page_article(index);
+	saved_chars = -1;
 	set_page_unsaved_changes(false);
 
 	return index;
@@ -409,9 +2211,9 @@ size_t new_template(const char *fpath) {
 	template = uki_add_template(fpath);
 	index = uki_templates_available() - 1;
 
-	// Set the state.
-	current_article_i = -1;
-	current_template_i = (ssize_t)index;
+	// Set the state. (Nothing is on disk yet)
+	current_page = page_template(index);
+	saved_chars = -1;
 	set_page_unsaved_changes(false);
 
 	return index;
@@ -423,5 +2225,64 @@ size_t new_template(const char *fpath) {
  * @return TRUE if an article is opened.
  */
 bool is_article_opened() {
-	return current_article_i >= 0;
+	return (current_page.type == PAGE_TYPE_ARTICLE) &&
+		(current_page.index >= 0);
+}
+
+/**
+ * Gets the page that's currently opened.
+ *
+ * @return Current page or an invalid page if nothing is opened.
+ */
+page_t get_current_page() {
+	return current_page;
+}
+
+/**
+ * Checks if the current page is being edited reformatted.
+ *
+ * @return TRUE if the page had its long lines broken up.
+ */
+bool is_page_reflowed() {
+	return reflow != NULL;
+}
+
+/**
+ * Checks if the current page is going to be saved as it's shown instead of
+ * with its original formatting.
+ *
+ * @return TRUE if the reformatting is going to be saved.
+ */
+bool is_page_save_reformatted() {
+	return save_reformatted;
+}
+
+/**
+ * Sets if the current page should be saved as it's shown instead of with its
+ * original formatting.
+ *
+ * @param state Save the reformatting?
+ */
+void set_page_save_reformatted(bool state) {
+	save_reformatted = state && (reflow != NULL);
+}
+
+/**
+ * Statistics gauge of the amount of content in the page editor.
+ *
+ * @return Number of characters in the editor buffer.
+ */
+gint64 stats_editor_content() {
+	return gtk_text_buffer_get_char_count(gtk_text_view_get_buffer(
+		GTK_TEXT_VIEW(editor)));
+}
+
+/**
+ * Statistics gauge of the amount of content shown in the page viewer.
+ *
+ * @return Size of the HTML of the last rendered page in bytes.
+ */
+gint64 stats_viewer_content() {
+	return (current_html != NULL) ? (gint64)g_bytes_get_size(current_html) :
+		0;
 }
@@ -10,6 +10,7 @@
 
 #include <gtk/gtk.h>
 #include <stdbool.h>
+#include "Page.h"
 
 // Initialization.
 void initialize_page_manager(GtkWidget **edit, GtkWidget **view);
@@ -17,14 +18,34 @@ void initialize_page_manager(GtkWidget **edit, GtkWidget **view);
 // Misc.
 GtkTextBuffer* get_page_editor_buffer();
 bool is_article_opened();
+page_t get_current_page();
+bool is_page_reflowed();
+bool is_page_save_reformatted();
+void set_page_save_reformatted(bool state);
 void set_page_unsaved_changes(bool state);
+void update_page_unsaved_changes();
 bool check_page_unsaved_changes();
+bool settle_page_timers();
+void set_journal_sync_paused(bool paused);
 
 // Loading content.
 void clear_page_contents();
 bool load_article(const gint index);
 bool load_template(const gint index);
 void refresh_page_viewer();
+void force_refresh_page_viewer();
+void replace_page_contents(const char *contents);
+void show_page_preview(GBytes *source, GBytes *html, gdouble scroll);
+void restore_page_state(page_t page, GBytes *source, GBytes *html,
+						gint cursor, gdouble scroll);
+bool get_page_state(page_t *page, GBytes **source, GBytes **html,
+					gint *cursor, gdouble *scroll);
+
+// History.
+bool go_back_page();
+bool go_forward_page();
+bool can_go_back_page();
+bool can_go_forward_page();
 
 // Saving and creation.
 bool save_current_page();
@@ -0,0 +1,266 @@
+/**
+ * PerformanceWindow.c
+ * Window that shows the live statistics of the application.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include "PerformanceWindow.h"
+#include "AppProperties.h"
+#include "DialogHelper.h"
+#include "Stats.h"
+
+// Constants.
+#define STATS_REFRESH_INTERVAL 1000
+#define RESPONSE_SAVE_JSON     1
+
+// Statistics list columns.
+enum {
+	STATS_COL_NAME = 0,
+	STATS_COL_VALUE,
+	STATS_NUM_COLS
+};
+
+// State of a refresh of the statistics list.
+typedef struct {
+	GtkTreeIter iter;
+	gboolean valid;
+} stats_refresh_t;
+
+// Private variables.
+GtkWidget *performance_parent;
+GtkWidget *performance_window = NULL;
+GtkListStore *performance_store;
+guint performance_timer;
+
+// Private methods.
+gboolean performance_refresh(gpointer data);
+void performance_refresh_row(const char *name, const char *value,
+							 gpointer data);
+void performance_save_json();
+void on_performance_response(GtkDialog *dialog, gint response_id,
+							 gpointer data);
+void on_performance_destroy(GtkWidget *widget, gpointer data);
+
+/**
+ * Initializes the performance window module.
+ *
+ * @param main_window Main application window.
+ */
+void initialize_performance_window(GtkWidget *main_window) {
+	performance_parent = main_window;
+}
+
+/**
+ * Shows the performance window, which keeps itself up to date while open.
+ */
+void show_performance_window() {
+	GtkWidget *vbox;
+	GtkWidget *scrolled;
+	GtkWidget *tview;
+	GtkTreeViewColumn *column;
+	GtkCellRenderer *renderer;
+
+	// Just bring it up if it's already open.
+	if (performance_window != NULL) {
+		gtk_window_present(GTK_WINDOW(performance_window));
+		return;
+	}
+
+	// Create the window.
+	performance_window = gtk_dialog_new_with_buttons("Performance",
+			GTK_WINDOW(performance_parent), GTK_DIALOG_DESTROY_WITH_PARENT,
+			"Save as JSON...", RESPONSE_SAVE_JSON,
+#if GTK_MAJOR_VERSION == 2
+			GTK_STOCK_CLOSE,
+#else
+			"Close",
+#endif
+			GTK_RESPONSE_CLOSE, NULL);
+	gtk_window_set_default_size(GTK_WINDOW(performance_window), 520, 480);
+	g_signal_connect(performance_window, "response",
+					 G_CALLBACK(on_performance_response), NULL);
+	g_signal_connect(performance_window, "destroy",
+					 G_CALLBACK(on_performance_destroy), NULL);
+#if GTK_MAJOR_VERSION == 2
+	vbox = GTK_DIALOG(performance_window)->vbox;
+#else
+	vbox = gtk_dialog_get_content_area(GTK_DIALOG(performance_window));
+#endif
+
+	// Create the list of statistics.
+	performance_store = gtk_list_store_new(STATS_NUM_COLS, G_TYPE_STRING,
+										   G_TYPE_STRING);
+	tview = gtk_tree_view_new_with_model(GTK_TREE_MODEL(performance_store));
+	g_object_unref(performance_store);
+	renderer = gtk_cell_renderer_text_new();
+	column = gtk_tree_view_column_new_with_attributes("Statistic", renderer,
+			"text", STATS_COL_NAME, NULL);
+	gtk_tree_view_append_column(GTK_TREE_VIEW(tview), column);
+	renderer = gtk_cell_renderer_text_new();
+	column = gtk_tree_view_column_new_with_attributes("Value", renderer,
+			"text", STATS_COL_VALUE, NULL);
+	gtk_tree_view_append_column(GTK_TREE_VIEW(tview), column);
+
+	// Put it inside a scrolled window.
+	scrolled = gtk_scrolled_window_new(NULL, NULL);
+	gtk_container_add(GTK_CONTAINER(scrolled), tview);
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled),
+								   GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+	gtk_scrolled_window_set_shadow_type(GTK_SCROLLED_WINDOW(scrolled),
+										GTK_SHADOW_ETCHED_IN);
+	gtk_box_pack_start(GTK_BOX(vbox), scrolled, true, true, 0);
+
+	// Fill it and keep it up to date.
+	performance_refresh(NULL);
+	performance_timer = g_timeout_add(STATS_REFRESH_INTERVAL,
+									  performance_refresh, NULL);
+	gtk_widget_show_all(performance_window);
+}
+
+/**
+ * Dumps the statistics to a JSON file in the user cache folder.
+ */
+void dump_performance_stats() {
+	GError *error = NULL;
+	GDateTime *now;
+	char *timestamp;
+	char *fname;
+	char *dir;
+	char *fpath;
+
+	// Build a unique file path.
+	now = g_date_time_new_now_local();
+	timestamp = g_date_time_format(now, "%Y%m%d-%H%M%S");
+	fname = g_strdup_printf("stats-%s.json", timestamp);
+	dir = g_build_filename(g_get_user_cache_dir(), APP_NAME, NULL);
+	fpath = g_build_filename(dir, fname, NULL);
+	g_date_time_unref(now);
+	g_free(timestamp);
+	g_free(fname);
+
+	// Write the statistics.
+	if ((g_mkdir_with_parents(dir, 0755) == 0) && stats_dump(fpath, &error)) {
+		message_dialog(GTK_MESSAGE_INFO, "Statistics Saved",
+					   "The statistics were saved to '%s'.", fpath);
+	} else if (error != NULL) {
+		error_dialog("Failed to Save Statistics", "%s", error->message);
+		g_error_free(error);
+	} else {
+		error_dialog("Failed to Save Statistics", "Unable to create the "
+					 "folder '%s'.", dir);
+	}
+
+	g_free(fpath);
+	g_free(dir);
+}
+
+/**
+ * Refreshes the statistics list.
+ *
+ * @param  data Unused.
+ * @return      TRUE to keep the timer going.
+ */
+gboolean performance_refresh(gpointer data) {
+	stats_refresh_t refresh;
+
+	// Update the rows in place so that the selection and scroll stay put.
+	refresh.valid = gtk_tree_model_get_iter_first(
+		GTK_TREE_MODEL(performance_store), &refresh.iter);
+	stats_foreach(performance_refresh_row, &refresh);
+
+	return true;
+}
+
+/**
+ * Updates or appends a row of the statistics list.
+ *
+ * @param name  Name of the statistic.
+ * @param value Formatted value of the statistic.
+ * @param data  State of the refresh.
+ */
+void performance_refresh_row(const char *name, const char *value,
+							 gpointer data) {
+	stats_refresh_t *refresh = (stats_refresh_t*)data;
+
+	if (refresh->valid) {
+		gtk_list_store_set(performance_store, &refresh->iter, STATS_COL_NAME,
+						   name, STATS_COL_VALUE, value, -1);
+		refresh->valid = gtk_tree_model_iter_next(
+			GTK_TREE_MODEL(performance_store), &refresh->iter);
+	} else {
+		GtkTreeIter iter;
+
+		gtk_list_store_append(performance_store, &iter);
+		gtk_list_store_set(performance_store, &iter, STATS_COL_NAME, name,
+						   STATS_COL_VALUE, value, -1);
+	}
+}
+
+/**
+ * Asks for a file and saves the statistics to it as JSON.
+ */
+void performance_save_json() {
+	GtkWidget *dialog;
+	GError *error = NULL;
+	char *fpath;
+
+	// Create the save dialog and set it up.
+	dialog = gtk_file_chooser_dialog_new("Save Statistics",
+										 GTK_WINDOW(performance_window),
+										 GTK_FILE_CHOOSER_ACTION_SAVE,
+#if GTK_MAJOR_VERSION == 2
+										 GTK_STOCK_CANCEL,
+										 GTK_RESPONSE_CANCEL,
+										 GTK_STOCK_SAVE,
+#else
+										 "Cancel", GTK_RESPONSE_CANCEL,
+										 "Save",
+#endif
+										 GTK_RESPONSE_ACCEPT, NULL);
+	gtk_file_chooser_set_do_overwrite_confirmation(GTK_FILE_CHOOSER(dialog),
+												   true);
+	gtk_file_chooser_set_current_name(GTK_FILE_CHOOSER(dialog), "stats.json");
+
+	// Save the statistics.
+	if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
+		fpath = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
+		if (!stats_dump(fpath, &error)) {
+			error_dialog("Failed to Save Statistics", "%s", error->message);
+			g_error_free(error);
+		}
+
+		g_free(fpath);
+	}
+
+	gtk_widget_destroy(dialog);
+}
+
+/**
+ * Callback for the buttons of the performance window.
+ *
+ * @param dialog      Performance window.
+ * @param response_id Button that was clicked.
+ * @param data        Data passed by the signal connector.
+ */
+void on_performance_response(GtkDialog *dialog, gint response_id,
+							 gpointer data) {
+	if (response_id == RESPONSE_SAVE_JSON) {
+		performance_save_json();
+		return;
+	}
+
+	gtk_widget_destroy(GTK_WIDGET(dialog));
+}
+
+/**
+ * Callback for when the performance window is destroyed.
+ *
+ * @param widget Performance window.
+ * @param data   Data passed by the signal connector.
+ */
+void on_performance_destroy(GtkWidget *widget, gpointer data) {
+	g_source_remove(performance_timer);
+	performance_window = NULL;
+	performance_store = NULL;
+}
@@ -0,0 +1,20 @@
+/**
+ * PerformanceWindow.h
+ * Window that shows the live statistics of the application.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _PERFORMANCEWINDOW_H_
+#define _PERFORMANCEWINDOW_H_
+
+#include <gtk/gtk.h>
+
+// Initialization.
+void initialize_performance_window(GtkWidget *main_window);
+
+// Display.
+void show_performance_window();
+void dump_performance_stats();
+
+#endif /* _PERFORMANCEWINDOW_H_ */
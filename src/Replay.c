@@ -0,0 +1,434 @@
+/**
+ * Replay.c
+ * Records the actions taken in the interface and replays them later.
+ *
+ * Replaying drives the same callbacks the interface does and, after each
+ * action, runs the main loop until the events it caused have been handled,
+ * the checks waiting for the page to settle down have been run, and the page
+ * scheduler is idle again. That wall time is the latency of the action as a
+ * user would have felt it. The journal is only synced once the replay is
+ * over, so it doesn't land on random actions.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <gtk/gtk.h>
+#include "Replay.h"
+#include "AppProperties.h"
+#include "DialogHelper.h"
+#include "FindReplace.h"
+#include "MainWindow.h"
+#include "PageManager.h"
+#include "PageScheduler.h"
+#include "Workspace.h"
+
+// Private variables.
+action_log_t *recording = NULL;
+guint recording_user_actions = 0;
+gulong recording_handlers[4];
+GArray *replay_actions = NULL;
+GArray *replay_latencies[NUM_ACTION_TYPES];
+bool replay_realtime = false;
+guint replay_waited = 0;
+guint replay_failures = 0;
+
+// Private methods.
+void on_record_begin_user_action(GtkTextBuffer *buffer, gpointer data);
+void on_record_end_user_action(GtkTextBuffer *buffer, gpointer data);
+void on_record_insert_text(GtkTextBuffer *buffer, GtkTextIter *location,
+						   gchar *text, gint len, gpointer data);
+void on_record_delete_range(GtkTextBuffer *buffer, GtkTextIter *start,
+							GtkTextIter *end, gpointer data);
+gboolean on_replay_start(gpointer data);
+void replay_actions_run();
+bool replay_action(const action_t *action);
+void replay_wait_until(gint64 time);
+void replay_report();
+
+/**
+ * Starts recording the actions taken in the interface.
+ *
+ * @param  fpath Path to the action log to be written.
+ * @return       TRUE if the recording started.
+ */
+bool start_action_recording(const char *fpath) {
+	GtkTextBuffer *buffer;
+	GError *error = NULL;
+
+	// Create the log.
+	recording = action_log_create(fpath, &error);
+	if (recording == NULL) {
+		fprintf(stderr, "%s: %s\n", APP_NAME, error->message);
+		g_error_free(error);
+
+		return false;
+	}
+
+	// Start from the page that's opened.
+	if (page_is_valid(get_current_page()))
+		record_page_selected(get_current_page());
+
+	// Only edits made by the user are recorded, so keep track of those.
+	buffer = get_page_editor_buffer();
+	recording_handlers[0] = g_signal_connect(buffer, "begin-user-action",
+		G_CALLBACK(on_record_begin_user_action), NULL);
+	recording_handlers[1] = g_signal_connect(buffer, "end-user-action",
+		G_CALLBACK(on_record_end_user_action), NULL);
+	recording_handlers[2] = g_signal_connect(buffer, "insert-text",
+		G_CALLBACK(on_record_insert_text), NULL);
+	recording_handlers[3] = g_signal_connect(buffer, "delete-range",
+		G_CALLBACK(on_record_delete_range), NULL);
+
+	return true;
+}
+
+/**
+ * Stops recording the actions taken in the interface.
+ */
+void stop_action_recording() {
+	GtkTextBuffer *buffer;
+
+	if (recording == NULL)
+		return;
+
+	buffer = get_page_editor_buffer();
+	for (guint i = 0; i < G_N_ELEMENTS(recording_handlers); i++)
+		g_signal_handler_disconnect(buffer, recording_handlers[i]);
+	action_log_close(recording);
+	recording = NULL;
+}
+
+/**
+ * Records an action if we're recording.
+ *
+ * @param type   Kind of action.
+ * @param offset Where in the page it happened or what it was applied to.
+ * @param count  How much it affected or a flag for the action.
+ * @param text   Text that goes along with the action. (Optional)
+ */
+void record_action(action_type_t type, gint64 offset, gint64 count,
+				   const char *text) {
+	if (recording == NULL)
+		return;
+
+	action_log_append(recording, type, offset, count, text);
+}
+
+/**
+ * Records that a page was selected in the workspace.
+ *
+ * @param page Page that was selected.
+ */
+void record_page_selected(page_t page) {
+	char *name;
+
+	if (recording == NULL)
+		return;
+
+	name = page_display_name(page);
+	action_log_append(recording, ACTION_SELECT_PAGE, page.type, 0, name);
+	g_free(name);
+}
+
+/**
+ * Starts replaying an action log as soon as the workspace is ready.
+ *
+ * @param  fpath    Path to the action log.
+ * @param  realtime Should the actions be spaced out as they were recorded?
+ * @return          TRUE if the log was loaded and the replay scheduled.
+ */
+bool start_action_replay(const char *fpath, bool realtime) {
+	GError *error = NULL;
+	int type;
+
+	// Load the actions.
+	replay_actions = action_log_load(fpath, &error);
+	if (replay_actions == NULL) {
+		fprintf(stderr, "%s: %s\n", APP_NAME, error->message);
+		g_error_free(error);
+
+		return false;
+	}
+
+	// Setup the latency samples.
+	for (type = 0; type < NUM_ACTION_TYPES; type++)
+		replay_latencies[type] = g_array_new(false, false, sizeof(gint64));
+
+	// Nobody is around to answer any questions.
+	set_dialogs_unattended(true);
+	replay_realtime = realtime;
+	replay_waited = 0;
+	replay_failures = 0;
+	g_timeout_add(REPLAY_START_INTERVAL, on_replay_start, NULL);
+
+	return true;
+}
+
+/**
+ * Gets the exit status of the replay.
+ *
+ * @return EXIT_FAILURE if any of the actions couldn't be replayed.
+ */
+int action_replay_status() {
+	return (replay_failures > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * Waits for the workspace to be opened and then replays the actions.
+ *
+ * @param  data Data passed by the timeout.
+ * @return      FALSE once the replay has been done.
+ */
+gboolean on_replay_start(gpointer data) {
+	// Wait for the workspace and the page it opened with.
+	if (!is_workspace_opened() ||
+			(page_scheduler_state() != SCHEDULER_IDLE)) {
+		replay_waited += REPLAY_START_INTERVAL;
+		if (replay_waited < REPLAY_START_TIMEOUT)
+			return true;
+
+		fprintf(stderr, "%s: No workspace was opened to replay the actions "
+				"in.\n", APP_NAME);
+		replay_failures++;
+	} else {
+		replay_actions_run();
+	}
+
+	// Let go of everything and quit.
+	action_log_free(replay_actions);
+	for (int type = 0; type < NUM_ACTION_TYPES; type++)
+		g_array_free(replay_latencies[type], true);
+	replay_actions = NULL;
+	gtk_main_quit();
+
+	return false;
+}
+
+/**
+ * Replays every action in the log and reports how long they took.
+ */
+void replay_actions_run() {
+	const action_t *action;
+	gint64 epoch;
+	gint64 start;
+	gint64 latency;
+	guint i;
+
+	set_journal_sync_paused(true);
+	epoch = g_get_monotonic_time();
+	for (i = 0; i < replay_actions->len; i++) {
+		action = &g_array_index(replay_actions, action_t, i);
+		if (replay_realtime)
+			replay_wait_until(epoch + action->time);
+
+		// Time the action until everything it caused has been done.
+		start = g_get_monotonic_time();
+		if (!replay_action(action)) {
+			fprintf(stderr, "%s: Failed to replay action %u (%s).\n",
+					APP_NAME, i + 1, action_type_name(action->type));
+			replay_failures++;
+			continue;
+		}
+		replay_settle();
+		latency = g_get_monotonic_time() - start;
+		g_array_append_val(replay_latencies[action->type], latency);
+	}
+
+	// Throw away whatever was left unsaved, along with its journal.
+	set_journal_sync_paused(false);
+	check_page_unsaved_changes();
+	replay_report();
+}
+
+/**
+ * Performs an action through the same callbacks the interface uses.
+ *
+ * @param  action Action to be performed.
+ * @return        TRUE if the action could be performed.
+ */
+bool replay_action(const action_t *action) {
+	GtkTextBuffer *buffer;
+	GtkTextIter start;
+	GtkTextIter end;
+	page_t page;
+	gint chars;
+
+	buffer = get_page_editor_buffer();
+	chars = gtk_text_buffer_get_char_count(buffer);
+
+	switch (action->type) {
+	case ACTION_SELECT_PAGE:
+		if (!page_find(action->text, &page) ||
+				(page.type != (page_type_t)action->offset)) {
+			return false;
+		}
+
+		return select_workspace_page(page);
+	case ACTION_INSERT_TEXT:
+		if ((action->offset < 0) || (action->offset > chars))
+			return false;
+
+		gtk_text_buffer_begin_user_action(buffer);
+		gtk_text_buffer_get_iter_at_offset(buffer, &start, action->offset);
+		gtk_text_buffer_insert(buffer, &start, action->text, -1);
+		gtk_text_buffer_end_user_action(buffer);
+		break;
+	case ACTION_DELETE_TEXT:
+		if ((action->offset < 0) || (action->count < 0) ||
+				(action->offset + action->count > chars)) {
+			return false;
+		}
+
+		gtk_text_buffer_begin_user_action(buffer);
+		gtk_text_buffer_get_iter_at_offset(buffer, &start, action->offset);
+		gtk_text_buffer_get_iter_at_offset(buffer, &end,
+										   action->offset + action->count);
+		gtk_text_buffer_delete(buffer, &start, &end);
+		gtk_text_buffer_end_user_action(buffer);
+		break;
+	case ACTION_SWITCH_TAB:
+		if (action->offset == 0) {
+			on_show_page_viewer(NULL, NULL);
+		} else {
+			on_show_page_editor(NULL, NULL);
+		}
+		break;
+	case ACTION_FIND_NEXT:
+		set_find_needle(action->text, action->count != 0);
+		on_editor_find_next(NULL, NULL);
+		break;
+	case ACTION_SAVE_PAGE:
+		on_page_save(NULL, NULL);
+		break;
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Runs the main loop until there's nothing left for it to do, including the
+ * checks that would only run once the page settled down, and no page is
+ * waiting to be loaded.
+ */
+void replay_settle() {
+	for (;;) {
+		do {
+			while (gtk_events_pending())
+				gtk_main_iteration();
+		} while (settle_page_timers());
+
+		if (page_scheduler_state() == SCHEDULER_IDLE)
+			break;
+		g_usleep(REPLAY_POLL_INTERVAL);
+	}
+}
+
+/**
+ * Keeps the interface going until it's time for the next action.
+ *
+ * @param time Monotonic time to wait for.
+ */
+void replay_wait_until(gint64 time) {
+	gint64 now;
+
+	while ((now = g_get_monotonic_time()) < time) {
+		if (gtk_events_pending()) {
+			gtk_main_iteration();
+		} else {
+			g_usleep(MIN(REPLAY_POLL_INTERVAL, time - now));
+		}
+	}
+}
+
+/**
+ * Prints the latency percentiles of each kind of action.
+ */
+void replay_report() {
+	GArray *samples;
+	int type;
+
+	printf("%-12s %8s %10s %10s %10s %10s\n", "action", "count", "p50 (ms)",
+		   "p90 (ms)", "p99 (ms)", "max (ms)");
+	for (type = 0; type < NUM_ACTION_TYPES; type++) {
+		samples = replay_latencies[type];
+		if (samples->len == 0)
+			continue;
+
+		printf("%-12s %8u %10.2f %10.2f %10.2f %10.2f\n",
+			   action_type_name((action_type_t)type), samples->len,
+			   action_percentile(samples, 50) / 1000.0,
+			   action_percentile(samples, 90) / 1000.0,
+			   action_percentile(samples, 99) / 1000.0,
+			   action_percentile(samples, 100) / 1000.0);
+	}
+
+	if (replay_failures > 0)
+		printf("%u actions couldn't be replayed.\n", replay_failures);
+}
+
+/**
+ * Callback for the start of a user action in the editor.
+ *
+ * @param buffer Text buffer of the editor.
+ * @param data   Data passed by the signal connector.
+ */
+void on_record_begin_user_action(GtkTextBuffer *buffer, gpointer data) {
+	recording_user_actions++;
+}
+
+/**
+ * Callback for the end of a user action in the editor.
+ *
+ * @param buffer Text buffer of the editor.
+ * @param data   Data passed by the signal connector.
+ */
+void on_record_end_user_action(GtkTextBuffer *buffer, gpointer data) {
+	if (recording_user_actions > 0)
+		recording_user_actions--;
+}
+
+/**
+ * Callback for text about to be inserted in the editor.
+ *
+ * @param buffer   Text buffer of the editor.
+ * @param location Where the text will be inserted.
+ * @param text     Text being inserted.
+ * @param len      Length of the text in bytes.
+ * @param data     Data passed by the signal connector.
+ */
+void on_record_insert_text(GtkTextBuffer *buffer, GtkTextIter *location,
+						   gchar *text, gint len, gpointer data) {
+	char *inserted;
+
+	if ((recording_user_actions == 0) || (len == 0))
+		return;
+
+	inserted = g_strndup(text, len);
+	record_action(ACTION_INSERT_TEXT, gtk_text_iter_get_offset(location),
+				  g_utf8_strlen(inserted, -1), inserted);
+	g_free(inserted);
+}
+
+/**
+ * Callback for text about to be deleted from the editor.
+ *
+ * @param buffer Text buffer of the editor.
+ * @param start  Start of the text being deleted.
+ * @param end    End of the text being deleted.
+ * @param data   Data passed by the signal connector.
+ */
+void on_record_delete_range(GtkTextBuffer *buffer, GtkTextIter *start,
+							GtkTextIter *end, gpointer data) {
+	gint offset;
+
+	if (recording_user_actions == 0)
+		return;
+
+	offset = gtk_text_iter_get_offset(start);
+	record_action(ACTION_DELETE_TEXT, offset,
+				  gtk_text_iter_get_offset(end) - offset, NULL);
+}
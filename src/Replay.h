@@ -0,0 +1,34 @@
+/**
+ * Replay.h
+ * Records the actions taken in the interface and replays them later.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _REPLAY_H_
+#define _REPLAY_H_
+
+#include <stdbool.h>
+#include "ActionLog.h"
+#include "Page.h"
+
+// Time between checks for the workspace to be ready to replay in. (ms)
+#define REPLAY_START_INTERVAL 100
+#define REPLAY_START_TIMEOUT  30000
+
+// Time between checks for the interface to settle down. (µs)
+#define REPLAY_POLL_INTERVAL 1000
+
+// Recording.
+bool start_action_recording(const char *fpath);
+void stop_action_recording();
+void record_action(action_type_t type, gint64 offset, gint64 count,
+				   const char *text);
+void record_page_selected(page_t page);
+
+// Replaying.
+bool start_action_replay(const char *fpath, bool realtime);
+int action_replay_status();
+void replay_settle();
+
+#endif /* _REPLAY_H_ */
@@ -0,0 +1,327 @@
+/**
+ * RevisionsDialog.c
+ * Dialog to browse and restore the saved revisions of a page.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include <string.h>
+#include <uki/uki.h>
+#include "RevisionsDialog.h"
+#include "DialogHelper.h"
+#include "PageManager.h"
+#include "Revisions.h"
+
+// Constants.
+#define RESPONSE_RESTORE 1
+
+// Revisions list columns.
+enum {
+	REVISIONS_COL_INDEX = 0,
+	REVISIONS_COL_DATE,
+	REVISIONS_COL_SIZE,
+	REVISIONS_COL_STORED,
+	REVISIONS_NUM_COLS
+};
+
+// Private variables.
+GtkWidget *revisions_dialog_parent;
+char revisions_dialog_fpath[UKI_MAX_PATH];
+char *revisions_dialog_contents;
+
+// Private methods.
+void revisions_dialog_fill(GtkListStore *store, GArray *revisions);
+void revisions_dialog_highlight(GtkTextView *preview, const char *previous,
+								gsize plength, const char *contents,
+								gsize length);
+void on_revision_selected(GtkTreeSelection *selection, gpointer data);
+
+/**
+ * Initializes the revisions dialog module.
+ *
+ * @param main_window Main application window.
+ */
+void initialize_revisions_dialog(GtkWidget *main_window) {
+	revisions_dialog_parent = main_window;
+}
+
+/**
+ * Shows the revisions of the current page and restores the one the user
+ * picks into the editor.
+ */
+void show_revisions_dialog() {
+	GtkWidget *dialog;
+	GtkWidget *vbox;
+	GtkWidget *hpaned;
+	GtkWidget *scrolled;
+	GtkWidget *tview;
+	GtkWidget *preview;
+	GtkListStore *store;
+	GtkTreeViewColumn *column;
+	GtkCellRenderer *renderer;
+	GtkTreeSelection *selection;
+	GtkTreeIter iter;
+	GArray *revisions;
+	GError *error = NULL;
+	page_t page;
+	gint res;
+
+	// Get the history of the current page.
+	page = get_current_page();
+	if (!page_is_valid(page) ||
+			(page_fpath(revisions_dialog_fpath, page) != UKI_OK)) {
+		return;
+	}
+	if ((revisions = revisions_list(revisions_dialog_fpath, &error)) == NULL) {
+		error_dialog("Unable to Read Page History", "%s", error->message);
+		g_error_free(error);
+
+		return;
+	}
+	if (revisions->len == 0) {
+		message_dialog(GTK_MESSAGE_INFO, "No Page History", "This page "
+					   "doesn't have any saved revisions yet.");
+		g_array_free(revisions, true);
+
+		return;
+	}
+
+	// Create the dialog.
+	dialog = gtk_dialog_new_with_buttons("Page History",
+			GTK_WINDOW(revisions_dialog_parent),
+			GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+			"Restore", RESPONSE_RESTORE,
+#if GTK_MAJOR_VERSION == 2
+			GTK_STOCK_CLOSE,
+#else
+			"Close",
+#endif
+			GTK_RESPONSE_CLOSE, NULL);
+	gtk_window_set_default_size(GTK_WINDOW(dialog), 760, 480);
+#if GTK_MAJOR_VERSION == 2
+	vbox = GTK_DIALOG(dialog)->vbox;
+	hpaned = gtk_hpaned_new();
+#else
+	vbox = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+	hpaned = gtk_paned_new(GTK_ORIENTATION_HORIZONTAL);
+#endif
+	gtk_box_pack_start(GTK_BOX(vbox), hpaned, true, true, 0);
+
+	// Create the list of revisions.
+	store = gtk_list_store_new(REVISIONS_NUM_COLS, G_TYPE_UINT, G_TYPE_STRING,
+							   G_TYPE_STRING, G_TYPE_STRING);
+	revisions_dialog_fill(store, revisions);
+	g_array_free(revisions, true);
+	tview = gtk_tree_view_new_with_model(GTK_TREE_MODEL(store));
+	g_object_unref(store);
+	renderer = gtk_cell_renderer_text_new();
+	column = gtk_tree_view_column_new_with_attributes("#", renderer,
+			"text", REVISIONS_COL_INDEX, NULL);
+	gtk_tree_view_append_column(GTK_TREE_VIEW(tview), column);
+	renderer = gtk_cell_renderer_text_new();
+	column = gtk_tree_view_column_new_with_attributes("Saved", renderer,
+			"text", REVISIONS_COL_DATE, NULL);
+	gtk_tree_view_append_column(GTK_TREE_VIEW(tview), column);
+	renderer = gtk_cell_renderer_text_new();
+	column = gtk_tree_view_column_new_with_attributes("Size", renderer,
+			"text", REVISIONS_COL_SIZE, NULL);
+	gtk_tree_view_append_column(GTK_TREE_VIEW(tview), column);
+	renderer = gtk_cell_renderer_text_new();
+	column = gtk_tree_view_column_new_with_attributes("Stored", renderer,
+			"text", REVISIONS_COL_STORED, NULL);
+	gtk_tree_view_append_column(GTK_TREE_VIEW(tview), column);
+	scrolled = gtk_scrolled_window_new(NULL, NULL);
+	gtk_container_add(GTK_CONTAINER(scrolled), tview);
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled),
+								   GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+	gtk_scrolled_window_set_shadow_type(GTK_SCROLLED_WINDOW(scrolled),
+										GTK_SHADOW_ETCHED_IN);
+	gtk_widget_set_size_request(scrolled, 320, -1);
+	gtk_paned_pack1(GTK_PANED(hpaned), scrolled, false, false);
+
+	// Create the preview of the selected revision.
+	preview = gtk_text_view_new();
+	gtk_text_view_set_editable(GTK_TEXT_VIEW(preview), false);
+	gtk_text_view_set_wrap_mode(GTK_TEXT_VIEW(preview), GTK_WRAP_WORD);
+#if GTK_MAJOR_VERSION == 2
+	gtk_widget_modify_font(preview,
+			pango_font_description_from_string("Monospace 10"));
+#else
+	gtk_text_view_set_monospace(GTK_TEXT_VIEW(preview), true);
+#endif
+	gtk_text_buffer_create_tag(gtk_text_view_get_buffer(GTK_TEXT_VIEW(preview)),
+							   "changed", "background", "#fff0a0", NULL);
+	scrolled = gtk_scrolled_window_new(NULL, NULL);
+	gtk_container_add(GTK_CONTAINER(scrolled), preview);
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled),
+								   GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+	gtk_scrolled_window_set_shadow_type(GTK_SCROLLED_WINDOW(scrolled),
+										GTK_SHADOW_ETCHED_IN);
+	gtk_paned_pack2(GTK_PANED(hpaned), scrolled, true, false);
+
+	// Start with the latest revision selected.
+	revisions_dialog_contents = NULL;
+	selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(tview));
+	gtk_tree_selection_set_mode(selection, GTK_SELECTION_BROWSE);
+	g_signal_connect(selection, "changed", G_CALLBACK(on_revision_selected),
+					 preview);
+	if (gtk_tree_model_get_iter_first(GTK_TREE_MODEL(store), &iter))
+		gtk_tree_selection_select_iter(selection, &iter);
+	gtk_widget_show_all(vbox);
+
+	// Restore the revision the user picked.
+	res = gtk_dialog_run(GTK_DIALOG(dialog));
+	gtk_widget_destroy(dialog);
+	if ((res == RESPONSE_RESTORE) && (revisions_dialog_contents != NULL) &&
+			!check_page_unsaved_changes()) {
+		replace_page_contents(revisions_dialog_contents);
+	}
+
+	g_free(revisions_dialog_contents);
+	revisions_dialog_contents = NULL;
+}
+
+/**
+ * Populates the list of revisions, from the newest to the oldest.
+ *
+ * @param store     List store to be populated.
+ * @param revisions Revisions of the page.
+ */
+void revisions_dialog_fill(GtkListStore *store, GArray *revisions) {
+	GtkTreeIter iter;
+	guint i;
+
+	for (i = revisions->len; i > 0; i--) {
+		revision_t *revision = &g_array_index(revisions, revision_t, i - 1);
+		GDateTime *time;
+		char *date;
+		char *size;
+		char *stored;
+		char *tmp;
+
+		// Format the information about the revision.
+		time = g_date_time_new_from_unix_local(revision->time /
+											   G_USEC_PER_SEC);
+		date = g_date_time_format(time, "%Y-%m-%d %H:%M:%S");
+		g_date_time_unref(time);
+		size = g_format_size(revision->length);
+		tmp = g_format_size(revision->stored);
+		stored = g_strdup_printf("%s%s", tmp,
+								 (revision->keyframe) ? " (full)" : "");
+		g_free(tmp);
+
+		// Add it to the list.
+		gtk_list_store_append(store, &iter);
+		gtk_list_store_set(store, &iter,
+						   REVISIONS_COL_INDEX, revision->index + 1,
+						   REVISIONS_COL_DATE, date,
+						   REVISIONS_COL_SIZE, size,
+						   REVISIONS_COL_STORED, stored, -1);
+		g_free(date);
+		g_free(size);
+		g_free(stored);
+	}
+}
+
+/**
+ * Highlights the region of a revision that changed since the previous one and
+ * scrolls to it.
+ *
+ * @param preview  Text view showing the revision.
+ * @param previous Contents of the previous revision.
+ * @param plength  Length of the previous revision.
+ * @param contents Contents of the revision.
+ * @param length   Length of the revision.
+ */
+void revisions_dialog_highlight(GtkTextView *preview, const char *previous,
+								gsize plength, const char *contents,
+								gsize length) {
+	GtkTextBuffer *buffer;
+	GtkTextIter start;
+	GtkTextIter end;
+	gsize shortest = MIN(plength, length);
+	gsize prefix = 0;
+	gsize suffix = 0;
+
+	// Find the region that changed.
+	while ((prefix < shortest) && (previous[prefix] == contents[prefix]))
+		prefix++;
+	while ((suffix < shortest - prefix) &&
+			(previous[plength - suffix - 1] == contents[length - suffix - 1])) {
+		suffix++;
+	}
+
+	// Don't split any characters.
+	while ((prefix > 0) && ((contents[prefix] & 0xC0) == 0x80))
+		prefix--;
+	while ((suffix > 0) && ((contents[length - suffix] & 0xC0) == 0x80))
+		suffix--;
+
+	// Highlight it.
+	buffer = gtk_text_view_get_buffer(preview);
+	gtk_text_buffer_get_iter_at_offset(buffer, &start,
+			g_utf8_pointer_to_offset(contents, contents + prefix));
+	gtk_text_buffer_get_iter_at_offset(buffer, &end,
+			g_utf8_pointer_to_offset(contents, contents + length - suffix));
+	gtk_text_buffer_apply_tag_by_name(buffer, "changed", &start, &end);
+	gtk_text_buffer_place_cursor(buffer, &start);
+	gtk_text_view_scroll_to_mark(preview, gtk_text_buffer_get_insert(buffer),
+								 0.0, true, 0.0, 0.3);
+}
+
+/**
+ * Revisions list selection callback that previews the selected revision.
+ *
+ * @param selection Selection of the revisions list.
+ * @param data      Text view of the preview.
+ */
+void on_revision_selected(GtkTreeSelection *selection, gpointer data) {
+	GtkTextView *preview = GTK_TEXT_VIEW(data);
+	GtkTreeModel *model;
+	GtkTreeIter iter;
+	GError *error = NULL;
+	char *previous;
+	gsize plength;
+	gsize length;
+	guint index;
+
+	// Get the revision that was selected.
+	g_free(revisions_dialog_contents);
+	revisions_dialog_contents = NULL;
+	gtk_text_buffer_set_text(gtk_text_view_get_buffer(preview), "", -1);
+	if (!gtk_tree_selection_get_selected(selection, &model, &iter))
+		return;
+	gtk_tree_model_get(model, &iter, REVISIONS_COL_INDEX, &index, -1);
+	index--;
+
+	// Fetch it.
+	revisions_dialog_contents = revisions_fetch(revisions_dialog_fpath, index,
+												&length, &error);
+	if (revisions_dialog_contents == NULL) {
+		error_dialog("Unable to Read Revision", "%s", error->message);
+		g_error_free(error);
+
+		return;
+	}
+	if (!g_utf8_validate(revisions_dialog_contents, length, NULL)) {
+		error_dialog("Unable to Read Revision", "Revision %u isn't valid "
+					 "UTF-8 text.", index + 1);
+		g_free(revisions_dialog_contents);
+		revisions_dialog_contents = NULL;
+
+		return;
+	}
+	gtk_text_buffer_set_text(gtk_text_view_get_buffer(preview),
+							 revisions_dialog_contents, length);
+
+	// Show what it changed.
+	if (index > 0) {
+		previous = revisions_fetch(revisions_dialog_fpath, index - 1,
+								   &plength, NULL);
+		if (previous != NULL) {
+			revisions_dialog_highlight(preview, previous, plength,
+									   revisions_dialog_contents, length);
+			g_free(previous);
+		}
+	}
+}
@@ -0,0 +1,19 @@
+/**
+ * RevisionsDialog.h
+ * Dialog to browse and restore the saved revisions of a page.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _REVISIONSDIALOG_H_
+#define _REVISIONSDIALOG_H_
+
+#include <gtk/gtk.h>
+
+// Initialization.
+void initialize_revisions_dialog(GtkWidget *main_window);
+
+// Display.
+void show_revisions_dialog();
+
+#endif /* _REVISIONSDIALOG_H_ */
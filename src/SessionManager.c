@@ -0,0 +1,397 @@
+/**
+ * SessionManager.c
+ * Saves the state of the application on exit and restores it on launch.
+ *
+ * The last workspace, page, cursor and scroll positions, and the expanded
+ * rows of the tree view are kept in a key file in the user config folder,
+ * while the source and render of the page are cached in the user cache
+ * folder. On launch the cached page is shown straight away and the workspace
+ * is only scanned once the window is up. The cached render is then checked
+ * against the page on disk and the templates it uses, being thrown away and
+ * rendered again if anything changed.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include "SessionManager.h"
+#include "AppProperties.h"
+#include "MainWindow.h"
+#include "MenuManager.h"
+#include "PageManager.h"
+#include "TemplateDeps.h"
+#include "Trace.h"
+#include "Wiki.h"
+#include "Workspace.h"
+
+// Constants.
+#define SESSION_GROUP      "Session"
+#define SESSION_FNAME      "session.ini"
+#define SESSION_SOURCE     "page.uki"
+#define SESSION_HTML       "page.html"
+#define SESSION_OPEN_DELAY 50
+
+// State of a previous session.
+typedef struct {
+	char *workspace;
+	char *page;
+	gint cursor;
+	gdouble scroll;
+	char **expanded;
+	char *fingerprint;
+	GBytes *source;
+	GBytes *html;
+} session_t;
+
+// Private methods.
+char* session_config_path();
+char* session_cache_path(const char *fname);
+char* session_fingerprint(GBytes *source);
+session_t* session_load();
+void session_load_cache(session_t *session);
+void session_free(session_t *session);
+gboolean on_session_open(gpointer data);
+
+/**
+ * Saves the current state of the application to be restored on the next
+ * launch.
+ */
+void store_session() {
+	GKeyFile *keyfile;
+	GError *error = NULL;
+	GBytes *source = NULL;
+	GBytes *html = NULL;
+	page_t page;
+	gint cursor;
+	gdouble scroll;
+	char *fpath;
+	char *dir;
+
+	TRACE_BEGIN("store_session");
+
+	// Forget about everything if there's no workspace opened.
+	keyfile = g_key_file_new();
+	if (is_workspace_opened()) {
+		char **expanded;
+
+		g_key_file_set_string(keyfile, SESSION_GROUP, "Workspace",
+							  wiki_root());
+		expanded = workspace_expanded_rows();
+		g_key_file_set_string_list(keyfile, SESSION_GROUP, "Expanded",
+								   (const gchar * const *)expanded,
+								   g_strv_length(expanded));
+		g_strfreev(expanded);
+
+		// Store the page we were in.
+		if (get_page_state(&page, &source, &html, &cursor, &scroll)) {
+			char *name = page_display_name(page);
+
+			g_key_file_set_string(keyfile, SESSION_GROUP, "Page", name);
+			g_key_file_set_integer(keyfile, SESSION_GROUP, "Cursor", cursor);
+			g_key_file_set_double(keyfile, SESSION_GROUP, "Scroll", scroll);
+			g_free(name);
+		}
+	}
+
+	// Cache the contents of the page if they are saved.
+	dir = session_cache_path(NULL);
+	if ((source != NULL) && (g_mkdir_with_parents(dir, 0755) == 0)) {
+		char *src_path = session_cache_path(SESSION_SOURCE);
+		char *html_path = session_cache_path(SESSION_HTML);
+		gconstpointer data;
+		gsize length;
+
+		data = g_bytes_get_data(source, &length);
+		if (g_file_set_contents(src_path, data, length, NULL)) {
+			data = g_bytes_get_data(html, &length);
+			if (g_file_set_contents(html_path, data, length, NULL)) {
+				char *fingerprint = session_fingerprint(source);
+
+				g_key_file_set_string(keyfile, SESSION_GROUP, "Fingerprint",
+									  fingerprint);
+				g_free(fingerprint);
+			}
+		}
+
+		g_free(src_path);
+		g_free(html_path);
+	}
+	if (source != NULL) {
+		g_bytes_unref(source);
+		g_bytes_unref(html);
+	}
+	g_free(dir);
+
+	// Write the session file.
+	fpath = session_config_path();
+	dir = g_path_get_dirname(fpath);
+	if (g_mkdir_with_parents(dir, 0755) != 0) {
+		g_warning("Unable to create the folder '%s'.", dir);
+	} else if (!g_key_file_save_to_file(keyfile, fpath, &error)) {
+		g_warning("Failed to save the session: %s", error->message);
+		g_error_free(error);
+	}
+
+	g_key_file_free(keyfile);
+	g_free(fpath);
+	g_free(dir);
+
+	TRACE_END("store_session");
+}
+
+/**
+ * Restores the state of the previous session. The cached page is shown right
+ * away, while the workspace is opened after the window is up.
+ *
+ * @return TRUE if there was a session to restore.
+ */
+bool restore_session() {
+	session_t *session;
+
+	// Check if we have a workspace to go back to.
+	session = session_load();
+	if (session == NULL)
+		return false;
+
+	// Show what we had cached while the workspace is scanned.
+	TRACE_BEGIN("restore_session");
+	session_load_cache(session);
+	if (session->source != NULL) {
+		show_page_preview(g_bytes_ref(session->source),
+						  g_bytes_ref(session->html), session->scroll);
+		set_window_page_title(session->page);
+	}
+	TRACE_END("restore_session");
+
+	// Let the window show up before the workspace blocks us.
+	g_timeout_add(SESSION_OPEN_DELAY, on_session_open, session);
+
+	return true;
+}
+
+/**
+ * Opens the workspace of the previous session and goes back to its page.
+ *
+ * @param  data Previous session.
+ * @return      FALSE to remove the timeout.
+ */
+gboolean on_session_open(gpointer data) {
+	session_t *session = data;
+	page_t page;
+
+	// Another workspace was opened in the meantime.
+	if (is_workspace_opened()) {
+		session_free(session);
+		return false;
+	}
+
+	// Open the workspace and get the tree view the way it was.
+	TRACE_BEGIN("on_session_open");
+	if (!open_workspace(session->workspace)) {
+		clear_page_contents();
+		set_window_page_title(NULL);
+		update_workspace_state_menu();
+		session_free(session);
+		TRACE_END("on_session_open");
+
+		return false;
+	}
+	if (session->expanded != NULL)
+		workspace_expand_rows((const char * const *)session->expanded);
+
+	// Go back to the page we were in.
+	if ((session->page != NULL) && page_find(session->page, &page)) {
+		// Only trust the cache if the page and its templates haven't changed.
+		if (session->source != NULL) {
+			GBytes *disk = NULL;
+			char *contents;
+			char *fingerprint;
+			size_t length;
+
+			if (page_read(page, &contents, &length, NULL))
+				disk = g_bytes_new_take(contents, length);
+			fingerprint = (disk != NULL) ? session_fingerprint(disk) : NULL;
+			if (g_strcmp0(fingerprint, session->fingerprint) != 0) {
+				g_bytes_unref(session->source);
+				g_bytes_unref(session->html);
+				session->source = NULL;
+				session->html = NULL;
+			}
+
+			if (disk != NULL)
+				g_bytes_unref(disk);
+			g_free(fingerprint);
+		}
+
+		restore_page_state(page, session->source, session->html,
+						   session->cursor, session->scroll);
+		session->source = NULL;
+		session->html = NULL;
+	} else {
+		clear_page_contents();
+		set_window_page_title(NULL);
+	}
+
+	// Set the state of the widgets affected by the changes.
+	update_workspace_state_menu();
+	session_free(session);
+	TRACE_END("on_session_open");
+
+	return false;
+}
+
+/**
+ * Loads the previous session from its file.
+ *
+ * @return Previous session or NULL if there's no workspace to restore.
+ */
+session_t* session_load() {
+	session_t *session;
+	GKeyFile *keyfile;
+	char *fpath;
+	char *workspace;
+
+	// Read the session file.
+	keyfile = g_key_file_new();
+	fpath = session_config_path();
+	if (!g_key_file_load_from_file(keyfile, fpath, G_KEY_FILE_NONE, NULL)) {
+		g_key_file_free(keyfile);
+		g_free(fpath);
+
+		return NULL;
+	}
+	g_free(fpath);
+
+	// Check if the workspace is still around.
+	workspace = g_key_file_get_string(keyfile, SESSION_GROUP, "Workspace",
+									  NULL);
+	if ((workspace == NULL) || !g_file_test(workspace, G_FILE_TEST_IS_DIR)) {
+		g_key_file_free(keyfile);
+		g_free(workspace);
+
+		return NULL;
+	}
+
+	// Get the rest of the state.
+	session = g_new0(session_t, 1);
+	session->workspace = workspace;
+	session->page = g_key_file_get_string(keyfile, SESSION_GROUP, "Page",
+										  NULL);
+	session->cursor = g_key_file_get_integer(keyfile, SESSION_GROUP, "Cursor",
+											 NULL);
+	session->scroll = g_key_file_get_double(keyfile, SESSION_GROUP, "Scroll",
+											NULL);
+	session->expanded = g_key_file_get_string_list(keyfile, SESSION_GROUP,
+												   "Expanded", NULL, NULL);
+	session->fingerprint = g_key_file_get_string(keyfile, SESSION_GROUP,
+												 "Fingerprint", NULL);
+
+	g_key_file_free(keyfile);
+	return session;
+}
+
+/**
+ * Loads the cached contents of the page of a session.
+ *
+ * @param session Session to have its contents loaded.
+ */
+void session_load_cache(session_t *session) {
+	char *src_path;
+	char *html_path;
+	char *source;
+	char *html;
+	gsize src_len;
+	gsize html_len;
+
+	// Only pages that had their contents saved have a cache.
+	if ((session->page == NULL) || (session->fingerprint == NULL))
+		return;
+
+	// Read both files.
+	src_path = session_cache_path(SESSION_SOURCE);
+	html_path = session_cache_path(SESSION_HTML);
+	if (g_file_get_contents(src_path, &source, &src_len, NULL)) {
+		if (g_file_get_contents(html_path, &html, &html_len, NULL)) {
+			session->source = g_bytes_new_take(source, src_len);
+			session->html = g_bytes_new_take(html, html_len);
+		} else {
+			g_free(source);
+		}
+	}
+
+	g_free(src_path);
+	g_free(html_path);
+}
+
+/**
+ * Frees a session.
+ *
+ * @param session Session to be freed.
+ */
+void session_free(session_t *session) {
+	if (session->source != NULL)
+		g_bytes_unref(session->source);
+	if (session->html != NULL)
+		g_bytes_unref(session->html);
+
+	g_free(session->workspace);
+	g_free(session->page);
+	g_strfreev(session->expanded);
+	g_free(session->fingerprint);
+	g_free(session);
+}
+
+/**
+ * Computes a fingerprint of a page source and of the templates it uses, which
+ * changes whenever its render would change.
+ *
+ * @param  source Source of the page.
+ * @return        Newly allocated fingerprint. Free it with g_free().
+ */
+char* session_fingerprint(GBytes *source) {
+	template_deps_t *deps;
+	gconstpointer data;
+	char *contents;
+	char *checksum;
+	char *templates;
+	char *fingerprint;
+	gsize length;
+
+	// The dependency scan needs a NUL-terminated source.
+	data = g_bytes_get_data(source, &length);
+	contents = g_strndup(data, length);
+	checksum = g_compute_checksum_for_data(G_CHECKSUM_SHA1,
+										   (const guchar*)contents, length);
+	deps = template_deps_new();
+	templates = template_deps_hash(deps, contents);
+	fingerprint = g_strdup_printf("%s:%s", checksum, templates);
+
+	template_deps_free(deps);
+	g_free(templates);
+	g_free(checksum);
+	g_free(contents);
+
+	return fingerprint;
+}
+
+/**
+ * Gets the path to the session file.
+ *
+ * @return Newly allocated path. Free it with g_free().
+ */
+char* session_config_path() {
+	return g_build_filename(g_get_user_config_dir(), APP_NAME, SESSION_FNAME,
+							NULL);
+}
+
+/**
+ * Gets the path to a file in the session cache folder.
+ *
+ * @param  fname Name of the file or NULL for the folder itself.
+ * @return       Newly allocated path. Free it with g_free().
+ */
+char* session_cache_path(const char *fname) {
+	return g_build_filename(g_get_user_cache_dir(), APP_NAME, "session", fname,
+							NULL);
+}
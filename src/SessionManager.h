@@ -0,0 +1,17 @@
+/**
+ * SessionManager.h
+ * Saves the state of the application on exit and restores it on launch.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _SESSIONMANAGER_H_
+#define _SESSIONMANAGER_H_
+
+#include <stdbool.h>
+
+// Saving and restoring.
+void store_session();
+bool restore_session();
+
+#endif /* _SESSIONMANAGER_H_ */
@@ -0,0 +1,212 @@
+/**
+ * SingleInstance.c
+ * Routes new invocations of the application to the instance that's running.
+ *
+ * The first graphical instance registers itself on the session bus and keeps
+ * running its own GTK main loop. Later invocations find it there, ask it to
+ * open their workspace and page through the "open-location" action, and exit
+ * before initializing GTK or WebKit. If there's no session bus every
+ * invocation simply runs on its own.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include <string.h>
+#include <gio/gio.h>
+#include "SingleInstance.h"
+#include "AppProperties.h"
+#include "DialogHelper.h"
+#include "MainWindow.h"
+#include "MenuManager.h"
+#include "Page.h"
+#include "PageManager.h"
+#include "Wiki.h"
+#include "Workspace.h"
+
+// Constants.
+#define ACTION_OPEN_LOCATION "open-location"
+
+// Private variables.
+GApplication *instance_app = NULL;
+
+// Private methods.
+char* instance_absolute_path(const char *path);
+void on_instance_activate(GApplication *app, gpointer data);
+void on_instance_open_location(GSimpleAction *action, GVariant *parameter,
+							   gpointer data);
+
+/**
+ * Registers this instance and hands the request over to another instance if
+ * one is already running.
+ *
+ * @param  workspace Workspace that should be opened. (May be NULL)
+ * @param  page      Page that should be opened. (May be NULL)
+ * @return           TRUE if another instance took over and we should exit.
+ */
+bool instance_forward(const char *workspace, const char *page) {
+	GSimpleAction *action;
+	GError *error = NULL;
+	char *abs_workspace;
+	char *abs_page;
+
+	// Setup the application and the action used to talk to it.
+	instance_app = g_application_new(APP_ID, G_APPLICATION_FLAGS_NONE);
+	action = g_simple_action_new(ACTION_OPEN_LOCATION,
+								 G_VARIANT_TYPE("(ss)"));
+	g_signal_connect(action, "activate",
+					 G_CALLBACK(on_instance_open_location), NULL);
+	g_action_map_add_action(G_ACTION_MAP(instance_app), G_ACTION(action));
+	g_object_unref(action);
+	g_signal_connect(instance_app, "activate",
+					 G_CALLBACK(on_instance_activate), NULL);
+
+	// Try to become the primary instance.
+	if (!g_application_register(instance_app, NULL, &error)) {
+		g_warning("Running without single instance support: %s",
+				  error->message);
+		g_error_free(error);
+		instance_release();
+
+		return false;
+	}
+
+	// We are the primary instance, so it's up to us.
+	if (!g_application_get_is_remote(instance_app))
+		return false;
+
+	// Paths must survive the trip to a process with another working directory.
+	abs_workspace = instance_absolute_path(workspace);
+	if ((page != NULL) && g_file_test(page, G_FILE_TEST_EXISTS)) {
+		abs_page = instance_absolute_path(page);
+	} else {
+		abs_page = g_strdup((page != NULL) ? page : "");
+	}
+	if ((*abs_workspace == '\0') && (*abs_page == '\0')) {
+		g_application_activate(instance_app);
+	} else {
+		g_action_group_activate_action(G_ACTION_GROUP(instance_app),
+									   ACTION_OPEN_LOCATION,
+									   g_variant_new("(ss)", abs_workspace,
+													 abs_page));
+	}
+
+	// Make sure the message leaves before we do.
+	g_dbus_connection_flush_sync(g_application_get_dbus_connection(
+		instance_app), NULL, NULL);
+	g_free(abs_workspace);
+	g_free(abs_page);
+
+	return true;
+}
+
+/**
+ * Releases the application registration.
+ */
+void instance_release() {
+	if (instance_app != NULL)
+		g_object_unref(instance_app);
+
+	instance_app = NULL;
+}
+
+/**
+ * Works out which workspace a request from the command-line is about.
+ *
+ * A page that exists on disk belongs to the workspace it's in, otherwise we
+ * look for one around the current directory. Both the instance that's started
+ * and the one that's handed the request over resolve it the same way.
+ *
+ * @param  workspace Workspace that was requested. (May be NULL)
+ * @param  page      Page name or path that was requested. (May be NULL)
+ * @return           Newly allocated canonical path to the root of the
+ *                   workspace or NULL if the page should be looked for in the
+ *                   workspace that's already opened. Free it with g_free().
+ */
+char* instance_resolve_workspace(const char *workspace, const char *page) {
+	if (workspace != NULL)
+		return g_canonicalize_filename(workspace, NULL);
+	if ((page != NULL) && g_file_test(page, G_FILE_TEST_EXISTS))
+		return wiki_find_root(page);
+
+	return wiki_find_root(".");
+}
+
+/**
+ * Opens a workspace and a page, switching workspaces if needed.
+ *
+ * @param workspace Workspace that should be opened or NULL to use the current
+ *                  one.
+ * @param page      Page name or path that should be opened. (May be NULL)
+ */
+void instance_open_location(const char *workspace, const char *page) {
+	page_t found;
+
+	// Switch to the requested workspace unless we are already there.
+	if ((workspace != NULL) && (!is_workspace_opened() ||
+			(strcmp(wiki_root(), workspace) != 0))) {
+		if (check_page_unsaved_changes())
+			return;
+
+		close_workspace();
+		open_workspace(workspace);
+		update_workspace_state_menu();
+	}
+
+	// Open the requested page.
+	if (page == NULL)
+		return;
+	if (!is_workspace_opened()) {
+		error_dialog("No Workspace Opened", "Open a workspace before opening "
+					 "the page '%s'.", page);
+		return;
+	}
+	if (!page_find(page, &found)) {
+		error_dialog("Page Not Found", "Unable to find the page '%s' in the "
+					 "workspace.", page);
+		return;
+	}
+
+	select_workspace_page(found);
+}
+
+/**
+ * Makes a path absolute.
+ *
+ * @param  path Path to be converted. (May be NULL)
+ * @return      Newly allocated canonical path or an empty string if the path
+ *              was NULL. Free it with g_free().
+ */
+char* instance_absolute_path(const char *path) {
+	if (path == NULL)
+		return g_strdup("");
+
+	return g_canonicalize_filename(path, NULL);
+}
+
+/**
+ * Callback for when another instance was started without a location.
+ *
+ * @param app  Application.
+ * @param data Data passed by the signal connector.
+ */
+void on_instance_activate(GApplication *app, gpointer data) {
+	present_mainwindow();
+}
+
+/**
+ * Callback for when another instance asks us to open a location.
+ *
+ * @param action    Action that was activated.
+ * @param parameter Workspace and page. (Empty strings if not set)
+ * @param data      Data passed by the signal connector.
+ */
+void on_instance_open_location(GSimpleAction *action, GVariant *parameter,
+							   gpointer data) {
+	const char *workspace;
+	const char *page;
+
+	g_variant_get(parameter, "(&s&s)", &workspace, &page);
+	present_mainwindow();
+	instance_open_location((*workspace != '\0') ? workspace : NULL,
+						   (*page != '\0') ? page : NULL);
+}
@@ -0,0 +1,21 @@
+/**
+ * SingleInstance.h
+ * Routes new invocations of the application to the instance that's running.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _SINGLEINSTANCE_H_
+#define _SINGLEINSTANCE_H_
+
+#include <stdbool.h>
+
+// Registration.
+bool instance_forward(const char *workspace, const char *page);
+void instance_release();
+
+// Opening.
+char* instance_resolve_workspace(const char *workspace, const char *page);
+void instance_open_location(const char *workspace, const char *page);
+
+#endif /* _SINGLEINSTANCE_H_ */
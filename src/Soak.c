@@ -0,0 +1,250 @@
+/**
+ * Soak.c
+ * Long-running benchmark that watches memory grow while pages are switched.
+ *
+ * Pages are loaded, previewed, and searched over and over, with the workspace
+ * reloaded every so often, while the memory of the process, of the WebKit
+ * processes, and the number of live objects are sampled. Whatever the caches
+ * are allowed to hold fills up during the first pass over the articles, so
+ * any growth after it is something that was never let go of.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gtk/gtk.h>
+#include "Soak.h"
+#include "AppProperties.h"
+#include "DialogHelper.h"
+#include "FindReplace.h"
+#include "PageManager.h"
+#include "Replay.h"
+#include "Stats.h"
+#include "Wiki.h"
+#include "Workspace.h"
+
+// Memory sample.
+typedef struct {
+	guint cycle;
+	gint64 rss;
+	gint64 webkit;
+	gint64 instances;
+} soak_sample_t;
+
+// Private variables.
+guint soak_cycles;
+gint64 soak_limit;
+guint soak_waited;
+bool soak_failed = false;
+
+// Private methods.
+gboolean on_soak_start(gpointer data);
+void soak_run();
+void soak_sample(soak_sample_t *sample, guint cycle);
+gint64 soak_count_instances(GType type);
+bool soak_check_growth(const char *name, gint64 growth, gint64 limit,
+					   bool bytes);
+
+/**
+ * Starts the soak benchmark as soon as the workspace is ready.
+ *
+ * @param  cycles   Number of times pages should be switched.
+ * @param  limit_mb Memory growth allowed before failing in megabytes.
+ * @return          TRUE if the benchmark was scheduled.
+ */
+bool start_soak(guint cycles, guint limit_mb) {
+	const char *debug;
+
+	if (cycles == 0)
+		return false;
+
+	// Object instances are only counted when GObject is asked to.
+	debug = g_getenv("GOBJECT_DEBUG");
+	if ((debug == NULL) || (strstr(debug, "instance-count") == NULL)) {
+		fprintf(stderr, "%s: Set GOBJECT_DEBUG=instance-count to check the "
+				"object instances as well.\n", APP_NAME);
+	}
+
+	// Nobody is around to answer any questions.
+	set_dialogs_unattended(true);
+	set_find_needle(SOAK_NEEDLE, true);
+	soak_cycles = cycles;
+	soak_limit = (gint64)limit_mb * 1024 * 1024;
+	soak_waited = 0;
+	soak_failed = false;
+	g_timeout_add(REPLAY_START_INTERVAL, on_soak_start, NULL);
+
+	return true;
+}
+
+/**
+ * Gets the exit status of the soak benchmark.
+ *
+ * @return EXIT_FAILURE if anything grew beyond its limit.
+ */
+int soak_status() {
+	return (soak_failed) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * Waits for the workspace to be opened and then runs the benchmark.
+ *
+ * @param  data Data passed by the timeout.
+ * @return      FALSE once the benchmark has been run.
+ */
+gboolean on_soak_start(gpointer data) {
+	if (!is_workspace_opened()) {
+		soak_waited += REPLAY_START_INTERVAL;
+		if (soak_waited < REPLAY_START_TIMEOUT)
+			return true;
+
+		fprintf(stderr, "%s: No workspace was opened to soak.\n", APP_NAME);
+		soak_failed = true;
+	} else if (wiki_pages_available(PAGE_TYPE_ARTICLE) == 0) {
+		fprintf(stderr, "%s: The workspace has no articles to soak.\n",
+				APP_NAME);
+		soak_failed = true;
+	} else {
+		soak_run();
+	}
+
+	gtk_main_quit();
+	return false;
+}
+
+/**
+ * Cycles through the articles while sampling the memory use.
+ */
+void soak_run() {
+	soak_sample_t baseline;
+	soak_sample_t sample;
+	guint interval;
+	guint warmup;
+	guint cycle;
+	bool warm = false;
+	size_t articles;
+
+	// Let the caches fill up before taking the baseline.
+	replay_settle();
+	articles = wiki_pages_available(PAGE_TYPE_ARTICLE);
+	interval = MAX(1, soak_cycles / SOAK_SAMPLES);
+	warmup = MIN(articles, soak_cycles / 2);
+	memset(&baseline, 0, sizeof(baseline));
+	memset(&sample, 0, sizeof(sample));
+
+	printf("%10s %12s %12s %10s\n", "cycle", "rss (MB)", "webkit (MB)",
+		   "objects");
+	for (cycle = 1; cycle <= soak_cycles; cycle++) {
+		// Go through a page like a user would.
+		load_article((gint)((cycle - 1) % articles));
+		replay_settle();
+		force_refresh_page_viewer();
+		replay_settle();
+		find_next();
+		replay_settle();
+
+		// Throw everything away every once in a while.
+		if ((cycle % SOAK_RELOAD_INTERVAL) == 0) {
+			reload_workspace();
+			replay_settle();
+			articles = wiki_pages_available(PAGE_TYPE_ARTICLE);
+			if (articles == 0)
+				break;
+		}
+
+		// Take a sample.
+		if (((cycle % interval) != 0) && (cycle != soak_cycles))
+			continue;
+		soak_sample(&sample, cycle);
+		printf("%10u %12.1f %12.1f %10" G_GINT64_FORMAT "\n", cycle,
+			   sample.rss / 1048576.0, sample.webkit / 1048576.0,
+			   sample.instances);
+		fflush(stdout);
+
+		if (!warm && (cycle >= warmup)) {
+			baseline = sample;
+			warm = true;
+		}
+	}
+
+	// Anything that kept growing after the warm up is a leak.
+	if (!warm || (sample.cycle == baseline.cycle)) {
+		fprintf(stderr, "%s: Not enough cycles to measure any growth.\n",
+				APP_NAME);
+		soak_failed = true;
+		return;
+	}
+
+	printf("Growth after cycle %u:\n", baseline.cycle);
+	soak_failed |= !soak_check_growth("rss", sample.rss - baseline.rss,
+									  soak_limit, true);
+	soak_failed |= !soak_check_growth("webkit", sample.webkit -
+									  baseline.webkit, soak_limit, true);
+	soak_failed |= !soak_check_growth("objects", sample.instances -
+									  baseline.instances,
+									  SOAK_INSTANCE_LIMIT, false);
+}
+
+/**
+ * Samples the memory use.
+ *
+ * @param sample Sample to populate.
+ * @param cycle  Cycle the sample was taken in.
+ */
+void soak_sample(soak_sample_t *sample, guint cycle) {
+	sample->cycle = cycle;
+	sample->rss = MAX(0, stats_rss());
+	sample->webkit = MAX(0, stats_children_rss());
+	sample->instances = soak_count_instances(G_TYPE_OBJECT);
+}
+
+/**
+ * Counts the live instances of a type and every type derived from it.
+ *
+ * @param  type Type to count the instances of.
+ * @return      Number of instances or 0 if they aren't being counted.
+ */
+gint64 soak_count_instances(GType type) {
+#if GLIB_CHECK_VERSION(2, 44, 0)
+	GType *children;
+	guint len;
+	guint i;
+	gint64 count;
+
+	count = g_type_get_instance_count(type);
+	children = g_type_children(type, &len);
+	for (i = 0; i < len; i++)
+		count += soak_count_instances(children[i]);
+	g_free(children);
+
+	return count;
+#else
+	return 0;
+#endif
+}
+
+/**
+ * Reports how much something grew and checks it against its limit.
+ *
+ * @param  name   Name of what was measured.
+ * @param  growth How much it grew.
+ * @param  limit  How much it's allowed to grow.
+ * @param  bytes  Is it measured in bytes?
+ * @return        TRUE if it's within its limit.
+ */
+bool soak_check_growth(const char *name, gint64 growth, gint64 limit,
+					   bool bytes) {
+	bool ok = growth <= limit;
+
+	if (bytes) {
+		printf("  %-8s %+10.1f MB (limit %.1f MB) %s\n", name,
+			   growth / 1048576.0, limit / 1048576.0, (ok) ? "ok" : "FAIL");
+	} else {
+		printf("  %-8s %+10" G_GINT64_FORMAT " (limit %" G_GINT64_FORMAT
+			   ") %s\n", name, growth, limit, (ok) ? "ok" : "FAIL");
+	}
+
+	return ok;
+}
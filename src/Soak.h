@@ -0,0 +1,30 @@
+/**
+ * Soak.h
+ * Long-running benchmark that watches memory grow while pages are switched.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _SOAK_H_
+#define _SOAK_H_
+
+#include <stdbool.h>
+#include <glib.h>
+
+// Number of samples taken during a run.
+#define SOAK_SAMPLES 20
+
+// Cycles between each reload of the workspace.
+#define SOAK_RELOAD_INTERVAL 100
+
+// Growth in object instances that's considered a leak.
+#define SOAK_INSTANCE_LIMIT 1000
+
+// What's searched for in each page.
+#define SOAK_NEEDLE "<"
+
+// Running.
+bool start_soak(guint cycles, guint limit_mb);
+int soak_status();
+
+#endif /* _SOAK_H_ */
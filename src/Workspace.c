@@ -5,20 +5,35 @@
  * @author Nathan Campos <nathan@innoveworkshop.com>
  */
 
+#include <string.h>
 #include <uki/uki.h>
 #include "Workspace.h"
+#include "Backlinks.h"
 #include "DialogHelper.h"
+#include "Intern.h"
+#include "LinkGraph.h"
 #include "PageManager.h"
+#include "Trace.h"
+#include "Wiki.h"
 
 // Private variables.
 GtkWidget *treeview;
-char root_path[UKI_MAX_PATH];
-bool workspace_opened;
+GPtrArray *article_rows = NULL;
+GPtrArray *template_rows = NULL;
 
 // Private methods.
 void treeview_clear();
+void on_link_graph_built(GObject *source, GAsyncResult *result,
+						 gpointer data);
+void workspace_add_row(GPtrArray *rows, GtkTreeStore *store,
+					   GtkTreeIter *iter);
+void workspace_forget_rows();
 void workspace_populate_articles(GtkTreeStore *store);
 void workspace_populate_templates(GtkTreeStore *store);
+void workspace_collect_expanded(GtkTreeModel *model, GtkTreeIter *parent,
+								GPtrArray *names);
+void workspace_expand_matching(GtkTreeModel *model, GtkTreeIter *parent,
+							   const char * const *names);
 
 /**
  * Initializes the workspace.
@@ -27,7 +42,6 @@ void workspace_populate_templates(GtkTreeStore *store);
  */
 void initialize_workspace(GtkWidget *tview) {
 	treeview = tview;
-	workspace_opened = false;
 }
 
 /**
@@ -40,24 +54,36 @@ bool open_workspace(const char *wiki_root) {
 	uki_error err;
 
 	// Initialize the uki wiki.
-	if ((err = uki_initialize(wiki_root)) != UKI_OK) {
+	if ((err = wiki_open(wiki_root)) != UKI_OK) {
 		error_dialog("Error While Initializing Workspace", uki_error_msg(err));
 		close_workspace();
 
-		workspace_opened = false;
 		return false;
 	}
 
-	// Populate the tree view and store the wiki root.
+	// Populate the tree view.
 	populate_workspace_treeview();
-	if (root_path != wiki_root)
-		strcpy(root_path, wiki_root);
 
-	// Set the opened flag and return.
-	workspace_opened = true;
+	// Index the links between the articles without holding up the interface.
+	link_graph_build_async(on_link_graph_built, NULL);
+
 	return true;
 }
 
+/**
+ * Callback for when the link graph has been built in the background.
+ *
+ * @param source Source object of the task.
+ * @param result Result of the task.
+ * @param data   Data passed by the task.
+ */
+void on_link_graph_built(GObject *source, GAsyncResult *result,
+						 gpointer data) {
+	// Show the backlinks that the current page was waiting for.
+	if (link_graph_build_finish(result))
+		update_backlinks(get_current_page());
+}
+
 /**
  * Closes the workspace.
  */
@@ -67,11 +93,7 @@ void close_workspace() {
 	clear_page_contents();
 
 	// Clean up our Uki mess if there was something to clean up.
-	if (workspace_opened) {
-		uki_clean();
-	}
-
-	workspace_opened = false;
+	wiki_close();
 }
 
 /**
@@ -79,7 +101,7 @@ void close_workspace() {
  */
 void reload_workspace() {
 	close_workspace();
-	open_workspace(root_path);
+	open_workspace(wiki_root());
 }
 
 /**
@@ -89,10 +111,20 @@ void populate_workspace_treeview() {
 	GtkTreeStore *store;
 	GtkTreeModel *model;
 
-	// Create tree view store.
-	store = gtk_tree_store_new(NUM_COLS, G_TYPE_STRING, G_TYPE_INT,
+	TRACE_BEGIN("populate_workspace_treeview");
+
+	// Create tree view store. (Names are interned, so the rows only hold
+	// pointers to them)
+	store = gtk_tree_store_new(NUM_COLS, G_TYPE_POINTER, G_TYPE_INT,
 							   G_TYPE_CHAR);
 
+	// Keep track of the row of each page for quick selection.
+	workspace_forget_rows();
+	article_rows = g_ptr_array_new_with_free_func(
+		(GDestroyNotify)gtk_tree_row_reference_free);
+	template_rows = g_ptr_array_new_with_free_func(
+		(GDestroyNotify)gtk_tree_row_reference_free);
+
 	// Populate the tree view.
 	workspace_populate_articles(store);
 	workspace_populate_templates(store);
@@ -104,6 +136,8 @@ void populate_workspace_treeview() {
 
 	// Expand the whole tree view.
 	gtk_tree_view_expand_all(GTK_TREE_VIEW(treeview));
+
+	TRACE_END("populate_workspace_treeview");
 }
 
 /**
@@ -116,8 +150,7 @@ void workspace_populate_articles(GtkTreeStore *store) {
 	GtkTreeIter child;
 	GtkTreeIter folder;
 	GtkTreeIter *parent;
-	char last_parent[UKI_MAX_PATH];
-	last_parent[0] = '\0';
+	const char *last_parent = NULL;
 
 	// Create articles root node.
 	gtk_tree_store_append(store, &root, NULL);
@@ -128,20 +161,21 @@ void workspace_populate_articles(GtkTreeStore *store) {
 	parent = &root;
 	for (size_t i = 0; i < uki_articles_available(); i++) {
 		uki_article_t article = uki_article(i);
+		const char *folder_name = intern_string(article.parent);
 
 		// Check if we have a parent.
-		if (article.parent != NULL) {
+		if (folder_name != NULL) {
 			// Check if we should add a new folder.
-			if (strcmp(last_parent, article.parent) != 0) {
+			if (folder_name != last_parent) {
 				// Set the new last parent.
-				strcpy(last_parent, article.parent);
+				last_parent = folder_name;
 
 				// Currently we only support a single deepness level.
 				parent = &root;
 
 				// Create the folder.
 				gtk_tree_store_append(store, &folder, parent);
-				gtk_tree_store_set(store, &folder, COL_NAME, article.parent,
+				gtk_tree_store_set(store, &folder, COL_NAME, folder_name,
 								   COL_INDEX, -1, COL_TYPE, ROW_TYPE_FOLDER, -1);
 
 				// Set the new folder as the parent.
@@ -149,13 +183,15 @@ void workspace_populate_articles(GtkTreeStore *store) {
 			}
 		} else {
 			// Back to the root.
+			last_parent = NULL;
 			parent = &root;
 		}
 
 		// Append as a child of articles.
 		gtk_tree_store_append(store, &child, parent);
-		gtk_tree_store_set(store, &child, COL_NAME, article.name, COL_INDEX, i,
-						   COL_TYPE, ROW_TYPE_ARTICLE, -1);
+		gtk_tree_store_set(store, &child, COL_NAME, intern_string(article.name),
+						   COL_INDEX, i, COL_TYPE, ROW_TYPE_ARTICLE, -1);
+		workspace_add_row(article_rows, store, &child);
 	}
 }
 
@@ -179,8 +215,216 @@ void workspace_populate_templates(GtkTreeStore *store) {
 
 		// Append as a child of articles.
 		gtk_tree_store_append(store, &child, &root);
-		gtk_tree_store_set(store, &child, COL_NAME, template.name, COL_INDEX, i,
+		gtk_tree_store_set(store, &child, COL_NAME,
+						   intern_string(template.name), COL_INDEX, i,
 						   COL_TYPE, ROW_TYPE_TEMPLATE, -1);
+		workspace_add_row(template_rows, store, &child);
+	}
+}
+
+/**
+ * Cell data function that shows the name of a row of the workspace tree view.
+ *
+ * @param column   Tree view column.
+ * @param renderer Text cell renderer.
+ * @param model    Workspace tree model.
+ * @param iter     Row to be shown.
+ * @param data     Unused.
+ */
+void workspace_name_cell_data(GtkTreeViewColumn *column,
+							  GtkCellRenderer *renderer, GtkTreeModel *model,
+							  GtkTreeIter *iter, gpointer data) {
+	const char *name;
+
+	gtk_tree_model_get(model, iter, COL_NAME, &name, -1);
+	g_object_set(renderer, "text", name, NULL);
+}
+
+/**
+ * Search function that matches the typed key against the beginning of the
+ * name of a row of the workspace tree view, ignoring the case.
+ *
+ * @param  model  Workspace tree model.
+ * @param  column Column being searched.
+ * @param  key    Text typed by the user.
+ * @param  iter   Row to be checked.
+ * @param  data   Unused.
+ * @return        FALSE if the row matches. (As GTK expects it)
+ */
+gboolean workspace_name_search_equal(GtkTreeModel *model, gint column,
+									 const gchar *key, GtkTreeIter *iter,
+									 gpointer data) {
+	const char *name;
+	char *fold_name;
+	char *fold_key;
+	bool match;
+
+	gtk_tree_model_get(model, iter, COL_NAME, &name, -1);
+	if (name == NULL)
+		return true;
+
+	// Compare them the same way GTK does with its own search.
+	fold_name = g_utf8_casefold(name, -1);
+	fold_key = g_utf8_casefold(key, -1);
+	match = strncmp(fold_name, fold_key, strlen(fold_key)) == 0;
+	g_free(fold_key);
+	g_free(fold_name);
+
+	return !match;
+}
+
+/**
+ * Remembers the row of a page in the tree view.
+ *
+ * @param rows  Array of row references indexed by the page index.
+ * @param store Tree view tree store.
+ * @param iter  Row of the page.
+ */
+void workspace_add_row(GPtrArray *rows, GtkTreeStore *store,
+					   GtkTreeIter *iter) {
+	GtkTreePath *path;
+
+	path = gtk_tree_model_get_path(GTK_TREE_MODEL(store), iter);
+	g_ptr_array_add(rows, gtk_tree_row_reference_new(GTK_TREE_MODEL(store),
+													 path));
+	gtk_tree_path_free(path);
+}
+
+/**
+ * Forgets the rows of the pages in the tree view.
+ */
+void workspace_forget_rows() {
+	if (article_rows != NULL)
+		g_ptr_array_free(article_rows, true);
+	if (template_rows != NULL)
+		g_ptr_array_free(template_rows, true);
+
+	article_rows = NULL;
+	template_rows = NULL;
+}
+
+/**
+ * Selects a page in the workspace tree view, which in turn loads it.
+ *
+ * @param  page Page to be selected.
+ * @return      TRUE if the page was found in the tree view.
+ */
+bool select_workspace_page(page_t page) {
+	GtkTreeSelection *selection;
+	GtkTreePath *path;
+	GPtrArray *rows;
+
+	// Get the row of the page.
+	rows = (page.type == PAGE_TYPE_ARTICLE) ? article_rows : template_rows;
+	if ((rows == NULL) || (page.index < 0) || ((guint)page.index >= rows->len))
+		return false;
+	path = gtk_tree_row_reference_get_path(g_ptr_array_index(rows,
+															 page.index));
+	if (path == NULL)
+		return false;
+
+	// Select it and make sure it's visible.
+	selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(treeview));
+	gtk_tree_view_expand_to_path(GTK_TREE_VIEW(treeview), path);
+	gtk_tree_selection_select_path(selection, path);
+	gtk_tree_view_scroll_to_cell(GTK_TREE_VIEW(treeview), path, NULL, false,
+								 0, 0);
+	gtk_tree_path_free(path);
+
+	return true;
+}
+
+/**
+ * Gets the names of the rows that are expanded in the workspace tree view.
+ *
+ * @return NULL-terminated array of row names. Free it with g_strfreev().
+ */
+char** workspace_expanded_rows() {
+	GtkTreeModel *model;
+	GPtrArray *names;
+
+	names = g_ptr_array_new();
+	model = gtk_tree_view_get_model(GTK_TREE_VIEW(treeview));
+	if (model != NULL)
+		workspace_collect_expanded(model, NULL, names);
+	g_ptr_array_add(names, NULL);
+
+	return (char**)g_ptr_array_free(names, false);
+}
+
+/**
+ * Expands only the rows of the workspace tree view that have certain names.
+ *
+ * @param names NULL-terminated array of the names of the rows to expand.
+ */
+void workspace_expand_rows(const char * const *names) {
+	GtkTreeModel *model;
+
+	model = gtk_tree_view_get_model(GTK_TREE_VIEW(treeview));
+	if (model == NULL)
+		return;
+
+	gtk_tree_view_collapse_all(GTK_TREE_VIEW(treeview));
+	workspace_expand_matching(model, NULL, names);
+}
+
+/**
+ * Collects the names of the expanded rows below a row of the tree view.
+ *
+ * @param model  Workspace tree model.
+ * @param parent Row to start from or NULL for the top-level rows.
+ * @param names  Array to append the names to. (Not copied)
+ */
+void workspace_collect_expanded(GtkTreeModel *model, GtkTreeIter *parent,
+								GPtrArray *names) {
+	GtkTreeIter iter;
+	bool valid;
+
+	valid = gtk_tree_model_iter_children(model, &iter, parent);
+	while (valid) {
+		GtkTreePath *path = gtk_tree_model_get_path(model, &iter);
+
+		// Only expanded rows have expanded children.
+		if (gtk_tree_view_row_expanded(GTK_TREE_VIEW(treeview), path)) {
+			const char *name;
+
+			gtk_tree_model_get(model, &iter, COL_NAME, &name, -1);
+			g_ptr_array_add(names, g_strdup(name));
+			workspace_collect_expanded(model, &iter, names);
+		}
+
+		gtk_tree_path_free(path);
+		valid = gtk_tree_model_iter_next(model, &iter);
+	}
+}
+
+/**
+ * Expands the rows below a row of the tree view that have certain names.
+ *
+ * @param model  Workspace tree model.
+ * @param parent Row to start from or NULL for the top-level rows.
+ * @param names  NULL-terminated array of the names of the rows to expand.
+ */
+void workspace_expand_matching(GtkTreeModel *model, GtkTreeIter *parent,
+							   const char * const *names) {
+	GtkTreeIter iter;
+	bool valid;
+
+	valid = gtk_tree_model_iter_children(model, &iter, parent);
+	while (valid) {
+		const char *name;
+
+		// Children can only be expanded once their parent is.
+		gtk_tree_model_get(model, &iter, COL_NAME, &name, -1);
+		if (g_strv_contains(names, name)) {
+			GtkTreePath *path = gtk_tree_model_get_path(model, &iter);
+
+			gtk_tree_view_expand_row(GTK_TREE_VIEW(treeview), path, false);
+			gtk_tree_path_free(path);
+			workspace_expand_matching(model, &iter, names);
+		}
+
+		valid = gtk_tree_model_iter_next(model, &iter);
 	}
 }
 
@@ -191,6 +435,9 @@ void treeview_clear() {
 	GtkTreeModel *model;
 	GtkTreeStore *store;
 
+	// Forget about the rows.
+	workspace_forget_rows();
+
 	// Get the tree view model.
 	model = gtk_tree_view_get_model(GTK_TREE_VIEW(treeview));
 	if (model == NULL)
@@ -207,5 +454,5 @@ void treeview_clear() {
  * @return TRUE if the workspace is opened.
  */
 bool is_workspace_opened() {
-	return workspace_opened;
+	return wiki_is_opened();
 }
@@ -10,6 +10,7 @@
 
 #include <gtk/gtk.h>
 #include <stdbool.h>
+#include "Page.h"
 
 // Row types.
 #define ROW_TYPE_TITLE    0
@@ -36,7 +37,16 @@ void close_workspace();
 bool open_workspace(const char *wiki_root);
 void reload_workspace();
 
-// TreeView Population.
+// TreeView Population and selection.
 void populate_workspace_treeview();
+void workspace_name_cell_data(GtkTreeViewColumn *column,
+							  GtkCellRenderer *renderer, GtkTreeModel *model,
+							  GtkTreeIter *iter, gpointer data);
+gboolean workspace_name_search_equal(GtkTreeModel *model, gint column,
+									 const gchar *key, GtkTreeIter *iter,
+									 gpointer data);
+bool select_workspace_page(page_t page);
+char** workspace_expanded_rows();
+void workspace_expand_rows(const char * const *names);
 
 #endif /* _WORKSPACE_H_ */
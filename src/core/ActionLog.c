@@ -0,0 +1,248 @@
+/**
+ * ActionLog.c
+ * Timestamped logs of the actions taken in the interface.
+ *
+ * Each action is a line of tab-separated fields: the time it happened in
+ * microseconds since the log was started, its name, an offset, a count, and
+ * some escaped text. Lines are flushed as they're written so that a log still
+ * holds everything up to a crash or a hang, which is usually what it's for.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include "ActionLog.h"
+
+// Names of the actions as they're written in the log.
+const char *action_type_names[NUM_ACTION_TYPES] = {
+	"select_page",
+	"insert_text",
+	"delete_text",
+	"switch_tab",
+	"find_next",
+	"save_page"
+};
+
+// Private methods.
+bool action_log_parse(const char *line, action_t *action);
+gint action_compare_samples(gconstpointer a, gconstpointer b);
+
+/**
+ * Creates a new action log and starts its clock.
+ *
+ * @param  fpath Path to the log file.
+ * @param  error Return location for a GError.
+ * @return       Action log or NULL if it couldn't be created. Close it with
+ *               action_log_close().
+ */
+action_log_t* action_log_create(const char *fpath, GError **error) {
+	action_log_t *log;
+	int err;
+
+	log = g_new0(action_log_t, 1);
+	if ((log->fh = g_fopen(fpath, "w")) == NULL) {
+		err = errno;
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(err),
+					"Failed to create the action log '%s': %s", fpath,
+					g_strerror(err));
+		g_free(log);
+
+		return NULL;
+	}
+
+	fprintf(log->fh, "%s\n", ACTION_LOG_HEADER);
+	fflush(log->fh);
+	log->epoch = g_get_monotonic_time();
+
+	return log;
+}
+
+/**
+ * Appends an action to a log.
+ *
+ * @param log    Action log.
+ * @param type   Kind of action.
+ * @param offset Where in the page it happened or what it was applied to.
+ * @param count  How much it affected or a flag for the action.
+ * @param text   Text that goes along with the action. (Optional)
+ */
+void action_log_append(action_log_t *log, action_type_t type, gint64 offset,
+					   gint64 count, const char *text) {
+	char *escaped;
+
+	escaped = g_strescape((text != NULL) ? text : "", NULL);
+	fprintf(log->fh, "%" G_GINT64_FORMAT "\t%s\t%" G_GINT64_FORMAT "\t%"
+			G_GINT64_FORMAT "\t%s\n", g_get_monotonic_time() - log->epoch,
+			action_type_names[type], offset, count, escaped);
+	fflush(log->fh);
+	g_free(escaped);
+}
+
+/**
+ * Closes an action log.
+ *
+ * @param log Action log to be closed.
+ */
+void action_log_close(action_log_t *log) {
+	if (log == NULL)
+		return;
+
+	fclose(log->fh);
+	g_free(log);
+}
+
+/**
+ * Loads every action from a log.
+ *
+ * @param  fpath Path to the log file.
+ * @param  error Return location for a GError.
+ * @return       Array of action_t in the order they happened or NULL if the
+ *               log couldn't be read. Free it with action_log_free().
+ */
+GArray* action_log_load(const char *fpath, GError **error) {
+	GArray *actions;
+	action_t action;
+	char **lines;
+	char *contents;
+	guint i;
+
+	if (!g_file_get_contents(fpath, &contents, NULL, error))
+		return NULL;
+
+	// Make sure it's one of ours.
+	lines = g_strsplit(contents, "\n", -1);
+	g_free(contents);
+	if ((lines[0] == NULL) || (strcmp(lines[0], ACTION_LOG_HEADER) != 0)) {
+		g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+					"'%s' isn't an action log.", fpath);
+		g_strfreev(lines);
+
+		return NULL;
+	}
+
+	// Parse every action in it.
+	actions = g_array_new(false, false, sizeof(action_t));
+	for (i = 1; lines[i] != NULL; i++) {
+		if (*lines[i] == '\0')
+			continue;
+
+		if (!action_log_parse(lines[i], &action)) {
+			g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+						"Invalid action in line %u of '%s'.", i + 1, fpath);
+			g_strfreev(lines);
+			action_log_free(actions);
+
+			return NULL;
+		}
+
+		g_array_append_val(actions, action);
+	}
+
+	g_strfreev(lines);
+	return actions;
+}
+
+/**
+ * Frees an array of actions loaded from a log.
+ *
+ * @param actions Array of action_t.
+ */
+void action_log_free(GArray *actions) {
+	guint i;
+
+	if (actions == NULL)
+		return;
+
+	for (i = 0; i < actions->len; i++)
+		g_free(g_array_index(actions, action_t, i).text);
+	g_array_free(actions, true);
+}
+
+/**
+ * Gets the name of a kind of action.
+ *
+ * @param  type Kind of action.
+ * @return      Name of the action as written in the logs.
+ */
+const char* action_type_name(action_type_t type) {
+	return action_type_names[type];
+}
+
+/**
+ * Gets a percentile of some samples using the nearest-rank method.
+ *
+ * @param  samples    Array of gint64 samples. (Will be sorted)
+ * @param  percentile Percentile to get, from 0 to 100.
+ * @return            Sample at the percentile or 0 if there are none.
+ */
+gint64 action_percentile(GArray *samples, guint percentile) {
+	guint rank;
+
+	if (samples->len == 0)
+		return 0;
+
+	g_array_sort(samples, action_compare_samples);
+	rank = (samples->len * percentile + 99) / 100;
+	if (rank > 0)
+		rank--;
+
+	return g_array_index(samples, gint64, MIN(rank, samples->len - 1));
+}
+
+/**
+ * Parses a line of an action log.
+ *
+ * @param  line   Line to be parsed.
+ * @param  action Action to populate. Its text must be freed with g_free().
+ * @return        TRUE if the line was a valid action.
+ */
+bool action_log_parse(const char *line, action_t *action) {
+	char **fields;
+	char *end;
+	int type;
+
+	// Split it up, making sure we've got every field.
+	fields = g_strsplit(line, "\t", 5);
+	if (g_strv_length(fields) != 5) {
+		g_strfreev(fields);
+		return false;
+	}
+
+	// Find out what the action is.
+	action->type = NUM_ACTION_TYPES;
+	for (type = 0; type < NUM_ACTION_TYPES; type++) {
+		if (strcmp(fields[1], action_type_names[type]) == 0) {
+			action->type = (action_type_t)type;
+			break;
+		}
+	}
+
+	// Get the numbers.
+	action->time = g_ascii_strtoll(fields[0], &end, 10);
+	if ((*end != '\0') || (action->type == NUM_ACTION_TYPES)) {
+		g_strfreev(fields);
+		return false;
+	}
+	action->offset = g_ascii_strtoll(fields[2], NULL, 10);
+	action->count = g_ascii_strtoll(fields[3], NULL, 10);
+	action->text = g_strcompress(fields[4]);
+
+	g_strfreev(fields);
+	return true;
+}
+
+/**
+ * Compares two samples for sorting.
+ *
+ * @param  a First sample.
+ * @param  b Second sample.
+ * @return   Negative, zero, or positive as in strcmp().
+ */
+gint action_compare_samples(gconstpointer a, gconstpointer b) {
+	gint64 x = *(const gint64*)a;
+	gint64 y = *(const gint64*)b;
+
+	return (x > y) - (x < y);
+}
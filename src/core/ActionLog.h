@@ -0,0 +1,58 @@
+/**
+ * ActionLog.h
+ * Timestamped logs of the actions taken in the interface.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _ACTIONLOG_H_
+#define _ACTIONLOG_H_
+
+#include <stdio.h>
+#include <glib.h>
+#include <stdbool.h>
+
+// First line of every action log.
+#define ACTION_LOG_HEADER "# gUki action log v1"
+
+// Kinds of actions.
+typedef enum {
+	ACTION_SELECT_PAGE = 0,
+	ACTION_INSERT_TEXT,
+	ACTION_DELETE_TEXT,
+	ACTION_SWITCH_TAB,
+	ACTION_FIND_NEXT,
+	ACTION_SAVE_PAGE,
+	NUM_ACTION_TYPES
+} action_type_t;
+
+// Action taken by the user.
+typedef struct {
+	action_type_t type;
+	gint64 time;
+	gint64 offset;
+	gint64 count;
+	char *text;
+} action_t;
+
+// Log that's being recorded.
+typedef struct {
+	FILE *fh;
+	gint64 epoch;
+} action_log_t;
+
+// Recording.
+action_log_t* action_log_create(const char *fpath, GError **error);
+void action_log_append(action_log_t *log, action_type_t type, gint64 offset,
+					   gint64 count, const char *text);
+void action_log_close(action_log_t *log);
+
+// Loading.
+GArray* action_log_load(const char *fpath, GError **error);
+void action_log_free(GArray *actions);
+
+// Information.
+const char* action_type_name(action_type_t type);
+gint64 action_percentile(GArray *samples, guint percentile);
+
+#endif /* _ACTIONLOG_H_ */
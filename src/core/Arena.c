@@ -0,0 +1,202 @@
+/**
+ * Arena.c
+ * Region allocator for the temporary data of a single operation.
+ *
+ * Allocations are carved out of large blocks by bumping a pointer and are
+ * never freed individually. Once the operation is over the whole arena is
+ * reset in constant time and its blocks are reused by the next operation, so
+ * a long session doesn't keep fragmenting the heap with short-lived strings
+ * and file buffers. Arenas aren't thread-safe, each thread needs its own.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include <string.h>
+#include "Arena.h"
+#include "Stats.h"
+
+// Every allocation is aligned to this.
+#define ARENA_ALIGN (2 * sizeof(gpointer))
+
+// Block of memory owned by an arena.
+typedef struct _arena_chunk_t {
+	struct _arena_chunk_t *next;
+	gsize size;
+	gsize used;
+	char data[];
+} arena_chunk_t;
+
+// Region allocator.
+struct _arena_t {
+	arena_chunk_t *first;
+	arena_chunk_t *current;
+	gsize chunk_size;
+	gsize allocs;
+	gsize bytes;
+};
+
+// Private variables.
+gssize arena_total_reserved = 0;
+
+// Private methods.
+arena_chunk_t* arena_chunk_new(gsize size);
+void arena_flush_stats(arena_t *arena);
+
+/**
+ * Creates a new arena.
+ *
+ * @param  chunk_size Size of each block or 0 for the default.
+ * @return            Newly allocated arena. Free it with arena_free().
+ */
+arena_t* arena_new(gsize chunk_size) {
+	arena_t *arena = g_new0(arena_t, 1);
+
+	arena->chunk_size = (chunk_size > 0) ? chunk_size : ARENA_CHUNK_SIZE;
+	arena->first = arena_chunk_new(arena->chunk_size);
+	arena->current = arena->first;
+
+	return arena;
+}
+
+/**
+ * Frees an arena and everything allocated from it.
+ *
+ * @param arena Arena to be freed. (May be NULL)
+ */
+void arena_free(arena_t *arena) {
+	arena_chunk_t *chunk;
+
+	if (arena == NULL)
+		return;
+
+	arena_flush_stats(arena);
+	while ((chunk = arena->first) != NULL) {
+		arena->first = chunk->next;
+		g_atomic_pointer_add(&arena_total_reserved, -(gssize)chunk->size);
+		g_free(chunk);
+	}
+
+	g_free(arena);
+}
+
+/**
+ * Releases everything allocated from an arena at once, keeping its blocks
+ * around to be reused.
+ *
+ * @param arena Arena to be reset.
+ */
+void arena_reset(arena_t *arena) {
+	arena_flush_stats(arena);
+	stats_count(STAT_ARENA_RESETS);
+
+	// Blocks further down the list are emptied as we get to them.
+	arena->current = arena->first;
+	arena->current->used = 0;
+}
+
+/**
+ * Allocates memory from an arena.
+ *
+ * @param  arena Arena to allocate from.
+ * @param  size  Number of bytes to allocate.
+ * @return       Memory that lives until the arena is reset or freed.
+ */
+gpointer arena_alloc(arena_t *arena, gsize size) {
+	arena_chunk_t *chunk = arena->current;
+	gpointer mem;
+
+	size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+	// Move on to the next block when this one is full.
+	if ((chunk->size - chunk->used) < size) {
+		if ((chunk->next != NULL) && (chunk->next->size >= size)) {
+			chunk = chunk->next;
+		} else {
+			arena_chunk_t *fresh;
+
+			// Make room right after the current one. (Big requests get a
+			// block of their own)
+			fresh = arena_chunk_new(MAX(arena->chunk_size, size));
+			fresh->next = chunk->next;
+			chunk->next = fresh;
+			chunk = fresh;
+		}
+
+		chunk->used = 0;
+		arena->current = chunk;
+	}
+
+	// Bump the pointer.
+	mem = chunk->data + chunk->used;
+	chunk->used += size;
+	arena->allocs++;
+	arena->bytes += size;
+
+	return mem;
+}
+
+/**
+ * Duplicates a string into an arena.
+ *
+ * @param  arena Arena to allocate from.
+ * @param  str   String to be duplicated.
+ * @return       Copy of the string owned by the arena.
+ */
+char* arena_strdup(arena_t *arena, const char *str) {
+	return arena_strndup(arena, str, strlen(str));
+}
+
+/**
+ * Duplicates the beginning of a string into an arena.
+ *
+ * @param  arena  Arena to allocate from.
+ * @param  str    String to be duplicated.
+ * @param  length Number of bytes to duplicate.
+ * @return        NUL-terminated copy of the string owned by the arena.
+ */
+char* arena_strndup(arena_t *arena, const char *str, gsize length) {
+	char *dup = arena_alloc(arena, length + 1);
+
+	memcpy(dup, str, length);
+	dup[length] = '\0';
+
+	return dup;
+}
+
+/**
+ * Gets the memory reserved by every arena in the application.
+ *
+ * @return Reserved bytes.
+ */
+gsize arena_reserved() {
+	return (gsize)g_atomic_pointer_get(&arena_total_reserved);
+}
+
+/**
+ * Creates a new block of memory.
+ *
+ * @param  size Usable size of the block.
+ * @return      Empty block.
+ */
+arena_chunk_t* arena_chunk_new(gsize size) {
+	arena_chunk_t *chunk = g_malloc(sizeof(arena_chunk_t) + size);
+
+	chunk->next = NULL;
+	chunk->size = size;
+	chunk->used = 0;
+	g_atomic_pointer_add(&arena_total_reserved, (gssize)size);
+
+	return chunk;
+}
+
+/**
+ * Reports the allocations of an arena to the runtime statistics.
+ *
+ * @param arena Arena that has been used.
+ */
+void arena_flush_stats(arena_t *arena) {
+	stats_add(STAT_ARENA_ALLOCS, arena->allocs);
+	stats_add(STAT_ARENA_BYTES, arena->bytes);
+	arena->allocs = 0;
+	arena->bytes = 0;
+}
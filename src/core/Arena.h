@@ -0,0 +1,32 @@
+/**
+ * Arena.h
+ * Region allocator for the temporary data of a single operation.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <glib.h>
+
+// Default size of the blocks of an arena.
+#define ARENA_CHUNK_SIZE (64 * 1024)
+
+// Opaque region allocator.
+typedef struct _arena_t arena_t;
+
+// Construction and destruction.
+arena_t* arena_new(gsize chunk_size);
+void arena_free(arena_t *arena);
+void arena_reset(arena_t *arena);
+
+// Allocation.
+gpointer arena_alloc(arena_t *arena, gsize size);
+char* arena_strdup(arena_t *arena, const char *str);
+char* arena_strndup(arena_t *arena, const char *str, gsize length);
+
+// Information.
+gsize arena_reserved();
+
+#endif /* _ARENA_H_ */
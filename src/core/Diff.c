@@ -0,0 +1,593 @@
+/**
+ * Diff.c
+ * Line-based comparison of two versions of a page.
+ *
+ * Lines are first mapped to integers, so that comparing two of them is a
+ * single instruction, and the common lines at both ends are skipped. What's
+ * left is compared with Myers' linear space algorithm, which keeps finding the
+ * middle of the shortest edit script and recursing on both halves of it. When
+ * the two versions are so different that finding the exact middle gets too
+ * expensive the search settles for the best split found so far, like GNU diff
+ * does, so a 100k line page that was completely rewritten still compares in a
+ * fraction of a second, just with a slightly longer script.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include <string.h>
+#include "Diff.h"
+#include "Page.h"
+#include "Stats.h"
+#include "Trace.h"
+
+// Minimum number of edits the middle snake search goes through before giving
+// up on finding the optimal one.
+#define DIFF_MIN_COST 1024
+
+// Line used as a hash table key.
+typedef struct {
+	const char *str;
+	gsize length;
+} diff_key_t;
+
+// State of a comparison.
+typedef struct {
+	const guint *a;
+	const guint *b;
+	gssize *fdiag;
+	gssize *bdiag;
+	gssize too_expensive;
+	guint8 *old_changed;
+	guint8 *new_changed;
+	GCancellable *cancellable;
+} diff_context_t;
+
+// Private methods.
+GArray* diff_split_lines(const char *text, gsize length);
+guint* diff_line_ids(GHashTable *ids, const char *text, GArray *lines,
+					 diff_key_t *keys);
+void diff_compareseq(diff_context_t *ctx, gssize xoff, gssize xlim,
+					 gssize yoff, gssize ylim);
+void diff_middle_snake(diff_context_t *ctx, gssize xoff, gssize xlim,
+					   gssize yoff, gssize ylim, gssize *xmid, gssize *ymid);
+void diff_build_hunks(diff_t *diff, const guint8 *old_changed,
+					  const guint8 *new_changed);
+void diff_worker(GTask *task, gpointer source, gpointer task_data,
+				 GCancellable *cancellable);
+guint diff_key_hash(gconstpointer key);
+gboolean diff_key_equal(gconstpointer a, gconstpointer b);
+
+/**
+ * Creates a comparison between two versions of some text.
+ *
+ * @param  old_text   Old version. (Taken over by the diff)
+ * @param  old_length Length of the old version.
+ * @param  new_text   New version. (Taken over by the diff)
+ * @param  new_length Length of the new version.
+ * @return            Diff ready to be computed. Free it with diff_free().
+ */
+diff_t* diff_new(char *old_text, gsize old_length, char *new_text,
+				 gsize new_length) {
+	diff_t *diff;
+
+	diff = g_new0(diff_t, 1);
+	diff->old_text = old_text;
+	diff->new_text = new_text;
+	diff->old_lines = diff_split_lines(old_text, old_length);
+	diff->new_lines = diff_split_lines(new_text, new_length);
+	diff->hunks = g_array_new(false, false, sizeof(diff_hunk_t));
+
+	return diff;
+}
+
+/**
+ * Frees a diff.
+ *
+ * @param diff Diff to be freed. (May be NULL)
+ */
+void diff_free(diff_t *diff) {
+	if (diff == NULL)
+		return;
+
+	g_free(diff->old_text);
+	g_free(diff->new_text);
+	g_array_free(diff->old_lines, true);
+	g_array_free(diff->new_lines, true);
+	g_array_free(diff->hunks, true);
+	g_free(diff);
+}
+
+/**
+ * Compares the two versions, populating the hunks of the diff.
+ *
+ * @param  diff        Diff to be computed.
+ * @param  cancellable Cancels the comparison. (May be NULL)
+ * @param  error       Return location for a GError.
+ * @return             TRUE if the operation was successful.
+ */
+bool diff_compute(diff_t *diff, GCancellable *cancellable, GError **error) {
+	diff_context_t ctx;
+	GHashTable *ids;
+	diff_key_t *old_keys;
+	diff_key_t *new_keys;
+	guint *a;
+	guint *b;
+	gsize diags;
+	gssize n;
+	gssize m;
+	gint64 start;
+	bool success;
+
+	TRACE_BEGIN("diff_compute");
+	start = g_get_monotonic_time();
+	n = diff_line_count(diff, false);
+	m = diff_line_count(diff, true);
+
+	// Give every distinct line a number.
+	ids = g_hash_table_new(diff_key_hash, diff_key_equal);
+	old_keys = g_new(diff_key_t, n + 1);
+	new_keys = g_new(diff_key_t, m + 1);
+	a = diff_line_ids(ids, diff->old_text, diff->old_lines, old_keys);
+	b = diff_line_ids(ids, diff->new_text, diff->new_lines, new_keys);
+	g_hash_table_destroy(ids);
+	g_free(old_keys);
+	g_free(new_keys);
+
+	// Setup the comparison. Diagonals go from -(m + 1) to (n + 1).
+	ctx.a = a;
+	ctx.b = b;
+	ctx.fdiag = g_new(gssize, n + m + 3);
+	ctx.bdiag = g_new(gssize, n + m + 3);
+	ctx.fdiag += m + 1;
+	ctx.bdiag += m + 1;
+	ctx.old_changed = g_new0(guint8, n + 1);
+	ctx.new_changed = g_new0(guint8, m + 1);
+	ctx.cancellable = cancellable;
+	ctx.too_expensive = 1;
+	for (diags = n + m + 3; diags != 0; diags >>= 2)
+		ctx.too_expensive <<= 1;
+	ctx.too_expensive = MAX(DIFF_MIN_COST, ctx.too_expensive);
+
+	// Compare them and group the changes.
+	diff_compareseq(&ctx, 0, n, 0, m);
+	success = !g_cancellable_set_error_if_cancelled(cancellable, error);
+	if (success)
+		diff_build_hunks(diff, ctx.old_changed, ctx.new_changed);
+
+	g_free(ctx.fdiag - (m + 1));
+	g_free(ctx.bdiag - (m + 1));
+	g_free(ctx.old_changed);
+	g_free(ctx.new_changed);
+	g_free(a);
+	g_free(b);
+	stats_record(STAT_DIFF_TIME, g_get_monotonic_time() - start);
+	TRACE_END("diff_compute");
+
+	return success;
+}
+
+/**
+ * Compares the two versions in a worker thread.
+ *
+ * @param diff        Diff to be computed. (Taken over by the task)
+ * @param cancellable Cancels the comparison. (May be NULL)
+ * @param callback    Called on the main loop once the diff is done.
+ * @param data        Data to be passed to the callback.
+ */
+void diff_compute_async(diff_t *diff, GCancellable *cancellable,
+						GAsyncReadyCallback callback, gpointer data) {
+	GTask *task;
+
+	task = g_task_new(NULL, cancellable, callback, data);
+	g_task_set_task_data(task, diff, NULL);
+	g_task_run_in_thread(task, diff_worker);
+	g_object_unref(task);
+}
+
+/**
+ * Gets the result of a comparison made in a worker thread.
+ *
+ * @param  result Result passed to the callback.
+ * @param  error  Return location for a GError.
+ * @return        Computed diff or NULL if it failed or was cancelled. Free it
+ *                with diff_free().
+ */
+diff_t* diff_compute_finish(GAsyncResult *result, GError **error) {
+	return g_task_propagate_pointer(G_TASK(result), error);
+}
+
+/**
+ * Gets the number of lines in one of the versions.
+ *
+ * @param  diff     Diff.
+ * @param  new_side Get it from the new version? Otherwise the old one.
+ * @return          Number of lines.
+ */
+guint diff_line_count(const diff_t *diff, bool new_side) {
+	return ((new_side) ? diff->new_lines : diff->old_lines)->len - 1;
+}
+
+/**
+ * Gets a line from one of the versions.
+ *
+ * @param  diff     Diff.
+ * @param  new_side Get it from the new version? Otherwise the old one.
+ * @param  line     Index of the line.
+ * @param  length   Pointer to store the length of the line, without its line
+ *                  break.
+ * @return          Pointer to the start of the line. (Not NULL-terminated)
+ */
+const char* diff_line(const diff_t *diff, bool new_side, guint line,
+					  gsize *length) {
+	GArray *lines = (new_side) ? diff->new_lines : diff->old_lines;
+	const char *text = (new_side) ? diff->new_text : diff->old_text;
+	gsize start = g_array_index(lines, gsize, line);
+	gsize stop = g_array_index(lines, gsize, line + 1);
+
+	if ((stop > start) && (text[stop - 1] == '\n'))
+		stop--;
+
+	*length = stop - start;
+	return text + start;
+}
+
+/**
+ * Finds where each line of some text starts.
+ *
+ * @param  text   Text to be split.
+ * @param  length Length of the text.
+ * @return        Offsets of the start of each line followed by the length of
+ *                the text.
+ */
+GArray* diff_split_lines(const char *text, gsize length) {
+	GArray *lines;
+	const char *pos = text;
+	const char *end = text + length;
+	gsize offset = 0;
+
+	lines = g_array_new(false, false, sizeof(gsize));
+	g_array_append_val(lines, offset);
+	while ((pos < end) && ((pos = memchr(pos, '\n', end - pos)) != NULL)) {
+		offset = ++pos - text;
+		g_array_append_val(lines, offset);
+	}
+
+	// Account for a last line without a line break.
+	if (g_array_index(lines, gsize, lines->len - 1) != length)
+		g_array_append_val(lines, length);
+
+	return lines;
+}
+
+/**
+ * Maps each line of some text to a number that's shared by equal lines.
+ *
+ * @param  ids   Table of the numbers given so far.
+ * @param  text  Text the lines belong to.
+ * @param  lines Offsets of the lines.
+ * @param  keys  Storage for the keys of the table, one per line.
+ * @return       Number of each line. Free it with g_free().
+ */
+guint* diff_line_ids(GHashTable *ids, const char *text, GArray *lines,
+					 diff_key_t *keys) {
+	guint *numbers;
+	guint i;
+
+	numbers = g_new(guint, lines->len);
+	for (i = 0; i + 1 < lines->len; i++) {
+		gpointer id;
+
+		keys[i].str = text + g_array_index(lines, gsize, i);
+		keys[i].length = g_array_index(lines, gsize, i + 1) -
+			g_array_index(lines, gsize, i);
+
+		if ((id = g_hash_table_lookup(ids, &keys[i])) == NULL) {
+			id = GUINT_TO_POINTER(g_hash_table_size(ids) + 1);
+			g_hash_table_insert(ids, &keys[i], id);
+		}
+		numbers[i] = GPOINTER_TO_UINT(id);
+	}
+
+	return numbers;
+}
+
+/**
+ * Compares a range of lines of both versions, marking the ones that changed.
+ *
+ * @param ctx  Comparison state.
+ * @param xoff Start of the range in the old version.
+ * @param xlim End of the range in the old version.
+ * @param yoff Start of the range in the new version.
+ * @param ylim End of the range in the new version.
+ */
+void diff_compareseq(diff_context_t *ctx, gssize xoff, gssize xlim,
+					 gssize yoff, gssize ylim) {
+	const guint *a = ctx->a;
+	const guint *b = ctx->b;
+
+	for (;;) {
+		gssize xmid;
+		gssize ymid;
+
+		if (g_cancellable_is_cancelled(ctx->cancellable))
+			return;
+
+		// Skip the lines that are the same at both ends.
+		while ((xoff < xlim) && (yoff < ylim) && (a[xoff] == b[yoff])) {
+			xoff++;
+			yoff++;
+		}
+		while ((xlim > xoff) && (ylim > yoff) &&
+				(a[xlim - 1] == b[ylim - 1])) {
+			xlim--;
+			ylim--;
+		}
+
+		// Only insertions or deletions left.
+		if (xoff == xlim) {
+			memset(ctx->new_changed + yoff, true, ylim - yoff);
+			return;
+		} else if (yoff == ylim) {
+			memset(ctx->old_changed + xoff, true, xlim - xoff);
+			return;
+		}
+
+		// Split it in the middle of the edit script.
+		diff_middle_snake(ctx, xoff, xlim, yoff, ylim, &xmid, &ymid);
+		if (((xmid == xoff) && (ymid == yoff)) ||
+				((xmid == xlim) && (ymid == ylim))) {
+			memset(ctx->old_changed + xoff, true, xlim - xoff);
+			memset(ctx->new_changed + yoff, true, ylim - yoff);
+			return;
+		}
+
+		// Recurse on the first half and carry on with the second one.
+		diff_compareseq(ctx, xoff, xmid, yoff, ymid);
+		xoff = xmid;
+		yoff = ymid;
+	}
+}
+
+/**
+ * Finds the middle of the shortest edit script of a range, or a good enough
+ * approximation of it if that's too expensive.
+ *
+ * @param ctx  Comparison state.
+ * @param xoff Start of the range in the old version.
+ * @param xlim End of the range in the old version.
+ * @param yoff Start of the range in the new version.
+ * @param ylim End of the range in the new version.
+ * @param xmid Pointer to store where to split the old version.
+ * @param ymid Pointer to store where to split the new version.
+ */
+void diff_middle_snake(diff_context_t *ctx, gssize xoff, gssize xlim,
+					   gssize yoff, gssize ylim, gssize *xmid, gssize *ymid) {
+	const guint *a = ctx->a;
+	const guint *b = ctx->b;
+	gssize *fd = ctx->fdiag;
+	gssize *bd = ctx->bdiag;
+	gssize dmin = xoff - ylim;
+	gssize dmax = xlim - yoff;
+	gssize fmid = xoff - yoff;
+	gssize bmid = xlim - ylim;
+	gssize fmin = fmid;
+	gssize fmax = fmid;
+	gssize bmin = bmid;
+	gssize bmax = bmid;
+	bool odd = (fmid - bmid) & 1;
+	gssize c;
+	gssize d;
+
+	fd[fmid] = xoff;
+	bd[bmid] = xlim;
+	for (c = 1;; c++) {
+		gssize x;
+		gssize y;
+
+		// Extend the forward search by one edit.
+		if (fmin > dmin)
+			fd[--fmin - 1] = -1;
+		else
+			fmin++;
+		if (fmax < dmax)
+			fd[++fmax + 1] = -1;
+		else
+			fmax--;
+		for (d = fmax; d >= fmin; d -= 2) {
+			gssize tlo = fd[d - 1];
+			gssize thi = fd[d + 1];
+
+			x = (tlo >= thi) ? tlo + 1 : thi;
+			y = x - d;
+			while ((x < xlim) && (y < ylim) && (a[x] == b[y])) {
+				x++;
+				y++;
+			}
+			fd[d] = x;
+
+			if (odd && (bmin <= d) && (d <= bmax) && (bd[d] <= x)) {
+				*xmid = x;
+				*ymid = y;
+				return;
+			}
+		}
+
+		// Extend the backward search by one edit.
+		if (bmin > dmin)
+			bd[--bmin - 1] = G_MAXSSIZE;
+		else
+			bmin++;
+		if (bmax < dmax)
+			bd[++bmax + 1] = G_MAXSSIZE;
+		else
+			bmax--;
+		for (d = bmax; d >= bmin; d -= 2) {
+			gssize tlo = bd[d - 1];
+			gssize thi = bd[d + 1];
+
+			x = (tlo < thi) ? tlo : thi - 1;
+			y = x - d;
+			while ((x > xoff) && (y > yoff) && (a[x - 1] == b[y - 1])) {
+				x--;
+				y--;
+			}
+			bd[d] = x;
+
+			if (!odd && (fmin <= d) && (d <= fmax) && (x <= fd[d])) {
+				*xmid = x;
+				*ymid = y;
+				return;
+			}
+		}
+
+		// Settle for the furthest point either search got to.
+		if ((c >= ctx->too_expensive) ||
+				g_cancellable_is_cancelled(ctx->cancellable)) {
+			gssize fxybest = -1;
+			gssize fxbest = xoff;
+			gssize bxybest = G_MAXSSIZE;
+			gssize bxbest = xlim;
+
+			for (d = fmax; d >= fmin; d -= 2) {
+				x = MIN(fd[d], xlim);
+				y = x - d;
+				if (ylim < y) {
+					x = ylim + d;
+					y = ylim;
+				}
+				if (fxybest < x + y) {
+					fxybest = x + y;
+					fxbest = x;
+				}
+			}
+			for (d = bmax; d >= bmin; d -= 2) {
+				x = MAX(xoff, bd[d]);
+				y = x - d;
+				if (y < yoff) {
+					x = yoff + d;
+					y = yoff;
+				}
+				if (x + y < bxybest) {
+					bxybest = x + y;
+					bxbest = x;
+				}
+			}
+
+			if ((xlim + ylim) - bxybest < fxybest - (xoff + yoff)) {
+				*xmid = fxbest;
+				*ymid = fxybest - fxbest;
+			} else {
+				*xmid = bxbest;
+				*ymid = bxybest - bxbest;
+			}
+
+			return;
+		}
+	}
+}
+
+/**
+ * Groups the lines that changed into hunks.
+ *
+ * @param diff        Diff to be populated.
+ * @param old_changed Lines of the old version that were removed.
+ * @param new_changed Lines of the new version that were added.
+ */
+void diff_build_hunks(diff_t *diff, const guint8 *old_changed,
+					  const guint8 *new_changed) {
+	guint n = diff_line_count(diff, false);
+	guint m = diff_line_count(diff, true);
+	guint i = 0;
+	guint j = 0;
+
+	g_array_set_size(diff->hunks, 0);
+	diff->removed = 0;
+	diff->added = 0;
+	while ((i < n) || (j < m)) {
+		diff_hunk_t hunk;
+
+		hunk.old_start = i;
+		hunk.new_start = j;
+		if ((i < n) && (j < m) && !old_changed[i] && !new_changed[j]) {
+			// Lines that are the same in both.
+			while ((i < n) && (j < m) && !old_changed[i] && !new_changed[j]) {
+				i++;
+				j++;
+			}
+			hunk.op = DIFF_EQUAL;
+		} else {
+			// Lines that were removed and/or added.
+			while ((i < n) && old_changed[i])
+				i++;
+			while ((j < m) && new_changed[j])
+				j++;
+
+			if (i == hunk.old_start) {
+				hunk.op = DIFF_INSERT;
+			} else if (j == hunk.new_start) {
+				hunk.op = DIFF_DELETE;
+			} else {
+				hunk.op = DIFF_REPLACE;
+			}
+		}
+
+		hunk.old_count = i - hunk.old_start;
+		hunk.new_count = j - hunk.new_start;
+		if (hunk.op != DIFF_EQUAL) {
+			diff->removed += hunk.old_count;
+			diff->added += hunk.new_count;
+		}
+		g_array_append_val(diff->hunks, hunk);
+	}
+}
+
+/**
+ * Worker that computes a diff.
+ *
+ * @param task        Task being run.
+ * @param source      Unused.
+ * @param task_data   Diff to be computed.
+ * @param cancellable Cancels the comparison.
+ */
+void diff_worker(GTask *task, gpointer source, gpointer task_data,
+				 GCancellable *cancellable) {
+	diff_t *diff = (diff_t*)task_data;
+	GError *error = NULL;
+
+	if (!diff_compute(diff, cancellable, &error)) {
+		diff_free(diff);
+		g_task_return_error(task, error);
+
+		return;
+	}
+
+	g_task_return_pointer(task, diff, (GDestroyNotify)diff_free);
+}
+
+/**
+ * Hashes a line.
+ *
+ * @param  key Line to be hashed.
+ * @return     Hash of the line.
+ */
+guint diff_key_hash(gconstpointer key) {
+	const diff_key_t *line = (const diff_key_t*)key;
+	guint64 hash = page_content_hash(line->str, line->length);
+
+	return (guint)(hash ^ (hash >> 32));
+}
+
+/**
+ * Checks if two lines are the same.
+ *
+ * @param  a First line.
+ * @param  b Second line.
+ * @return   TRUE if they are equal.
+ */
+gboolean diff_key_equal(gconstpointer a, gconstpointer b) {
+	const diff_key_t *la = (const diff_key_t*)a;
+	const diff_key_t *lb = (const diff_key_t*)b;
+
+	return (la->length == lb->length) &&
+		(memcmp(la->str, lb->str, la->length) == 0);
+}
@@ -0,0 +1,58 @@
+/**
+ * Diff.h
+ * Line-based comparison of two versions of a page.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _DIFF_H_
+#define _DIFF_H_
+
+#include <gio/gio.h>
+#include <stdbool.h>
+
+// Kinds of hunks.
+typedef enum {
+	DIFF_EQUAL = 0,
+	DIFF_DELETE,
+	DIFF_INSERT,
+	DIFF_REPLACE
+} diff_op_t;
+
+// Run of lines that are either the same or changed between the versions.
+typedef struct {
+	diff_op_t op;
+	guint old_start;
+	guint old_count;
+	guint new_start;
+	guint new_count;
+} diff_hunk_t;
+
+// Comparison between an old and a new version of some text.
+typedef struct {
+	char *old_text;
+	char *new_text;
+	GArray *old_lines;
+	GArray *new_lines;
+	GArray *hunks;
+	guint removed;
+	guint added;
+} diff_t;
+
+// Construction and destruction.
+diff_t* diff_new(char *old_text, gsize old_length, char *new_text,
+				 gsize new_length);
+void diff_free(diff_t *diff);
+
+// Comparison.
+bool diff_compute(diff_t *diff, GCancellable *cancellable, GError **error);
+void diff_compute_async(diff_t *diff, GCancellable *cancellable,
+						GAsyncReadyCallback callback, gpointer data);
+diff_t* diff_compute_finish(GAsyncResult *result, GError **error);
+
+// Lines.
+guint diff_line_count(const diff_t *diff, bool new_side);
+const char* diff_line(const diff_t *diff, bool new_side, guint line,
+					  gsize *length);
+
+#endif /* _DIFF_H_ */
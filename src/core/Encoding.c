@@ -0,0 +1,349 @@
+/**
+ * Encoding.c
+ * Validation and conversion of the character encoding of pages.
+ *
+ * Nearly every page is already UTF-8, so validating it has to cost next to
+ * nothing. Plain ASCII is skipped eight bytes at a time by checking a whole
+ * word for high bits and NUL bytes at once, and only the bytes of multibyte
+ * sequences are looked at one by one. Pages that aren't valid UTF-8 are taken
+ * as Windows-1252 or Latin-1 and converted in blocks through GIConv.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include <errno.h>
+#include <string.h>
+#include "Encoding.h"
+#include "Stats.h"
+#include "Trace.h"
+
+// Constants.
+#define ENCODING_ONES  G_GUINT64_CONSTANT(0x0101010101010101)
+#define ENCODING_HIGHS G_GUINT64_CONSTANT(0x8080808080808080)
+#define ENCODING_BOM   "\xEF\xBB\xBF"
+
+// Private methods.
+char* encoding_iconv(const char *text, gsize length, const char *to,
+					 const char *from, gsize *converted_length,
+					 GError **error);
+
+/**
+ * Checks if some text is valid UTF-8 that can be placed in a text buffer,
+ * which means it also can't have NUL bytes.
+ *
+ * @param  text   Text to be checked.
+ * @param  length Length of the text.
+ * @return        TRUE if the text is valid.
+ */
+bool encoding_validate_utf8(const char *text, gsize length) {
+	const guchar *pos = (const guchar*)text;
+	const guchar *end = pos + length;
+	guint64 word;
+	guchar lo;
+	guchar hi;
+	guint need;
+	guint i;
+
+	while (pos < end) {
+		// Skip through plain ASCII a word at a time.
+		if (end - pos >= 8) {
+			memcpy(&word, pos, sizeof(word));
+			if (((word | ((word - ENCODING_ONES) & ~word)) &
+					ENCODING_HIGHS) == 0) {
+				pos += 8;
+				continue;
+			}
+		}
+
+		// Something in here needs a closer look.
+		if (*pos == 0) {
+			return false;
+		} else if (*pos < 0x80) {
+			pos++;
+			continue;
+		}
+
+		// Get the length of the sequence, rejecting overlong ones.
+		if ((*pos >= 0xC2) && (*pos <= 0xDF)) {
+			need = 2;
+		} else if ((*pos >= 0xE0) && (*pos <= 0xEF)) {
+			need = 3;
+		} else if ((*pos >= 0xF0) && (*pos <= 0xF4)) {
+			need = 4;
+		} else {
+			return false;
+		}
+		if ((gsize)(end - pos) < need)
+			return false;
+
+		// Keep it out of surrogates and past the last code point.
+		lo = 0x80;
+		hi = 0xBF;
+		if (*pos == 0xE0) {
+			lo = 0xA0;
+		} else if (*pos == 0xED) {
+			hi = 0x9F;
+		} else if (*pos == 0xF0) {
+			lo = 0x90;
+		} else if (*pos == 0xF4) {
+			hi = 0x8F;
+		}
+		if ((pos[1] < lo) || (pos[1] > hi))
+			return false;
+
+		for (i = 2; i < need; i++) {
+			if ((pos[i] < 0x80) || (pos[i] > 0xBF))
+				return false;
+		}
+
+		pos += need;
+	}
+
+	return true;
+}
+
+/**
+ * Guesses the encoding of some text.
+ *
+ * @param  text   Text to be checked.
+ * @param  length Length of the text.
+ * @return        Most likely encoding of the text.
+ */
+encoding_t encoding_detect(const char *text, gsize length) {
+	const guchar *pos = (const guchar*)text;
+	const guchar *end = pos + length;
+	bool c1 = false;
+
+	// Check for UTF-8, with or without a byte order mark.
+	if ((length >= 3) && (memcmp(text, ENCODING_BOM, 3) == 0) &&
+			encoding_validate_utf8(text + 3, length - 3)) {
+		return ENCODING_UTF8_BOM;
+	} else if (encoding_validate_utf8(text, length)) {
+		return ENCODING_UTF8;
+	}
+
+	// Windows-1252 fills most of the C1 control range with characters, so a
+	// byte in there that's undefined in it must be Latin-1.
+	for (; pos < end; pos++) {
+		if ((*pos >= 0x80) && (*pos <= 0x9F)) {
+			if ((*pos == 0x81) || (*pos == 0x8D) || (*pos == 0x8F) ||
+					(*pos == 0x90) || (*pos == 0x9D)) {
+				return ENCODING_LATIN1;
+			}
+
+			c1 = true;
+		}
+	}
+
+	return (c1) ? ENCODING_WINDOWS_1252 : ENCODING_LATIN1;
+}
+
+/**
+ * Gets the name of an encoding.
+ *
+ * @param  encoding Encoding.
+ * @return          Name of the encoding as known by iconv.
+ */
+const char* encoding_name(encoding_t encoding) {
+	switch (encoding) {
+		case ENCODING_WINDOWS_1252:
+			return "WINDOWS-1252";
+		case ENCODING_LATIN1:
+			return "ISO-8859-1";
+		default:
+			return "UTF-8";
+	}
+}
+
+/**
+ * Makes sure the contents of a page are UTF-8, converting them if needed.
+ *
+ * @param  contents       Contents of the page. (Ownership is taken)
+ * @param  length         Length of the contents.
+ * @param  encoding       Pointer to store the encoding the contents were in.
+ *                        (Optional)
+ * @param  decoded_length Pointer to store the length of the decoded contents.
+ * @param  error          Return location for a GError.
+ * @return                NUL-terminated UTF-8 contents, which may be the ones
+ *                        passed, or NULL if they couldn't be converted. Free
+ *                        it with g_free().
+ */
+char* encoding_decode(char *contents, gsize length, encoding_t *encoding,
+					  gsize *decoded_length, GError **error) {
+	encoding_t detected;
+	char *decoded;
+
+	// The usual case costs a single pass over the contents.
+	TRACE_BEGIN("encoding_decode");
+	detected = encoding_detect(contents, length);
+	if (encoding != NULL)
+		*encoding = detected;
+
+	switch (detected) {
+		case ENCODING_UTF8:
+			*decoded_length = length;
+			decoded = contents;
+			break;
+		case ENCODING_UTF8_BOM:
+			*decoded_length = length - 3;
+			memmove(contents, contents + 3, length - 3);
+			contents[length - 3] = '\0';
+			decoded = contents;
+			break;
+		default:
+			decoded = encoding_iconv(contents, length, "UTF-8",
+									 encoding_name(detected), decoded_length,
+									 error);
+			g_free(contents);
+			stats_count(STAT_ENCODING_CONVERSIONS);
+			break;
+	}
+
+	TRACE_END("encoding_decode");
+	return decoded;
+}
+
+/**
+ * Makes sure the contents of a page that live in an arena are UTF-8,
+ * converting them into the same arena if needed.
+ *
+ * @param  contents       Contents of the page. (Owned by the arena)
+ * @param  length         Length of the contents.
+ * @param  arena          Arena that owns the contents.
+ * @param  decoded_length Pointer to store the length of the decoded contents.
+ * @param  error          Return location for a GError.
+ * @return                NUL-terminated UTF-8 contents owned by the arena,
+ *                        which may be the ones passed, or NULL if they
+ *                        couldn't be converted.
+ */
+char* encoding_decode_arena(char *contents, gsize length, arena_t *arena,
+							gsize *decoded_length, GError **error) {
+	encoding_t detected;
+	char *converted;
+	char *decoded;
+
+	TRACE_BEGIN("encoding_decode");
+	detected = encoding_detect(contents, length);
+	switch (detected) {
+		case ENCODING_UTF8:
+			*decoded_length = length;
+			decoded = contents;
+			break;
+		case ENCODING_UTF8_BOM:
+			// The arena doesn't mind us skipping over the mark.
+			*decoded_length = length - 3;
+			decoded = contents + 3;
+			break;
+		default:
+			decoded = NULL;
+			converted = encoding_iconv(contents, length, "UTF-8",
+									   encoding_name(detected),
+									   decoded_length, error);
+			if (converted != NULL) {
+				decoded = arena_strndup(arena, converted, *decoded_length);
+				g_free(converted);
+			}
+			stats_count(STAT_ENCODING_CONVERSIONS);
+			break;
+	}
+
+	TRACE_END("encoding_decode");
+	return decoded;
+}
+
+/**
+ * Converts UTF-8 text back into the encoding of a page.
+ *
+ * @param  text           UTF-8 text.
+ * @param  length         Length of the text.
+ * @param  encoding       Encoding to convert to.
+ * @param  encoded_length Pointer to store the length of the converted text.
+ * @param  error          Return location for a GError.
+ * @return                Converted text or NULL if it has characters the
+ *                        encoding can't represent. Free it with g_free().
+ */
+char* encoding_encode(const char *text, gsize length, encoding_t encoding,
+					  gsize *encoded_length, GError **error) {
+	char *encoded;
+
+	switch (encoding) {
+		case ENCODING_UTF8:
+			*encoded_length = length;
+			return g_strndup(text, length);
+		case ENCODING_UTF8_BOM:
+			*encoded_length = length + 3;
+			encoded = g_malloc(length + 4);
+			memcpy(encoded, ENCODING_BOM, 3);
+			memcpy(encoded + 3, text, length);
+			encoded[length + 3] = '\0';
+			return encoded;
+		default:
+			stats_count(STAT_ENCODING_CONVERSIONS);
+			return encoding_iconv(text, length, encoding_name(encoding),
+								  "UTF-8", encoded_length, error);
+	}
+}
+
+/**
+ * Converts some text between encodings a block at a time.
+ *
+ * @param  text             Text to be converted.
+ * @param  length           Length of the text.
+ * @param  to               Encoding to convert to.
+ * @param  from             Encoding the text is in.
+ * @param  converted_length Pointer to store the length of the converted text.
+ * @param  error            Return location for a GError.
+ * @return                  NUL-terminated converted text or NULL if an error
+ *                          occurred. Free it with g_free().
+ */
+char* encoding_iconv(const char *text, gsize length, const char *to,
+					 const char *from, gsize *converted_length,
+					 GError **error) {
+	char buffer[ENCODING_CHUNK_SIZE];
+	GString *converted;
+	GIConv cd;
+	gchar *inbuf = (gchar*)text;
+	gsize inleft = length;
+	gchar *outbuf;
+	gsize outleft;
+
+	// Get a converter.
+	cd = g_iconv_open(to, from);
+	if (cd == (GIConv)-1) {
+		g_set_error(error, G_CONVERT_ERROR, G_CONVERT_ERROR_NO_CONVERSION,
+					"Conversion from %s to %s isn't supported.", from, to);
+		return NULL;
+	}
+
+	// Convert it a block at a time.
+	converted = g_string_sized_new(length + (length / 4));
+	while (inleft > 0) {
+		outbuf = buffer;
+		outleft = sizeof(buffer);
+		if ((g_iconv(cd, &inbuf, &inleft, &outbuf, &outleft) == (gsize)-1) &&
+				(errno != E2BIG)) {
+			g_set_error(error, G_CONVERT_ERROR,
+						(errno == EILSEQ) ? G_CONVERT_ERROR_ILLEGAL_SEQUENCE :
+						G_CONVERT_ERROR_PARTIAL_INPUT,
+						"Character at byte %" G_GSIZE_FORMAT " can't be "
+						"converted from %s to %s.", (gsize)(inbuf - text),
+						from, to);
+			g_iconv_close(cd);
+			g_string_free(converted, true);
+
+			return NULL;
+		}
+
+		g_string_append_len(converted, buffer, outbuf - buffer);
+	}
+
+	// Let it wrap up any state it was keeping.
+	outbuf = buffer;
+	outleft = sizeof(buffer);
+	g_iconv(cd, NULL, NULL, &outbuf, &outleft);
+	g_string_append_len(converted, buffer, outbuf - buffer);
+	g_iconv_close(cd);
+
+	*converted_length = converted->len;
+	return g_string_free(converted, false);
+}
@@ -0,0 +1,39 @@
+/**
+ * Encoding.h
+ * Validation and conversion of the character encoding of pages.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _ENCODING_H_
+#define _ENCODING_H_
+
+#include <glib.h>
+#include <stdbool.h>
+#include "Arena.h"
+
+// Size of the blocks text is converted in.
+#define ENCODING_CHUNK_SIZE 16384
+
+// Encodings a page may be stored in.
+typedef enum {
+	ENCODING_UTF8 = 0,
+	ENCODING_UTF8_BOM,
+	ENCODING_WINDOWS_1252,
+	ENCODING_LATIN1
+} encoding_t;
+
+// Detection.
+bool encoding_validate_utf8(const char *text, gsize length);
+encoding_t encoding_detect(const char *text, gsize length);
+const char* encoding_name(encoding_t encoding);
+
+// Conversion.
+char* encoding_decode(char *contents, gsize length, encoding_t *encoding,
+					  gsize *decoded_length, GError **error);
+char* encoding_decode_arena(char *contents, gsize length, arena_t *arena,
+							gsize *decoded_length, GError **error);
+char* encoding_encode(const char *text, gsize length, encoding_t encoding,
+					  gsize *encoded_length, GError **error);
+
+#endif /* _ENCODING_H_ */
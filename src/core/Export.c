@@ -0,0 +1,682 @@
+/**
+ * Export.c
+ * Parallel static-site exporter for the whole workspace.
+ *
+ * The exported site mirrors the workspace folder structure, so the relative
+ * links that libuki generates based on the page deepness stay valid. Every
+ * article is rendered by a pool of workers sized to the number of processors
+ * and written straight to disk, so only the pages currently being worked on
+ * are ever held in memory. This assumes libuki's lookup and rendering functions
+ * only read the state built by uki_initialize().
+ *
+ * Exports are incremental: a manifest in the output directory remembers the
+ * source and template hashes of every page, so only pages whose source or any
+ * of the templates they transitively use changed are rendered again, and the
+ * outputs of pages that were removed get deleted.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include "Export.h"
+#include "Manifest.h"
+#include "Page.h"
+#include "Stats.h"
+#include "TemplateDeps.h"
+#include "Wiki.h"
+
+// Export job shared between the workers.
+typedef struct {
+	char *root;
+	char *outdir;
+	bool incremental;
+	GHashTable *assets;
+	GMutex assets_lock;
+	template_deps_t *deps;
+	GHashTable *old_manifest;
+	GHashTable *manifest;
+	GMutex manifest_lock;
+	export_progress_t *progress;
+} export_job_t;
+
+// Private methods.
+char* export_real_path(const char *fpath);
+bool export_path_inside(const char *fpath, const char *dir);
+bool export_remove_output(const char *outdir, const char *relpath);
+void export_worker(gpointer data, gpointer user_data);
+bool export_page(export_job_t *job, page_t page);
+bool export_page_unchanged(export_job_t *job, const char *relpath,
+						   const char *source, const char *templates);
+char* export_output_path(export_job_t *job, const char *fpath);
+const char* export_relative_path(export_job_t *job, const char *fpath);
+GPtrArray* export_assets(export_job_t *job, const char *html,
+						 const char *fpath);
+char* export_asset(export_job_t *job, const char *ref, const char *src_dir);
+bool export_asset_copy(export_job_t *job, const char *relpath);
+void export_remove_stale(export_job_t *job);
+void export_keep_stale(export_job_t *job);
+
+/**
+ * Initializes an export progress structure.
+ *
+ * @param progress Progress structure to be initialized.
+ */
+void export_progress_init(export_progress_t *progress) {
+	progress->total = 0;
+	progress->rendered = 0;
+	progress->skipped = 0;
+	progress->removed = 0;
+	progress->assets = 0;
+	progress->failed = 0;
+	progress->cancelled = false;
+}
+
+/**
+ * Requests a running export to stop as soon as possible.
+ *
+ * @param progress Progress structure of the running export.
+ */
+void export_cancel(export_progress_t *progress) {
+	g_atomic_int_set(&progress->cancelled, true);
+}
+
+/**
+ * Checks that a folder can be exported to without overwriting the workspace,
+ * which means it can't be the workspace itself or anything inside it.
+ *
+ * @param  outdir Output directory.
+ * @param  error  Return location for a GError.
+ * @return        TRUE if the folder is safe to export to.
+ */
+bool export_check_outdir(const char *outdir, GError **error) {
+	char *root;
+	char *dir;
+	bool inside;
+
+	root = export_real_path(wiki_root());
+	dir = export_real_path(outdir);
+	inside = export_path_inside(dir, root);
+	if (inside) {
+		g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+					"Can't export to '%s' since it's inside the workspace "
+					"'%s' and the pages would be overwritten.", dir, root);
+	}
+
+	g_free(dir);
+	g_free(root);
+	return !inside;
+}
+
+/**
+ * Exports every article in the workspace as a static website.
+ *
+ * @param  outdir      Output directory.
+ * @param  incremental Only render the pages that changed since the last export.
+ * @param  progress    Progress structure to be updated while exporting.
+ * @param  error       Return location for a GError.
+ * @return             TRUE if every page was exported.
+ */
+bool export_workspace(const char *outdir, bool incremental,
+					  export_progress_t *progress, GError **error) {
+	export_job_t job;
+	GThreadPool *pool;
+	char *manifest_path;
+	size_t count;
+	bool success = true;
+
+	// Never write over the workspace.
+	if (!export_check_outdir(outdir, error))
+		return false;
+
+	// Setup the job.
+	job.root = g_canonicalize_filename(wiki_root(), NULL);
+	job.outdir = g_canonicalize_filename(outdir, NULL);
+	job.incremental = incremental;
+	job.assets = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	job.deps = template_deps_new();
+	job.manifest = manifest_new();
+	job.progress = progress;
+	g_mutex_init(&job.assets_lock);
+	g_mutex_init(&job.manifest_lock);
+	count = wiki_pages_available(PAGE_TYPE_ARTICLE);
+	g_atomic_int_set(&progress->total, (gint)count);
+
+	// Load what we did last time.
+	manifest_path = g_build_filename(job.outdir, MANIFEST_FNAME, NULL);
+	job.old_manifest = manifest_load(manifest_path);
+
+	// Create the worker pool.
+	pool = g_thread_pool_new(export_worker, &job, g_get_num_processors(), true,
+							 error);
+	if (pool != NULL) {
+		// Queue every article. (Pointers can't be NULL, so offset the index)
+		stats_add(STAT_PENDING_JOBS, count);
+		for (size_t i = 0; i < count; i++)
+			g_thread_pool_push(pool, GSIZE_TO_POINTER(i + 1), NULL);
+
+		// Wait for the workers to finish.
+		g_thread_pool_free(pool, false, true);
+
+		// Remove the leftovers of deleted pages unless something went wrong.
+		if (g_atomic_int_get(&progress->cancelled) ||
+				(g_atomic_int_get(&progress->failed) > 0)) {
+			export_keep_stale(&job);
+		} else {
+			export_remove_stale(&job);
+		}
+
+		// Remember what we did for the next time.
+		success = manifest_save(job.manifest, manifest_path, error);
+	}
+
+	// Clean up.
+	g_mutex_clear(&job.manifest_lock);
+	g_mutex_clear(&job.assets_lock);
+	g_hash_table_destroy(job.old_manifest);
+	g_hash_table_destroy(job.manifest);
+	g_hash_table_destroy(job.assets);
+	template_deps_free(job.deps);
+	g_free(manifest_path);
+	g_free(job.outdir);
+	g_free(job.root);
+
+	if ((pool == NULL) || !success)
+		return false;
+
+	// Report any failures.
+	if (g_atomic_int_get(&progress->failed) > 0) {
+		g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+					"Failed to export %d of %d pages.",
+					g_atomic_int_get(&progress->failed), (gint)count);
+		return false;
+	}
+
+	// Report a cancellation.
+	if (g_atomic_int_get(&progress->cancelled)) {
+		g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+					"The export was cancelled.");
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Gets the canonical path of a file, with the symbolic links resolved for as
+ * much of it as already exists.
+ *
+ * @param  fpath Path to the file.
+ * @return       Canonical path. Free it with g_free().
+ */
+char* export_real_path(const char *fpath) {
+	char *canonical;
+	char *resolved;
+	char *parent;
+	char *name;
+	char *real;
+
+	// Resolve the path as a whole if it exists.
+	canonical = g_canonicalize_filename(fpath, NULL);
+	if ((resolved = realpath(canonical, NULL)) != NULL) {
+		real = g_strdup(resolved);
+		free(resolved);
+		g_free(canonical);
+
+		return real;
+	}
+
+	// Otherwise resolve its parent and append the rest.
+	parent = g_path_get_dirname(canonical);
+	if (strcmp(parent, canonical) == 0) {
+		g_free(parent);
+		return canonical;
+	}
+	name = g_path_get_basename(canonical);
+	resolved = export_real_path(parent);
+	real = g_build_filename(resolved, name, NULL);
+
+	g_free(resolved);
+	g_free(name);
+	g_free(parent);
+	g_free(canonical);
+
+	return real;
+}
+
+/**
+ * Checks if a canonical path is a folder or inside it.
+ *
+ * @param  fpath Canonical path to be checked.
+ * @param  dir   Canonical path of the folder.
+ * @return       TRUE if the path is the folder itself or inside it.
+ */
+bool export_path_inside(const char *fpath, const char *dir) {
+	size_t len = strlen(dir);
+
+	// The root folder contains everything.
+	if ((len > 0) && (dir[len - 1] == G_DIR_SEPARATOR))
+		return strncmp(fpath, dir, len) == 0;
+
+	return (strncmp(fpath, dir, len) == 0) &&
+		((fpath[len] == '\0') || (fpath[len] == G_DIR_SEPARATOR));
+}
+
+/**
+ * Thread pool worker that exports a single article.
+ *
+ * @param data      Index of the article plus one.
+ * @param user_data Export job.
+ */
+void export_worker(gpointer data, gpointer user_data) {
+	export_job_t *job = (export_job_t*)user_data;
+	page_t page = page_article(GPOINTER_TO_SIZE(data) - 1);
+
+	// Export the page unless the export was cancelled. (It accounts for its
+	// own successes)
+	if (!g_atomic_int_get(&job->progress->cancelled) &&
+			!export_page(job, page)) {
+		g_atomic_int_inc(&job->progress->failed);
+	}
+
+	stats_add(STAT_PENDING_JOBS, -1);
+}
+
+/**
+ * Renders a page and writes it to the output directory if it has changed.
+ *
+ * @param  job  Export job.
+ * @param  page Page to be exported.
+ * @return      TRUE if the operation was successful.
+ */
+bool export_page(export_job_t *job, page_t page) {
+	char fpath[UKI_MAX_PATH];
+	GPtrArray *assets;
+	char *canon;
+	char *contents;
+	char *source;
+	char *templates;
+	char *output;
+	char *outpath;
+	char *outdir;
+	const char *relpath;
+	bool success;
+
+	// Get the page path and where it should go.
+	if (page_fpath(fpath, page) != UKI_OK)
+		return false;
+	canon = g_canonicalize_filename(fpath, NULL);
+	outpath = export_output_path(job, canon);
+	relpath = export_relative_path(job, canon);
+	if (outpath == NULL) {
+		g_free(canon);
+		return false;
+	}
+
+	// Read the page and hash everything that goes into rendering it.
+	if (!page_read(page, &contents, NULL, NULL)) {
+		g_free(outpath);
+		g_free(canon);
+
+		return false;
+	}
+	source = g_compute_checksum_for_string(G_CHECKSUM_SHA1, contents, -1);
+	templates = template_deps_hash(job->deps, contents);
+
+	// Skip the page if nothing changed since the last export.
+	if (export_page_unchanged(job, relpath, source, templates)) {
+		g_atomic_int_inc(&job->progress->skipped);
+		stats_count(STAT_EXPORT_SKIPPED);
+		success = true;
+		goto cleanup;
+	}
+
+	// Render the page and write it out.
+	page_render(page, &contents);
+	outdir = g_path_get_dirname(outpath);
+	success = (g_mkdir_with_parents(outdir, 0755) == 0) &&
+		g_file_set_contents(outpath, contents, -1, NULL);
+	g_free(outdir);
+	if (!success)
+		goto cleanup;
+	g_atomic_int_inc(&job->progress->rendered);
+	stats_count(STAT_EXPORT_RENDERED);
+
+	// Copy over the assets it references and record what we did.
+	assets = export_assets(job, contents, fpath);
+	output = g_compute_checksum_for_string(G_CHECKSUM_SHA1, contents, -1);
+	g_mutex_lock(&job->manifest_lock);
+	g_hash_table_replace(job->manifest, g_strdup(relpath),
+		manifest_entry_new(source, templates, output, (char**)assets->pdata));
+	g_mutex_unlock(&job->manifest_lock);
+	g_ptr_array_free(assets, true);
+	g_free(output);
+
+cleanup:
+	g_free(templates);
+	g_free(source);
+	g_free(contents);
+	g_free(outpath);
+	g_free(canon);
+
+	return success;
+}
+
+/**
+ * Checks if a page is unchanged since the last export and carries its
+ * manifest entry over if so.
+ *
+ * @param  job       Export job.
+ * @param  relpath   Path of the page relative to the output directory.
+ * @param  source    Hash of the page source.
+ * @param  templates Combined hash of the templates used by the page.
+ * @return           TRUE if the page doesn't have to be rendered again.
+ */
+bool export_page_unchanged(export_job_t *job, const char *relpath,
+						   const char *source, const char *templates) {
+	manifest_entry_t *entry;
+	char *outpath;
+	bool exists;
+
+	// Check the hashes against the last export.
+	if (!job->incremental)
+		return false;
+	entry = g_hash_table_lookup(job->old_manifest, relpath);
+	if ((entry == NULL) || (strcmp(entry->source, source) != 0) ||
+			(strcmp(entry->templates, templates) != 0)) {
+		return false;
+	}
+
+	// Make sure the output is still there.
+	outpath = g_build_filename(job->outdir, relpath, NULL);
+	exists = g_file_test(outpath, G_FILE_TEST_IS_REGULAR);
+	g_free(outpath);
+	if (!exists)
+		return false;
+
+	// Refresh the assets it uses, since those aren't part of the hashes.
+	for (char **asset = entry->assets; (asset != NULL) && (*asset != NULL);
+			asset++) {
+		export_asset_copy(job, *asset);
+	}
+
+	// Carry the entry over.
+	g_mutex_lock(&job->manifest_lock);
+	g_hash_table_replace(job->manifest, g_strdup(relpath),
+						 manifest_entry_copy(entry));
+	g_mutex_unlock(&job->manifest_lock);
+
+	return true;
+}
+
+/**
+ * Gets the output path equivalent to a file inside the workspace.
+ *
+ * @param  job   Export job.
+ * @param  fpath Canonical path of a file inside the workspace.
+ * @return       Newly allocated output path or NULL if the file isn't inside
+ *               the workspace.
+ */
+char* export_output_path(export_job_t *job, const char *fpath) {
+	const char *relpath = export_relative_path(job, fpath);
+
+	if (relpath == NULL)
+		return NULL;
+
+	return g_build_filename(job->outdir, relpath, NULL);
+}
+
+/**
+ * Gets the path of a file relative to the root of the workspace.
+ *
+ * @param  job   Export job.
+ * @param  fpath Canonical path of a file inside the workspace.
+ * @return       Pointer inside fpath to the relative path or NULL if the file
+ *               isn't inside the workspace.
+ */
+const char* export_relative_path(export_job_t *job, const char *fpath) {
+	size_t rlen = strlen(job->root);
+
+	// Make sure the file is inside the workspace.
+	if ((strncmp(fpath, job->root, rlen) != 0) ||
+			(fpath[rlen] != G_DIR_SEPARATOR)) {
+		return NULL;
+	}
+
+	return fpath + rlen + 1;
+}
+
+/**
+ * Copies the local assets referenced by a rendered page.
+ *
+ * @param  job   Export job.
+ * @param  html  Rendered page.
+ * @param  fpath Path to the page source.
+ * @return       NULL-terminated array of asset paths relative to the
+ *               workspace root.
+ */
+GPtrArray* export_assets(export_job_t *job, const char *html,
+						 const char *fpath) {
+	const char *attrs[] = { "src=", "href=" };
+	GPtrArray *assets;
+	char *src_dir;
+
+	assets = g_ptr_array_new_with_free_func(g_free);
+	src_dir = g_path_get_dirname(fpath);
+	for (size_t a = 0; a < G_N_ELEMENTS(attrs); a++) {
+		const char *pos = html;
+
+		while ((pos = strstr(pos, attrs[a])) != NULL) {
+			const char *end;
+			char quote;
+			char *ref;
+			char *relpath;
+
+			// Get the quoted attribute value.
+			pos += strlen(attrs[a]);
+			quote = *pos;
+			if ((quote != '"') && (quote != '\''))
+				continue;
+			pos++;
+			if ((end = strchr(pos, quote)) == NULL)
+				break;
+
+			// Copy the asset over.
+			ref = g_strndup(pos, end - pos);
+			if ((relpath = export_asset(job, ref, src_dir)) != NULL)
+				g_ptr_array_add(assets, relpath);
+			g_free(ref);
+
+			pos = end + 1;
+		}
+	}
+
+	g_free(src_dir);
+	g_ptr_array_add(assets, NULL);
+
+	return assets;
+}
+
+/**
+ * Copies a single asset to the output directory if it's a local file.
+ *
+ * @param  job     Export job.
+ * @param  ref     Reference to the asset as written in the page.
+ * @param  src_dir Directory of the page that referenced it.
+ * @return         Newly allocated path of the asset relative to the workspace
+ *                 root or NULL if it isn't a local asset.
+ */
+char* export_asset(export_job_t *job, const char *ref, const char *src_dir) {
+	const char *relpath;
+	char *path;
+	char *fpath;
+	char *result = NULL;
+
+	// Ignore URLs, anchors, absolute paths, and other pages.
+	if ((ref[0] == '\0') || (ref[0] == '#') || (ref[0] == '/') ||
+			(ref[0] == '?') || (strchr(ref, ':') != NULL) ||
+			g_str_has_suffix(ref, "." UKI_ARTICLE_EXT)) {
+		return NULL;
+	}
+
+	// Drop any query or fragment and resolve the path.
+	path = g_strndup(ref, strcspn(ref, "?#"));
+	fpath = g_uri_unescape_string(path, NULL);
+	g_free(path);
+	if (fpath == NULL)
+		return NULL;
+	path = g_canonicalize_filename(fpath, src_dir);
+	g_free(fpath);
+
+	// Only copy regular files from inside the workspace.
+	relpath = export_relative_path(job, path);
+	if ((relpath != NULL) && g_file_test(path, G_FILE_TEST_IS_REGULAR)) {
+		result = g_strdup(relpath);
+		export_asset_copy(job, result);
+	}
+
+	g_free(path);
+	return result;
+}
+
+/**
+ * Copies an asset to the output directory once per export, skipping it if the
+ * output copy is already up-to-date.
+ *
+ * @param  job     Export job.
+ * @param  relpath Path of the asset relative to the workspace root.
+ * @return         TRUE if the asset was copied during this call.
+ */
+bool export_asset_copy(export_job_t *job, const char *relpath) {
+	GStatBuf src_stat;
+	GStatBuf dest_stat;
+	GFile *src;
+	GFile *dest;
+	char *path;
+	char *outpath;
+	char *outdir;
+	bool exists;
+	bool copied = false;
+
+	// Only handle each asset once.
+	g_mutex_lock(&job->assets_lock);
+	exists = !g_hash_table_add(job->assets, g_strdup(relpath));
+	g_mutex_unlock(&job->assets_lock);
+	if (exists)
+		return false;
+
+	// Check if the output copy is up-to-date.
+	path = g_build_filename(job->root, relpath, NULL);
+	outpath = g_build_filename(job->outdir, relpath, NULL);
+	if (g_stat(path, &src_stat) != 0)
+		goto cleanup;
+	if ((g_stat(outpath, &dest_stat) == 0) &&
+			(dest_stat.st_size == src_stat.st_size) &&
+			(dest_stat.st_mtime >= src_stat.st_mtime)) {
+		goto cleanup;
+	}
+
+	// Copy the file.
+	outdir = g_path_get_dirname(outpath);
+	src = g_file_new_for_path(path);
+	dest = g_file_new_for_path(outpath);
+	if ((g_mkdir_with_parents(outdir, 0755) == 0) &&
+			g_file_copy(src, dest, G_FILE_COPY_OVERWRITE, NULL, NULL, NULL,
+						NULL)) {
+		g_atomic_int_inc(&job->progress->assets);
+		copied = true;
+	}
+	g_object_unref(dest);
+	g_object_unref(src);
+	g_free(outdir);
+
+cleanup:
+	g_free(outpath);
+	g_free(path);
+
+	return copied;
+}
+
+/**
+ * Removes the outputs of pages and assets that are gone from the workspace.
+ *
+ * @param job Export job.
+ */
+void export_remove_stale(export_job_t *job) {
+	GHashTableIter iter;
+	gpointer key;
+	gpointer value;
+	char *outdir;
+
+	outdir = export_real_path(job->outdir);
+	g_hash_table_iter_init(&iter, job->old_manifest);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		manifest_entry_t *entry = (manifest_entry_t*)value;
+
+		// Remove the page if it's gone.
+		if (!g_hash_table_contains(job->manifest, key)) {
+			if (export_remove_output(outdir, key))
+				g_atomic_int_inc(&job->progress->removed);
+		}
+
+		// Remove the assets that nobody references anymore.
+		for (char **asset = entry->assets; (asset != NULL) && (*asset != NULL);
+				asset++) {
+			if (g_hash_table_contains(job->assets, *asset))
+				continue;
+
+			export_remove_output(outdir, *asset);
+		}
+	}
+
+	g_free(outdir);
+}
+
+/**
+ * Removes a file from the output directory, as long as the folder it's in
+ * really is inside of it.
+ *
+ * @param  outdir  Canonical path of the output directory.
+ * @param  relpath Path of the file relative to the output directory.
+ * @return         TRUE if the file was removed.
+ */
+bool export_remove_output(const char *outdir, const char *relpath) {
+	char *outpath;
+	char *parent;
+	char *resolved;
+	bool removed = false;
+
+	outpath = g_build_filename(outdir, relpath, NULL);
+	parent = g_path_get_dirname(outpath);
+	resolved = export_real_path(parent);
+	if (export_path_inside(resolved, outdir))
+		removed = g_remove(outpath) == 0;
+
+	g_free(resolved);
+	g_free(parent);
+	g_free(outpath);
+
+	return removed;
+}
+
+/**
+ * Carries over the manifest entries of pages that weren't exported, so an
+ * interrupted export doesn't forget about the outputs it left behind.
+ *
+ * @param job Export job.
+ */
+void export_keep_stale(export_job_t *job) {
+	GHashTableIter iter;
+	gpointer key;
+	gpointer value;
+
+	g_hash_table_iter_init(&iter, job->old_manifest);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		if (!g_hash_table_contains(job->manifest, key)) {
+			g_hash_table_insert(job->manifest, g_strdup(key),
+								manifest_entry_copy(value));
+		}
+	}
+}
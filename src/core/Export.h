@@ -0,0 +1,32 @@
+/**
+ * Export.h
+ * Parallel static-site exporter for the whole workspace.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _EXPORT_H_
+#define _EXPORT_H_
+
+#include <glib.h>
+#include <stdbool.h>
+
+// Export progress. (Updated atomically by the workers)
+typedef struct {
+	gint total;
+	gint rendered;
+	gint skipped;
+	gint removed;
+	gint assets;
+	gint failed;
+	gint cancelled;
+} export_progress_t;
+
+// Exporting.
+void export_progress_init(export_progress_t *progress);
+bool export_check_outdir(const char *outdir, GError **error);
+bool export_workspace(const char *outdir, bool incremental,
+					  export_progress_t *progress, GError **error);
+void export_cancel(export_progress_t *progress);
+
+#endif /* _EXPORT_H_ */
@@ -0,0 +1,297 @@
+/**
+ * History.c
+ * Bounded back and forward navigation history with cached page state.
+ *
+ * Each entry keeps the source and the rendered HTML of the page so that going
+ * back and forth doesn't have to touch the disk or render anything again. The
+ * contents are reference-counted, so they are shared with whatever the editor
+ * and viewer are showing instead of being copied. When the cache grows beyond
+ * its limit the contents of the entries furthest from the current page are
+ * dropped first, but the entries themselves are kept, so the history stays
+ * complete and those pages are simply loaded from disk.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include "History.h"
+
+// Private variables.
+GQueue history_back_stack = G_QUEUE_INIT;
+GQueue history_forward_stack = G_QUEUE_INIT;
+gsize history_bytes = 0;
+guint history_last_id = 0;
+
+// Private methods.
+void history_push(GQueue *stack, history_entry_t *entry);
+history_entry_t* history_pop(GQueue *stack);
+void history_trim();
+bool history_evict(GQueue *stack);
+void history_drop_contents(history_entry_t *entry);
+void history_clear_stack(GQueue *stack);
+
+/**
+ * Creates a new history entry.
+ *
+ * @param  page   Page that was visited.
+ * @param  source Source of the page or NULL if it shouldn't be cached. (The
+ *                reference is taken by the entry)
+ * @param  html   Rendered page or NULL if it shouldn't be cached. (The
+ *                reference is taken by the entry)
+ * @param  cursor Offset of the cursor in the editor.
+ * @param  scroll Scroll offset of the viewer.
+ * @return        Newly allocated history entry.
+ */
+history_entry_t* history_entry_new(page_t page, GBytes *source, GBytes *html,
+								   gint cursor, gdouble scroll) {
+	history_entry_t *entry = g_new0(history_entry_t, 1);
+
+	entry->id = ++history_last_id;
+	entry->page = page;
+	entry->cursor = cursor;
+	entry->scroll = scroll;
+
+	// Only cache complete states.
+	if ((source != NULL) && (html != NULL)) {
+		entry->source = source;
+		entry->html = html;
+		entry->size = g_bytes_get_size(source) + g_bytes_get_size(html);
+	} else {
+		if (source != NULL)
+			g_bytes_unref(source);
+		if (html != NULL)
+			g_bytes_unref(html);
+	}
+
+	return entry;
+}
+
+/**
+ * Frees a history entry.
+ *
+ * @param entry History entry to be freed. (May be NULL)
+ */
+void history_entry_free(history_entry_t *entry) {
+	if (entry == NULL)
+		return;
+
+	if (entry->source != NULL)
+		g_bytes_unref(entry->source);
+	if (entry->html != NULL)
+		g_bytes_unref(entry->html);
+	g_free(entry);
+}
+
+/**
+ * Records that we are leaving a page to visit a new one.
+ *
+ * @param current State of the page we are leaving. (Owned by the history,
+ *                ignored if NULL)
+ */
+void history_visit(history_entry_t *current) {
+	if (current == NULL)
+		return;
+
+	history_clear_stack(&history_forward_stack);
+	history_push(&history_back_stack, current);
+}
+
+/**
+ * Goes back in the history.
+ *
+ * @param  current State of the page we are leaving. (Owned by the history,
+ *                 ignored if NULL)
+ * @return         Entry to be restored or NULL if there's nowhere to go. Free
+ *                 it with history_entry_free().
+ */
+history_entry_t* history_back(history_entry_t *current) {
+	if (!history_can_go_back()) {
+		history_entry_free(current);
+		return NULL;
+	}
+
+	if (current != NULL)
+		history_push(&history_forward_stack, current);
+	return history_pop(&history_back_stack);
+}
+
+/**
+ * Goes forward in the history.
+ *
+ * @param  current State of the page we are leaving. (Owned by the history,
+ *                 ignored if NULL)
+ * @return         Entry to be restored or NULL if there's nowhere to go. Free
+ *                 it with history_entry_free().
+ */
+history_entry_t* history_forward(history_entry_t *current) {
+	if (!history_can_go_forward()) {
+		history_entry_free(current);
+		return NULL;
+	}
+
+	if (current != NULL)
+		history_push(&history_back_stack, current);
+	return history_pop(&history_forward_stack);
+}
+
+/**
+ * Checks if there's anywhere to go back to.
+ *
+ * @return TRUE if we can go back.
+ */
+bool history_can_go_back() {
+	return !g_queue_is_empty(&history_back_stack);
+}
+
+/**
+ * Checks if there's anywhere to go forward to.
+ *
+ * @return TRUE if we can go forward.
+ */
+bool history_can_go_forward() {
+	return !g_queue_is_empty(&history_forward_stack);
+}
+
+/**
+ * Forgets the whole history.
+ */
+void history_clear() {
+	history_clear_stack(&history_back_stack);
+	history_clear_stack(&history_forward_stack);
+}
+
+/**
+ * Finds an entry that is still in the history.
+ *
+ * @param  id Identifier of the entry.
+ * @return    The entry or NULL if it isn't in the history anymore.
+ */
+history_entry_t* history_find(guint id) {
+	GQueue *stacks[] = { &history_back_stack, &history_forward_stack };
+
+	for (size_t s = 0; s < G_N_ELEMENTS(stacks); s++) {
+		for (GList *l = stacks[s]->head; l != NULL; l = l->next) {
+			if (((history_entry_t*)l->data)->id == id)
+				return l->data;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Gets the number of bytes cached by the history.
+ *
+ * @return Bytes of page contents held by the history.
+ */
+gsize history_memory() {
+	return history_bytes;
+}
+
+/**
+ * Gets the number of entries in the history.
+ *
+ * @return Number of back and forward entries.
+ */
+guint history_length() {
+	return g_queue_get_length(&history_back_stack) +
+		g_queue_get_length(&history_forward_stack);
+}
+
+/**
+ * Pushes an entry to the top of a stack and keeps the history within bounds.
+ *
+ * @param stack Stack to push the entry to.
+ * @param entry Entry to be pushed.
+ */
+void history_push(GQueue *stack, history_entry_t *entry) {
+	g_queue_push_head(stack, entry);
+	history_bytes += entry->size;
+
+	history_trim();
+}
+
+/**
+ * Pops the entry on the top of a stack.
+ *
+ * @param  stack Stack to pop the entry from.
+ * @return       Entry that was on the top of the stack.
+ */
+history_entry_t* history_pop(GQueue *stack) {
+	history_entry_t *entry = g_queue_pop_head(stack);
+
+	history_bytes -= entry->size;
+	return entry;
+}
+
+/**
+ * Keeps the history within its limits, starting with the entries that are the
+ * furthest away from the current page.
+ */
+void history_trim() {
+	// Limit the number of entries.
+	while (history_length() > HISTORY_MAX_ENTRIES) {
+		GQueue *stack = (g_queue_get_length(&history_back_stack) >=
+						 g_queue_get_length(&history_forward_stack)) ?
+			&history_back_stack : &history_forward_stack;
+		history_entry_t *entry = g_queue_pop_tail(stack);
+
+		history_bytes -= entry->size;
+		history_entry_free(entry);
+	}
+
+	// Limit the amount of cached contents.
+	while ((history_bytes > HISTORY_MAX_BYTES) &&
+		   (history_evict(&history_back_stack) ||
+			history_evict(&history_forward_stack))) {
+	}
+}
+
+/**
+ * Drops the cached contents of the oldest entry in a stack that has any.
+ *
+ * @param  stack Stack to evict from.
+ * @return       TRUE if something was evicted.
+ */
+bool history_evict(GQueue *stack) {
+	for (GList *l = stack->tail; l != NULL; l = l->prev) {
+		history_entry_t *entry = (history_entry_t*)l->data;
+
+		if (entry->size > 0) {
+			history_drop_contents(entry);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Drops the cached contents of an entry.
+ *
+ * @param entry Entry to have its contents dropped.
+ */
+void history_drop_contents(history_entry_t *entry) {
+	if (entry->source != NULL)
+		g_bytes_unref(entry->source);
+	if (entry->html != NULL)
+		g_bytes_unref(entry->html);
+
+	history_bytes -= entry->size;
+	entry->source = NULL;
+	entry->html = NULL;
+	entry->size = 0;
+}
+
+/**
+ * Frees every entry in a stack.
+ *
+ * @param stack Stack to be cleared.
+ */
+void history_clear_stack(GQueue *stack) {
+	history_entry_t *entry;
+
+	while ((entry = g_queue_pop_head(stack)) != NULL) {
+		history_bytes -= entry->size;
+		history_entry_free(entry);
+	}
+}
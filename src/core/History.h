@@ -0,0 +1,48 @@
+/**
+ * History.h
+ * Bounded back and forward navigation history with cached page state.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _HISTORY_H_
+#define _HISTORY_H_
+
+#include <glib.h>
+#include <stdbool.h>
+#include "Page.h"
+
+// Limits of the cached page state.
+#define HISTORY_MAX_ENTRIES 100
+#define HISTORY_MAX_BYTES   (32 * 1024 * 1024)
+
+// State of a visited page.
+typedef struct {
+	guint id;
+	page_t page;
+	GBytes *source;
+	GBytes *html;
+	gsize size;
+	gint cursor;
+	gdouble scroll;
+} history_entry_t;
+
+// Entries.
+history_entry_t* history_entry_new(page_t page, GBytes *source, GBytes *html,
+								   gint cursor, gdouble scroll);
+void history_entry_free(history_entry_t *entry);
+
+// Navigation.
+void history_visit(history_entry_t *current);
+history_entry_t* history_back(history_entry_t *current);
+history_entry_t* history_forward(history_entry_t *current);
+bool history_can_go_back();
+bool history_can_go_forward();
+void history_clear();
+
+// Information.
+history_entry_t* history_find(guint id);
+gsize history_memory();
+guint history_length();
+
+#endif /* _HISTORY_H_ */
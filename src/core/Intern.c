@@ -0,0 +1,144 @@
+/**
+ * Intern.c
+ * Workspace-wide table of interned strings.
+ *
+ * Every distinct string is stored only once, so page names, folder names,
+ * paths and links that are repeated all over the workspace model and indexes
+ * share the same memory and can be compared by pointer. The strings live in an
+ * arena until the workspace is closed, when the whole table is thrown away at
+ * once. The table is safe to use from the indexing threads.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include <string.h>
+#include "Intern.h"
+#include "Arena.h"
+
+// Strings shorter than this are looked up without allocating.
+#define INTERN_STACK_LEN 256
+
+// Private variables.
+GHashTable *intern_table = NULL;
+arena_t *intern_arena = NULL;
+gsize intern_total_bytes = 0;
+GMutex intern_mutex;
+
+// Private methods.
+const char* intern_lookup(const char *str, gsize length);
+
+/**
+ * Interns a string.
+ *
+ * @param  str String to be interned. (May be NULL)
+ * @return     Canonical copy of the string that lives until intern_clear() is
+ *             called, or NULL if the string was NULL.
+ */
+const char* intern_string(const char *str) {
+	if (str == NULL)
+		return NULL;
+
+	return intern_lookup(str, strlen(str));
+}
+
+/**
+ * Interns the beginning of a string.
+ *
+ * @param  str    String to be interned.
+ * @param  length Number of bytes to intern.
+ * @return        Canonical NUL-terminated copy of the string that lives until
+ *                intern_clear() is called.
+ */
+const char* intern_string_len(const char *str, gsize length) {
+	char buf[INTERN_STACK_LEN];
+	const char *interned;
+	char *key;
+
+	// The table needs a NUL-terminated key to look it up.
+	key = (length < INTERN_STACK_LEN) ? buf : g_malloc(length + 1);
+	memcpy(key, str, length);
+	key[length] = '\0';
+
+	interned = intern_lookup(key, length);
+	if (key != buf)
+		g_free(key);
+
+	return interned;
+}
+
+/**
+ * Forgets about every interned string. Pointers previously returned are no
+ * longer valid after this.
+ */
+void intern_clear() {
+	g_mutex_lock(&intern_mutex);
+	if (intern_table != NULL)
+		g_hash_table_destroy(intern_table);
+	arena_free(intern_arena);
+
+	intern_table = NULL;
+	intern_arena = NULL;
+	intern_total_bytes = 0;
+	g_mutex_unlock(&intern_mutex);
+}
+
+/**
+ * Gets the number of distinct strings in the table.
+ *
+ * @return Number of interned strings.
+ */
+guint intern_count() {
+	guint count;
+
+	g_mutex_lock(&intern_mutex);
+	count = (intern_table != NULL) ? g_hash_table_size(intern_table) : 0;
+	g_mutex_unlock(&intern_mutex);
+
+	return count;
+}
+
+/**
+ * Gets the memory taken by the strings in the table.
+ *
+ * @return Bytes used by the interned strings.
+ */
+gsize intern_bytes() {
+	gsize bytes;
+
+	g_mutex_lock(&intern_mutex);
+	bytes = intern_total_bytes;
+	g_mutex_unlock(&intern_mutex);
+
+	return bytes;
+}
+
+/**
+ * Finds a string in the table and adds it if it isn't there yet.
+ *
+ * @param  str    NUL-terminated string to be interned.
+ * @param  length Length of the string.
+ * @return        Canonical copy of the string.
+ */
+const char* intern_lookup(const char *str, gsize length) {
+	char *interned;
+
+	g_mutex_lock(&intern_mutex);
+
+	// Create the table on first use.
+	if (intern_table == NULL) {
+		intern_table = g_hash_table_new(g_str_hash, g_str_equal);
+		intern_arena = arena_new(0);
+	}
+
+	// Add it if we haven't seen it before.
+	interned = g_hash_table_lookup(intern_table, str);
+	if (interned == NULL) {
+		interned = arena_strndup(intern_arena, str, length);
+		g_hash_table_add(intern_table, interned);
+		intern_total_bytes += length + 1;
+	}
+
+	g_mutex_unlock(&intern_mutex);
+
+	return interned;
+}
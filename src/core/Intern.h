@@ -0,0 +1,22 @@
+/**
+ * Intern.h
+ * Workspace-wide table of interned strings.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _INTERN_H_
+#define _INTERN_H_
+
+#include <glib.h>
+
+// Interning.
+const char* intern_string(const char *str);
+const char* intern_string_len(const char *str, gsize length);
+void intern_clear();
+
+// Information.
+guint intern_count();
+gsize intern_bytes();
+
+#endif /* _INTERN_H_ */
@@ -0,0 +1,363 @@
+/**
+ * Journal.c
+ * Crash-safe append-only journal of the edits made to a page.
+ *
+ * Every insertion and deletion made in the editor is appended to a journal
+ * file in the cache folder, which is flushed to disk periodically, so the cost
+ * of keeping the changes safe is proportional to the edits rather than the
+ * size of the page. The journal starts with a checksum of the contents it
+ * applies to, and is emptied every time the page is saved. If gUki crashes,
+ * replaying the journal over the contents on disk gets the changes back.
+ * Records that were only partially written are ignored.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include "Journal.h"
+#include "Stats.h"
+
+// Journal format.
+#define JOURNAL_MAGIC "GUKI-JOURNAL 1"
+#define JOURNAL_EXT   ".journal"
+
+// Journal of an open page.
+struct _journal_t {
+	char *fpath;
+	FILE *fh;
+	bool dirty;
+};
+
+// Private methods.
+char* journal_path(const char *dir, const char *fpath);
+bool journal_write_header(journal_t *journal, const char *base, gsize length,
+						  GError **error);
+bool journal_replay(GString *contents, const char *records, gsize length);
+void journal_set_error(GError **error, const char *fpath, int err);
+
+/**
+ * Starts a new journal for a page, replacing any previous one.
+ *
+ * @param  dir    Folder where the journals are kept.
+ * @param  fpath  Path to the page file.
+ * @param  base   Contents that the edits will be applied to.
+ * @param  length Length of the contents.
+ * @param  error  Return location for a GError.
+ * @return        Journal or NULL if it couldn't be created. Close it with
+ *                journal_close().
+ */
+journal_t* journal_open(const char *dir, const char *fpath, const char *base,
+						gsize length, GError **error) {
+	journal_t *journal;
+
+	// Make sure we have somewhere to write to.
+	if (g_mkdir_with_parents(dir, 0700) != 0) {
+		journal_set_error(error, dir, errno);
+		return NULL;
+	}
+
+	// Create the file.
+	journal = g_new0(journal_t, 1);
+	journal->fpath = journal_path(dir, fpath);
+	if ((journal->fh = g_fopen(journal->fpath, "wb")) == NULL) {
+		journal_set_error(error, journal->fpath, errno);
+		journal_close(journal, false);
+
+		return NULL;
+	}
+
+	// Record what the edits apply to.
+	if (!journal_write_header(journal, base, length, error)) {
+		journal_close(journal, true);
+		return NULL;
+	}
+
+	return journal;
+}
+
+/**
+ * Closes a journal.
+ *
+ * @param journal Journal to be closed. (May be NULL)
+ * @param discard Delete the journal file? Otherwise it's kept for recovery.
+ */
+void journal_close(journal_t *journal, bool discard) {
+	if (journal == NULL)
+		return;
+
+	if (journal->fh != NULL) {
+		if (!discard)
+			journal_sync(journal, NULL);
+		fclose(journal->fh);
+	}
+	if (discard)
+		g_unlink(journal->fpath);
+
+	g_free(journal->fpath);
+	g_free(journal);
+}
+
+/**
+ * Empties a journal once its edits have been saved to the page.
+ *
+ * @param  journal Journal to be compacted.
+ * @param  base    Contents that were saved.
+ * @param  length  Length of the contents.
+ * @param  error   Return location for a GError.
+ * @return         TRUE if the operation was successful.
+ */
+bool journal_compact(journal_t *journal, const char *base, gsize length,
+					 GError **error) {
+	// Start over from the beginning of the file.
+	if ((fflush(journal->fh) != 0) ||
+			(ftruncate(fileno(journal->fh), 0) != 0)) {
+		journal_set_error(error, journal->fpath, errno);
+		return false;
+	}
+	rewind(journal->fh);
+
+	return journal_write_header(journal, base, length, error);
+}
+
+/**
+ * Records text being inserted.
+ *
+ * @param journal Journal of the page.
+ * @param offset  Character offset where the text was inserted.
+ * @param text    Text that was inserted.
+ * @param length  Length of the text in bytes.
+ */
+void journal_insert(journal_t *journal, glong offset, const char *text,
+					gsize length) {
+	int written;
+
+	written = fprintf(journal->fh, "I %ld %" G_GSIZE_FORMAT "\n", offset,
+					  length);
+	fwrite(text, 1, length, journal->fh);
+	fputc('\n', journal->fh);
+	journal->dirty = true;
+
+	stats_count(STAT_JOURNAL_RECORDS);
+	stats_add(STAT_JOURNAL_BYTES, written + length + 1);
+}
+
+/**
+ * Records text being deleted.
+ *
+ * @param journal Journal of the page.
+ * @param offset  Character offset where the deletion starts.
+ * @param count   Number of characters that were deleted.
+ */
+void journal_delete(journal_t *journal, glong offset, glong count) {
+	int written;
+
+	written = fprintf(journal->fh, "D %ld %ld\n", offset, count);
+	journal->dirty = true;
+
+	stats_count(STAT_JOURNAL_RECORDS);
+	stats_add(STAT_JOURNAL_BYTES, written);
+}
+
+/**
+ * Makes sure the recorded edits are on disk.
+ *
+ * @param  journal Journal of the page.
+ * @param  error   Return location for a GError.
+ * @return         TRUE if the operation was successful.
+ */
+bool journal_sync(journal_t *journal, GError **error) {
+	if (!journal->dirty)
+		return true;
+
+	if ((fflush(journal->fh) != 0) || (fsync(fileno(journal->fh)) != 0)) {
+		journal_set_error(error, journal->fpath, errno);
+		return false;
+	}
+
+	journal->dirty = false;
+	stats_count(STAT_JOURNAL_SYNCS);
+
+	return true;
+}
+
+/**
+ * Recovers the edits that were left in the journal of a page.
+ *
+ * @param  dir       Folder where the journals are kept.
+ * @param  fpath     Path to the page file.
+ * @param  base      Current contents of the page.
+ * @param  length    Length of the contents.
+ * @param  recovered Pointer to store the length of the recovered contents.
+ * @return           Contents with the edits applied or NULL if there was
+ *                   nothing to recover. Free it with g_free().
+ */
+char* journal_recover(const char *dir, const char *fpath, const char *base,
+					  gsize length, gsize *recovered) {
+	GString *contents;
+	char *jpath;
+	char *journal;
+	char *checksum;
+	char *header;
+	const char *records;
+	gsize jlength;
+
+	// Read the journal.
+	jpath = journal_path(dir, fpath);
+	if (!g_file_get_contents(jpath, &journal, &jlength, NULL)) {
+		g_free(jpath);
+		return NULL;
+	}
+	g_free(jpath);
+
+	// Check if the edits apply to what's on disk.
+	checksum = g_compute_checksum_for_data(G_CHECKSUM_SHA1,
+										   (const guchar*)base, length);
+	header = g_strdup_printf("%s\n%s\n", JOURNAL_MAGIC, checksum);
+	g_free(checksum);
+	if (!g_str_has_prefix(journal, header) ||
+			(strlen(header) == jlength)) {
+		g_free(header);
+		g_free(journal);
+
+		return NULL;
+	}
+	records = journal + strlen(header);
+	g_free(header);
+
+	// Replay them.
+	contents = g_string_new_len(base, length);
+	if (!journal_replay(contents, records, jlength - (records - journal))) {
+		g_string_free(contents, true);
+		g_free(journal);
+
+		return NULL;
+	}
+	g_free(journal);
+
+	*recovered = contents->len;
+	return g_string_free(contents, false);
+}
+
+/**
+ * Applies the records of a journal to some contents, stopping at the first
+ * record that's incomplete.
+ *
+ * @param  contents Contents to be edited.
+ * @param  records  Journal records.
+ * @param  length   Length of the records.
+ * @return          TRUE if at least one record was applied.
+ */
+bool journal_replay(GString *contents, const char *records, gsize length) {
+	const char *pos = records;
+	const char *end = records + length;
+	glong chars = g_utf8_strlen(contents->str, contents->len);
+	bool applied = false;
+
+	while (pos < end) {
+		const char *eol;
+		char *line;
+		char op;
+		glong offset;
+		glong count;
+		gsize start;
+
+		// Parse the record header.
+		if ((eol = memchr(pos, '\n', end - pos)) == NULL)
+			break;
+		line = g_strndup(pos, eol - pos);
+		if ((sscanf(line, "%c %ld %ld", &op, &offset, &count) != 3) ||
+				(offset < 0) || (count < 0) || (offset > chars)) {
+			g_free(line);
+			break;
+		}
+		g_free(line);
+		pos = eol + 1;
+		start = g_utf8_offset_to_pointer(contents->str, offset) -
+			contents->str;
+
+		// Apply it.
+		if (op == 'I') {
+			// Inserted text is followed by a newline we added.
+			if (((gsize)(end - pos) < (gsize)count + 1) ||
+					(pos[count] != '\n') ||
+					!g_utf8_validate(pos, count, NULL)) {
+				break;
+			}
+
+			g_string_insert_len(contents, start, pos, count);
+			chars += g_utf8_strlen(pos, count);
+			pos += count + 1;
+		} else if ((op == 'D') && (offset + count <= chars)) {
+			gsize stop = g_utf8_offset_to_pointer(contents->str + start,
+												  count) - contents->str;
+
+			g_string_erase(contents, start, stop - start);
+			chars -= count;
+		} else {
+			break;
+		}
+
+		applied = true;
+	}
+
+	return applied;
+}
+
+/**
+ * Writes the header of a journal.
+ *
+ * @param  journal Journal to be written to.
+ * @param  base    Contents that the edits will be applied to.
+ * @param  length  Length of the contents.
+ * @param  error   Return location for a GError.
+ * @return         TRUE if the operation was successful.
+ */
+bool journal_write_header(journal_t *journal, const char *base, gsize length,
+						  GError **error) {
+	char *checksum;
+
+	checksum = g_compute_checksum_for_data(G_CHECKSUM_SHA1,
+										   (const guchar*)base, length);
+	fprintf(journal->fh, "%s\n%s\n", JOURNAL_MAGIC, checksum);
+	g_free(checksum);
+
+	journal->dirty = true;
+	return journal_sync(journal, error);
+}
+
+/**
+ * Gets the path of the journal of a page.
+ *
+ * @param  dir   Folder where the journals are kept.
+ * @param  fpath Path to the page file.
+ * @return       Newly allocated path. Free it with g_free().
+ */
+char* journal_path(const char *dir, const char *fpath) {
+	char *hash;
+	char *fname;
+	char *path;
+
+	hash = g_compute_checksum_for_string(G_CHECKSUM_SHA1, fpath, -1);
+	fname = g_strconcat(hash, JOURNAL_EXT, NULL);
+	path = g_build_filename(dir, fname, NULL);
+	g_free(hash);
+	g_free(fname);
+
+	return path;
+}
+
+/**
+ * Sets an error from an errno value.
+ *
+ * @param error Return location for a GError.
+ * @param fpath File that we failed to operate on.
+ * @param err   Value of errno.
+ */
+void journal_set_error(GError **error, const char *fpath, int err) {
+	g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(err),
+				"Failed to write the journal '%s': %s", fpath, g_strerror(err));
+}
@@ -0,0 +1,37 @@
+/**
+ * Journal.h
+ * Crash-safe append-only journal of the edits made to a page.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _JOURNAL_H_
+#define _JOURNAL_H_
+
+#include <glib.h>
+#include <stdbool.h>
+
+// Seconds between the journal being flushed to disk.
+#define JOURNAL_SYNC_INTERVAL 2
+
+// Opaque journal of an open page.
+typedef struct _journal_t journal_t;
+
+// Opening and closing.
+journal_t* journal_open(const char *dir, const char *fpath, const char *base,
+						gsize length, GError **error);
+void journal_close(journal_t *journal, bool discard);
+bool journal_compact(journal_t *journal, const char *base, gsize length,
+					 GError **error);
+
+// Recording.
+void journal_insert(journal_t *journal, glong offset, const char *text,
+					gsize length);
+void journal_delete(journal_t *journal, glong offset, glong count);
+bool journal_sync(journal_t *journal, GError **error);
+
+// Recovery.
+char* journal_recover(const char *dir, const char *fpath, const char *base,
+					  gsize length, gsize *recovered);
+
+#endif /* _JOURNAL_H_ */
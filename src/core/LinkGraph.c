@@ -0,0 +1,700 @@
+/**
+ * LinkGraph.c
+ * Workspace-wide graph of the links between articles.
+ *
+ * Links are extracted from the sources of every article in parallel and
+ * resolved relative to the folder of the article, the same way the browser
+ * resolves them in the rendered page. Links to other articles become the edges
+ * of the graph, while links to files that don't exist are kept around as
+ * broken links. The graph of a workspace that was just opened is built in the
+ * background and only swapped in once it's complete, while articles saved in
+ * the meantime are brought up to date right after.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include <string.h>
+#include "LinkGraph.h"
+#include "Arena.h"
+#include "Intern.h"
+#include "PageIndex.h"
+#include "Stats.h"
+#include "Wiki.h"
+
+// Link graph being built.
+typedef struct {
+	GPtrArray *links;
+	GPtrArray *backlinks;
+	GPtrArray *strings;
+	GAsyncQueue *arenas;
+	GCancellable *cancellable;
+	gint64 start;
+} link_build_t;
+
+// Private variables.
+GPtrArray *graph_links = NULL;
+GPtrArray *graph_backlinks = NULL;
+GPtrArray *graph_strings = NULL;
+link_build_t *graph_pending = NULL;
+GArray *graph_stale = NULL;
+bool graph_running = false;
+GMutex graph_lock;
+GCond graph_finished;
+
+// Private methods.
+link_build_t* link_build_new(GCancellable *cancellable);
+void link_build_free(gpointer data);
+void link_graph_collect(link_build_t *build);
+void link_graph_install(link_build_t *build);
+void link_graph_build_worker(GTask *task, gpointer source, gpointer task_data,
+							 GCancellable *cancellable);
+void link_graph_worker(gpointer data, gpointer user_data);
+GArray* link_graph_extract(page_t page, const char *contents,
+						   GStringChunk *strings);
+bool link_graph_resolve(const char *href, const char *src_dir, link_t *link);
+void link_graph_link_backlinks(GPtrArray *links, GPtrArray *backlinks,
+							   size_t source);
+void link_graph_unlink_backlinks(size_t source);
+bool link_graph_find_backlink(GArray *backlinks, size_t source, guint *pos);
+GArray* link_array_new();
+void link_array_free(gpointer data);
+void link_strings_free(gpointer data);
+
+/**
+ * Builds the link graph of the whole workspace.
+ */
+void link_graph_build() {
+	link_build_t *build;
+
+	link_graph_clear();
+	build = link_build_new(NULL);
+	link_graph_collect(build);
+	link_graph_install(build);
+	link_build_free(build);
+}
+
+/**
+ * Builds the link graph of the whole workspace in the background. The graph
+ * is pending until the callback calls link_graph_build_finish().
+ *
+ * @param callback Function called once the graph has been built.
+ * @param data     Data to be passed to the callback.
+ */
+void link_graph_build_async(GAsyncReadyCallback callback, gpointer data) {
+	GTask *task;
+
+	// Start from scratch.
+	link_graph_clear();
+	graph_pending = link_build_new(g_cancellable_new());
+	graph_running = true;
+
+	// Send it to the background.
+	task = g_task_new(NULL, graph_pending->cancellable, callback, data);
+	g_task_set_task_data(task, graph_pending, link_build_free);
+	g_task_run_in_thread(task, link_graph_build_worker);
+	g_object_unref(task);
+}
+
+/**
+ * Puts the link graph that was built in the background in place.
+ *
+ * @param  result Result passed to the callback of link_graph_build_async().
+ * @return        TRUE if the graph is now available. FALSE if it was thrown
+ *                away in the meantime.
+ */
+bool link_graph_build_finish(GAsyncResult *result) {
+	link_build_t *build = g_task_get_task_data(G_TASK(result));
+
+	// Check if it's still the one we are waiting for.
+	if (build != graph_pending)
+		return false;
+
+	graph_pending = NULL;
+	link_graph_install(build);
+
+	return true;
+}
+
+/**
+ * Frees the link graph, stopping it from being built if needed.
+ */
+void link_graph_clear() {
+	// Whatever is being built belongs to what we are getting rid of. (The
+	// worker still needs the workspace, so wait for it to give up)
+	if (graph_pending != NULL) {
+		g_cancellable_cancel(graph_pending->cancellable);
+		g_mutex_lock(&graph_lock);
+		while (graph_running)
+			g_cond_wait(&graph_finished, &graph_lock);
+		g_mutex_unlock(&graph_lock);
+		graph_pending = NULL;
+	}
+
+	if (graph_backlinks != NULL)
+		g_ptr_array_unref(graph_backlinks);
+	if (graph_links != NULL)
+		g_ptr_array_unref(graph_links);
+	if (graph_strings != NULL)
+		g_ptr_array_unref(graph_strings);
+	if (graph_stale != NULL)
+		g_array_free(graph_stale, true);
+
+	graph_backlinks = NULL;
+	graph_links = NULL;
+	graph_strings = NULL;
+	graph_stale = NULL;
+}
+
+/**
+ * Checks if the link graph is still being built.
+ *
+ * @return TRUE if the link graph will be available later.
+ */
+bool link_graph_is_pending() {
+	return graph_pending != NULL;
+}
+
+/**
+ * Updates the links of a single article after it has been changed.
+ *
+ * @param page     Article that was changed.
+ * @param contents New contents of the article.
+ */
+void link_graph_update(page_t page, const char *contents) {
+	size_t index = (size_t)page.index;
+
+	// Bring it up to date once the graph is ready.
+	if (link_graph_is_pending() && (page.type == PAGE_TYPE_ARTICLE) &&
+			(page.index >= 0)) {
+		if (graph_stale == NULL)
+			graph_stale = g_array_new(false, false, sizeof(size_t));
+		g_array_append_val(graph_stale, index);
+
+		return;
+	}
+
+	// Check if the page is part of the graph.
+	if (!link_graph_is_built() || (page.type != PAGE_TYPE_ARTICLE) ||
+			(page.index < 0) || (index >= graph_links->len)) {
+		return;
+	}
+
+	// Replace its links. (Their strings belong to the article from now on, so
+	// that editing doesn't keep growing the workspace intern table)
+	link_graph_unlink_backlinks(index);
+	link_array_free(g_ptr_array_index(graph_links, index));
+	link_strings_free(g_ptr_array_index(graph_strings, index));
+	g_ptr_array_index(graph_strings, index) = g_string_chunk_new(64);
+	g_ptr_array_index(graph_links, index) = link_graph_extract(page, contents,
+		g_ptr_array_index(graph_strings, index));
+	link_graph_link_backlinks(graph_links, graph_backlinks, index);
+}
+
+/**
+ * Checks if the link graph has been built.
+ *
+ * @return TRUE if the link graph is available.
+ */
+bool link_graph_is_built() {
+	return graph_links != NULL;
+}
+
+/**
+ * Gets the links of an article.
+ *
+ * @param  page Article reference.
+ * @return      Array of link_t owned by the graph or NULL if the page isn't
+ *              part of the graph.
+ */
+GArray* link_graph_links(page_t page) {
+	if (!link_graph_is_built() || (page.type != PAGE_TYPE_ARTICLE) ||
+			(page.index < 0) || ((size_t)page.index >= graph_links->len)) {
+		return NULL;
+	}
+
+	return g_ptr_array_index(graph_links, page.index);
+}
+
+/**
+ * Gets the articles that link to an article.
+ *
+ * @param  page Article reference.
+ * @return      Sorted array of article indexes (size_t) owned by the graph or
+ *              NULL if the page isn't part of the graph.
+ */
+GArray* link_graph_backlinks(page_t page) {
+	if (!link_graph_is_built() || (page.type != PAGE_TYPE_ARTICLE) ||
+			(page.index < 0) || ((size_t)page.index >= graph_backlinks->len)) {
+		return NULL;
+	}
+
+	return g_ptr_array_index(graph_backlinks, page.index);
+}
+
+/**
+ * Goes through every broken link in the workspace.
+ *
+ * @param  callback Function called for each broken link.
+ * @param  data     Data to be passed to the callback.
+ * @return          Number of broken links.
+ */
+size_t link_graph_broken(link_func callback, gpointer data) {
+	size_t count = 0;
+
+	if (!link_graph_is_built())
+		return 0;
+
+	for (size_t i = 0; i < graph_links->len; i++) {
+		GArray *links = g_ptr_array_index(graph_links, i);
+
+		for (guint j = 0; j < links->len; j++) {
+			link_t *link = &g_array_index(links, link_t, j);
+
+			if (link->broken) {
+				callback(page_article(i), link, data);
+				count++;
+			}
+		}
+	}
+
+	return count;
+}
+
+/**
+ * Goes through every article that no other article links to.
+ *
+ * @param  callback Function called for each orphan article.
+ * @param  data     Data to be passed to the callback.
+ * @return          Number of orphan articles.
+ */
+size_t link_graph_orphans(link_page_func callback, gpointer data) {
+	size_t count = 0;
+
+	if (!link_graph_is_built())
+		return 0;
+
+	for (size_t i = 0; i < graph_backlinks->len; i++) {
+		GArray *backlinks = g_ptr_array_index(graph_backlinks, i);
+
+		if (backlinks->len == 0) {
+			callback(page_article(i), data);
+			count++;
+		}
+	}
+
+	return count;
+}
+
+/**
+ * Gets the number of links in the graph.
+ *
+ * @return Number of links to articles and broken links.
+ */
+size_t link_graph_size() {
+	size_t count = 0;
+
+	if (!link_graph_is_built())
+		return 0;
+
+	for (size_t i = 0; i < graph_links->len; i++)
+		count += ((GArray*)g_ptr_array_index(graph_links, i))->len;
+
+	return count;
+}
+
+/**
+ * Allocates a link graph to be built.
+ *
+ * @param  cancellable Cancellable of the build or NULL. (Taken over)
+ * @return             Empty link graph with every article slot in place.
+ */
+link_build_t* link_build_new(GCancellable *cancellable) {
+	link_build_t *build;
+	size_t count;
+
+	count = wiki_pages_available(PAGE_TYPE_ARTICLE);
+	build = g_new0(link_build_t, 1);
+	build->cancellable = cancellable;
+	build->start = g_get_monotonic_time();
+
+	build->links = g_ptr_array_new_full(count, link_array_free);
+	g_ptr_array_set_size(build->links, count);
+	build->strings = g_ptr_array_new_full(count, link_strings_free);
+	g_ptr_array_set_size(build->strings, count);
+	build->backlinks = g_ptr_array_new_full(count,
+											(GDestroyNotify)g_array_unref);
+	for (size_t i = 0; i < count; i++)
+		g_ptr_array_add(build->backlinks, g_array_new(false, false,
+													  sizeof(size_t)));
+
+	return build;
+}
+
+/**
+ * Frees whatever is left of a link graph that was built.
+ *
+ * @param data Link graph being built.
+ */
+void link_build_free(gpointer data) {
+	link_build_t *build = data;
+
+	if (build->backlinks != NULL)
+		g_ptr_array_unref(build->backlinks);
+	if (build->links != NULL)
+		g_ptr_array_unref(build->links);
+	if (build->strings != NULL)
+		g_ptr_array_unref(build->strings);
+	if (build->cancellable != NULL)
+		g_object_unref(build->cancellable);
+
+	g_free(build);
+}
+
+/**
+ * Extracts the links of every article and reverses the edges.
+ *
+ * @param build Link graph to be built.
+ */
+void link_graph_collect(link_build_t *build) {
+	GThreadPool *pool;
+	arena_t *arena;
+	guint workers;
+	size_t count;
+
+	count = build->links->len;
+
+	// Give every worker an arena to read the sources into.
+	workers = g_get_num_processors();
+	build->arenas = g_async_queue_new();
+	for (guint i = 0; i < workers; i++)
+		g_async_queue_push(build->arenas, arena_new(0));
+
+	// Extract the links in parallel. (Each worker only touches its own slot)
+	pool = g_thread_pool_new(link_graph_worker, build, workers, true, NULL);
+	stats_add(STAT_PENDING_JOBS, count);
+	for (size_t i = 0; i < count; i++) {
+		if (pool != NULL) {
+			g_thread_pool_push(pool, GSIZE_TO_POINTER(i + 1), NULL);
+		} else {
+			link_graph_worker(GSIZE_TO_POINTER(i + 1), build);
+		}
+	}
+	if (pool != NULL)
+		g_thread_pool_free(pool, false, true);
+
+	// Release the arenas.
+	while ((arena = g_async_queue_try_pop(build->arenas)) != NULL)
+		arena_free(arena);
+	g_async_queue_unref(build->arenas);
+	build->arenas = NULL;
+
+	// Reverse the edges.
+	if (g_cancellable_is_cancelled(build->cancellable))
+		return;
+	for (size_t i = 0; i < count; i++)
+		link_graph_link_backlinks(build->links, build->backlinks, i);
+}
+
+/**
+ * Puts a link graph that was built in place.
+ *
+ * @param build Link graph that was built. (Its arrays are taken over)
+ */
+void link_graph_install(link_build_t *build) {
+	GArray *stale;
+
+	graph_links = build->links;
+	graph_backlinks = build->backlinks;
+	graph_strings = build->strings;
+	build->links = NULL;
+	build->backlinks = NULL;
+	build->strings = NULL;
+	stats_record(STAT_LINK_GRAPH_TIME, g_get_monotonic_time() - build->start);
+
+	// Catch up with the articles that were saved while it was being built.
+	if ((stale = graph_stale) == NULL)
+		return;
+	graph_stale = NULL;
+	for (guint i = 0; i < stale->len; i++) {
+		page_t page = page_article(g_array_index(stale, size_t, i));
+		char *contents;
+
+		if (page_read(page, &contents, NULL, NULL)) {
+			link_graph_update(page, contents);
+			g_free(contents);
+		}
+	}
+	g_array_free(stale, true);
+}
+
+/**
+ * Task that builds the link graph in the background.
+ *
+ * @param task        Task being run.
+ * @param source      Source object of the task.
+ * @param task_data   Link graph to be built.
+ * @param cancellable Cancellable of the task.
+ */
+void link_graph_build_worker(GTask *task, gpointer source, gpointer task_data,
+							 GCancellable *cancellable) {
+	link_graph_collect(task_data);
+
+	// Let anyone waiting for us to give up know that we are done.
+	g_mutex_lock(&graph_lock);
+	graph_running = false;
+	g_cond_broadcast(&graph_finished);
+	g_mutex_unlock(&graph_lock);
+
+	g_task_return_boolean(task, true);
+}
+
+/**
+ * Thread pool worker that extracts the links of a single article.
+ *
+ * @param data      Index of the article plus one.
+ * @param user_data Link graph being built.
+ */
+void link_graph_worker(gpointer data, gpointer user_data) {
+	size_t index = GPOINTER_TO_SIZE(data) - 1;
+	page_t page = page_article(index);
+	link_build_t *build = user_data;
+	arena_t *arena;
+	char *contents;
+
+	// Borrow an arena. (There's one for every thread in the pool)
+	arena = g_async_queue_pop(build->arenas);
+
+	// Make sure we always leave something in our slot.
+	if (!g_cancellable_is_cancelled(build->cancellable) &&
+			page_read_arena(page, arena, &contents, NULL, NULL)) {
+		g_ptr_array_index(build->links, index) = link_graph_extract(page,
+			contents, NULL);
+	} else {
+		g_ptr_array_index(build->links, index) = link_array_new();
+	}
+
+	// Give it back empty.
+	arena_reset(arena);
+	g_async_queue_push(build->arenas, arena);
+
+	stats_add(STAT_PENDING_JOBS, -1);
+}
+
+/**
+ * Extracts the links from the contents of an article.
+ *
+ * @param  page     Article reference.
+ * @param  contents Contents of the article.
+ * @param  strings  Where to store the links or NULL to intern them.
+ * @return          Array of links to articles and broken links.
+ */
+GArray* link_graph_extract(page_t page, const char *contents,
+						   GStringChunk *strings) {
+	const char *attrs[] = { "href=", "src=" };
+	char fpath[UKI_MAX_PATH];
+	GArray *links;
+	char *canon;
+	char *src_dir;
+
+	// Get the folder that links are relative to.
+	links = link_array_new();
+	if (page_fpath(fpath, page) != UKI_OK)
+		return links;
+	canon = g_canonicalize_filename(fpath, NULL);
+	src_dir = g_path_get_dirname(canon);
+	g_free(canon);
+
+	for (size_t a = 0; a < G_N_ELEMENTS(attrs); a++) {
+		const char *pos = contents;
+		const char *counted = contents;
+		size_t line = 1;
+
+		while ((pos = strstr(pos, attrs[a])) != NULL) {
+			const char *end;
+			link_t link;
+			char *href;
+			char quote;
+
+			// Get the quoted attribute value.
+			pos += strlen(attrs[a]);
+			quote = *pos;
+			if ((quote != '"') && (quote != '\''))
+				continue;
+			pos++;
+			if ((end = strchr(pos, quote)) == NULL)
+				break;
+
+			// Keep track of the line we are in.
+			for (; counted < pos; counted++) {
+				if (*counted == '\n')
+					line++;
+			}
+
+			// Resolve the link and keep it if it matters. (Links to the same
+			// place share their string)
+			href = g_strndup(pos, end - pos);
+			link.line = line;
+			if (link_graph_resolve(href, src_dir, &link)) {
+				link.href = (strings == NULL) ? intern_string(href) :
+					g_string_chunk_insert_const(strings, href);
+				g_array_append_val(links, link);
+			}
+			g_free(href);
+
+			pos = end + 1;
+		}
+	}
+
+	g_free(src_dir);
+	return links;
+}
+
+/**
+ * Resolves where a link points to.
+ *
+ * @param  href    Link as written in the page.
+ * @param  src_dir Folder of the page that contains the link.
+ * @param  link    Link to have its target and broken state set.
+ * @return         TRUE if the link points to an article or is broken.
+ */
+bool link_graph_resolve(const char *href, const char *src_dir, link_t *link) {
+	page_t target;
+	char *path;
+	char *fpath;
+
+	link->target = page_none();
+	link->broken = false;
+
+	// Ignore URLs, anchors, and absolute paths.
+	if ((href[0] == '\0') || (href[0] == '#') || (href[0] == '/') ||
+			(href[0] == '?') || (strchr(href, ':') != NULL)) {
+		return false;
+	}
+
+	// Drop any query or fragment and resolve the path.
+	path = g_strndup(href, strcspn(href, "?#"));
+	fpath = g_uri_unescape_string(path, NULL);
+	g_free(path);
+	if (fpath == NULL) {
+		link->broken = true;
+		return true;
+	}
+	path = g_canonicalize_filename(fpath, src_dir);
+	g_free(fpath);
+
+	// Check if it's an article or at least something that exists.
+	if (page_index_lookup_path(path, &target) &&
+			(target.type == PAGE_TYPE_ARTICLE)) {
+		link->target = target;
+	} else {
+		link->broken = !g_file_test(path, G_FILE_TEST_EXISTS);
+	}
+
+	g_free(path);
+	return page_is_valid(link->target) || link->broken;
+}
+
+/**
+ * Adds the backlinks that an article creates to the articles it links to.
+ *
+ * @param links     Links of every article.
+ * @param backlinks Backlinks of every article.
+ * @param source    Index of the article.
+ */
+void link_graph_link_backlinks(GPtrArray *links, GPtrArray *backlinks,
+							   size_t source) {
+	GArray *targets = g_ptr_array_index(links, source);
+
+	for (guint i = 0; i < targets->len; i++) {
+		page_t target = g_array_index(targets, link_t, i).target;
+		GArray *sources;
+		guint pos;
+
+		// Ignore broken links and links to itself.
+		if (!page_is_valid(target) || ((size_t)target.index == source))
+			continue;
+
+		// Keep the backlinks sorted and without duplicates.
+		sources = g_ptr_array_index(backlinks, target.index);
+		if (!link_graph_find_backlink(sources, source, &pos))
+			g_array_insert_val(sources, pos, source);
+	}
+}
+
+/**
+ * Removes the backlinks that an article created to the articles it links to.
+ *
+ * @param source Index of the article.
+ */
+void link_graph_unlink_backlinks(size_t source) {
+	GArray *links = g_ptr_array_index(graph_links, source);
+
+	for (guint i = 0; i < links->len; i++) {
+		page_t target = g_array_index(links, link_t, i).target;
+		GArray *backlinks;
+		guint pos;
+
+		if (!page_is_valid(target))
+			continue;
+
+		backlinks = g_ptr_array_index(graph_backlinks, target.index);
+		if (link_graph_find_backlink(backlinks, source, &pos))
+			g_array_remove_index(backlinks, pos);
+	}
+}
+
+/**
+ * Finds an article in a sorted array of backlinks.
+ *
+ * @param  backlinks Sorted array of article indexes.
+ * @param  source    Index of the article to find.
+ * @param  pos       Pointer to store the position where it is or should be.
+ * @return           TRUE if the article was found.
+ */
+bool link_graph_find_backlink(GArray *backlinks, size_t source, guint *pos) {
+	guint low = 0;
+	guint high = backlinks->len;
+
+	while (low < high) {
+		guint mid = low + ((high - low) / 2);
+
+		if (g_array_index(backlinks, size_t, mid) < source) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	*pos = low;
+	return (low < backlinks->len) &&
+		(g_array_index(backlinks, size_t, low) == source);
+}
+
+/**
+ * Creates an empty array of links.
+ *
+ * @return Empty array of link_t.
+ */
+GArray* link_array_new() {
+	return g_array_new(false, false, sizeof(link_t));
+}
+
+/**
+ * Frees an array of links.
+ *
+ * @param data Array of link_t. (May be NULL)
+ */
+void link_array_free(gpointer data) {
+	if (data != NULL)
+		g_array_unref((GArray*)data);
+}
+
+/**
+ * Frees the strings of the links of an article.
+ *
+ * @param data String chunk of the article. (May be NULL)
+ */
+void link_strings_free(gpointer data) {
+	if (data != NULL)
+		g_string_chunk_free((GStringChunk*)data);
+}
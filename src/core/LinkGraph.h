@@ -0,0 +1,44 @@
+/**
+ * LinkGraph.h
+ * Workspace-wide graph of the links between articles.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _LINKGRAPH_H_
+#define _LINKGRAPH_H_
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <stdbool.h>
+#include "Page.h"
+
+// Link found in an article.
+typedef struct {
+	const char *href;
+	size_t line;
+	page_t target;
+	bool broken;
+} link_t;
+
+// Link and page callbacks.
+typedef void (*link_func)(page_t source, const link_t *link, gpointer data);
+typedef void (*link_page_func)(page_t page, gpointer data);
+
+// Building.
+void link_graph_build();
+void link_graph_build_async(GAsyncReadyCallback callback, gpointer data);
+bool link_graph_build_finish(GAsyncResult *result);
+void link_graph_clear();
+void link_graph_update(page_t page, const char *contents);
+bool link_graph_is_built();
+bool link_graph_is_pending();
+
+// Querying.
+GArray* link_graph_links(page_t page);
+GArray* link_graph_backlinks(page_t page);
+size_t link_graph_broken(link_func callback, gpointer data);
+size_t link_graph_orphans(link_page_func callback, gpointer data);
+size_t link_graph_size();
+
+#endif /* _LINKGRAPH_H_ */
@@ -0,0 +1,251 @@
+/**
+ * Manifest.c
+ * Export manifest that remembers what was rendered in the previous run.
+ *
+ * The manifest is a key file with a group for each exported page, holding its
+ * path relative to the output directory, the hash of its source, the combined
+ * hash of every template it transitively uses, the hash of the rendered
+ * output, and the assets it referenced. Groups are named after the hash of the
+ * path, since key files don't allow every character a path may have in them.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include <string.h>
+#include "Manifest.h"
+
+// Key names.
+#define KEY_PATH      "path"
+#define KEY_SOURCE    "source"
+#define KEY_TEMPLATES "templates"
+#define KEY_OUTPUT    "output"
+#define KEY_ASSETS    "assets"
+
+// Private methods.
+bool manifest_path_is_safe(const char *relpath);
+char** manifest_safe_paths(char **paths);
+
+/**
+ * Creates an empty manifest.
+ *
+ * @return Hash table of page paths to manifest_entry_t.
+ */
+GHashTable* manifest_new() {
+	return g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+								 manifest_entry_free);
+}
+
+/**
+ * Loads a manifest from a file.
+ *
+ * @param  fpath Path to the manifest file.
+ * @return       Loaded manifest or an empty one if it couldn't be read.
+ */
+GHashTable* manifest_load(const char *fpath) {
+	GHashTable *manifest;
+	GKeyFile *keyfile;
+	gchar **groups;
+
+	// Read the key file.
+	manifest = manifest_new();
+	keyfile = g_key_file_new();
+	if (!g_key_file_load_from_file(keyfile, fpath, G_KEY_FILE_NONE, NULL)) {
+		g_key_file_free(keyfile);
+		return manifest;
+	}
+
+	// Go through the pages.
+	groups = g_key_file_get_groups(keyfile, NULL);
+	for (gchar **group = groups; *group != NULL; group++) {
+		manifest_entry_t *entry;
+		char *relpath;
+
+		// Manifests from before the paths were stored are simply left behind.
+		relpath = g_key_file_get_string(keyfile, *group, KEY_PATH, NULL);
+		if (relpath == NULL)
+			continue;
+
+		entry = g_new0(manifest_entry_t, 1);
+		entry->source = g_key_file_get_string(keyfile, *group, KEY_SOURCE,
+											  NULL);
+		entry->templates = g_key_file_get_string(keyfile, *group,
+												 KEY_TEMPLATES, NULL);
+		entry->output = g_key_file_get_string(keyfile, *group, KEY_OUTPUT,
+											  NULL);
+		entry->assets = g_key_file_get_string_list(keyfile, *group,
+												   KEY_ASSETS, NULL, NULL);
+
+		// Never trust paths that could point outside the output directory.
+		if (!manifest_path_is_safe(relpath)) {
+			manifest_entry_free(entry);
+			g_free(relpath);
+			continue;
+		}
+		entry->assets = manifest_safe_paths(entry->assets);
+
+		// Ignore incomplete entries so that they get rendered again.
+		if ((entry->source == NULL) || (entry->templates == NULL)) {
+			manifest_entry_free(entry);
+			g_free(relpath);
+			continue;
+		}
+
+		g_hash_table_insert(manifest, relpath, entry);
+	}
+
+	g_strfreev(groups);
+	g_key_file_free(keyfile);
+
+	return manifest;
+}
+
+/**
+ * Checks if a path from the manifest stays inside the output directory, which
+ * means it's relative and has no parent directory references.
+ *
+ * @param  relpath Path relative to the output directory.
+ * @return         TRUE if the path is safe to be used.
+ */
+bool manifest_path_is_safe(const char *relpath) {
+	gchar **parts;
+	bool safe = true;
+
+	if ((*relpath == '\0') || g_path_is_absolute(relpath))
+		return false;
+
+	// Look for any parent directory references.
+	parts = g_strsplit_set(relpath, "/\\", -1);
+	for (gchar **part = parts; *part != NULL; part++) {
+		if (strcmp(*part, "..") == 0) {
+			safe = false;
+			break;
+		}
+	}
+	g_strfreev(parts);
+
+	return safe;
+}
+
+/**
+ * Drops the unsafe paths from a list.
+ *
+ * @param  paths NULL-terminated list of paths. Will be freed.
+ * @return       List with only the safe paths. Free it with g_strfreev().
+ */
+char** manifest_safe_paths(char **paths) {
+	GPtrArray *safe;
+
+	if (paths == NULL)
+		return NULL;
+
+	safe = g_ptr_array_new();
+	for (char **path = paths; *path != NULL; path++) {
+		if (manifest_path_is_safe(*path)) {
+			g_ptr_array_add(safe, *path);
+		} else {
+			g_free(*path);
+		}
+	}
+	g_ptr_array_add(safe, NULL);
+	g_free(paths);
+
+	return (char**)g_ptr_array_free(safe, false);
+}
+
+/**
+ * Saves a manifest to a file.
+ *
+ * @param  manifest Manifest to be saved.
+ * @param  fpath    Path to the manifest file.
+ * @param  error    Return location for a GError.
+ * @return          TRUE if the operation was successful.
+ */
+bool manifest_save(GHashTable *manifest, const char *fpath, GError **error) {
+	GHashTableIter iter;
+	GKeyFile *keyfile;
+	gpointer key;
+	gpointer value;
+	gchar *data;
+	gsize length;
+	bool success;
+
+	// Build the key file.
+	keyfile = g_key_file_new();
+	g_hash_table_iter_init(&iter, manifest);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		manifest_entry_t *entry = (manifest_entry_t*)value;
+		gchar *group;
+
+		group = g_compute_checksum_for_string(G_CHECKSUM_SHA1, key, -1);
+		g_key_file_set_string(keyfile, group, KEY_PATH, key);
+		g_key_file_set_string(keyfile, group, KEY_SOURCE, entry->source);
+		g_key_file_set_string(keyfile, group, KEY_TEMPLATES,
+							  entry->templates);
+		if (entry->output != NULL)
+			g_key_file_set_string(keyfile, group, KEY_OUTPUT, entry->output);
+		if ((entry->assets != NULL) && (entry->assets[0] != NULL)) {
+			g_key_file_set_string_list(keyfile, group, KEY_ASSETS,
+				(const gchar * const*)entry->assets,
+				g_strv_length(entry->assets));
+		}
+		g_free(group);
+	}
+
+	// Write it out.
+	data = g_key_file_to_data(keyfile, &length, NULL);
+	success = g_file_set_contents(fpath, data, length, error);
+	g_free(data);
+	g_key_file_free(keyfile);
+
+	return success;
+}
+
+/**
+ * Creates a new manifest entry.
+ *
+ * @param  source    Hash of the page source.
+ * @param  templates Combined hash of the templates used by the page.
+ * @param  output    Hash of the rendered page.
+ * @param  assets    NULL-terminated array of assets used by the page.
+ * @return           Newly allocated entry. Free it with manifest_entry_free().
+ */
+manifest_entry_t* manifest_entry_new(const char *source, const char *templates,
+									 const char *output, char **assets) {
+	manifest_entry_t *entry = g_new0(manifest_entry_t, 1);
+
+	entry->source = g_strdup(source);
+	entry->templates = g_strdup(templates);
+	entry->output = g_strdup(output);
+	entry->assets = g_strdupv(assets);
+
+	return entry;
+}
+
+/**
+ * Duplicates a manifest entry.
+ *
+ * @param  entry Entry to be duplicated.
+ * @return       Newly allocated entry. Free it with manifest_entry_free().
+ */
+manifest_entry_t* manifest_entry_copy(const manifest_entry_t *entry) {
+	return manifest_entry_new(entry->source, entry->templates, entry->output,
+							  entry->assets);
+}
+
+/**
+ * Frees a manifest entry.
+ *
+ * @param entry Entry to be freed.
+ */
+void manifest_entry_free(gpointer entry) {
+	manifest_entry_t *e = (manifest_entry_t*)entry;
+
+	if (e == NULL)
+		return;
+
+	g_free(e->source);
+	g_free(e->templates);
+	g_free(e->output);
+	g_strfreev(e->assets);
+	g_free(e);
+}
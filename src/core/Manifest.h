@@ -0,0 +1,36 @@
+/**
+ * Manifest.h
+ * Export manifest that remembers what was rendered in the previous run.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _MANIFEST_H_
+#define _MANIFEST_H_
+
+#include <glib.h>
+#include <stdbool.h>
+
+// Manifest file name inside the output directory.
+#define MANIFEST_FNAME ".guki-manifest"
+
+// State of a single exported page.
+typedef struct {
+	char *source;
+	char *templates;
+	char *output;
+	char **assets;
+} manifest_entry_t;
+
+// Manifest.
+GHashTable* manifest_new();
+GHashTable* manifest_load(const char *fpath);
+bool manifest_save(GHashTable *manifest, const char *fpath, GError **error);
+
+// Entries.
+manifest_entry_t* manifest_entry_new(const char *source, const char *templates,
+									 const char *output, char **assets);
+manifest_entry_t* manifest_entry_copy(const manifest_entry_t *entry);
+void manifest_entry_free(gpointer entry);
+
+#endif /* _MANIFEST_H_ */
@@ -0,0 +1,378 @@
+/**
+ * Merge.c
+ * Three-way merge of two versions of a page that came from the same base.
+ *
+ * Both versions are compared against the base, and the changes of each side
+ * are walked in the order of the base. Changes that only one side made are
+ * taken as they are, while regions that both sides touched are only marked as
+ * a conflict if they ended up different.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include <string.h>
+#include "Merge.h"
+#include "Diff.h"
+#include "Stats.h"
+#include "Trace.h"
+
+// Versions to be merged in a worker thread.
+typedef struct {
+	GBytes *base;
+	GBytes *ours;
+	GBytes *theirs;
+} merge_request_t;
+
+// Private methods.
+GArray* merge_changes(diff_t *diff);
+void merge_side_range(GArray *changes, guint first, guint last, guint lo,
+					  guint hi, guint *start, guint *end);
+void merge_append_lines(GString *merged, const char *text, GArray *lines,
+						guint start, guint end);
+bool merge_same_lines(diff_t *ours, guint ostart, guint oend, diff_t *theirs,
+					  guint tstart, guint tend);
+void merge_append_conflict(GString *merged, diff_t *ours, guint ostart,
+						   guint oend, diff_t *theirs, guint tstart,
+						   guint tend);
+void merge_worker(GTask *task, gpointer source, gpointer task_data,
+				  GCancellable *cancellable);
+void merge_request_free(merge_request_t *request);
+
+/**
+ * Merges two versions of some text that were derived from the same base.
+ *
+ * @param  base          Common ancestor of both versions.
+ * @param  base_length   Length of the base.
+ * @param  ours          Our version.
+ * @param  ours_length   Length of our version.
+ * @param  theirs        Their version.
+ * @param  theirs_length Length of their version.
+ * @param  cancellable   Cancels the merge. (May be NULL)
+ * @param  error         Return location for a GError.
+ * @return               Merged text or NULL if an error occurred. Free it with
+ *                       merge_free().
+ */
+merge_t* merge_texts(const char *base, gsize base_length, const char *ours,
+					 gsize ours_length, const char *theirs,
+					 gsize theirs_length, GCancellable *cancellable,
+					 GError **error) {
+	diff_t *dours;
+	diff_t *dtheirs;
+	GArray *cours = NULL;
+	GArray *ctheirs = NULL;
+	GString *merged;
+	merge_t *merge = NULL;
+	guint io = 0;
+	guint it = 0;
+	guint pos = 0;
+
+	// Find out what each side changed.
+	TRACE_BEGIN("merge_texts");
+	dours = diff_new(g_strndup(base, base_length), base_length,
+					 g_strndup(ours, ours_length), ours_length);
+	dtheirs = diff_new(g_strndup(base, base_length), base_length,
+					   g_strndup(theirs, theirs_length), theirs_length);
+	if (!diff_compute(dours, cancellable, error) ||
+			!diff_compute(dtheirs, cancellable, error)) {
+		goto cleanup;
+	}
+	cours = merge_changes(dours);
+	ctheirs = merge_changes(dtheirs);
+
+	// Go through the changes in the order of the base.
+	merge = g_new0(merge_t, 1);
+	merged = g_string_sized_new(MAX(ours_length, theirs_length));
+	while ((io < cours->len) || (it < ctheirs->len)) {
+		diff_hunk_t *change;
+		guint ofirst = io;
+		guint tfirst = it;
+		guint ostart;
+		guint oend;
+		guint tstart;
+		guint tend;
+		guint lo;
+		guint hi;
+
+		// Start from whichever change comes first.
+		if ((it >= ctheirs->len) || ((io < cours->len) &&
+				(g_array_index(cours, diff_hunk_t, io).old_start <=
+				 g_array_index(ctheirs, diff_hunk_t, it).old_start))) {
+			change = &g_array_index(cours, diff_hunk_t, io++);
+		} else {
+			change = &g_array_index(ctheirs, diff_hunk_t, it++);
+		}
+		lo = change->old_start;
+		hi = change->old_start + change->old_count;
+
+		// Pull in every change from either side that touches the region.
+		for (;;) {
+			if ((io < cours->len) &&
+					(g_array_index(cours, diff_hunk_t, io).old_start <= hi)) {
+				change = &g_array_index(cours, diff_hunk_t, io++);
+			} else if ((it < ctheirs->len) &&
+					(g_array_index(ctheirs, diff_hunk_t, it).old_start <= hi)) {
+				change = &g_array_index(ctheirs, diff_hunk_t, it++);
+			} else {
+				break;
+			}
+
+			hi = MAX(hi, change->old_start + change->old_count);
+		}
+
+		// Copy what nobody touched and resolve the region.
+		merge_append_lines(merged, dours->old_text, dours->old_lines, pos, lo);
+		if (ofirst == io) {
+			merge_side_range(ctheirs, tfirst, it, lo, hi, &tstart, &tend);
+			merge_append_lines(merged, dtheirs->new_text, dtheirs->new_lines,
+							   tstart, tend);
+		} else if (tfirst == it) {
+			merge_side_range(cours, ofirst, io, lo, hi, &ostart, &oend);
+			merge_append_lines(merged, dours->new_text, dours->new_lines,
+							   ostart, oend);
+		} else {
+			merge_side_range(cours, ofirst, io, lo, hi, &ostart, &oend);
+			merge_side_range(ctheirs, tfirst, it, lo, hi, &tstart, &tend);
+			if (merge_same_lines(dours, ostart, oend, dtheirs, tstart, tend)) {
+				merge_append_lines(merged, dours->new_text, dours->new_lines,
+								   ostart, oend);
+			} else {
+				merge_append_conflict(merged, dours, ostart, oend, dtheirs,
+									  tstart, tend);
+				merge->conflicts++;
+			}
+		}
+
+		pos = hi;
+	}
+
+	// Copy whatever is left of the base.
+	merge_append_lines(merged, dours->old_text, dours->old_lines, pos,
+					   diff_line_count(dours, false));
+	merge->length = merged->len;
+	merge->text = g_string_free(merged, false);
+	stats_count(STAT_MERGES);
+	stats_add(STAT_MERGE_CONFLICTS, merge->conflicts);
+
+cleanup:
+	if (cours != NULL)
+		g_array_free(cours, true);
+	if (ctheirs != NULL)
+		g_array_free(ctheirs, true);
+	diff_free(dours);
+	diff_free(dtheirs);
+	TRACE_END("merge_texts");
+
+	return merge;
+}
+
+/**
+ * Merges two versions of some text in a worker thread.
+ *
+ * @param base        Common ancestor of both versions.
+ * @param ours        Our version.
+ * @param theirs      Their version.
+ * @param cancellable Cancels the merge. (May be NULL)
+ * @param callback    Called on the main loop once the merge is done.
+ * @param data        Data to be passed to the callback.
+ */
+void merge_texts_async(GBytes *base, GBytes *ours, GBytes *theirs,
+					   GCancellable *cancellable, GAsyncReadyCallback callback,
+					   gpointer data) {
+	merge_request_t *request;
+	GTask *task;
+
+	request = g_new(merge_request_t, 1);
+	request->base = g_bytes_ref(base);
+	request->ours = g_bytes_ref(ours);
+	request->theirs = g_bytes_ref(theirs);
+
+	task = g_task_new(NULL, cancellable, callback, data);
+	g_task_set_task_data(task, request, (GDestroyNotify)merge_request_free);
+	g_task_run_in_thread(task, merge_worker);
+	g_object_unref(task);
+}
+
+/**
+ * Gets the result of a merge made in a worker thread.
+ *
+ * @param  result Result passed to the callback.
+ * @param  error  Return location for a GError.
+ * @return        Merged text or NULL if it failed or was cancelled. Free it
+ *                with merge_free().
+ */
+merge_t* merge_texts_finish(GAsyncResult *result, GError **error) {
+	return g_task_propagate_pointer(G_TASK(result), error);
+}
+
+/**
+ * Frees the result of a merge.
+ *
+ * @param merge Merge to be freed. (May be NULL)
+ */
+void merge_free(merge_t *merge) {
+	if (merge == NULL)
+		return;
+
+	g_free(merge->text);
+	g_free(merge);
+}
+
+/**
+ * Gets the hunks of a diff that actually changed something.
+ *
+ * @param  diff Computed diff.
+ * @return      Array of diff_hunk_t.
+ */
+GArray* merge_changes(diff_t *diff) {
+	GArray *changes;
+	guint i;
+
+	changes = g_array_new(false, false, sizeof(diff_hunk_t));
+	for (i = 0; i < diff->hunks->len; i++) {
+		diff_hunk_t *hunk = &g_array_index(diff->hunks, diff_hunk_t, i);
+
+		if (hunk->op != DIFF_EQUAL)
+			g_array_append_val(changes, *hunk);
+	}
+
+	return changes;
+}
+
+/**
+ * Gets the lines of one side that correspond to a region of the base.
+ *
+ * @param changes Changes of the side.
+ * @param first   First change of the side inside the region.
+ * @param last    One past the last change of the side inside the region.
+ * @param lo      Start of the region in the base.
+ * @param hi      End of the region in the base.
+ * @param start   Pointer to store the start of the region in the side.
+ * @param end     Pointer to store the end of the region in the side.
+ */
+void merge_side_range(GArray *changes, guint first, guint last, guint lo,
+					  guint hi, guint *start, guint *end) {
+	diff_hunk_t *a = &g_array_index(changes, diff_hunk_t, first);
+	diff_hunk_t *b = &g_array_index(changes, diff_hunk_t, last - 1);
+
+	// Lines around the changes are the same as in the base.
+	*start = a->new_start - (a->old_start - lo);
+	*end = b->new_start + b->new_count + (hi - (b->old_start + b->old_count));
+}
+
+/**
+ * Appends a range of lines of some text.
+ *
+ * @param merged Merged text.
+ * @param text   Text the lines come from.
+ * @param lines  Offsets of the lines of the text.
+ * @param start  First line.
+ * @param end    One past the last line.
+ */
+void merge_append_lines(GString *merged, const char *text, GArray *lines,
+						guint start, guint end) {
+	gsize from = g_array_index(lines, gsize, start);
+	gsize to = g_array_index(lines, gsize, end);
+
+	g_string_append_len(merged, text + from, to - from);
+}
+
+/**
+ * Checks if both sides ended up with the same lines in a region.
+ *
+ * @param  ours   Diff of our side.
+ * @param  ostart Start of the region in our side.
+ * @param  oend   End of the region in our side.
+ * @param  theirs Diff of their side.
+ * @param  tstart Start of the region in their side.
+ * @param  tend   End of the region in their side.
+ * @return        TRUE if they are the same.
+ */
+bool merge_same_lines(diff_t *ours, guint ostart, guint oend, diff_t *theirs,
+					  guint tstart, guint tend) {
+	gsize ofrom = g_array_index(ours->new_lines, gsize, ostart);
+	gsize oto = g_array_index(ours->new_lines, gsize, oend);
+	gsize tfrom = g_array_index(theirs->new_lines, gsize, tstart);
+	gsize tto = g_array_index(theirs->new_lines, gsize, tend);
+
+	return (oto - ofrom == tto - tfrom) &&
+		(memcmp(ours->new_text + ofrom, theirs->new_text + tfrom,
+				oto - ofrom) == 0);
+}
+
+/**
+ * Appends a region that both sides changed differently, between conflict
+ * markers.
+ *
+ * @param merged Merged text.
+ * @param ours   Diff of our side.
+ * @param ostart Start of the region in our side.
+ * @param oend   End of the region in our side.
+ * @param theirs Diff of their side.
+ * @param tstart Start of the region in their side.
+ * @param tend   End of the region in their side.
+ */
+void merge_append_conflict(GString *merged, diff_t *ours, guint ostart,
+						   guint oend, diff_t *theirs, guint tstart,
+						   guint tend) {
+	// Markers must always start on their own line.
+	if ((merged->len > 0) && (merged->str[merged->len - 1] != '\n'))
+		g_string_append_c(merged, '\n');
+
+	g_string_append(merged, MERGE_MARKER_OURS "\n");
+	merge_append_lines(merged, ours->new_text, ours->new_lines, ostart, oend);
+	if ((merged->str[merged->len - 1] != '\n'))
+		g_string_append_c(merged, '\n');
+
+	g_string_append(merged, MERGE_MARKER_SPLIT "\n");
+	merge_append_lines(merged, theirs->new_text, theirs->new_lines, tstart,
+					   tend);
+	if ((merged->str[merged->len - 1] != '\n'))
+		g_string_append_c(merged, '\n');
+
+	g_string_append(merged, MERGE_MARKER_THEIRS "\n");
+}
+
+/**
+ * Worker that merges two versions.
+ *
+ * @param task        Task being run.
+ * @param source      Unused.
+ * @param task_data   Versions to be merged.
+ * @param cancellable Cancels the merge.
+ */
+void merge_worker(GTask *task, gpointer source, gpointer task_data,
+				  GCancellable *cancellable) {
+	merge_request_t *request = (merge_request_t*)task_data;
+	GError *error = NULL;
+	merge_t *merge;
+	const char *base;
+	const char *ours;
+	const char *theirs;
+	gsize base_length;
+	gsize ours_length;
+	gsize theirs_length;
+
+	base = g_bytes_get_data(request->base, &base_length);
+	ours = g_bytes_get_data(request->ours, &ours_length);
+	theirs = g_bytes_get_data(request->theirs, &theirs_length);
+	merge = merge_texts(base, base_length, ours, ours_length, theirs,
+						theirs_length, cancellable, &error);
+	if (merge == NULL) {
+		g_task_return_error(task, error);
+		return;
+	}
+
+	g_task_return_pointer(task, merge, (GDestroyNotify)merge_free);
+}
+
+/**
+ * Frees a merge request.
+ *
+ * @param request Request to be freed.
+ */
+void merge_request_free(merge_request_t *request) {
+	g_bytes_unref(request->base);
+	g_bytes_unref(request->ours);
+	g_bytes_unref(request->theirs);
+	g_free(request);
+}
@@ -0,0 +1,37 @@
+/**
+ * Merge.h
+ * Three-way merge of two versions of a page that came from the same base.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _MERGE_H_
+#define _MERGE_H_
+
+#include <gio/gio.h>
+#include <stdbool.h>
+
+// Conflict markers.
+#define MERGE_MARKER_OURS   "<<<<<<< Editor"
+#define MERGE_MARKER_SPLIT  "======="
+#define MERGE_MARKER_THEIRS ">>>>>>> On disk"
+
+// Result of a merge.
+typedef struct {
+	char *text;
+	gsize length;
+	guint conflicts;
+} merge_t;
+
+// Merging.
+merge_t* merge_texts(const char *base, gsize base_length, const char *ours,
+					 gsize ours_length, const char *theirs,
+					 gsize theirs_length, GCancellable *cancellable,
+					 GError **error);
+void merge_texts_async(GBytes *base, GBytes *ours, GBytes *theirs,
+					   GCancellable *cancellable, GAsyncReadyCallback callback,
+					   gpointer data);
+merge_t* merge_texts_finish(GAsyncResult *result, GError **error);
+void merge_free(merge_t *merge);
+
+#endif /* _MERGE_H_ */
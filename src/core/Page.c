@@ -0,0 +1,356 @@
+/**
+ * Page.c
+ * GTK-free helpers to reference, locate, read, and render Uki pages.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+#include "Page.h"
+#include "PageIndex.h"
+#include "Stats.h"
+#include "Trace.h"
+#include "Wiki.h"
+
+/**
+ * Creates an invalid page reference.
+ *
+ * @return Page reference that points to nothing.
+ */
+page_t page_none() {
+	page_t page;
+
+	page.type = PAGE_TYPE_ARTICLE;
+	page.index = -1;
+
+	return page;
+}
+
+/**
+ * Creates a reference to an article.
+ *
+ * @param  index Article index.
+ * @return       Page reference.
+ */
+page_t page_article(size_t index) {
+	page_t page;
+
+	page.type = PAGE_TYPE_ARTICLE;
+	page.index = (ssize_t)index;
+
+	return page;
+}
+
+/**
+ * Creates a reference to a template.
+ *
+ * @param  index Template index.
+ * @return       Page reference.
+ */
+page_t page_template(size_t index) {
+	page_t page;
+
+	page.type = PAGE_TYPE_TEMPLATE;
+	page.index = (ssize_t)index;
+
+	return page;
+}
+
+/**
+ * Checks if a page reference points to an existing page.
+ *
+ * @param  page Page reference.
+ * @return      TRUE if the page exists in the opened workspace.
+ */
+bool page_is_valid(page_t page) {
+	if (page.index < 0)
+		return false;
+
+	return (size_t)page.index < wiki_pages_available(page.type);
+}
+
+/**
+ * Checks if two page references point to the same page.
+ *
+ * @param  a First page reference.
+ * @param  b Second page reference.
+ * @return   TRUE if both references are the same.
+ */
+bool page_equal(page_t a, page_t b) {
+	if ((a.index < 0) && (b.index < 0))
+		return true;
+
+	return (a.type == b.type) && (a.index == b.index);
+}
+
+/**
+ * Gets the name of a page.
+ *
+ * @param  page Page reference.
+ * @return      Name of the page or NULL if it wasn't found.
+ */
+const char* page_name(page_t page) {
+	if (page.type == PAGE_TYPE_ARTICLE)
+		return uki_article((size_t)page.index).name;
+
+	return uki_template((size_t)page.index).name;
+}
+
+/**
+ * Gets the parent folder of a page.
+ *
+ * @param  page Page reference.
+ * @return      Parent folder name or NULL if the page is at the root.
+ */
+const char* page_parent(page_t page) {
+	if (page.type == PAGE_TYPE_ARTICLE)
+		return uki_article((size_t)page.index).parent;
+
+	return NULL;
+}
+
+/**
+ * Gets how deep a page is inside the workspace folder structure.
+ *
+ * @param  page Page reference.
+ * @return      Deepness of the page.
+ */
+int page_deepness(page_t page) {
+	if (page.type == PAGE_TYPE_ARTICLE)
+		return uki_article((size_t)page.index).deepness;
+
+	return uki_template((size_t)page.index).deepness;
+}
+
+/**
+ * Builds a name that identifies a page inside the workspace. (parent/name)
+ *
+ * @param  page Page reference.
+ * @return      Newly allocated display name. Free it with g_free().
+ */
+char* page_display_name(page_t page) {
+	const char *parent = page_parent(page);
+
+	if (parent != NULL)
+		return g_strdup_printf("%s/%s", parent, page_name(page));
+
+	return g_strdup(page_name(page));
+}
+
+/**
+ * Gets the file path of a page.
+ *
+ * @param  fpath Pre-allocated string (UKI_MAX_PATH) to store the path.
+ * @param  page  Page reference.
+ * @return       UKI_OK if the operation was successful.
+ */
+uki_error page_fpath(char *fpath, page_t page) {
+	if (page.type == PAGE_TYPE_ARTICLE)
+		return uki_article_fpath(fpath, uki_article((size_t)page.index));
+
+	return uki_template_fpath(fpath, uki_template((size_t)page.index));
+}
+
+/**
+ * Finds a page by its name, display name, or file path.
+ *
+ * @param  query Name, parent/name, or file path of the page.
+ * @param  page  Pointer to store the found page reference.
+ * @return       TRUE if a page was found.
+ */
+bool page_find(const char *query, page_t *page) {
+	char *abs_query;
+	bool found;
+
+	// Try the names first.
+	if (page_index_lookup_name(query, page))
+		return true;
+
+	// Resolve the query as if it was a path relative to the working directory.
+	abs_query = g_canonicalize_filename(query, NULL);
+	found = page_index_lookup_path(abs_query, page);
+	g_free(abs_query);
+
+	return found;
+}
+
+/**
+ * Reads the contents of a page from disk as UTF-8.
+ *
+ * @param  page     Page reference.
+ * @param  contents Pointer to the newly allocated contents. Free it with
+ *                  g_free().
+ * @param  length   Pointer to store the length of the contents. (Optional)
+ * @param  error    Return location for a GError.
+ * @return          TRUE if the operation was successful.
+ */
+bool page_read(page_t page, char **contents, size_t *length, GError **error) {
+	return page_read_encoded(page, contents, length, NULL, error);
+}
+
+/**
+ * Reads the contents of a page from disk converting them to UTF-8 and telling
+ * which encoding they were in.
+ *
+ * @param  page     Page reference.
+ * @param  contents Pointer to the newly allocated UTF-8 contents. Free it with
+ *                  g_free().
+ * @param  length   Pointer to store the length of the contents. (Optional)
+ * @param  encoding Pointer to store the encoding of the file. (Optional)
+ * @param  error    Return location for a GError.
+ * @return          TRUE if the operation was successful.
+ */
+bool page_read_encoded(page_t page, char **contents, size_t *length,
+					   encoding_t *encoding, GError **error) {
+	char fpath[UKI_MAX_PATH];
+	gsize decoded;
+	size_t bytes;
+	bool success;
+
+	// Get the file path.
+	if (page_fpath(fpath, page) != UKI_OK) {
+		g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT,
+					"Unable to find path for page '%s'.", page_name(page));
+		return false;
+	}
+
+	// Read contents.
+	TRACE_BEGIN("g_file_get_contents");
+	success = g_file_get_contents(fpath, contents, &bytes, error);
+	TRACE_END("g_file_get_contents");
+	if (!success)
+		return false;
+
+	// Account for it.
+	stats_count(STAT_PAGE_READS);
+	stats_add(STAT_BYTES_READ, bytes);
+
+	// Make sure the editor and renderer get UTF-8.
+	*contents = encoding_decode(*contents, bytes, encoding, &decoded, error);
+	if (*contents == NULL)
+		return false;
+	if (length != NULL)
+		*length = decoded;
+
+	return true;
+}
+
+/**
+ * Reads the contents of a page from disk into an arena as UTF-8. Meant for
+ * passes that go through many pages and throw their contents away right
+ * after.
+ *
+ * @param  page     Page reference.
+ * @param  arena    Arena that will own the contents.
+ * @param  contents Pointer to the NUL-terminated UTF-8 contents.
+ * @param  length   Pointer to store the length of the contents. (Optional)
+ * @param  error    Return location for a GError.
+ * @return          TRUE if the operation was successful.
+ */
+bool page_read_arena(page_t page, arena_t *arena, char **contents,
+					 size_t *length, GError **error) {
+	char fpath[UKI_MAX_PATH];
+	struct stat st;
+	size_t bytes;
+	gsize decoded;
+	FILE *fh;
+
+	// Get the file path.
+	if (page_fpath(fpath, page) != UKI_OK) {
+		g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT,
+					"Unable to find path for page '%s'.", page_name(page));
+		return false;
+	}
+
+	// Open the file.
+	TRACE_BEGIN("page_read_arena");
+	fh = g_fopen(fpath, "rb");
+	if ((fh == NULL) || (fstat(fileno(fh), &st) != 0)) {
+		int saved_errno = errno;
+
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(saved_errno),
+					"Failed to open file '%s': %s", fpath,
+					g_strerror(saved_errno));
+		if (fh != NULL)
+			fclose(fh);
+		TRACE_END("page_read_arena");
+
+		return false;
+	}
+
+	// Read its contents into the arena.
+	*contents = arena_alloc(arena, (gsize)st.st_size + 1);
+	bytes = fread(*contents, 1, (size_t)st.st_size, fh);
+	if (ferror(fh)) {
+		g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_IO,
+					"Failed to read from file '%s'.", fpath);
+		fclose(fh);
+		TRACE_END("page_read_arena");
+
+		return false;
+	}
+	(*contents)[bytes] = '\0';
+	fclose(fh);
+	TRACE_END("page_read_arena");
+
+	// Account for it.
+	stats_count(STAT_PAGE_READS);
+	stats_add(STAT_BYTES_READ, bytes);
+
+	// Make sure the searches and links see the same text as the editor.
+	*contents = encoding_decode_arena(*contents, bytes, arena, &decoded,
+									  error);
+	if (*contents == NULL)
+		return false;
+	if (length != NULL)
+		*length = decoded;
+
+	return true;
+}
+
+/**
+ * Renders the contents of a page in-place.
+ *
+ * @param page     Page reference.
+ * @param contents Pointer to the page contents. Will be reallocated to hold
+ *                 the rendered page.
+ */
+void page_render(page_t page, char **contents) {
+	gint64 start = g_get_monotonic_time();
+
+	if (page.type == PAGE_TYPE_ARTICLE) {
+		TRACE_BEGIN("uki_render_article_from_text");
+		uki_render_article_from_text(contents, page_deepness(page));
+		TRACE_END("uki_render_article_from_text");
+	} else {
+		TRACE_BEGIN("uki_render_template_from_text");
+		uki_render_template_from_text(contents, page_deepness(page));
+		TRACE_END("uki_render_template_from_text");
+	}
+
+	stats_count(STAT_RENDERS);
+	stats_record(STAT_RENDER_TIME, g_get_monotonic_time() - start);
+}
+
+/**
+ * Computes a quick hash of the contents of a page to tell whether they changed.
+ * (64-bit FNV-1a, not meant to be cryptographically secure)
+ *
+ * @param  contents Contents of the page.
+ * @param  length   Length of the contents in bytes.
+ * @return          Hash of the contents.
+ */
+guint64 page_content_hash(const char *contents, gsize length) {
+	guint64 hash = G_GUINT64_CONSTANT(14695981039346656037);
+
+	for (gsize i = 0; i < length; i++) {
+		hash ^= (guchar)contents[i];
+		hash *= G_GUINT64_CONSTANT(1099511628211);
+	}
+
+	return hash;
+}
@@ -0,0 +1,56 @@
+/**
+ * Page.h
+ * GTK-free helpers to reference, locate, read, and render Uki pages.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _PAGE_H_
+#define _PAGE_H_
+
+#include <glib.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <uki/uki.h>
+#include "Arena.h"
+#include "Encoding.h"
+
+// Page types.
+typedef enum {
+	PAGE_TYPE_ARTICLE = 0,
+	PAGE_TYPE_TEMPLATE
+} page_type_t;
+
+// Reference to a page in the workspace.
+typedef struct {
+	page_type_t type;
+	ssize_t index;
+} page_t;
+
+// Construction and comparison.
+page_t page_none();
+page_t page_article(size_t index);
+page_t page_template(size_t index);
+bool page_is_valid(page_t page);
+bool page_equal(page_t a, page_t b);
+
+// Information.
+const char* page_name(page_t page);
+const char* page_parent(page_t page);
+int page_deepness(page_t page);
+char* page_display_name(page_t page);
+uki_error page_fpath(char *fpath, page_t page);
+
+// Lookup.
+bool page_find(const char *query, page_t *page);
+
+// Loading and rendering.
+bool page_read(page_t page, char **contents, size_t *length, GError **error);
+bool page_read_encoded(page_t page, char **contents, size_t *length,
+					   encoding_t *encoding, GError **error);
+bool page_read_arena(page_t page, arena_t *arena, char **contents,
+					 size_t *length, GError **error);
+void page_render(page_t page, char **contents);
+guint64 page_content_hash(const char *contents, gsize length);
+
+#endif /* _PAGE_H_ */
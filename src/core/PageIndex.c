@@ -0,0 +1,188 @@
+/**
+ * PageIndex.c
+ * Constant-time lookup of the pages in the workspace by path or name.
+ *
+ * Pages are packed straight into the hash table values and the keys are
+ * interned, so the index doesn't own any memory besides its tables.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include "PageIndex.h"
+#include "Intern.h"
+#include "Wiki.h"
+
+// Private variables.
+GHashTable *index_paths = NULL;
+GHashTable *index_names = NULL;
+
+// Private methods.
+void page_index_add(page_t page);
+void page_index_add_name(const char *name, page_t page);
+bool page_index_lookup(GHashTable *table, const char *key, page_t *page);
+gpointer page_index_pack(page_t page);
+page_t page_index_unpack(gpointer value);
+
+/**
+ * Builds the index of every page in the workspace.
+ */
+void page_index_build() {
+	size_t count;
+
+	// Start from scratch.
+	page_index_clear();
+	index_paths = g_hash_table_new(g_str_hash, g_str_equal);
+	index_names = g_hash_table_new(g_str_hash, g_str_equal);
+
+	// Index the articles and then the templates.
+	count = wiki_pages_available(PAGE_TYPE_ARTICLE);
+	for (size_t i = 0; i < count; i++)
+		page_index_add(page_article(i));
+	count = wiki_pages_available(PAGE_TYPE_TEMPLATE);
+	for (size_t i = 0; i < count; i++)
+		page_index_add(page_template(i));
+
+	// Bare names come last so that they never shadow a full name.
+	count = wiki_pages_available(PAGE_TYPE_ARTICLE);
+	for (size_t i = 0; i < count; i++)
+		page_index_add_name(page_name(page_article(i)), page_article(i));
+	count = wiki_pages_available(PAGE_TYPE_TEMPLATE);
+	for (size_t i = 0; i < count; i++)
+		page_index_add_name(page_name(page_template(i)), page_template(i));
+}
+
+/**
+ * Frees the page index.
+ */
+void page_index_clear() {
+	if (index_paths != NULL)
+		g_hash_table_destroy(index_paths);
+	if (index_names != NULL)
+		g_hash_table_destroy(index_names);
+
+	index_paths = NULL;
+	index_names = NULL;
+}
+
+/**
+ * Finds a page by its file path.
+ *
+ * @param  fpath Canonical path to the page file.
+ * @param  page  Pointer to store the found page reference.
+ * @return       TRUE if a page was found.
+ */
+bool page_index_lookup_path(const char *fpath, page_t *page) {
+	return page_index_lookup(index_paths, fpath, page);
+}
+
+/**
+ * Finds a page by its name or display name.
+ *
+ * @param  name Name or parent/name of the page.
+ * @param  page Pointer to store the found page reference.
+ * @return      TRUE if a page was found.
+ */
+bool page_index_lookup_name(const char *name, page_t *page) {
+	return page_index_lookup(index_names, name, page);
+}
+
+/**
+ * Gets the number of keys in the index.
+ *
+ * @return Number of paths and names indexed.
+ */
+guint page_index_size() {
+	if (index_paths == NULL)
+		return 0;
+
+	return g_hash_table_size(index_paths) + g_hash_table_size(index_names);
+}
+
+/**
+ * Adds the path and display name of a page to the index.
+ *
+ * @param page Page to be indexed.
+ */
+void page_index_add(page_t page) {
+	char fpath[UKI_MAX_PATH];
+
+	if (page_fpath(fpath, page) == UKI_OK) {
+		char *canon = g_canonicalize_filename(fpath, NULL);
+
+		g_hash_table_insert(index_paths, (gpointer)intern_string(canon),
+							page_index_pack(page));
+		g_free(canon);
+	}
+
+	page_index_add_name(NULL, page);
+}
+
+/**
+ * Adds a name of a page to the index unless another page already has it.
+ *
+ * @param name Name to be indexed or NULL to use the display name.
+ * @param page Page that has this name.
+ */
+void page_index_add_name(const char *name, page_t page) {
+	char *display = NULL;
+	const char *key;
+
+	// Get the canonical copy of the name.
+	if (name == NULL) {
+		display = page_display_name(page);
+		name = display;
+	}
+	key = intern_string(name);
+	g_free(display);
+
+	if ((key == NULL) || g_hash_table_contains(index_names, key))
+		return;
+
+	g_hash_table_insert(index_names, (gpointer)key, page_index_pack(page));
+}
+
+/**
+ * Looks up a page in one of the index tables.
+ *
+ * @param  table Table to look into.
+ * @param  key   Key of the page.
+ * @param  page  Pointer to store the found page reference.
+ * @return       TRUE if a page was found.
+ */
+bool page_index_lookup(GHashTable *table, const char *key, page_t *page) {
+	gpointer value;
+
+	if ((table == NULL) || (key == NULL) ||
+			((value = g_hash_table_lookup(table, key)) == NULL)) {
+		*page = page_none();
+		return false;
+	}
+
+	*page = page_index_unpack(value);
+	return true;
+}
+
+/**
+ * Packs a page reference into a hash table value.
+ *
+ * @param  page Page reference.
+ * @return      Non-NULL pointer that represents the page.
+ */
+gpointer page_index_pack(page_t page) {
+	return GSIZE_TO_POINTER((((gsize)page.index << 1) | page.type) + 1);
+}
+
+/**
+ * Unpacks a page reference from a hash table value.
+ *
+ * @param  value Value created by page_index_pack().
+ * @return       Page reference.
+ */
+page_t page_index_unpack(gpointer value) {
+	gsize packed = GPOINTER_TO_SIZE(value) - 1;
+
+	if (packed & 1)
+		return page_template(packed >> 1);
+
+	return page_article(packed >> 1);
+}
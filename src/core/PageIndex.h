@@ -0,0 +1,25 @@
+/**
+ * PageIndex.h
+ * Constant-time lookup of the pages in the workspace by path or name.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _PAGEINDEX_H_
+#define _PAGEINDEX_H_
+
+#include <stdbool.h>
+#include "Page.h"
+
+// Building.
+void page_index_build();
+void page_index_clear();
+
+// Lookup.
+bool page_index_lookup_path(const char *fpath, page_t *page);
+bool page_index_lookup_name(const char *name, page_t *page);
+
+// Information.
+guint page_index_size();
+
+#endif /* _PAGEINDEX_H_ */
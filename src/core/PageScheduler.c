@@ -0,0 +1,264 @@
+/**
+ * PageScheduler.c
+ * Cancellable latest-wins scheduler that reads and renders pages in the
+ * background.
+ *
+ * Every request goes through a small state machine:
+ *
+ *   IDLE -> PENDING -> LOADING -> IDLE
+ *
+ * A request made while the previous one is still PENDING (the user is holding
+ * an arrow key in the tree) just moves the target and restarts the debounce
+ * timer, while one made during LOADING cancels the worker and discards its
+ * result. Only the page the user stops on gets its result delivered. A request
+ * made after things have settled for a while skips the debounce entirely, so
+ * single clicks aren't delayed.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include <gio/gio.h>
+#include "PageScheduler.h"
+#include "Stats.h"
+#include "Trace.h"
+
+// Private variables.
+scheduler_state_t scheduler_state = SCHEDULER_IDLE;
+page_loaded_func scheduler_callback = NULL;
+gpointer scheduler_data = NULL;
+GCancellable *scheduler_cancellable = NULL;
+page_t scheduler_target;
+gint64 scheduler_requested = 0;
+guint scheduler_timer = 0;
+guint scheduler_running = 0;
+GMutex scheduler_lock;
+GCond scheduler_finished;
+
+// Private methods.
+void page_scheduler_start();
+gboolean page_scheduler_timeout(gpointer data);
+void page_scheduler_worker(GTask *task, gpointer source, gpointer task_data,
+						   GCancellable *cancellable);
+void page_scheduler_done(GObject *source, GAsyncResult *result,
+						 gpointer data);
+
+/**
+ * Initializes the page scheduler.
+ *
+ * @param callback Function called with the result of the latest request.
+ * @param data     Data to be passed to the callback.
+ */
+void page_scheduler_init(page_loaded_func callback, gpointer data) {
+	scheduler_callback = callback;
+	scheduler_data = data;
+	scheduler_target = page_none();
+}
+
+/**
+ * Requests a page to be loaded, superseding any previous request.
+ *
+ * @param page Page to be read and rendered.
+ */
+void page_scheduler_request(page_t page) {
+	gint64 now = g_get_monotonic_time();
+	bool settled;
+
+	// Check if the user is still moving around before dropping what we had.
+	settled = (scheduler_state == SCHEDULER_IDLE) &&
+		((now - scheduler_requested) >= (PAGE_SCHEDULER_DEBOUNCE * 1000));
+	page_scheduler_cancel();
+	scheduler_target = page;
+	scheduler_requested = now;
+
+	// Load it right away or wait for the selection to settle.
+	if (settled) {
+		page_scheduler_start();
+	} else {
+		scheduler_state = SCHEDULER_PENDING;
+		scheduler_timer = g_timeout_add(PAGE_SCHEDULER_DEBOUNCE,
+										page_scheduler_timeout, NULL);
+	}
+}
+
+/**
+ * Cancels the current request. Its result will never be delivered.
+ */
+void page_scheduler_cancel() {
+	if (scheduler_state != SCHEDULER_IDLE)
+		stats_count(STAT_LOADS_CANCELLED);
+
+	// Stop waiting.
+	if (scheduler_timer != 0) {
+		g_source_remove(scheduler_timer);
+		scheduler_timer = 0;
+	}
+
+	// Tell the worker to give up.
+	if (scheduler_cancellable != NULL) {
+		g_cancellable_cancel(scheduler_cancellable);
+		g_object_unref(scheduler_cancellable);
+		scheduler_cancellable = NULL;
+	}
+
+	scheduler_state = SCHEDULER_IDLE;
+}
+
+/**
+ * Cancels the current request and waits for every worker to finish. Must be
+ * called before the pages they reference go away.
+ */
+void page_scheduler_shutdown() {
+	page_scheduler_cancel();
+
+	g_mutex_lock(&scheduler_lock);
+	while (scheduler_running > 0)
+		g_cond_wait(&scheduler_finished, &scheduler_lock);
+	g_mutex_unlock(&scheduler_lock);
+}
+
+/**
+ * Gets the state of the scheduler.
+ *
+ * @return Current state.
+ */
+scheduler_state_t page_scheduler_state() {
+	return scheduler_state;
+}
+
+/**
+ * Frees a page load.
+ *
+ * @param load Page load to be freed. (May be NULL)
+ */
+void page_load_free(page_load_t *load) {
+	if (load == NULL)
+		return;
+
+	g_free(load->source);
+	g_free(load->html);
+	g_free(load);
+}
+
+/**
+ * Starts loading the target page in a worker thread.
+ */
+void page_scheduler_start() {
+	page_load_t *load;
+	GTask *task;
+
+	// Setup the request.
+	load = g_new0(page_load_t, 1);
+	load->page = scheduler_target;
+	load->requested = scheduler_requested;
+	scheduler_state = SCHEDULER_LOADING;
+	scheduler_cancellable = g_cancellable_new();
+
+	// Keep track of the workers that are still around.
+	g_mutex_lock(&scheduler_lock);
+	scheduler_running++;
+	g_mutex_unlock(&scheduler_lock);
+	stats_add(STAT_PENDING_JOBS, 1);
+
+	// Send it to the background.
+	task = g_task_new(NULL, scheduler_cancellable, page_scheduler_done, NULL);
+	g_task_set_task_data(task, load, (GDestroyNotify)page_load_free);
+	g_task_run_in_thread(task, page_scheduler_worker);
+	g_object_unref(task);
+}
+
+/**
+ * Debounce timer callback that starts loading the settled selection.
+ *
+ * @param  data Unused.
+ * @return      FALSE to stop the timer.
+ */
+gboolean page_scheduler_timeout(gpointer data) {
+	scheduler_timer = 0;
+	page_scheduler_start();
+
+	return false;
+}
+
+/**
+ * Worker that reads and renders a page, giving up as soon as it's cancelled.
+ *
+ * @param task        Task being run.
+ * @param source      Unused.
+ * @param task_data   Page load request.
+ * @param cancellable Cancellable of the request.
+ */
+void page_scheduler_worker(GTask *task, gpointer source, gpointer task_data,
+						   GCancellable *cancellable) {
+	page_load_t *request = (page_load_t*)task_data;
+	page_load_t *load;
+	GError *error = NULL;
+
+	TRACE_BEGIN("page_scheduler_worker");
+	load = g_new0(page_load_t, 1);
+	load->page = request->page;
+	load->requested = request->requested;
+
+	// Read the page.
+	if (g_task_return_error_if_cancelled(task)) {
+		page_load_free(load);
+		goto finished;
+	}
+	if (!page_read_encoded(load->page, &load->source, &load->length,
+						   &load->encoding, &error)) {
+		g_task_return_error(task, error);
+		page_load_free(load);
+		goto finished;
+	}
+
+	// Render it, unless we are already too late.
+	if (g_task_return_error_if_cancelled(task)) {
+		page_load_free(load);
+		goto finished;
+	}
+	load->html = g_strndup(load->source, load->length);
+	page_render(load->page, &load->html);
+	g_task_return_pointer(task, load, (GDestroyNotify)page_load_free);
+
+finished:
+	// Let anyone waiting on us know we are done.
+	stats_add(STAT_PENDING_JOBS, -1);
+	g_mutex_lock(&scheduler_lock);
+	scheduler_running--;
+	g_cond_broadcast(&scheduler_finished);
+	g_mutex_unlock(&scheduler_lock);
+	TRACE_END("page_scheduler_worker");
+}
+
+/**
+ * Delivers the result of a worker if it's still the latest request.
+ *
+ * @param source Unused.
+ * @param result Task that finished.
+ * @param data   Unused.
+ */
+void page_scheduler_done(GObject *source, GAsyncResult *result,
+						 gpointer data) {
+	GTask *task = G_TASK(result);
+	GError *error = NULL;
+	page_load_t *load;
+
+	// Drop the results of superseded requests.
+	if ((scheduler_cancellable == NULL) ||
+			(g_task_get_cancellable(task) != scheduler_cancellable)) {
+		page_load_free(g_task_propagate_pointer(task, NULL));
+		return;
+	}
+
+	// Go back to idle before handing it over.
+	g_object_unref(scheduler_cancellable);
+	scheduler_cancellable = NULL;
+	scheduler_state = SCHEDULER_IDLE;
+	load = g_task_propagate_pointer(task, &error);
+
+	if (scheduler_callback != NULL) {
+		scheduler_callback(scheduler_target, load, error, scheduler_data);
+	} else {
+		page_load_free(load);
+		g_clear_error(&error);
+	}
+}
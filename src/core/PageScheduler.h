@@ -0,0 +1,54 @@
+/**
+ * PageScheduler.h
+ * Cancellable latest-wins scheduler that reads and renders pages in the
+ * background.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _PAGESCHEDULER_H_
+#define _PAGESCHEDULER_H_
+
+#include <glib.h>
+#include <stdbool.h>
+#include "Encoding.h"
+#include "Page.h"
+
+// Time a selection must stay put before it's loaded, in milliseconds.
+#define PAGE_SCHEDULER_DEBOUNCE 80
+
+// States of the scheduler.
+typedef enum {
+	SCHEDULER_IDLE = 0,
+	SCHEDULER_PENDING,
+	SCHEDULER_LOADING
+} scheduler_state_t;
+
+// Page that was read and rendered.
+typedef struct {
+	page_t page;
+	char *source;
+	size_t length;
+	encoding_t encoding;
+	char *html;
+	gint64 requested;
+} page_load_t;
+
+// Called on the main loop with the result of the latest request. The callee
+// owns the load (NULL if it failed) and the error.
+typedef void (*page_loaded_func)(page_t page, page_load_t *load,
+								 GError *error, gpointer data);
+
+// Initialization.
+void page_scheduler_init(page_loaded_func callback, gpointer data);
+
+// Scheduling.
+void page_scheduler_request(page_t page);
+void page_scheduler_cancel();
+void page_scheduler_shutdown();
+scheduler_state_t page_scheduler_state();
+
+// Loads.
+void page_load_free(page_load_t *load);
+
+#endif /* _PAGESCHEDULER_H_ */
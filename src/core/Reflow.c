@@ -0,0 +1,507 @@
+/**
+ * Reflow.c
+ * Reversible reformatting of pages with lines too long to be edited.
+ *
+ * Generated pages often come as a single line of hundreds of kilobytes, which
+ * takes the text view seconds to lay out on every keystroke. Those lines are
+ * broken up before tags and at spaces, indented by how deep the tags are, and
+ * every inserted break is remembered. Nothing of the original is ever changed,
+ * so taking the breaks out gives it back byte for byte. Edits are brought back
+ * by comparing the lines with the reformatted text: lines nobody touched come
+ * from the original, while only what was actually edited in the others is
+ * taken as it was typed.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include <string.h>
+#include "Reflow.h"
+#include "Diff.h"
+#include "Trace.h"
+
+// Constants.
+#define REFLOW_NAME_SIZE 16
+
+// Private variables.
+const char *reflow_void_tags[] = {
+	"area", "base", "br", "col", "embed", "hr", "img", "input", "link", "meta",
+	"param", "source", "track", "wbr", NULL
+};
+const char *reflow_raw_tags[] = {
+	"pre", "script", "style", "textarea", NULL
+};
+
+// Private methods.
+void reflow_line(reflow_t *reflow, GString *view, const char *line,
+				 gsize length);
+gsize reflow_break(reflow_t *reflow, GString *view, guint depth);
+void reflow_tag_name(const char *text, gsize length, char *name);
+bool reflow_tag_in(const char *name, const char **tags);
+guint reflow_find_break(const reflow_t *reflow, gsize offset);
+void reflow_copy(const reflow_t *reflow, GString *restored, gsize start,
+				 gsize end);
+void reflow_restore_lines(const reflow_t *reflow, diff_t *diff,
+						  diff_hunk_t *hunk, GString *restored);
+bool reflow_is_break(const reflow_t *reflow, gsize offset);
+void reflow_restore_deleted(const reflow_t *reflow, GString *restored,
+							gsize start, gsize end);
+
+/**
+ * Reformats the lines of some text that are too long.
+ *
+ * @param  source Text to be reformatted.
+ * @param  length Length of the text.
+ * @return        Reformatted text. Free it with reflow_free().
+ */
+reflow_t* reflow_new(const char *source, gsize length) {
+	reflow_t *reflow;
+	GString *view;
+	const char *line = source;
+	const char *end = source + length;
+	const char *eol;
+
+	TRACE_BEGIN("reflow_new");
+	reflow = g_new(reflow_t, 1);
+	reflow->source = g_strndup(source, length);
+	reflow->source_length = length;
+	reflow->breaks = g_array_new(false, false, sizeof(reflow_break_t));
+	view = g_string_sized_new(length + (length / 8));
+
+	// Only break up the lines that are actually too long.
+	while (line < end) {
+		eol = memchr(line, '\n', end - line);
+		if (eol == NULL)
+			eol = end;
+
+		if ((gsize)(eol - line) > REFLOW_LINE_LIMIT) {
+			reflow_line(reflow, view, line, eol - line);
+		} else {
+			g_string_append_len(view, line, eol - line);
+		}
+
+		if (eol < end)
+			g_string_append_c(view, '\n');
+		line = eol + 1;
+	}
+
+	reflow->length = view->len;
+	reflow->text = g_string_free(view, false);
+	TRACE_END("reflow_new");
+
+	return reflow;
+}
+
+/**
+ * Frees a reformatted text.
+ *
+ * @param reflow Reformatted text to be freed. (May be NULL)
+ */
+void reflow_free(reflow_t *reflow) {
+	if (reflow == NULL)
+		return;
+
+	g_free(reflow->source);
+	g_free(reflow->text);
+	g_array_free(reflow->breaks, true);
+	g_free(reflow);
+}
+
+/**
+ * Finds the length of the longest line of some text.
+ *
+ * @param  text   Text to be checked.
+ * @param  length Length of the text.
+ * @return        Length of the longest line in bytes.
+ */
+gsize reflow_longest_line(const char *text, gsize length) {
+	const char *line = text;
+	const char *end = text + length;
+	const char *eol;
+	gsize longest = 0;
+
+	while (line < end) {
+		eol = memchr(line, '\n', end - line);
+		if (eol == NULL)
+			eol = end;
+
+		longest = MAX(longest, (gsize)(eol - line));
+		line = eol + 1;
+	}
+
+	return longest;
+}
+
+/**
+ * Brings the edits made to a reformatted text back into the original
+ * formatting.
+ *
+ * @param  reflow          Reformatted text that was edited.
+ * @param  edited          Edited version of the reformatted text.
+ * @param  length          Length of the edited text.
+ * @param  restored_length Pointer to store the length of the restored text.
+ * @param  error           Return location for a GError.
+ * @return                 Edited text in the original formatting or NULL if
+ *                         an error occurred. Free it with g_free().
+ */
+char* reflow_restore(const reflow_t *reflow, const char *edited,
+					 gsize length, gsize *restored_length, GError **error) {
+	GString *restored;
+	diff_t *diff;
+	guint i;
+
+	// Nothing was edited, so nothing to work out.
+	if ((length == reflow->length) &&
+			(memcmp(edited, reflow->text, length) == 0)) {
+		*restored_length = reflow->source_length;
+		return g_strndup(reflow->source, reflow->source_length);
+	}
+
+	// Find out which lines were edited.
+	TRACE_BEGIN("reflow_restore");
+	diff = diff_new(g_strndup(reflow->text, reflow->length), reflow->length,
+					g_strndup(edited, length), length);
+	if (!diff_compute(diff, NULL, error)) {
+		diff_free(diff);
+		TRACE_END("reflow_restore");
+
+		return NULL;
+	}
+
+	// Go through them taking the breaks we inserted out.
+	restored = g_string_sized_new(reflow->source_length);
+	for (i = 0; i < diff->hunks->len; i++) {
+		diff_hunk_t *hunk = &g_array_index(diff->hunks, diff_hunk_t, i);
+
+		switch (hunk->op) {
+			case DIFF_EQUAL:
+				reflow_copy(reflow, restored,
+							g_array_index(diff->old_lines, gsize,
+										  hunk->old_start),
+							g_array_index(diff->old_lines, gsize,
+										  hunk->old_start + hunk->old_count));
+				break;
+			case DIFF_INSERT:
+			case DIFF_REPLACE:
+				reflow_restore_lines(reflow, diff, hunk, restored);
+				break;
+			case DIFF_DELETE:
+				reflow_restore_deleted(reflow, restored,
+					g_array_index(diff->old_lines, gsize, hunk->old_start),
+					g_array_index(diff->old_lines, gsize,
+								  hunk->old_start + hunk->old_count));
+				break;
+			default:
+				break;
+		}
+	}
+
+	diff_free(diff);
+	TRACE_END("reflow_restore");
+	*restored_length = restored->len;
+
+	return g_string_free(restored, false);
+}
+
+/**
+ * Breaks up a line that's too long.
+ *
+ * Tags start on a line of their own, except for the ones closing what the
+ * line just opened, and text is wrapped at spaces. Anything that's still too
+ * wide, such as an inline image, is broken up between characters.
+ *
+ * @param reflow Reformatted text being built.
+ * @param view   Reformatted text so far.
+ * @param line   Line to be broken up.
+ * @param length Length of the line without its line break.
+ */
+void reflow_line(reflow_t *reflow, GString *view, const char *line,
+				 gsize length) {
+	char name[REFLOW_NAME_SIZE] = "";
+	char raw[REFLOW_NAME_SIZE] = "";
+	guint depth = 0;
+	gsize width = 0;
+	bool in_tag = false;
+	bool closing = false;
+	bool special = false;
+	bool opened = false;
+	bool content = false;
+	gsize i;
+
+	for (i = 0; i < length; i++) {
+		char c = line[i];
+
+		// Check if a tag is starting. (Only its own closing tag ends raw text)
+		if (!in_tag && (c == '<') && (i + 1 < length) &&
+				(g_ascii_isalpha(line[i + 1]) || (line[i + 1] == '/') ||
+				 (line[i + 1] == '!'))) {
+			closing = line[i + 1] == '/';
+			special = line[i + 1] == '!';
+			reflow_tag_name(line + i + ((closing) ? 2 : 1),
+							length - i - ((closing) ? 2 : 1), name);
+
+			if ((raw[0] == '\0') || (closing && (strcmp(name, raw) == 0))) {
+				in_tag = true;
+				raw[0] = '\0';
+				if (closing && (depth > 0))
+					depth--;
+
+				if (content && !(closing && opened)) {
+					width = reflow_break(reflow, view, depth);
+					content = false;
+				}
+				opened = false;
+			}
+		}
+
+		g_string_append_c(view, c);
+		width++;
+		content = true;
+
+		// Check if a tag that opens an element has ended.
+		if (in_tag && (c == '>')) {
+			in_tag = false;
+			if (!closing && !special && (line[i - 1] != '/') &&
+					!reflow_tag_in(name, reflow_void_tags)) {
+				depth++;
+				opened = true;
+				if (reflow_tag_in(name, reflow_raw_tags))
+					g_strlcpy(raw, name, REFLOW_NAME_SIZE);
+			}
+		}
+
+		// Wrap whatever is getting too wide.
+		if (i + 1 >= length)
+			continue;
+		if (!in_tag && (width >= REFLOW_WIDTH) && ((c == ' ') ||
+				((raw[0] != '\0') && ((c == ';') || (c == '}'))))) {
+			width = reflow_break(reflow, view, depth);
+			content = false;
+		} else if ((width >= REFLOW_HARD_WIDTH) &&
+				   (((guchar)line[i + 1] & 0xC0) != 0x80)) {
+			width = reflow_break(reflow, view, depth);
+			content = false;
+		}
+	}
+}
+
+/**
+ * Inserts a line break followed by the indentation.
+ *
+ * @param  reflow Reformatted text being built.
+ * @param  view   Reformatted text so far.
+ * @param  depth  How deep in the tags the new line is.
+ * @return        Width of the indentation.
+ */
+gsize reflow_break(reflow_t *reflow, GString *view, guint depth) {
+	reflow_break_t brk;
+	guint indent;
+
+	indent = MIN(depth, REFLOW_MAX_DEPTH) * REFLOW_INDENT;
+	brk.offset = view->len;
+	brk.length = indent + 1;
+	g_array_append_val(reflow->breaks, brk);
+
+	g_string_append_c(view, '\n');
+	while (indent-- > 0)
+		g_string_append_c(view, ' ');
+
+	return brk.length - 1;
+}
+
+/**
+ * Gets the name of a tag in lowercase.
+ *
+ * @param text   Text right after the start of the tag.
+ * @param length Length of the text.
+ * @param name   Buffer of REFLOW_NAME_SIZE to store the name of the tag.
+ */
+void reflow_tag_name(const char *text, gsize length, char *name) {
+	gsize i = 0;
+
+	while ((i < length) && (i < REFLOW_NAME_SIZE - 1) &&
+			g_ascii_isalnum(text[i])) {
+		name[i] = g_ascii_tolower(text[i]);
+		i++;
+	}
+
+	name[i] = '\0';
+}
+
+/**
+ * Checks if a tag is in a list.
+ *
+ * @param  name Name of the tag.
+ * @param  tags NULL-terminated list of tags.
+ * @return      TRUE if the tag is in the list.
+ */
+bool reflow_tag_in(const char *name, const char **tags) {
+	for (; *tags != NULL; tags++) {
+		if (strcmp(name, *tags) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * Finds the first break that ends after an offset of the reformatted text.
+ *
+ * @param  reflow Reformatted text.
+ * @param  offset Offset in the reformatted text.
+ * @return        Index of the break or the number of breaks if there's none.
+ */
+guint reflow_find_break(const reflow_t *reflow, gsize offset) {
+	guint lo = 0;
+	guint hi = reflow->breaks->len;
+
+	while (lo < hi) {
+		guint mid = lo + ((hi - lo) / 2);
+		reflow_break_t *brk = &g_array_index(reflow->breaks, reflow_break_t,
+											 mid);
+
+		if (brk->offset + brk->length <= offset) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+/**
+ * Copies a region of the reformatted text without the breaks we inserted.
+ *
+ * @param reflow   Reformatted text.
+ * @param restored Text being restored.
+ * @param start    Start of the region in the reformatted text.
+ * @param end      End of the region in the reformatted text.
+ */
+void reflow_copy(const reflow_t *reflow, GString *restored, gsize start,
+				 gsize end) {
+	guint i;
+
+	for (i = reflow_find_break(reflow, start); i < reflow->breaks->len; i++) {
+		reflow_break_t *brk = &g_array_index(reflow->breaks, reflow_break_t,
+											 i);
+
+		if (brk->offset >= end)
+			break;
+
+		if (brk->offset > start) {
+			g_string_append_len(restored, reflow->text + start,
+								brk->offset - start);
+		}
+		start = MAX(start, MIN(brk->offset + brk->length, end));
+	}
+
+	if (start < end)
+		g_string_append_len(restored, reflow->text + start, end - start);
+}
+
+/**
+ * Restores the lines of a hunk that were edited.
+ *
+ * Whatever is still the same at the start and the end of the hunk comes from
+ * the reformatted text without the breaks we inserted, while the edit in
+ * between is taken as it is, so line breaks typed by the user are always kept.
+ * Lines added right after one of our breaks are kept apart from the line that
+ * was broken up, just like they are shown.
+ *
+ * @param reflow   Reformatted text.
+ * @param diff     Comparison of the reformatted and edited texts.
+ * @param hunk     Hunk of the comparison with the edited lines.
+ * @param restored Text being restored.
+ */
+void reflow_restore_lines(const reflow_t *reflow, diff_t *diff,
+						  diff_hunk_t *hunk, GString *restored) {
+	reflow_break_t *brk;
+	gsize ostart;
+	gsize oend;
+	gsize nstart;
+	gsize nend;
+	gsize prefix = 0;
+	gsize suffix = 0;
+	guint b;
+
+	ostart = g_array_index(diff->old_lines, gsize, hunk->old_start);
+	oend = g_array_index(diff->old_lines, gsize,
+						 hunk->old_start + hunk->old_count);
+	nstart = g_array_index(diff->new_lines, gsize, hunk->new_start);
+	nend = g_array_index(diff->new_lines, gsize,
+						 hunk->new_start + hunk->new_count);
+
+	// Find out what was actually edited.
+	while ((prefix < MIN(oend - ostart, nend - nstart)) &&
+			(reflow->text[ostart + prefix] ==
+			 diff->new_text[nstart + prefix])) {
+		prefix++;
+	}
+	while ((suffix < MIN(oend - ostart, nend - nstart) - prefix) &&
+			(reflow->text[oend - suffix - 1] ==
+			 diff->new_text[nend - suffix - 1])) {
+		suffix++;
+	}
+	reflow_copy(reflow, restored, ostart, ostart + prefix);
+
+	// Keep lines that were added right after one of our breaks on their own.
+	if ((ostart + prefix == oend - suffix) && (ostart + prefix > 0) &&
+			(nstart + prefix < nend - suffix) &&
+			(diff->new_text[nend - suffix - 1] == '\n') &&
+			((restored->len == 0) ||
+			 (restored->str[restored->len - 1] != '\n'))) {
+		b = reflow_find_break(reflow, ostart + prefix - 1);
+		brk = (b < reflow->breaks->len) ?
+			&g_array_index(reflow->breaks, reflow_break_t, b) : NULL;
+		if ((brk != NULL) && (brk->offset < ostart + prefix))
+			g_string_append_c(restored, '\n');
+	}
+
+	g_string_append_len(restored, diff->new_text + nstart + prefix,
+						(nend - suffix) - (nstart + prefix));
+	reflow_copy(reflow, restored, oend - suffix, oend);
+}
+
+/**
+ * Checks if a character of the reformatted text is a line break we inserted.
+ *
+ * @param  reflow Reformatted text.
+ * @param  offset Offset of the character in the reformatted text.
+ * @return        TRUE if it's the start of an inserted break.
+ */
+bool reflow_is_break(const reflow_t *reflow, gsize offset) {
+	guint b = reflow_find_break(reflow, offset);
+
+	return (b < reflow->breaks->len) &&
+		(g_array_index(reflow->breaks, reflow_break_t, b).offset == offset);
+}
+
+/**
+ * Keeps the original line break of lines that were deleted.
+ *
+ * The line before the deleted ones lost the break we gave it, so it's now
+ * continued by whatever comes after them. If they took an original line
+ * break with them, the last one has to be put back to keep the lines apart.
+ *
+ * @param reflow   Reformatted text.
+ * @param restored Text being restored.
+ * @param start    Start of the deleted lines in the reformatted text.
+ * @param end      End of the deleted lines in the reformatted text.
+ */
+void reflow_restore_deleted(const reflow_t *reflow, GString *restored,
+							gsize start, gsize end) {
+	gsize i;
+
+	// Only a line that lost its break continues into the deleted ones.
+	if ((start == 0) || !reflow_is_break(reflow, start - 1))
+		return;
+	if ((restored->len > 0) && (restored->str[restored->len - 1] == '\n'))
+		return;
+
+	for (i = end; i > start; i--) {
+		if ((reflow->text[i - 1] == '\n') && !reflow_is_break(reflow, i - 1)) {
+			g_string_append_c(restored, '\n');
+			return;
+		}
+	}
+}
@@ -0,0 +1,49 @@
+/**
+ * Reflow.h
+ * Reversible reformatting of pages with lines too long to be edited.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _REFLOW_H_
+#define _REFLOW_H_
+
+#include <gio/gio.h>
+#include <stdbool.h>
+
+// Lines longer than this (in bytes) make the editor crawl.
+#define REFLOW_LINE_LIMIT 10000
+
+// Layout of the reformatted lines.
+#define REFLOW_WIDTH      100
+#define REFLOW_HARD_WIDTH 1000
+#define REFLOW_INDENT     2
+#define REFLOW_MAX_DEPTH  16
+
+// Line break inserted into the original text.
+typedef struct {
+	gsize offset;
+	guint length;
+} reflow_break_t;
+
+// Reformatted version of some text.
+typedef struct {
+	char *source;
+	gsize source_length;
+	char *text;
+	gsize length;
+	GArray *breaks;
+} reflow_t;
+
+// Construction and destruction.
+reflow_t* reflow_new(const char *source, gsize length);
+void reflow_free(reflow_t *reflow);
+
+// Detection.
+gsize reflow_longest_line(const char *text, gsize length);
+
+// Restoration.
+char* reflow_restore(const reflow_t *reflow, const char *edited,
+					 gsize length, gsize *restored_length, GError **error);
+
+#endif /* _REFLOW_H_ */
@@ -0,0 +1,852 @@
+/**
+ * Revisions.c
+ * Local history of the revisions saved of each page in a workspace.
+ *
+ * Every time a page is saved a revision is appended to its history file inside
+ * the workspace. Most revisions are stored as a delta against the previous one,
+ * which is simply the region that changed between the two, since saves tend to
+ * be small edits to a single part of the page. Every few revisions (or when a
+ * delta wouldn't be much smaller than the page) a keyframe with the whole page
+ * is stored instead, so getting any revision back never takes more than
+ * decoding a keyframe and a handful of deltas. Payloads that are big enough are
+ * compressed with zlib. Records that were only partially written are ignored
+ * and overwritten by the next revision.
+ *
+ * The newest revision of the last few pages that were recorded is kept in
+ * memory along with where their history ends, so saving the same page over
+ * and over only costs working out the delta and appending it, instead of
+ * going through its whole history every time.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include "Revisions.h"
+#include "Page.h"
+#include "Stats.h"
+#include "Trace.h"
+#include "Wiki.h"
+
+// History format.
+#define REVISIONS_MAGIC       "GUKIREV1"
+#define REVISIONS_MAGIC_LEN   8
+#define REVISIONS_EXT         ".history"
+#define RECORD_HEADER_LEN     32
+#define RECORD_KEYFRAME       0x01
+#define RECORD_COMPRESSED     0x02
+#define DELTA_HEADER_LEN      8
+#define COMPRESSION_THRESHOLD 64
+
+// Revision record of a history file.
+typedef struct {
+	revision_t info;
+	guint8 flags;
+	gsize offset;
+	gsize payload;
+	gsize raw;
+} rev_record_t;
+
+// History file of a page loaded into memory.
+typedef struct {
+	char *fpath;
+	guint8 *data;
+	gsize length;
+	GArray *records;
+} rev_history_t;
+
+// Newest revision of a page that was recorded recently.
+typedef struct {
+	char *fpath;
+	gsize length;
+	gsize size;
+	gint64 mtime;
+	guint count;
+	guint deltas;
+	gsize revision;
+	guint64 hash;
+	GString *contents;
+} rev_tip_t;
+
+// Private variables.
+GQueue *revisions_tips = NULL;
+
+// Private methods.
+char* revisions_path(const char *fpath);
+rev_tip_t* revisions_tip(const char *fpath, GError **error);
+void revisions_tip_free(gpointer data);
+bool revisions_load(rev_history_t *history, const char *fpath,
+					GError **error);
+void revisions_unload(rev_history_t *history);
+GString* revisions_rebuild(rev_history_t *history, guint index,
+						   GError **error);
+GBytes* revisions_payload(rev_history_t *history, rev_record_t *record,
+						  GError **error);
+bool revisions_append(rev_tip_t *tip, guint8 flags, GByteArray *payload,
+					  const char *contents, gsize length, GError **error);
+GBytes* revisions_convert(GConverter *converter, const guint8 *data,
+						  gsize length, gsize size, GError **error);
+void revisions_set_error(GError **error, const char *fpath, int err);
+void revisions_set_corrupt(GError **error, const char *fpath);
+
+/**
+ * Records a new revision of a page that has just been saved.
+ *
+ * @param  fpath    Path to the page file.
+ * @param  contents Contents that were saved.
+ * @param  length   Length of the contents.
+ * @param  error    Return location for a GError.
+ * @return          TRUE if the operation was successful.
+ */
+bool revisions_record(const char *fpath, const char *contents, gsize length,
+					  GError **error) {
+	rev_tip_t *tip;
+	GByteArray *payload;
+	GString *previous = NULL;
+	guint8 flags = RECORD_KEYFRAME;
+	guint64 hash;
+	guint32 prefix = 0;
+	guint32 suffix = 0;
+	guint32 value;
+	bool success;
+
+	// We only use 32-bit lengths.
+	if (length > G_MAXUINT32) {
+		g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+					"Page '%s' is too big to keep its history.", fpath);
+		return false;
+	}
+
+	TRACE_BEGIN("revisions_record");
+	if ((tip = revisions_tip(fpath, error)) == NULL) {
+		TRACE_END("revisions_record");
+		return false;
+	}
+
+	// Check if this isn't the revision that we already have.
+	hash = page_content_hash(contents, length);
+	if ((tip->count > 0) && (tip->revision == length) &&
+			(tip->hash == hash)) {
+		TRACE_END("revisions_record");
+		return true;
+	}
+
+	// Only store a delta if we aren't due for a keyframe.
+	if ((tip->contents != NULL) &&
+			(tip->deltas < REVISIONS_KEYFRAME_INTERVAL)) {
+		previous = tip->contents;
+	}
+
+	// Find the region that changed since the previous revision.
+	if (previous != NULL) {
+		gsize shortest = MIN(previous->len, length);
+
+		while ((prefix < shortest) && (previous->str[prefix] ==
+									   contents[prefix])) {
+			prefix++;
+		}
+		while ((suffix < shortest - prefix) &&
+				(previous->str[previous->len - suffix - 1] ==
+				 contents[length - suffix - 1])) {
+			suffix++;
+		}
+
+		// Rewrites are better off as a keyframe.
+		if (DELTA_HEADER_LEN + (length - prefix - suffix) < length / 2)
+			flags = 0;
+	}
+
+	// Build the payload.
+	payload = g_byte_array_new();
+	if (flags & RECORD_KEYFRAME) {
+		g_byte_array_append(payload, (const guint8*)contents, length);
+	} else {
+		value = GUINT32_TO_LE(prefix);
+		g_byte_array_append(payload, (const guint8*)&value, sizeof(value));
+		value = GUINT32_TO_LE(suffix);
+		g_byte_array_append(payload, (const guint8*)&value, sizeof(value));
+		g_byte_array_append(payload, (const guint8*)contents + prefix,
+							length - prefix - suffix);
+	}
+
+	// Write it.
+	success = revisions_append(tip, flags, payload, contents, length, error);
+	g_byte_array_free(payload, true);
+
+	// Remember it for the next time.
+	if (success) {
+		if (tip->contents == NULL)
+			tip->contents = g_string_sized_new(length);
+		g_string_truncate(tip->contents, 0);
+		g_string_append_len(tip->contents, contents, length);
+		tip->revision = length;
+		tip->hash = hash;
+		tip->count++;
+		tip->deltas = (flags & RECORD_KEYFRAME) ? 1 : tip->deltas + 1;
+	} else {
+		g_queue_remove(revisions_tips, tip);
+		revisions_tip_free(tip);
+	}
+	TRACE_END("revisions_record");
+
+	return success;
+}
+
+/**
+ * Checks if a page already has any revisions in its history.
+ *
+ * @param  fpath Path to the page file.
+ * @return       TRUE if there's at least one revision recorded.
+ */
+bool revisions_exist(const char *fpath) {
+	GStatBuf st;
+	char *hpath;
+	bool exists;
+
+	if (!wiki_is_opened())
+		return false;
+
+	hpath = revisions_path(fpath);
+	exists = (g_stat(hpath, &st) == 0) &&
+		(st.st_size >= REVISIONS_MAGIC_LEN + RECORD_HEADER_LEN);
+	g_free(hpath);
+
+	return exists;
+}
+
+/**
+ * Forgets about the revisions that were kept in memory.
+ */
+void revisions_forget() {
+	if (revisions_tips == NULL)
+		return;
+
+	g_queue_free_full(revisions_tips, revisions_tip_free);
+	revisions_tips = NULL;
+}
+
+/**
+ * Gets the newest revision of a page, going through its history only if it
+ * isn't in memory or its history was changed behind our backs.
+ *
+ * @param  fpath Path to the page file.
+ * @param  error Return location for a GError.
+ * @return       Newest revision of the page, owned by the cache, or NULL if
+ *               an error occurred.
+ */
+rev_tip_t* revisions_tip(const char *fpath, GError **error) {
+	rev_history_t history;
+	rev_record_t *record;
+	rev_tip_t *tip = NULL;
+	GStatBuf st;
+	char *hpath;
+	bool exists;
+	GList *item;
+	guint i;
+
+	// Check if we have a workspace to keep the history in.
+	if (!wiki_is_opened()) {
+		g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+					"No workspace opened to keep the history of '%s'.", fpath);
+		return NULL;
+	}
+
+	// Look for it in the cache.
+	if (revisions_tips == NULL)
+		revisions_tips = g_queue_new();
+	hpath = revisions_path(fpath);
+	exists = g_stat(hpath, &st) == 0;
+	for (item = revisions_tips->head; item != NULL; item = item->next) {
+		if (strcmp(((rev_tip_t*)item->data)->fpath, hpath) == 0) {
+			tip = item->data;
+			g_queue_delete_link(revisions_tips, item);
+			break;
+		}
+	}
+	g_free(hpath);
+
+	// Use it if nobody else touched its history.
+	if (tip != NULL) {
+		if ((exists && ((gsize)st.st_size == tip->size) &&
+				((gint64)st.st_mtime == tip->mtime)) ||
+				(!exists && (tip->size == 0))) {
+			g_queue_push_head(revisions_tips, tip);
+			return tip;
+		}
+
+		revisions_tip_free(tip);
+	}
+
+	// Go through its history.
+	if (!revisions_load(&history, fpath, error))
+		return NULL;
+	tip = g_new0(rev_tip_t, 1);
+	tip->fpath = g_strdup(history.fpath);
+	tip->length = history.length;
+	tip->size = (exists) ? (gsize)st.st_size : 0;
+	tip->mtime = (exists) ? (gint64)st.st_mtime : 0;
+	tip->count = history.records->len;
+	tip->deltas = REVISIONS_KEYFRAME_INTERVAL;
+	if (tip->count > 0) {
+		// Count the deltas since the last keyframe.
+		for (i = tip->count; i > 0; i--) {
+			record = &g_array_index(history.records, rev_record_t, i - 1);
+			if (record->flags & RECORD_KEYFRAME) {
+				tip->deltas = tip->count - i + 1;
+				break;
+			}
+		}
+
+		// A damaged history just gets a keyframe next.
+		record = &g_array_index(history.records, rev_record_t,
+								tip->count - 1);
+		tip->revision = record->info.length;
+		tip->hash = record->info.hash;
+		if (tip->deltas < REVISIONS_KEYFRAME_INTERVAL)
+			tip->contents = revisions_rebuild(&history, tip->count - 1, NULL);
+	}
+	revisions_unload(&history);
+
+	// Keep only the last few around.
+	g_queue_push_head(revisions_tips, tip);
+	while (g_queue_get_length(revisions_tips) > REVISIONS_CACHED_PAGES)
+		revisions_tip_free(g_queue_pop_tail(revisions_tips));
+
+	return tip;
+}
+
+/**
+ * Frees a cached revision.
+ *
+ * @param data Cached revision.
+ */
+void revisions_tip_free(gpointer data) {
+	rev_tip_t *tip = data;
+
+	g_free(tip->fpath);
+	if (tip->contents != NULL)
+		g_string_free(tip->contents, true);
+	g_free(tip);
+}
+
+/**
+ * Lists the revisions that were saved of a page.
+ *
+ * @param  fpath Path to the page file.
+ * @param  error Return location for a GError.
+ * @return       Array of revision_t from the oldest to the newest or NULL if
+ *               an error occurred. Free it with g_array_free().
+ */
+GArray* revisions_list(const char *fpath, GError **error) {
+	rev_history_t history;
+	GArray *revisions;
+	guint i;
+
+	if (!revisions_load(&history, fpath, error))
+		return NULL;
+
+	revisions = g_array_sized_new(false, false, sizeof(revision_t),
+								  history.records->len);
+	for (i = 0; i < history.records->len; i++) {
+		g_array_append_val(revisions, g_array_index(history.records,
+													rev_record_t, i).info);
+	}
+	revisions_unload(&history);
+
+	return revisions;
+}
+
+/**
+ * Gets the contents of a revision of a page.
+ *
+ * @param  fpath  Path to the page file.
+ * @param  index  Index of the revision.
+ * @param  length Pointer to store the length of the contents.
+ * @param  error  Return location for a GError.
+ * @return        Contents of the revision or NULL if an error occurred. Free it
+ *                with g_free().
+ */
+char* revisions_fetch(const char *fpath, guint index, gsize *length,
+					  GError **error) {
+	rev_history_t history;
+	GString *contents;
+
+	TRACE_BEGIN("revisions_fetch");
+	if (!revisions_load(&history, fpath, error)) {
+		TRACE_END("revisions_fetch");
+		return NULL;
+	}
+
+	// Check if we have the revision.
+	if (index >= history.records->len) {
+		g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT,
+					"Revision %u of '%s' doesn't exist.", index + 1, fpath);
+		revisions_unload(&history);
+		TRACE_END("revisions_fetch");
+
+		return NULL;
+	}
+
+	contents = revisions_rebuild(&history, index, error);
+	revisions_unload(&history);
+	TRACE_END("revisions_fetch");
+	if (contents == NULL)
+		return NULL;
+
+	*length = contents->len;
+	return g_string_free(contents, false);
+}
+
+/**
+ * Rebuilds the contents of a revision from the nearest keyframe before it.
+ *
+ * @param  history History of the page.
+ * @param  index   Index of the revision.
+ * @param  error   Return location for a GError.
+ * @return         Contents of the revision or NULL if an error occurred.
+ */
+GString* revisions_rebuild(rev_history_t *history, guint index,
+						   GError **error) {
+	rev_record_t *record;
+	GString *contents = NULL;
+	guint first;
+	guint i;
+
+	// Find the keyframe that we'll start from.
+	for (first = index + 1; first > 0; first--) {
+		record = &g_array_index(history->records, rev_record_t, first - 1);
+		if (record->flags & RECORD_KEYFRAME)
+			break;
+	}
+	if (first == 0) {
+		revisions_set_corrupt(error, history->fpath);
+		return NULL;
+	}
+
+	// Apply the deltas on top of it.
+	for (i = first - 1; i <= index; i++) {
+		const guint8 *data;
+		GBytes *payload;
+		gsize size;
+		guint32 prefix;
+		guint32 suffix;
+
+		record = &g_array_index(history->records, rev_record_t, i);
+		if ((payload = revisions_payload(history, record, error)) == NULL)
+			goto failed;
+		data = g_bytes_get_data(payload, &size);
+
+		if (record->flags & RECORD_KEYFRAME) {
+			contents = g_string_new_len((const char*)data, size);
+		} else {
+			// Get the region that changed.
+			if (size < DELTA_HEADER_LEN) {
+				g_bytes_unref(payload);
+				goto corrupt;
+			}
+			memcpy(&prefix, data, sizeof(prefix));
+			memcpy(&suffix, data + sizeof(prefix), sizeof(suffix));
+			prefix = GUINT32_FROM_LE(prefix);
+			suffix = GUINT32_FROM_LE(suffix);
+			if ((gsize)prefix + suffix > contents->len) {
+				g_bytes_unref(payload);
+				goto corrupt;
+			}
+
+			// Replace it.
+			g_string_erase(contents, prefix, contents->len - prefix - suffix);
+			g_string_insert_len(contents, prefix,
+								(const char*)data + DELTA_HEADER_LEN,
+								size - DELTA_HEADER_LEN);
+		}
+		g_bytes_unref(payload);
+
+		if (contents->len != record->info.length)
+			goto corrupt;
+	}
+
+	// Make sure we got back exactly what was saved.
+	if (page_content_hash(contents->str, contents->len) !=
+			g_array_index(history->records, rev_record_t, index).info.hash) {
+		goto corrupt;
+	}
+
+	return contents;
+
+corrupt:
+	revisions_set_corrupt(error, history->fpath);
+failed:
+	if (contents != NULL)
+		g_string_free(contents, true);
+
+	return NULL;
+}
+
+/**
+ * Gets the decompressed payload of a record.
+ *
+ * @param  history History of the page.
+ * @param  record  Record to get the payload of.
+ * @param  error   Return location for a GError.
+ * @return         Payload or NULL if an error occurred. Only valid while the
+ *                 history is loaded.
+ */
+GBytes* revisions_payload(rev_history_t *history, rev_record_t *record,
+						  GError **error) {
+	GConverter *converter;
+	GBytes *payload;
+
+	if (!(record->flags & RECORD_COMPRESSED)) {
+		return g_bytes_new_static(history->data + record->offset,
+								  record->payload);
+	}
+
+	converter = G_CONVERTER(g_zlib_decompressor_new(
+		G_ZLIB_COMPRESSOR_FORMAT_RAW));
+	payload = revisions_convert(converter, history->data + record->offset,
+								record->payload, record->raw, error);
+	g_object_unref(converter);
+
+	if ((payload != NULL) && (g_bytes_get_size(payload) != record->raw)) {
+		g_bytes_unref(payload);
+		revisions_set_corrupt(error, history->fpath);
+
+		return NULL;
+	}
+
+	return payload;
+}
+
+/**
+ * Appends a record to the history of a page, replacing anything after the last
+ * complete record.
+ *
+ * @param  tip      Newest revision of the page, which gets told where its
+ *                  history ends now.
+ * @param  flags    Record flags.
+ * @param  payload  Uncompressed payload of the record.
+ * @param  contents Contents of the revision.
+ * @param  length   Length of the contents.
+ * @param  error    Return location for a GError.
+ * @return          TRUE if the operation was successful.
+ */
+bool revisions_append(rev_tip_t *tip, guint8 flags, GByteArray *payload,
+					  const char *contents, gsize length, GError **error) {
+	guint8 header[RECORD_HEADER_LEN];
+	GBytes *compressed = NULL;
+	const guint8 *data = payload->data;
+	gsize size = payload->len;
+	guint32 value32;
+	guint64 value64;
+	GStatBuf st;
+	char *dir;
+	FILE *fh;
+	int fd;
+
+	// Compress the payload if it's worth it.
+	if (payload->len > COMPRESSION_THRESHOLD) {
+		GConverter *converter;
+
+		converter = G_CONVERTER(g_zlib_compressor_new(
+			G_ZLIB_COMPRESSOR_FORMAT_RAW, -1));
+		compressed = revisions_convert(converter, payload->data, payload->len,
+									   payload->len / 2, NULL);
+		g_object_unref(converter);
+
+		if ((compressed != NULL) &&
+				(g_bytes_get_size(compressed) < payload->len)) {
+			data = g_bytes_get_data(compressed, &size);
+			flags |= RECORD_COMPRESSED;
+		}
+	}
+
+	// Build the record header.
+	memset(header, 0, sizeof(header));
+	header[0] = flags;
+	value32 = GUINT32_TO_LE((guint32)size);
+	memcpy(header + 4, &value32, sizeof(value32));
+	value32 = GUINT32_TO_LE(payload->len);
+	memcpy(header + 8, &value32, sizeof(value32));
+	value32 = GUINT32_TO_LE((guint32)length);
+	memcpy(header + 12, &value32, sizeof(value32));
+	value64 = GUINT64_TO_LE((guint64)g_get_real_time());
+	memcpy(header + 16, &value64, sizeof(value64));
+	value64 = GUINT64_TO_LE(page_content_hash(contents, length));
+	memcpy(header + 24, &value64, sizeof(value64));
+
+	// Make sure we have somewhere to write to.
+	dir = g_path_get_dirname(tip->fpath);
+	if (g_mkdir_with_parents(dir, 0755) != 0) {
+		revisions_set_error(error, dir, errno);
+		g_free(dir);
+		goto failed;
+	}
+	g_free(dir);
+
+	// Start a new history or append to the end of the existing one, dropping
+	// any record that was only partially written.
+	if (tip->length == 0) {
+		fh = g_fopen(tip->fpath, "wb");
+		if ((fh != NULL) && (fwrite(REVISIONS_MAGIC, 1, REVISIONS_MAGIC_LEN,
+									fh) != REVISIONS_MAGIC_LEN)) {
+			fclose(fh);
+			fh = NULL;
+		}
+		tip->length = REVISIONS_MAGIC_LEN;
+	} else {
+		fh = NULL;
+		fd = g_open(tip->fpath, O_WRONLY | O_APPEND, 0);
+		if ((fd >= 0) && ((tip->size == tip->length) ||
+						  (ftruncate(fd, tip->length) == 0))) {
+			fh = fdopen(fd, "ab");
+		}
+		if ((fh == NULL) && (fd >= 0)) {
+			int saved_errno = errno;
+
+			close(fd);
+			errno = saved_errno;
+		}
+	}
+	if (fh == NULL) {
+		revisions_set_error(error, tip->fpath, errno);
+		goto failed;
+	}
+
+	// Write the record.
+	if ((fwrite(header, 1, sizeof(header), fh) != sizeof(header)) ||
+			(fwrite(data, 1, size, fh) != size) || (fflush(fh) != 0) ||
+			(fsync(fileno(fh)) != 0) || (fstat(fileno(fh), &st) != 0)) {
+		revisions_set_error(error, tip->fpath, errno);
+		fclose(fh);
+		goto failed;
+	}
+	fclose(fh);
+
+	// Remember where the history ends now.
+	tip->length += sizeof(header) + size;
+	tip->size = (gsize)st.st_size;
+	tip->mtime = (gint64)st.st_mtime;
+
+	if (compressed != NULL)
+		g_bytes_unref(compressed);
+	stats_count(STAT_REVISIONS_RECORDED);
+	stats_add(STAT_REVISIONS_BYTES, sizeof(header) + size);
+
+	return true;
+
+failed:
+	if (compressed != NULL)
+		g_bytes_unref(compressed);
+
+	return false;
+}
+
+/**
+ * Loads the history of a page.
+ *
+ * @param  history History to be populated. Release it with revisions_unload().
+ * @param  fpath   Path to the page file.
+ * @param  error   Return location for a GError.
+ * @return         TRUE if the operation was successful. A page without any
+ *                 history simply has no records.
+ */
+bool revisions_load(rev_history_t *history, const char *fpath,
+					GError **error) {
+	GError *err = NULL;
+	gsize length;
+	gsize pos;
+
+	// Check if we have a workspace to keep the history in.
+	if (!wiki_is_opened()) {
+		g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+					"No workspace opened to keep the history of '%s'.", fpath);
+		return false;
+	}
+
+	// Read the history file.
+	history->fpath = revisions_path(fpath);
+	history->data = NULL;
+	history->length = 0;
+	history->records = g_array_new(false, false, sizeof(rev_record_t));
+	if (!g_file_get_contents(history->fpath, (gchar**)&history->data, &length,
+							 &err)) {
+		if (g_error_matches(err, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+			g_error_free(err);
+			return true;
+		}
+
+		g_propagate_error(error, err);
+		revisions_unload(history);
+
+		return false;
+	}
+
+	// A history that never got past its magic is as good as none.
+	if (length < REVISIONS_MAGIC_LEN)
+		return true;
+
+	// Check if it's actually a history file.
+	if (memcmp(history->data, REVISIONS_MAGIC, REVISIONS_MAGIC_LEN) != 0) {
+		revisions_set_corrupt(error, history->fpath);
+		revisions_unload(history);
+
+		return false;
+	}
+
+	// Go through the records, stopping at the first incomplete one.
+	pos = REVISIONS_MAGIC_LEN;
+	while (pos + RECORD_HEADER_LEN <= length) {
+		const guint8 *header = history->data + pos;
+		rev_record_t record;
+		guint32 value32;
+		guint64 value64;
+
+		record.flags = header[0];
+		memcpy(&value32, header + 4, sizeof(value32));
+		record.payload = GUINT32_FROM_LE(value32);
+		memcpy(&value32, header + 8, sizeof(value32));
+		record.raw = GUINT32_FROM_LE(value32);
+		memcpy(&value32, header + 12, sizeof(value32));
+		record.info.length = GUINT32_FROM_LE(value32);
+		memcpy(&value64, header + 16, sizeof(value64));
+		record.info.time = (gint64)GUINT64_FROM_LE(value64);
+		memcpy(&value64, header + 24, sizeof(value64));
+		record.info.hash = GUINT64_FROM_LE(value64);
+		if (pos + RECORD_HEADER_LEN + record.payload > length)
+			break;
+
+		record.offset = pos + RECORD_HEADER_LEN;
+		record.info.index = history->records->len;
+		record.info.stored = RECORD_HEADER_LEN + record.payload;
+		record.info.keyframe = record.flags & RECORD_KEYFRAME;
+		g_array_append_val(history->records, record);
+
+		pos += record.info.stored;
+	}
+	history->length = pos;
+
+	return true;
+}
+
+/**
+ * Releases the resources of a loaded history.
+ *
+ * @param history History to be released.
+ */
+void revisions_unload(rev_history_t *history) {
+	g_free(history->fpath);
+	g_free(history->data);
+	g_array_free(history->records, true);
+}
+
+/**
+ * Runs some data through a compressor or decompressor.
+ *
+ * @param  converter Compressor or decompressor.
+ * @param  data      Data to be converted.
+ * @param  length    Length of the data.
+ * @param  size      Expected size of the output.
+ * @param  error     Return location for a GError.
+ * @return           Converted data or NULL if an error occurred.
+ */
+GBytes* revisions_convert(GConverter *converter, const guint8 *data,
+						  gsize length, gsize size, GError **error) {
+	GByteArray *output;
+	gsize consumed = 0;
+	gsize produced = 0;
+
+	output = g_byte_array_sized_new(MAX(size, 64));
+	g_byte_array_set_size(output, MAX(size, 64));
+	for (;;) {
+		GConverterResult res;
+		GError *err = NULL;
+		gsize read;
+		gsize written;
+
+		res = g_converter_convert(converter, data + consumed, length - consumed,
+								  output->data + produced,
+								  output->len - produced,
+								  G_CONVERTER_INPUT_AT_END, &read, &written,
+								  &err);
+		if (res == G_CONVERTER_ERROR) {
+			// Just give it more room if that's all it needs.
+			if (g_error_matches(err, G_IO_ERROR, G_IO_ERROR_NO_SPACE)) {
+				g_error_free(err);
+				g_byte_array_set_size(output, output->len * 2);
+				continue;
+			}
+
+			g_propagate_error(error, err);
+			g_byte_array_free(output, true);
+
+			return NULL;
+		}
+
+		consumed += read;
+		produced += written;
+		if (res == G_CONVERTER_FINISHED)
+			break;
+		if (produced == output->len)
+			g_byte_array_set_size(output, output->len * 2);
+	}
+
+	g_byte_array_set_size(output, produced);
+	return g_byte_array_free_to_bytes(output);
+}
+
+/**
+ * Gets the path to the history file of a page.
+ *
+ * @param  fpath Path to the page file.
+ * @return       Newly allocated path to the history file.
+ */
+char* revisions_path(const char *fpath) {
+	const char *root = wiki_root();
+	const char *key = fpath;
+	char *hash;
+	char *fname;
+	char *path;
+
+	// Key it relative to the workspace so that it can be moved around.
+	if (g_str_has_prefix(fpath, root)) {
+		key = fpath + strlen(root);
+		while (G_IS_DIR_SEPARATOR(*key))
+			key++;
+	}
+
+	hash = g_compute_checksum_for_string(G_CHECKSUM_SHA1, key, -1);
+	fname = g_strconcat(hash, REVISIONS_EXT, NULL);
+	path = g_build_filename(root, REVISIONS_DIRNAME, fname, NULL);
+	g_free(hash);
+	g_free(fname);
+
+	return path;
+}
+
+/**
+ * Sets an error for a history file that couldn't be written to.
+ *
+ * @param error Return location for a GError.
+ * @param fpath Path of the file.
+ * @param err   errno of the failure.
+ */
+void revisions_set_error(GError **error, const char *fpath, int err) {
+	g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(err),
+				"Failed to write the history '%s': %s", fpath, g_strerror(err));
+}
+
+/**
+ * Sets an error for a history file that's damaged.
+ *
+ * @param error Return location for a GError.
+ * @param fpath Path of the file.
+ */
+void revisions_set_corrupt(GError **error, const char *fpath) {
+	g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+				"The history '%s' is damaged.", fpath);
+}
@@ -0,0 +1,44 @@
+/**
+ * Revisions.h
+ * Local history of the revisions saved of each page in a workspace.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _REVISIONS_H_
+#define _REVISIONS_H_
+
+#include <glib.h>
+#include <stdbool.h>
+
+// History folder inside the workspace.
+#define REVISIONS_DIRNAME ".guki-history"
+
+// Maximum number of deltas between two full copies of a page.
+#define REVISIONS_KEYFRAME_INTERVAL 32
+
+// Number of pages whose newest revision is kept around for the next save.
+#define REVISIONS_CACHED_PAGES 8
+
+// Saved revision of a page.
+typedef struct {
+	guint index;
+	gint64 time;
+	gsize length;
+	gsize stored;
+	guint64 hash;
+	bool keyframe;
+} revision_t;
+
+// Recording.
+bool revisions_record(const char *fpath, const char *contents, gsize length,
+					  GError **error);
+bool revisions_exist(const char *fpath);
+void revisions_forget();
+
+// Browsing.
+GArray* revisions_list(const char *fpath, GError **error);
+char* revisions_fetch(const char *fpath, guint index, gsize *length,
+					  GError **error);
+
+#endif /* _REVISIONS_H_ */
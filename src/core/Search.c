@@ -0,0 +1,167 @@
+/**
+ * Search.c
+ * GTK-free text search across pages of the workspace.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include <string.h>
+#include "Search.h"
+#include "Arena.h"
+#include "Wiki.h"
+
+// Private methods.
+size_t search_lines(page_t page, const char *contents, size_t length,
+					const char *needle, bool match_case,
+					search_hit_func callback, gpointer data);
+
+/**
+ * Finds the first occurrence of a needle in a haystack.
+ *
+ * @param  haystack   Text to be searched.
+ * @param  length     Length of the haystack in bytes.
+ * @param  needle     String to search for.
+ * @param  match_case Should the search be case sensitive?
+ * @return            Offset of the match or -1 if it wasn't found.
+ */
+ssize_t search_text(const char *haystack, size_t length, const char *needle,
+					bool match_case) {
+	size_t nlen = strlen(needle);
+	const char *match;
+
+	// Check if we even have something to look for.
+	if ((nlen == 0) || (nlen > length))
+		return -1;
+
+	// Case sensitive searches can rely on the optimized libc.
+	if (match_case) {
+		match = g_strstr_len(haystack, length, needle);
+		return (match == NULL) ? -1 : match - haystack;
+	}
+
+	// Go through the haystack comparing only where the first letter matches.
+	for (size_t i = 0; i <= length - nlen; i++) {
+		if (g_ascii_tolower(haystack[i]) != g_ascii_tolower(needle[0]))
+			continue;
+
+		if (g_ascii_strncasecmp(haystack + i, needle, nlen) == 0)
+			return (ssize_t)i;
+	}
+
+	return -1;
+}
+
+/**
+ * Searches a page for every line that contains a needle.
+ *
+ * @param  page       Page to be searched.
+ * @param  needle     String to search for.
+ * @param  match_case Should the search be case sensitive?
+ * @param  callback   Function called for every line that matched.
+ * @param  data       Data passed to the callback function.
+ * @return            Number of lines that matched.
+ */
+size_t search_page(page_t page, const char *needle, bool match_case,
+				   search_hit_func callback, gpointer data) {
+	char *contents;
+	size_t length;
+	size_t hits;
+
+	// Read the page contents.
+	if (!page_read(page, &contents, &length, NULL))
+		return 0;
+
+	hits = search_lines(page, contents, length, needle, match_case, callback,
+						data);
+
+	g_free(contents);
+	return hits;
+}
+
+/**
+ * Searches every page in the workspace for lines that contain a needle.
+ *
+ * @param  needle     String to search for.
+ * @param  match_case Should the search be case sensitive?
+ * @param  callback   Function called for every line that matched.
+ * @param  data       Data passed to the callback function.
+ * @return            Number of lines that matched.
+ */
+size_t search_workspace(const char *needle, bool match_case,
+						search_hit_func callback, gpointer data) {
+	size_t available[2];
+	size_t hits = 0;
+	arena_t *arena;
+
+	available[PAGE_TYPE_ARTICLE] = wiki_pages_available(PAGE_TYPE_ARTICLE);
+	available[PAGE_TYPE_TEMPLATE] = wiki_pages_available(PAGE_TYPE_TEMPLATE);
+
+	// Every page is read into the same arena, which is emptied between them.
+	arena = arena_new(0);
+	for (int type = PAGE_TYPE_ARTICLE; type <= PAGE_TYPE_TEMPLATE; type++) {
+		for (size_t i = 0; i < available[type]; i++) {
+			page_t page;
+			char *contents;
+			size_t length;
+
+			page = (type == PAGE_TYPE_ARTICLE) ? page_article(i) :
+				page_template(i);
+			if (page_read_arena(page, arena, &contents, &length, NULL)) {
+				hits += search_lines(page, contents, length, needle,
+									 match_case, callback, data);
+			}
+
+			arena_reset(arena);
+		}
+	}
+	arena_free(arena);
+
+	return hits;
+}
+
+/**
+ * Searches the contents of a page for every line that contains a needle.
+ *
+ * @param  page       Page that the contents belong to.
+ * @param  contents   Contents of the page.
+ * @param  length     Length of the contents in bytes.
+ * @param  needle     String to search for.
+ * @param  match_case Should the search be case sensitive?
+ * @param  callback   Function called for every line that matched.
+ * @param  data       Data passed to the callback function.
+ * @return            Number of lines that matched.
+ */
+size_t search_lines(page_t page, const char *contents, size_t length,
+					const char *needle, bool match_case,
+					search_hit_func callback, gpointer data) {
+	size_t hits = 0;
+	size_t line = 1;
+	const char *pos;
+	const char *end;
+
+	// Go through the page line by line.
+	pos = contents;
+	end = contents + length;
+	while (pos < end) {
+		const char *eol;
+		size_t llen;
+
+		// Find the end of the line.
+		eol = memchr(pos, '\n', end - pos);
+		if (eol == NULL)
+			eol = end;
+		llen = eol - pos;
+
+		// Report the line if it matches.
+		if (search_text(pos, llen, needle, match_case) >= 0) {
+			if (callback != NULL)
+				callback(page, line, pos, llen, data);
+			hits++;
+		}
+
+		pos = eol + 1;
+		line++;
+	}
+
+	return hits;
+}
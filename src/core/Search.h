@@ -0,0 +1,28 @@
+/**
+ * Search.h
+ * GTK-free text search across pages of the workspace.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _SEARCH_H_
+#define _SEARCH_H_
+
+#include <glib.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "Page.h"
+
+// Search hit callback.
+typedef void (*search_hit_func)(page_t page, size_t line, const char *text,
+								size_t length, gpointer data);
+
+// Searching.
+ssize_t search_text(const char *haystack, size_t length, const char *needle,
+					bool match_case);
+size_t search_page(page_t page, const char *needle, bool match_case,
+				   search_hit_func callback, gpointer data);
+size_t search_workspace(const char *needle, bool match_case,
+						search_hit_func callback, gpointer data);
+
+#endif /* _SEARCH_H_ */
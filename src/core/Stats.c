@@ -0,0 +1,524 @@
+/**
+ * Stats.c
+ * Live counters, latency histograms, and gauges about the application.
+ *
+ * Counters and histograms are updated with atomic operations so that they can
+ * be recorded from the worker threads without any locking. Latencies go into
+ * log2 buckets of microseconds, which is precise enough to tell a 2ms render
+ * from a 200ms one while keeping every histogram at a fixed size. Gauges are
+ * sampled only when the statistics are read.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "Stats.h"
+#include "Arena.h"
+#include "Intern.h"
+#include "History.h"
+#include "LinkGraph.h"
+#include "PageIndex.h"
+
+// Latency histogram.
+typedef struct {
+	gssize buckets[STATS_BUCKETS];
+	gssize count;
+	gssize sum;
+} stat_histogram_data_t;
+
+// Registered gauge.
+typedef struct {
+	const char *name;
+	stat_gauge_func func;
+	bool bytes;
+} stat_gauge_t;
+
+// Names of the counters and histograms. (Same order as their enums)
+const char *stat_counter_names[NUM_STAT_COUNTERS] = {
+	"page_loads",
+	"loads_cancelled",
+	"page_saves",
+	"saves_skipped",
+	"page_reads",
+	"bytes_read",
+	"renders",
+	"renders_skipped",
+	"history_hits",
+	"history_misses",
+	"export_rendered",
+	"export_skipped",
+	"pending_jobs",
+	"arena_allocs",
+	"arena_bytes",
+	"arena_resets",
+	"journal_records",
+	"journal_bytes",
+	"journal_syncs",
+	"revisions_recorded",
+	"revisions_bytes",
+	"external_changes",
+	"merges",
+	"merge_conflicts",
+	"encoding_conversions"
+};
+const char *stat_histogram_names[NUM_STAT_HISTOGRAMS] = {
+	"load_time",
+	"render_time",
+	"save_time",
+	"link_graph_time",
+	"diff_time"
+};
+
+// Private variables.
+gssize stat_counters[NUM_STAT_COUNTERS];
+stat_histogram_data_t stat_histograms[NUM_STAT_HISTOGRAMS];
+GArray *stat_gauges = NULL;
+
+// Private methods.
+void stats_register_core_gauges();
+gint64 stats_process_rss(const char *pid);
+bool stats_process_parent(const char *pid, gint64 *parent);
+gint64 stats_history_entries();
+gint64 stats_history_bytes();
+gint64 stats_page_index_entries();
+gint64 stats_link_graph_links();
+gint64 stats_arena_reserved();
+gint64 stats_interned_strings();
+gint64 stats_interned_bytes();
+
+/**
+ * Increments a counter by one.
+ *
+ * @param counter Counter to be incremented.
+ */
+void stats_count(stat_counter_t counter) {
+	stats_add(counter, 1);
+}
+
+/**
+ * Adds a value to a counter. Negative values are allowed for counters that
+ * track things in flight, like the pending background jobs.
+ *
+ * @param counter Counter to be changed.
+ * @param value   Value to be added.
+ */
+void stats_add(stat_counter_t counter, gint64 value) {
+	g_atomic_pointer_add(&stat_counters[counter], (gssize)value);
+}
+
+/**
+ * Records a latency in a histogram.
+ *
+ * @param histogram Histogram to record the latency in.
+ * @param usec      Latency in microseconds.
+ */
+void stats_record(stat_histogram_t histogram, gint64 usec) {
+	stat_histogram_data_t *hist = &stat_histograms[histogram];
+	guint bucket;
+
+	// Find the bucket. (Bucket N holds everything below 2^N microseconds)
+	if (usec < 0)
+		usec = 0;
+	bucket = g_bit_storage((gulong)usec);
+	if (bucket >= STATS_BUCKETS)
+		bucket = STATS_BUCKETS - 1;
+
+	g_atomic_pointer_add(&hist->buckets[bucket], 1);
+	g_atomic_pointer_add(&hist->count, 1);
+	g_atomic_pointer_add(&hist->sum, (gssize)usec);
+}
+
+/**
+ * Registers a gauge to be sampled whenever the statistics are read.
+ *
+ * @param name  Name of the gauge. (Must outlive the application)
+ * @param func  Function that samples the gauge.
+ * @param bytes Is the gauge a size in bytes?
+ */
+void stats_register_gauge(const char *name, stat_gauge_func func,
+						  bool bytes) {
+	stat_gauge_t gauge;
+
+	if (stat_gauges == NULL)
+		stats_register_core_gauges();
+
+	gauge.name = name;
+	gauge.func = func;
+	gauge.bytes = bytes;
+	g_array_append_val(stat_gauges, gauge);
+}
+
+/**
+ * Gets the current value of a counter.
+ *
+ * @param  counter Counter to be read.
+ * @return         Current value.
+ */
+gint64 stats_counter(stat_counter_t counter) {
+	return (gint64)g_atomic_pointer_get(&stat_counters[counter]);
+}
+
+/**
+ * Estimates a percentile of a histogram.
+ *
+ * @param  histogram  Histogram to be read.
+ * @param  percentile Percentile to be estimated. (0.0 to 1.0)
+ * @return            Upper bound of the bucket where the percentile falls, in
+ *                    microseconds, or 0 if nothing was recorded.
+ */
+gint64 stats_percentile(stat_histogram_t histogram, double percentile) {
+	stat_histogram_data_t *hist = &stat_histograms[histogram];
+	gssize count = g_atomic_pointer_get(&hist->count);
+	gssize seen = 0;
+	gssize rank;
+
+	if (count == 0)
+		return 0;
+
+	// Walk the buckets until we reach the requested rank.
+	rank = (gssize)(percentile * count + 0.5);
+	if (rank < 1)
+		rank = 1;
+	for (guint i = 0; i < STATS_BUCKETS; i++) {
+		seen += g_atomic_pointer_get(&hist->buckets[i]);
+		if (seen >= rank)
+			return (i == 0) ? 0 : ((gint64)1 << i) - 1;
+	}
+
+	return ((gint64)1 << (STATS_BUCKETS - 1)) - 1;
+}
+
+/**
+ * Goes through every statistic formatted for display.
+ *
+ * @param callback Function called for each statistic.
+ * @param data     Data to be passed to the callback.
+ */
+void stats_foreach(stat_func callback, gpointer data) {
+	char value[128];
+
+	if (stat_gauges == NULL)
+		stats_register_core_gauges();
+
+	// Counters.
+	for (guint i = 0; i < NUM_STAT_COUNTERS; i++) {
+		snprintf(value, sizeof(value), "%" G_GINT64_FORMAT, stats_counter(i));
+		callback(stat_counter_names[i], value, data);
+	}
+
+	// Histograms.
+	for (guint i = 0; i < NUM_STAT_HISTOGRAMS; i++) {
+		gssize count = g_atomic_pointer_get(&stat_histograms[i].count);
+		gssize sum = g_atomic_pointer_get(&stat_histograms[i].sum);
+
+		snprintf(value, sizeof(value), "%zd samples, avg %.2fms, p50 %.2fms, "
+				 "p90 %.2fms, p99 %.2fms", count,
+				 (count > 0) ? (sum / (double)count) / 1000 : 0,
+				 stats_percentile(i, 0.50) / 1000.0,
+				 stats_percentile(i, 0.90) / 1000.0,
+				 stats_percentile(i, 0.99) / 1000.0);
+		callback(stat_histogram_names[i], value, data);
+	}
+
+	// Gauges.
+	for (guint i = 0; i < stat_gauges->len; i++) {
+		stat_gauge_t *gauge = &g_array_index(stat_gauges, stat_gauge_t, i);
+		gint64 sample = gauge->func();
+
+		if (gauge->bytes && (sample >= 0)) {
+			char *size = g_format_size((guint64)sample);
+
+			g_strlcpy(value, size, sizeof(value));
+			g_free(size);
+		} else {
+			snprintf(value, sizeof(value), "%" G_GINT64_FORMAT, sample);
+		}
+
+		callback(gauge->name, value, data);
+	}
+}
+
+/**
+ * Builds a JSON document with every statistic.
+ *
+ * @return Newly allocated JSON document.
+ */
+char* stats_to_json() {
+	GString *json;
+
+	if (stat_gauges == NULL)
+		stats_register_core_gauges();
+
+	json = g_string_sized_new(4096);
+	g_string_append_printf(json, "{\n\"timestamp\":%" G_GINT64_FORMAT ",\n",
+						   g_get_real_time() / G_USEC_PER_SEC);
+
+	// Counters.
+	g_string_append(json, "\"counters\":{");
+	for (guint i = 0; i < NUM_STAT_COUNTERS; i++) {
+		g_string_append_printf(json, "%s\n\"%s\":%" G_GINT64_FORMAT,
+							   (i > 0) ? "," : "", stat_counter_names[i],
+							   stats_counter(i));
+	}
+
+	// Histograms.
+	g_string_append(json, "\n},\n\"histograms_us\":{");
+	for (guint i = 0; i < NUM_STAT_HISTOGRAMS; i++) {
+		stat_histogram_data_t *hist = &stat_histograms[i];
+
+		g_string_append_printf(json, "%s\n\"%s\":{\"count\":%zd,\"sum\":%zd,"
+							   "\"p50\":%" G_GINT64_FORMAT ",\"p90\":%"
+							   G_GINT64_FORMAT ",\"p99\":%" G_GINT64_FORMAT
+							   ",\"buckets\":[", (i > 0) ? "," : "",
+							   stat_histogram_names[i],
+							   (gssize)g_atomic_pointer_get(&hist->count),
+							   (gssize)g_atomic_pointer_get(&hist->sum),
+							   stats_percentile(i, 0.50),
+							   stats_percentile(i, 0.90),
+							   stats_percentile(i, 0.99));
+		for (guint b = 0; b < STATS_BUCKETS; b++) {
+			g_string_append_printf(json, "%s%zd", (b > 0) ? "," : "",
+								   (gssize)g_atomic_pointer_get(
+									   &hist->buckets[b]));
+		}
+		g_string_append(json, "]}");
+	}
+
+	// Gauges.
+	g_string_append(json, "\n},\n\"gauges\":{");
+	for (guint i = 0; i < stat_gauges->len; i++) {
+		stat_gauge_t *gauge = &g_array_index(stat_gauges, stat_gauge_t, i);
+
+		g_string_append_printf(json, "%s\n\"%s\":%" G_GINT64_FORMAT,
+							   (i > 0) ? "," : "", gauge->name,
+							   gauge->func());
+	}
+	g_string_append(json, "\n}\n}\n");
+
+	return g_string_free(json, false);
+}
+
+/**
+ * Writes every statistic to a JSON file.
+ *
+ * @param  fpath Path to the file or "-" for the standard output.
+ * @param  error Return location for a GError.
+ * @return       TRUE if the statistics were written.
+ */
+bool stats_dump(const char *fpath, GError **error) {
+	char *json = stats_to_json();
+	bool success = true;
+
+	if (strcmp(fpath, "-") == 0) {
+		fputs(json, stdout);
+	} else {
+		success = g_file_set_contents(fpath, json, -1, error);
+	}
+
+	g_free(json);
+	return success;
+}
+
+/**
+ * Gets the resident set size of the process.
+ *
+ * @return Resident memory in bytes or -1 if it isn't available.
+ */
+gint64 stats_rss() {
+	return stats_process_rss("self");
+}
+
+/**
+ * Gets the resident set size of every process we started and the ones they
+ * started in turn, such as the web processes of WebKit.
+ *
+ * @return Resident memory in bytes or -1 if it isn't available.
+ */
+gint64 stats_children_rss() {
+	GHashTableIter iter;
+	GHashTable *parents;
+	GDir *proc;
+	const char *name;
+	gpointer key;
+	gint64 parent;
+	gint self;
+	gint pid;
+	gint up;
+	gint64 rss;
+	gint64 total = 0;
+	guint depth;
+
+	// Only available where there's a /proc filesystem.
+	if ((proc = g_dir_open("/proc", 0, NULL)) == NULL)
+		return -1;
+
+	// Get the parent of every process.
+	parents = g_hash_table_new(g_direct_hash, g_direct_equal);
+	while ((name = g_dir_read_name(proc)) != NULL) {
+		if (g_ascii_isdigit(*name) && stats_process_parent(name, &parent)) {
+			g_hash_table_insert(parents, GINT_TO_POINTER(atoi(name)),
+								GINT_TO_POINTER((gint)parent));
+		}
+	}
+	g_dir_close(proc);
+
+	// Add up the ones that descend from us.
+	self = getpid();
+	g_hash_table_iter_init(&iter, parents);
+	while (g_hash_table_iter_next(&iter, &key, NULL)) {
+		pid = GPOINTER_TO_INT(key);
+		up = pid;
+		for (depth = 0; (up > 1) && (depth < STATS_MAX_DESCENT); depth++) {
+			up = GPOINTER_TO_INT(g_hash_table_lookup(parents,
+													 GINT_TO_POINTER(up)));
+			if (up == self) {
+				char *id = g_strdup_printf("%d", pid);
+
+				if ((rss = stats_process_rss(id)) > 0)
+					total += rss;
+				g_free(id);
+				break;
+			}
+		}
+	}
+	g_hash_table_destroy(parents);
+
+	return total;
+}
+
+/**
+ * Gets the resident set size of a process.
+ *
+ * @param  pid Process ID or "self".
+ * @return     Resident memory in bytes or -1 if it isn't available.
+ */
+gint64 stats_process_rss(const char *pid) {
+	gint64 pages = -1;
+	char *fpath;
+	FILE *statm;
+
+	fpath = g_strdup_printf("/proc/%s/statm", pid);
+	statm = fopen(fpath, "r");
+	g_free(fpath);
+	if (statm == NULL)
+		return -1;
+
+	if (fscanf(statm, "%*s %" G_GINT64_FORMAT, &pages) != 1)
+		pages = -1;
+	fclose(statm);
+
+	return (pages < 0) ? -1 : pages * sysconf(_SC_PAGESIZE);
+}
+
+/**
+ * Gets the parent of a process.
+ *
+ * @param  pid    Process ID.
+ * @param  parent Pointer to store the ID of the parent process.
+ * @return        TRUE if the process still exists.
+ */
+bool stats_process_parent(const char *pid, gint64 *parent) {
+	char *contents;
+	char *fpath;
+	char *end;
+	bool found;
+
+	fpath = g_strdup_printf("/proc/%s/stat", pid);
+	found = g_file_get_contents(fpath, &contents, NULL, NULL);
+	g_free(fpath);
+	if (!found)
+		return false;
+
+	// The name may have spaces and parentheses, so skip to the last one.
+	end = strrchr(contents, ')');
+	found = (end != NULL) &&
+		(sscanf(end + 1, " %*c %" G_GINT64_FORMAT, parent) == 1);
+	g_free(contents);
+
+	return found;
+}
+
+/**
+ * Registers the gauges of the core modules.
+ */
+void stats_register_core_gauges() {
+	stat_gauges = g_array_new(false, false, sizeof(stat_gauge_t));
+
+	stats_register_gauge("process_rss_bytes", stats_rss, true);
+	stats_register_gauge("child_processes_rss_bytes", stats_children_rss,
+						 true);
+	stats_register_gauge("history_entries", stats_history_entries, false);
+	stats_register_gauge("history_cache_bytes", stats_history_bytes, true);
+	stats_register_gauge("page_index_entries", stats_page_index_entries,
+						 false);
+	stats_register_gauge("link_graph_links", stats_link_graph_links, false);
+	stats_register_gauge("arena_reserved_bytes", stats_arena_reserved, true);
+	stats_register_gauge("interned_strings", stats_interned_strings, false);
+	stats_register_gauge("interned_bytes", stats_interned_bytes, true);
+}
+
+/**
+ * Gauge of the number of entries in the navigation history.
+ *
+ * @return Number of entries.
+ */
+gint64 stats_history_entries() {
+	return history_length();
+}
+
+/**
+ * Gauge of the memory used by the page state cached in the history.
+ *
+ * @return Cached bytes.
+ */
+gint64 stats_history_bytes() {
+	return history_memory();
+}
+
+/**
+ * Gauge of the number of keys in the page index.
+ *
+ * @return Number of keys.
+ */
+gint64 stats_page_index_entries() {
+	return page_index_size();
+}
+
+/**
+ * Gauge of the number of links in the link graph.
+ *
+ * @return Number of links.
+ */
+gint64 stats_link_graph_links() {
+	return link_graph_size();
+}
+
+/**
+ * Gauge of the memory reserved by the arenas.
+ *
+ * @return Reserved bytes.
+ */
+gint64 stats_arena_reserved() {
+	return arena_reserved();
+}
+
+/**
+ * Gauge of the number of interned strings.
+ *
+ * @return Distinct strings in the intern table.
+ */
+gint64 stats_interned_strings() {
+	return intern_count();
+}
+
+/**
+ * Gauge of the memory taken by the interned strings.
+ *
+ * @return Bytes used by the intern table strings.
+ */
+gint64 stats_interned_bytes() {
+	return intern_bytes();
+}
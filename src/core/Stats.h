@@ -0,0 +1,85 @@
+/**
+ * Stats.h
+ * Live counters, latency histograms, and gauges about the application.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <glib.h>
+#include <stdbool.h>
+
+// Number of log2 buckets in a latency histogram.
+#define STATS_BUCKETS 32
+
+// How far down the process tree memory is attributed to us.
+#define STATS_MAX_DESCENT 8
+
+// Counters.
+typedef enum {
+	STAT_PAGE_LOADS = 0,
+	STAT_LOADS_CANCELLED,
+	STAT_PAGE_SAVES,
+	STAT_SAVES_SKIPPED,
+	STAT_PAGE_READS,
+	STAT_BYTES_READ,
+	STAT_RENDERS,
+	STAT_RENDERS_SKIPPED,
+	STAT_HISTORY_HITS,
+	STAT_HISTORY_MISSES,
+	STAT_EXPORT_RENDERED,
+	STAT_EXPORT_SKIPPED,
+	STAT_PENDING_JOBS,
+	STAT_ARENA_ALLOCS,
+	STAT_ARENA_BYTES,
+	STAT_ARENA_RESETS,
+	STAT_JOURNAL_RECORDS,
+	STAT_JOURNAL_BYTES,
+	STAT_JOURNAL_SYNCS,
+	STAT_REVISIONS_RECORDED,
+	STAT_REVISIONS_BYTES,
+	STAT_EXTERNAL_CHANGES,
+	STAT_MERGES,
+	STAT_MERGE_CONFLICTS,
+	STAT_ENCODING_CONVERSIONS,
+	NUM_STAT_COUNTERS
+} stat_counter_t;
+
+// Latency histograms.
+typedef enum {
+	STAT_LOAD_TIME = 0,
+	STAT_RENDER_TIME,
+	STAT_SAVE_TIME,
+	STAT_LINK_GRAPH_TIME,
+	STAT_DIFF_TIME,
+	NUM_STAT_HISTOGRAMS
+} stat_histogram_t;
+
+// Gauge sampled when the statistics are read.
+typedef gint64 (*stat_gauge_func)(void);
+
+// Callback for each formatted statistic.
+typedef void (*stat_func)(const char *name, const char *value,
+						  gpointer data);
+
+// Recording.
+void stats_count(stat_counter_t counter);
+void stats_add(stat_counter_t counter, gint64 value);
+void stats_record(stat_histogram_t histogram, gint64 usec);
+void stats_register_gauge(const char *name, stat_gauge_func func,
+						  bool bytes);
+
+// Reading.
+gint64 stats_counter(stat_counter_t counter);
+gint64 stats_percentile(stat_histogram_t histogram, double percentile);
+void stats_foreach(stat_func callback, gpointer data);
+char* stats_to_json();
+bool stats_dump(const char *fpath, GError **error);
+
+// Memory.
+gint64 stats_rss();
+gint64 stats_children_rss();
+
+#endif /* _STATS_H_ */
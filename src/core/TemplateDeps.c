@@ -0,0 +1,195 @@
+/**
+ * TemplateDeps.c
+ * Tracks which templates a page transitively depends on.
+ *
+ * A page is considered to use a template whenever the template name (without
+ * its extension) appears in its source. This over-approximates the real usage,
+ * which is fine for invalidation: a page may be rendered again without need,
+ * but it's never left stale. Each template gets an effective hash that
+ * combines its own source with the effective hashes of the templates it uses,
+ * so a change anywhere down the chain changes the hash of every page above it.
+ * The graph is read-only once built and can be shared between threads.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include <string.h>
+#include "TemplateDeps.h"
+#include "Page.h"
+#include "Wiki.h"
+
+// Visiting state of a template while resolving the effective hashes.
+typedef enum {
+	DEPS_UNVISITED = 0,
+	DEPS_VISITING,
+	DEPS_DONE
+} deps_state_t;
+
+// Single template in the graph.
+typedef struct {
+	char *name;
+	char *hash;
+	char *effective;
+	GArray *uses;
+	deps_state_t state;
+} template_node_t;
+
+// Dependency graph.
+struct _template_deps_t {
+	template_node_t *nodes;
+	size_t count;
+};
+
+// Private methods.
+GArray* template_deps_scan(template_deps_t *deps, const char *contents,
+						   ssize_t self);
+void template_deps_resolve(template_deps_t *deps, size_t index);
+
+/**
+ * Builds the dependency graph of every template in the workspace.
+ *
+ * @return Newly allocated graph. Free it with template_deps_free().
+ */
+template_deps_t* template_deps_new() {
+	template_deps_t *deps;
+
+	// Allocate the graph.
+	deps = g_new0(template_deps_t, 1);
+	deps->count = wiki_pages_available(PAGE_TYPE_TEMPLATE);
+	deps->nodes = g_new0(template_node_t, deps->count);
+
+	// Get the template names without their extensions.
+	for (size_t i = 0; i < deps->count; i++) {
+		const char *name = page_name(page_template(i));
+		const char *ext = strrchr(name, '.');
+
+		deps->nodes[i].name = (ext != NULL) ? g_strndup(name, ext - name) :
+			g_strdup(name);
+	}
+
+	// Hash the templates and find out which ones they use.
+	for (size_t i = 0; i < deps->count; i++) {
+		char *contents;
+
+		if (!page_read(page_template(i), &contents, NULL, NULL))
+			contents = g_strdup("");
+
+		deps->nodes[i].hash = g_compute_checksum_for_string(G_CHECKSUM_SHA1,
+															contents, -1);
+		deps->nodes[i].uses = template_deps_scan(deps, contents, (ssize_t)i);
+		g_free(contents);
+	}
+
+	// Resolve the effective hashes.
+	for (size_t i = 0; i < deps->count; i++)
+		template_deps_resolve(deps, i);
+
+	return deps;
+}
+
+/**
+ * Frees a template dependency graph.
+ *
+ * @param deps Dependency graph.
+ */
+void template_deps_free(template_deps_t *deps) {
+	if (deps == NULL)
+		return;
+
+	for (size_t i = 0; i < deps->count; i++) {
+		g_free(deps->nodes[i].name);
+		g_free(deps->nodes[i].hash);
+		g_free(deps->nodes[i].effective);
+		g_array_free(deps->nodes[i].uses, true);
+	}
+
+	g_free(deps->nodes);
+	g_free(deps);
+}
+
+/**
+ * Computes a hash of every template transitively used by a page source.
+ *
+ * @param  deps     Dependency graph.
+ * @param  contents Source of the page.
+ * @return          Newly allocated hash string. Free it with g_free().
+ */
+char* template_deps_hash(template_deps_t *deps, const char *contents) {
+	GChecksum *checksum;
+	GArray *uses;
+	char *hash;
+
+	// Combine the effective hashes of the templates used directly.
+	checksum = g_checksum_new(G_CHECKSUM_SHA1);
+	uses = template_deps_scan(deps, contents, -1);
+	for (guint i = 0; i < uses->len; i++) {
+		template_node_t *node = &deps->nodes[g_array_index(uses, size_t, i)];
+
+		g_checksum_update(checksum, (const guchar*)node->name, -1);
+		g_checksum_update(checksum, (const guchar*)node->effective, -1);
+	}
+
+	// Clean up.
+	hash = g_strdup(g_checksum_get_string(checksum));
+	g_checksum_free(checksum);
+	g_array_free(uses, true);
+
+	return hash;
+}
+
+/**
+ * Finds which templates are used by a source.
+ *
+ * @param  deps     Dependency graph.
+ * @param  contents Source to be scanned.
+ * @param  self     Index of the template being scanned or -1 for articles.
+ * @return          Array of template indexes (size_t) in ascending order.
+ */
+GArray* template_deps_scan(template_deps_t *deps, const char *contents,
+						   ssize_t self) {
+	GArray *uses = g_array_new(false, false, sizeof(size_t));
+
+	for (size_t i = 0; i < deps->count; i++) {
+		if ((ssize_t)i == self)
+			continue;
+
+		if (strstr(contents, deps->nodes[i].name) != NULL)
+			g_array_append_val(uses, i);
+	}
+
+	return uses;
+}
+
+/**
+ * Resolves the effective hash of a template.
+ *
+ * @param deps  Dependency graph.
+ * @param index Index of the template.
+ */
+void template_deps_resolve(template_deps_t *deps, size_t index) {
+	template_node_t *node = &deps->nodes[index];
+	GChecksum *checksum;
+
+	// Check if it's already resolved or part of a cycle.
+	if (node->state != DEPS_UNVISITED)
+		return;
+	node->state = DEPS_VISITING;
+
+	// Combine its own hash with the ones of the templates it uses.
+	checksum = g_checksum_new(G_CHECKSUM_SHA1);
+	g_checksum_update(checksum, (const guchar*)node->hash, -1);
+	for (guint i = 0; i < node->uses->len; i++) {
+		template_node_t *dep;
+
+		// Resolve the dependency first, falling back to its own hash on cycles.
+		dep = &deps->nodes[g_array_index(node->uses, size_t, i)];
+		template_deps_resolve(deps, g_array_index(node->uses, size_t, i));
+		g_checksum_update(checksum, (const guchar*)dep->name, -1);
+		g_checksum_update(checksum, (const guchar*)((dep->effective != NULL) ?
+							dep->effective : dep->hash), -1);
+	}
+
+	node->effective = g_strdup(g_checksum_get_string(checksum));
+	node->state = DEPS_DONE;
+	g_checksum_free(checksum);
+}
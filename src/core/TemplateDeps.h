@@ -0,0 +1,24 @@
+/**
+ * TemplateDeps.h
+ * Tracks which templates a page transitively depends on.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _TEMPLATEDEPS_H_
+#define _TEMPLATEDEPS_H_
+
+#include <glib.h>
+#include <stddef.h>
+
+// Opaque dependency graph of the workspace templates.
+typedef struct _template_deps_t template_deps_t;
+
+// Construction and destruction.
+template_deps_t* template_deps_new();
+void template_deps_free(template_deps_t *deps);
+
+// Queries.
+char* template_deps_hash(template_deps_t *deps, const char *contents);
+
+#endif /* _TEMPLATEDEPS_H_ */
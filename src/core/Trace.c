@@ -0,0 +1,140 @@
+/**
+ * Trace.c
+ * Span tracing that writes Chrome/Perfetto trace files.
+ *
+ * When disabled every span costs a single predictable branch. When enabled the
+ * events are appended to an in-memory buffer and only written out, in the
+ * Trace Event JSON format understood by chrome://tracing and Perfetto, once
+ * tracing is stopped.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include <stdio.h>
+#include "Trace.h"
+
+// Recorded event.
+typedef struct {
+	const char *name;
+	gint64 ts;
+	guint tid;
+	char phase;
+} trace_event_t;
+
+// Private variables.
+bool trace_enabled = false;
+char *trace_fpath = NULL;
+GArray *trace_events = NULL;
+GMutex trace_lock;
+gint64 trace_epoch;
+gint trace_last_tid = 0;
+GPrivate trace_tid;
+
+// Private methods.
+guint trace_thread_id();
+
+/**
+ * Starts recording a trace.
+ *
+ * @param  fpath Path to write the trace to or NULL to use the path in the
+ *               GUKI_TRACE environment variable.
+ * @return       TRUE if tracing was started.
+ */
+bool trace_start(const char *fpath) {
+	// Get where the trace should go.
+	if (fpath == NULL)
+		fpath = g_getenv(TRACE_ENV);
+	if ((fpath == NULL) || (*fpath == '\0') || trace_enabled)
+		return false;
+
+	// Setup the buffer.
+	trace_fpath = g_strdup(fpath);
+	trace_events = g_array_sized_new(false, false, sizeof(trace_event_t),
+									 4096);
+	trace_epoch = g_get_monotonic_time();
+	trace_enabled = true;
+
+	return true;
+}
+
+/**
+ * Stops recording and writes the trace to its file.
+ *
+ * @param  error Return location for a GError.
+ * @return       TRUE if the trace was written or tracing wasn't enabled.
+ */
+bool trace_stop(GError **error) {
+	GString *json;
+	bool success;
+
+	if (!trace_enabled)
+		return true;
+
+	// Stop recording.
+	g_mutex_lock(&trace_lock);
+	trace_enabled = false;
+	g_mutex_unlock(&trace_lock);
+
+	// Build the JSON document.
+	json = g_string_sized_new(trace_events->len * 64);
+	g_string_append(json, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	for (guint i = 0; i < trace_events->len; i++) {
+		trace_event_t *event = &g_array_index(trace_events, trace_event_t, i);
+
+		g_string_append_printf(json, "%s{\"name\":\"%s\",\"ph\":\"%c\","
+							   "\"ts\":%" G_GINT64_FORMAT ",\"pid\":1,"
+							   "\"tid\":%u}", (i > 0) ? ",\n" : "",
+							   event->name, event->phase, event->ts,
+							   event->tid);
+	}
+	g_string_append(json, "\n]}\n");
+
+	// Write it out.
+	success = g_file_set_contents(trace_fpath, json->str, json->len, error);
+
+	// Clean up.
+	g_string_free(json, true);
+	g_array_free(trace_events, true);
+	g_free(trace_fpath);
+	trace_events = NULL;
+	trace_fpath = NULL;
+
+	return success;
+}
+
+/**
+ * Records a trace event. Use the TRACE_BEGIN and TRACE_END macros instead.
+ *
+ * @param name  Name of the span. (Must outlive the trace)
+ * @param phase 'B' when the span begins, 'E' when it ends.
+ */
+void trace_event(const char *name, char phase) {
+	trace_event_t event;
+
+	event.name = name;
+	event.phase = phase;
+	event.tid = trace_thread_id();
+
+	g_mutex_lock(&trace_lock);
+	if (trace_enabled) {
+		event.ts = g_get_monotonic_time() - trace_epoch;
+		g_array_append_val(trace_events, event);
+	}
+	g_mutex_unlock(&trace_lock);
+}
+
+/**
+ * Gets a small identifier for the calling thread.
+ *
+ * @return Thread identifier. (Starting at 1)
+ */
+guint trace_thread_id() {
+	guint tid = GPOINTER_TO_UINT(g_private_get(&trace_tid));
+
+	if (tid == 0) {
+		tid = (guint)g_atomic_int_add(&trace_last_tid, 1) + 1;
+		g_private_set(&trace_tid, GUINT_TO_POINTER(tid));
+	}
+
+	return tid;
+}
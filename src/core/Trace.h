@@ -0,0 +1,33 @@
+/**
+ * Trace.h
+ * Span tracing that writes Chrome/Perfetto trace files.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <glib.h>
+#include <stdbool.h>
+
+// Environment variable that enables tracing.
+#define TRACE_ENV "GUKI_TRACE"
+
+// Span macros. (Names must be string literals, they are never copied)
+#define TRACE_BEGIN(name) \
+	do { if (G_UNLIKELY(trace_enabled)) trace_event((name), 'B'); } while (0)
+#define TRACE_END(name) \
+	do { if (G_UNLIKELY(trace_enabled)) trace_event((name), 'E'); } while (0)
+
+// Is tracing enabled? (Read through the macros)
+extern bool trace_enabled;
+
+// Control.
+bool trace_start(const char *fpath);
+bool trace_stop(GError **error);
+
+// Recording.
+void trace_event(const char *name, char phase);
+
+#endif /* _TRACE_H_ */
@@ -0,0 +1,155 @@
+/**
+ * Wiki.c
+ * GTK-free management of the opened Uki workspace.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#include <string.h>
+#include <glib.h>
+#include "Wiki.h"
+#include "History.h"
+#include "Intern.h"
+#include "LinkGraph.h"
+#include "PageIndex.h"
+#include "PageScheduler.h"
+#include "Revisions.h"
+#include "Trace.h"
+
+// Private variables.
+char wiki_root_path[UKI_MAX_PATH];
+bool wiki_opened = false;
+
+// Private methods.
+bool wiki_is_root(const char *dir);
+
+/**
+ * Opens up a Uki workspace.
+ *
+ * @param  root Path to the root of a Uki wiki.
+ * @return      UKI_OK if the operation was successful.
+ */
+uki_error wiki_open(const char *root) {
+	uki_error err;
+
+	// Initialize the uki wiki.
+	TRACE_BEGIN("uki_initialize");
+	err = uki_initialize(root);
+	TRACE_END("uki_initialize");
+	if (err != UKI_OK) {
+		wiki_close();
+		return err;
+	}
+
+	// Store the wiki root.
+	if (wiki_root_path != root)
+		g_strlcpy(wiki_root_path, root, UKI_MAX_PATH);
+
+	// Index the pages for quick lookups.
+	page_index_build();
+
+	// Set the opened flag and return.
+	wiki_opened = true;
+	return UKI_OK;
+}
+
+/**
+ * Closes the workspace.
+ */
+void wiki_close() {
+	// Wait for the background loads and forget about the history and links of
+	// the old workspace.
+	page_scheduler_shutdown();
+	history_clear();
+	link_graph_clear();
+	page_index_clear();
+	revisions_forget();
+	intern_clear();
+
+	// Clean up our Uki mess if there was something to clean up.
+	if (wiki_opened)
+		uki_clean();
+
+	wiki_opened = false;
+}
+
+/**
+ * Is the workspace currently opened?
+ *
+ * @return TRUE if the workspace is opened.
+ */
+bool wiki_is_opened() {
+	return wiki_opened;
+}
+
+/**
+ * Gets the root path of the last opened workspace.
+ *
+ * @return Workspace root path.
+ */
+const char* wiki_root() {
+	return wiki_root_path;
+}
+
+/**
+ * Finds the root of the workspace that a file or folder is in.
+ *
+ * @param  path Path to a page or anything else inside a workspace.
+ * @return      Newly allocated canonical path to the root of the workspace or
+ *              NULL if the path isn't inside one. Free it with g_free().
+ */
+char* wiki_find_root(const char *path) {
+	char *dir;
+	char *parent;
+
+	// Walk up until we find the folders of a workspace.
+	dir = g_canonicalize_filename(path, NULL);
+	while (!wiki_is_root(dir)) {
+		parent = g_path_get_dirname(dir);
+		if (strcmp(parent, dir) == 0) {
+			g_free(parent);
+			g_free(dir);
+
+			return NULL;
+		}
+
+		g_free(dir);
+		dir = parent;
+	}
+
+	return dir;
+}
+
+/**
+ * Checks if a folder is the root of a workspace.
+ *
+ * @param  dir Path to the folder.
+ * @return     TRUE if it has the articles and templates folders.
+ */
+bool wiki_is_root(const char *dir) {
+	char *articles;
+	char *templates;
+	bool found;
+
+	articles = g_build_filename(dir, WIKI_ARTICLES_FOLDER, NULL);
+	templates = g_build_filename(dir, WIKI_TEMPLATES_FOLDER, NULL);
+	found = g_file_test(articles, G_FILE_TEST_IS_DIR) &&
+		g_file_test(templates, G_FILE_TEST_IS_DIR);
+	g_free(articles);
+	g_free(templates);
+
+	return found;
+}
+
+/**
+ * Gets the number of pages of a type available in the workspace.
+ *
+ * @param  type Type of the pages.
+ * @return      Number of pages available.
+ */
+size_t wiki_pages_available(page_type_t type) {
+	if (type == PAGE_TYPE_ARTICLE)
+		return uki_articles_available();
+
+	return uki_templates_available();
+}
@@ -0,0 +1,32 @@
+/**
+ * Wiki.h
+ * GTK-free management of the opened Uki workspace.
+ *
+ * @author Nathan Campos <hi@nathancampos.me>
+ */
+
+#ifndef _WIKI_H_
+#define _WIKI_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <uki/uki.h>
+#include "Page.h"
+
+// Folders that make a folder the root of a workspace.
+#define WIKI_ARTICLES_FOLDER  "articles"
+#define WIKI_TEMPLATES_FOLDER "templates"
+
+// Opening and closing.
+uki_error wiki_open(const char *root);
+void wiki_close();
+
+// State.
+bool wiki_is_opened();
+const char* wiki_root();
+char* wiki_find_root(const char *path);
+
+// Enumeration.
+size_t wiki_pages_available(page_type_t type);
+
+#endif /* _WIKI_H_ */
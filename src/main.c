@@ -10,8 +10,14 @@
 #include <string.h>
 #include <uki/uki.h>
 #include <gtk/gtk.h>
+#include "AppProperties.h"
+#include "CommandLine.h"
 #include "MainWindow.h"
-#include "Workspace.h"
+#include "Replay.h"
+#include "Soak.h"
+#include "SessionManager.h"
+#include "SingleInstance.h"
+#include "Trace.h"
 
 /**
  * Application's main entry point.
@@ -21,11 +27,71 @@
  * @return      Return code.
  */
 int main(int argc, char **argv) {
-	// Initialize GTK and the main window.
-	gtk_init(&argc, &argv);
-	initialize_mainwindow();
+	GError *error = NULL;
+	char *root = NULL;
+	bool headless;
+	int ret = 0;
 
-	// Enter the GTK main loop.
-	gtk_main();
-	return 0;
+	// Parse our options and start tracing if requested.
+	headless = cli_parse(&argc, &argv);
+	trace_start(cli_trace());
+
+	// Work out the workspace the same way whether we open it or hand it over.
+	if (!headless && ((cli_workspace() != NULL) || (cli_page() != NULL)))
+		root = instance_resolve_workspace(cli_workspace(), cli_page());
+
+	if (headless) {
+		// Handle headless operations without ever touching GTK.
+		ret = cli_run();
+	} else if (!cli_new_instance() && (cli_replay() == NULL) &&
+			   (cli_soak() == 0) && instance_forward(root, cli_page())) {
+		// Another instance is already running and took care of it.
+	} else {
+		// Initialize GTK and the main window.
+		gtk_init(&argc, &argv);
+		initialize_mainwindow();
+
+		// Open the workspace and page requested in the command-line. (A page
+		// outside of any workspace is looked for in the one we left off in)
+		if ((root != NULL) || (cli_page() != NULL)) {
+			if ((root == NULL) && (cli_replay() == NULL))
+				restore_session();
+			instance_open_location(root, cli_page());
+		} else if (cli_replay() == NULL) {
+			// Pick up where we left off, unless the replay says where to go.
+			restore_session();
+		}
+
+		// Record or replay the actions taken in the interface, or soak it.
+		if (cli_soak() > 0) {
+			start_soak(cli_soak(), cli_soak_limit());
+		} else if (cli_replay() != NULL) {
+			if (!start_action_replay(cli_replay(), cli_realtime()))
+				ret = EXIT_FAILURE;
+		} else if (cli_record() != NULL) {
+			start_action_recording(cli_record());
+		}
+
+		// Enter the GTK main loop.
+		if (ret == 0) {
+			gtk_main();
+			stop_action_recording();
+			cli_dump_stats();
+			if (cli_soak() > 0) {
+				ret = soak_status();
+			} else if (cli_replay() != NULL) {
+				ret = action_replay_status();
+			}
+		}
+	}
+	instance_release();
+	g_free(root);
+
+	// Write out the trace.
+	if (!trace_stop(&error)) {
+		fprintf(stderr, "%s: %s\n", APP_NAME, error->message);
+		g_error_free(error);
+	}
+
+	return ret;
 }